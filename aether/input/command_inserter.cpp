@@ -11,6 +11,7 @@
 #include <aether/input/commands/help/help.hpp>
 #include <aether/input/commands/stop/stop.hpp>
 #include <aether/input/commands/logs/logs.hpp>
+#include <aether/input/commands/stats/stats.hpp>
 
 namespace input {
     bool command_inserter::has_inserted_default = false;
@@ -25,6 +26,7 @@ namespace input {
         insert_command<commands::help>();
         insert_command<commands::stop>();
         insert_command<commands::logs>();
+        insert_command<commands::stats>();
         has_inserted_default = true;
     }
 }
\ No newline at end of file
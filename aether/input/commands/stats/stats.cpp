@@ -0,0 +1,60 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "stats.hpp"
+#include <aether/proxy/tcp/tunnel/tunnel_loop.hpp>
+
+namespace input::commands {
+    void stats::run(const arguments &args, proxy::server &server, command_service &owner) {
+        auto pool = server.connection_pool_statistics();
+        out::user::log("Connection pool");
+        out::user::stream("  Created: ", pool.created, out::manip::endl);
+        out::user::stream("  Reused: ", pool.reused, out::manip::endl);
+        out::user::stream("  Discarded: ", pool.discarded, out::manip::endl);
+        out::user::stream("  Idle: ", pool.idle, out::manip::endl);
+        auto upstream = server.upstream_pool_statistics();
+        out::user::log("Upstream pool");
+        out::user::stream("  Hits: ", upstream.hits, out::manip::endl);
+        out::user::stream("  Misses: ", upstream.misses, out::manip::endl);
+        out::user::stream("  Stale: ", upstream.stale, out::manip::endl);
+        out::user::stream("  Evicted: ", upstream.evicted, out::manip::endl);
+        out::user::stream("  Idle: ", upstream.idle, out::manip::endl);
+        auto dns = server.dns_cache_statistics();
+        out::user::log("DNS cache");
+        out::user::stream("  Hits: ", dns.hits, out::manip::endl);
+        out::user::stream("  Negative hits: ", dns.negative_hits, out::manip::endl);
+        out::user::stream("  Misses: ", dns.misses, out::manip::endl);
+        out::user::stream("  Collapsed: ", dns.collapsed, out::manip::endl);
+        out::user::stream("  Overrides: ", dns.overrides, out::manip::endl);
+        out::user::stream("  Entries: ", dns.entries, out::manip::endl);
+        auto cache = server.response_cache_statistics();
+        out::user::log("Response cache");
+        out::user::stream("  Hits: ", cache.hits, out::manip::endl);
+        out::user::stream("  Misses: ", cache.misses, out::manip::endl);
+        out::user::stream("  Revalidations: ", cache.revalidations, out::manip::endl);
+        out::user::stream("  Validated: ", cache.validated, out::manip::endl);
+        out::user::stream("  Stores: ", cache.stores, out::manip::endl);
+        out::user::stream("  Rejected: ", cache.rejected, out::manip::endl);
+        out::user::stream("  Evictions: ", cache.evictions, out::manip::endl);
+        out::user::stream("  Invalidations: ", cache.invalidations, out::manip::endl);
+        out::user::stream("  Bytes served: ", cache.bytes_served, out::manip::endl);
+        out::user::stream("  Bytes fetched: ", cache.bytes_fetched, out::manip::endl);
+        out::user::stream("  Entries: ", cache.entries, out::manip::endl);
+        out::user::stream("  Size: ", cache.size, out::manip::endl);
+        auto disk = server.disk_cache_statistics();
+        out::user::log("Disk cache");
+        out::user::stream("  Hits: ", disk.hits, out::manip::endl);
+        out::user::stream("  Stores: ", disk.stores, out::manip::endl);
+        out::user::stream("  Dropped: ", disk.dropped, out::manip::endl);
+        out::user::stream("  Evictions: ", disk.evictions, out::manip::endl);
+        out::user::stream("  Entries: ", disk.entries, out::manip::endl);
+        out::user::stream("  Segments: ", disk.segments, out::manip::endl);
+        out::user::stream("  Size: ", disk.size, out::manip::endl);
+        out::user::log("Tunnels");
+        out::user::stream("  Bytes: ", proxy::tcp::tunnel::tunnel_loop::total_bytes_transferred(), out::manip::endl);
+    }
+}
\ No newline at end of file
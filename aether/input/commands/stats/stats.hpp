@@ -0,0 +1,35 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <aether/input/commands/base_command.hpp>
+#include <aether/util/console.hpp>
+
+namespace input::commands {
+    /*
+        Command that prints the server's internal counters.
+    */
+    class stats
+        : public base_command {
+    public:
+        void run(const arguments &args, proxy::server &server, command_service &caller) override;
+
+        inline std::string name() const override {
+            return "stats";
+        }
+        inline std::string args() const override {
+            return "";
+        }
+        inline std::string description() const override {
+            return "Prints server statistics.";
+        }
+        inline bool uses_signals() const override {
+            return false;
+        }
+    };
+}
\ No newline at end of file
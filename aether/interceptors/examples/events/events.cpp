@@ -21,6 +21,11 @@ namespace interceptors::examples::events {
         out::safe_console::stream(req.get_method(), " request to ", req.get_target().absolute_string(), '\n');
     }
 
+    void on_http_request_body(connection_flow &flow, http::exchange &exch) {
+        http::request &req = exch.request();
+        out::safe_console::stream(req.get_method(), " request body of ", req.get_body().length(), " bytes\n");
+    }
+
     void on_http_connect(connection_flow &flow, http::exchange &exch) {
         http::request &req = exch.request();
         out::safe_console::stream("CONNECT request to ", req.get_target().absolute_string(), '\n');
@@ -36,6 +41,14 @@ namespace interceptors::examples::events {
         out::safe_console::stream("WebSocket handshake request to ", req.get_target().absolute_string(), '\n');
     }
 
+    void on_http_response_head(connection_flow &flow, http::exchange &exch) {
+        http::response &res = exch.response();
+        // Read HTML pages in full, so that on_http_response could rewrite them
+        if (res.has_header("Content-Type") && res.get_header("Content-Type").find("text/html") != std::string::npos) {
+            exch.set_buffer_response(true);
+        }
+    }
+
     void on_http_response(connection_flow &flow, http::exchange &exch) {
         http::response &res = exch.response();
         out::safe_console::stream(res.get_status(), " response from ", exch.request().get_target().absolute_string(), '\n');
@@ -90,9 +103,11 @@ namespace interceptors::examples::events {
         server.interceptors.server.attach(intercept::server_event::disconnect, on_server_disconnect);
 
         server.interceptors.http.attach(intercept::http_event::request, on_http_request);
+        server.interceptors.http.attach(intercept::http_event::request_body, on_http_request_body);
         server.interceptors.http.attach(intercept::http_event::connect, on_http_connect);
         server.interceptors.http.attach(intercept::http_event::any_request, on_http_any_request);
         server.interceptors.http.attach(intercept::http_event::websocket_handshake, on_http_websocket_handshake);
+        server.interceptors.http.attach(intercept::http_event::response_head, on_http_response_head);
         server.interceptors.http.attach(intercept::http_event::response, on_http_response);
         server.interceptors.http.attach(intercept::http_event::error, on_http_error);
 
@@ -30,6 +30,13 @@ namespace interceptors::examples::events {
     */
     void on_http_request(connection_flow &flow, http::exchange &exch);
 
+    /*
+        Fires when an HTTP request has been received along with its entire body.
+        Fires before on_http_request.
+        Attaching to this event keeps the proxy from streaming request bodies.
+    */
+    void on_http_request_body(connection_flow &flow, http::exchange &exch);
+
     /*
         Fires when an HTTP CONNECT request is received.
     */
@@ -46,9 +53,17 @@ namespace interceptors::examples::events {
     */
     void on_http_websocket_handshake(connection_flow &flow, http::exchange &exch);
 
+    /*
+        Fires when the head of an HTTP response is received, before its body is read.
+        Large response bodies are streamed to the client unless exchange::set_buffer_response
+            is called here.
+    */
+    void on_http_response_head(connection_flow &flow, http::exchange &exch);
+
     /*
         Fires when an HTTP response is received and being prepared
             to send to the client.
+        The body is empty if it is being streamed.
     */
     void on_http_response(connection_flow &flow, http::exchange &exch);
 
@@ -32,18 +32,138 @@ namespace program {
             "Number of threads for the server to run.",
             [](auto t) { return t > 0; }, { });
 
+        parser.add_option<bool>("reuse-port", &reuse_port, false,
+            "Opens one SO_REUSEPORT listener per thread so the kernel balances accepts across threads.",
+            { }, { });
+
+        parser.add_option<bool>("incoming-cpu", &incoming_cpu, false,
+            "Pins each thread to a CPU and steers its listener's connections to that CPU. Requires --reuse-port.",
+            { }, { });
+
+        parser.add_option<std::string, proxy::concurrent::scheduler_policy>("scheduler", &scheduler, boost::lexical_cast<std::string>(proxy::concurrent::scheduler_policy::least_connections),
+            "Policy for assigning new connections to threads (round-robin, least-connections, or power-of-two).",
+            &util::validate::lexical_castable<std::string, proxy::concurrent::scheduler_policy>, [](auto p) { return boost::lexical_cast<proxy::concurrent::scheduler_policy>(p); });
+
+        parser.add_option<std::size_t>("recycle-pool-size", &recycle_pool_size, 256,
+            "Maximum number of idle connection objects kept per thread for reuse. Use 0 to disable recycling.",
+            { }, { });
+
+        parser.add_option<std::size_t>("recycle-buffer-limit", &recycle_buffer_limit, 64 * 1024,
+            "Maximum buffer memory (in bytes) a connection may hold and still be recycled.",
+            { }, { });
+
         parser.add_option<std::size_t, proxy::milliseconds>("timeout", &timeout, 120000,
-            "Milliseconds for connect, read, and write operations to timeout.",
+            "Milliseconds for read and write operations to timeout.",
+            [](auto t) { return t != 0; }, [](auto t) { return proxy::milliseconds(t); });
+
+        parser.add_option<std::size_t, proxy::milliseconds>("connect-timeout", &connect_timeout, 30000,
+            "Milliseconds for resolving and connecting to a server to timeout.",
+            [](auto t) { return t != 0; }, [](auto t) { return proxy::milliseconds(t); });
+
+        parser.add_option<std::size_t, std::chrono::milliseconds>("connect-attempt-delay", &connect_attempt_delay, 250,
+            "Milliseconds to wait on a connection attempt before also trying the server's next address. Must be between 10 and 2000.",
+            [](auto t) { return t >= 10 && t <= 2000; }, [](auto t) { return std::chrono::milliseconds(t); });
+
+        parser.add_option<std::size_t, proxy::milliseconds>("idle-timeout", &idle_timeout, 60000,
+            "Milliseconds a client connection may wait for its next request.",
             [](auto t) { return t != 0; }, [](auto t) { return proxy::milliseconds(t); });
 
         parser.add_option<std::size_t, proxy::milliseconds>("tunnel-timeout", &tunnel_timeout, 30000,
             "Milliseconds for tunnel operations to timeout.",
             [](auto t) { return t != 0; }, [](auto t) { return proxy::milliseconds(t); });
 
+        parser.add_option<std::size_t>("tunnel-buffer-size", &tunnel_buffer_size, 256 * 1024,
+            "Size (in bytes) of the buffer for each direction of a tunnel that cannot use splice(). Must be at least 4096.",
+            [](auto s) { return s >= 4096; }, { });
+
+        parser.add_option<std::size_t>("tunnel-read-size", &tunnel_read_size, 64 * 1024,
+            "Maximum number of bytes requested by a single tunnel read.",
+            [](auto s) { return s != 0; }, { });
+
+        parser.add_option<bool>("tunnel-splice", &tunnel_splice, true,
+            "Relays plain TCP tunnels with splice() so data is not copied through the proxy. Linux only.",
+            { }, { });
+
+        parser.add_option<std::size_t>("upstream-pool-size", &upstream_pool_size, 8,
+            "Maximum number of idle upstream connections kept open per server on each thread. 0 disables pooling.",
+            { }, { });
+
+        parser.add_option<std::size_t, std::chrono::milliseconds>("upstream-idle-ttl", &upstream_idle_ttl, 30000,
+            "Milliseconds an idle upstream connection is kept in the pool before it is closed.",
+            [](auto t) { return t != 0; }, [](auto t) { return std::chrono::milliseconds(t); });
+
+        parser.add_option<std::size_t, std::chrono::milliseconds>("dns-cache-ttl", &dns_cache_ttl, 60000,
+            "Milliseconds a resolved host name is cached. 0 disables caching.",
+            { }, [](auto t) { return std::chrono::milliseconds(t); });
+
+        parser.add_option<std::size_t, std::chrono::milliseconds>("dns-negative-ttl", &dns_negative_ttl, 5000,
+            "Milliseconds a failed host name lookup is cached. 0 disables negative caching.",
+            { }, [](auto t) { return std::chrono::milliseconds(t); });
+
+        parser.add_option<std::string>("dns-hosts-file", &dns_hosts_file, "",
+            "Path to a hosts file whose entries override DNS resolution for upstream servers.",
+            [](const std::string &path) { return path.empty() || std::ifstream(path).good(); }, { });
+
+        parser.add_option<std::size_t, std::chrono::milliseconds>("timer-resolution", &timer_resolution, 50,
+            "Milliseconds between ticks of the timer that checks socket timeouts. Must be between 10 and 100.",
+            [](auto t) { return t >= 10 && t <= 100; }, [](auto t) { return std::chrono::milliseconds(t); });
+
+        parser.add_option<bool>("stream-request-body", &stream_request_body, true,
+            "Relays request bodies to the server as they arrive when no interceptor needs the whole request.",
+            { }, { });
+
+        parser.add_option<bool>("stream-response-body", &stream_response_body, true,
+            "Relays large, unbounded, and event-stream response bodies to the client as they arrive.",
+            { }, { });
+
+        parser.add_option<std::size_t>("stream-response-threshold", &stream_response_threshold, 1'048'576, // 1 MB
+            "Size (in bytes) above which a response body is streamed instead of buffered. Must be at least 4096.",
+            [](auto t) { return t >= 4096; }, { });
+
+        parser.add_option<std::size_t>("http-pipeline-depth", &http_pipeline_depth, 8,
+            "Maximum number of pipelined client requests forwarded to the server before the current response arrives. 0 handles requests one at a time.",
+            { }, { });
+
+        parser.add_option<bool>("http2", &http2, true,
+            "Offers HTTP/2 to clients that support it when intercepting TLS.",
+            { }, { });
+
+        parser.add_option<std::size_t>("http2-max-streams", &http2_max_concurrent_streams, 100,
+            "Maximum number of concurrent streams a client may open on one HTTP/2 connection. Must be at least 1.",
+            [](auto n) { return n >= 1; }, { });
+
+        parser.add_option<bool>("http2-upstream", &http2_upstream, true,
+            "Offers HTTP/2 to servers when intercepting TLS. Requests from HTTP/1.1 clients to the same server share its HTTP/2 connections.",
+            { }, { });
+
+        parser.add_option<std::size_t>("http2-upstream-connections", &http2_upstream_connections, 2,
+            "Maximum number of HTTP/2 connections to one server per thread. More are only opened when the others are at their stream limit. Must be at least 1.",
+            [](auto n) { return n >= 1; }, { });
+
         parser.add_option<std::size_t>("body-size-limit", &body_size_limit, 200'000'000, // 200 MB
             "Maximum body size (in bytes) to allow through the proxy. Must be greater than 4096.",
             [](auto l) { return l > 4096; }, { });
 
+        parser.add_option<bool>("cache", &cache, false,
+            "Stores cacheable responses from servers in memory and answers requests with them while they are fresh.",
+            { }, { });
+
+        parser.add_option<std::size_t>("cache-size", &cache_size, 67'108'864, // 64 MB
+            "Memory (in bytes) the response cache may use. Must be at least 1048576.",
+            [](auto s) { return s >= 1'048'576; }, { });
+
+        parser.add_option<std::size_t>("cache-max-object-size", &cache_max_object_size, 1'048'576, // 1 MB
+            "Largest response body (in bytes) the cache keeps in memory. Larger responses are only stored on disk.",
+            { }, { });
+
+        parser.add_option<std::string>("cache-dir", &cache_dir, "",
+            "Folder for the disk tier of the response cache, which holds responses that do not fit in memory. No disk tier is used if empty.",
+            { }, { });
+
+        parser.add_option<std::size_t>("cache-disk-size", &cache_disk_size, 1'073'741'824, // 1 GB
+            "Disk space (in bytes) the response cache may use. Must be at least 67108864.",
+            [](auto s) { return s >= 67'108'864; }, { });
+
         parser.add_option<bool>("ssl-passthrough-strict", &ssl_passthrough_strict, false,
             "Passes all CONNECT requests to a TCP tunnel and does not use TLS services.",
             { }, { });
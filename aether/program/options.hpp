@@ -8,10 +8,12 @@
 #pragma once
 
 #include <string>
+#include <chrono>
 #include <boost/asio.hpp>
 #include <boost/asio/ssl.hpp>
 
 #include <aether/proxy/types.hpp>
+#include <aether/proxy/concurrent/scheduler_policy.hpp>
 #include <aether/util/console.hpp>
 #include <aether/util/validate.hpp>
 #include <aether/util/singleton.hpp>
@@ -47,9 +49,39 @@ namespace program {
         bool help;
         bool ipv6;
         int thread_pool_size;
+        bool reuse_port;
+        bool incoming_cpu;
+        proxy::concurrent::scheduler_policy scheduler;
+        std::size_t recycle_pool_size;
+        std::size_t recycle_buffer_limit;
         proxy::milliseconds timeout { 0 };
+        proxy::milliseconds connect_timeout { 0 };
+        std::chrono::milliseconds connect_attempt_delay { 0 };
+        proxy::milliseconds idle_timeout { 0 };
         proxy::milliseconds tunnel_timeout { 0 };
+        std::chrono::milliseconds timer_resolution { 0 };
+        std::size_t upstream_pool_size;
+        std::chrono::milliseconds upstream_idle_ttl { 0 };
+        std::chrono::milliseconds dns_cache_ttl { 0 };
+        std::chrono::milliseconds dns_negative_ttl { 0 };
+        std::string dns_hosts_file;
+        bool tunnel_splice;
+        std::size_t tunnel_buffer_size;
+        std::size_t tunnel_read_size;
+        bool stream_request_body;
+        bool stream_response_body;
+        std::size_t stream_response_threshold;
+        std::size_t http_pipeline_depth;
+        bool http2;
+        std::size_t http2_max_concurrent_streams;
+        bool http2_upstream;
+        std::size_t http2_upstream_connections;
         std::size_t body_size_limit;
+        bool cache;
+        std::size_t cache_size;
+        std::size_t cache_max_object_size;
+        std::string cache_dir;
+        std::size_t cache_disk_size;
 
         bool ssl_passthrough;
         bool ssl_passthrough_strict;
@@ -8,17 +8,47 @@
 #include "acceptor.hpp"
 
 namespace proxy {
+    namespace _impl {
+#ifdef SO_REUSEPORT
+        using reuse_port = boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>;
+#endif
+#ifdef SO_INCOMING_CPU
+        using incoming_cpu = boost::asio::detail::socket_option::integer<SOL_SOCKET, SO_INCOMING_CPU>;
+#endif
+    }
+
     acceptor::acceptor(concurrent::io_context_pool &io_contexts, connection::connection_manager &connection_manager)
         : io_contexts(io_contexts),
         endpoint(program::options::instance().ipv6 ? boost::asio::ip::tcp::v6() : boost::asio::ip::tcp::v4(), program::options::instance().port),
-        acc(io_contexts.get_io_context(), endpoint),
         is_stopped(false),
+        is_sharded(program::options::instance().reuse_port),
         connection_manager(connection_manager)
     {
+#ifndef SO_REUSEPORT
+        if (is_sharded) {
+            out::warn::log("SO_REUSEPORT is not supported on this platform. Using a single listener.");
+            is_sharded = false;
+        }
+#endif
+
+        if (is_sharded) {
+            for (std::size_t i = 0; i < io_contexts.pool_size(); ++i) {
+                open_listener(io_contexts.get_io_context(i), i);
+            }
+        }
+        else {
+            open_listener(io_contexts.get_io_context(), 0);
+        }
+    }
+
+    void acceptor::open_listener(boost::asio::io_context &ioc, std::size_t index) {
+        auto acc = std::make_unique<boost::asio::ip::tcp::acceptor>(ioc);
+        acc->open(endpoint.protocol());
+
         boost::system::error_code ec;
         if (program::options::instance().ipv6) {
-            acc.set_option(boost::asio::ip::v6_only(false), ec);
-            acc.set_option(boost::asio::socket_base::send_buffer_size(64 * 1024));
+            acc->set_option(boost::asio::ip::v6_only(false), ec);
+            acc->set_option(boost::asio::socket_base::send_buffer_size(64 * 1024));
             if (ec != boost::system::errc::success) {
                 throw error::ipv6_error_exception(out::string::stream(
                     "Could not configure dual stack socket (error code = ",
@@ -27,42 +57,71 @@ namespace proxy {
                 ));
             }
         }
-        acc.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true), ec);
+        acc->set_option(boost::asio::ip::tcp::acceptor::reuse_address(true), ec);
         if (ec != boost::system::errc::success) {
             throw error::acceptor_error_exception("Could not configure socket option SO_REUSEADDR.");
         }
+
+#ifdef SO_REUSEPORT
+        // Every listener binds the same port, and the kernel distributes incoming connections between them
+        if (is_sharded) {
+            acc->set_option(_impl::reuse_port(true), ec);
+            if (ec != boost::system::errc::success) {
+                throw error::acceptor_error_exception("Could not configure socket option SO_REUSEPORT.");
+            }
+
+#ifdef SO_INCOMING_CPU
+            // Prefer the listener whose thread is pinned to the core that received the packets
+            // Failure is not fatal, the kernel simply falls back to hashing
+            if (program::options::instance().incoming_cpu) {
+                int cpu = static_cast<int>(index % std::max(std::thread::hardware_concurrency(), 1u));
+                acc->set_option(_impl::incoming_cpu(cpu), ec);
+            }
+#endif
+        }
+#endif
+
+        acc->bind(endpoint, ec);
+        if (ec != boost::system::errc::success) {
+            throw error::acceptor_error_exception(out::string::stream("Could not bind to ", endpoint, " (", ec.message(), ')'));
+        }
+
+        listeners.push_back(std::move(acc));
     }
 
     void acceptor::start() {
-        acc.listen();
-        init_accept();
+        for (std::size_t i = 0; i < listeners.size(); ++i) {
+            listeners[i]->listen();
+            init_accept(i);
+        }
     }
 
     void acceptor::stop() {
         is_stopped.store(true);
     }
 
-    void acceptor::init_accept() {
-        auto &new_connection = connection_manager.new_connection(io_contexts.get_io_context());
+    void acceptor::init_accept(std::size_t index) {
+        // A sharded listener keeps its connections on its own io_context
+        auto &new_connection = connection_manager.new_connection(is_sharded ? io_contexts.get_io_context(index) : io_contexts.select_io_context());
 
-        acc.async_accept(new_connection.client.get_socket(),
-            boost::bind(&acceptor::on_accept, this, std::ref(new_connection), boost::asio::placeholders::error));
+        listeners[index]->async_accept(new_connection.client.get_socket(),
+            boost::bind(&acceptor::on_accept, this, index, std::ref(new_connection), boost::asio::placeholders::error));
     }
 
-    void acceptor::on_accept(connection::connection_flow &connection, const boost::system::error_code &error) {
+    void acceptor::on_accept(std::size_t index, connection::connection_flow &connection, const boost::system::error_code &error) {
         if (error != boost::system::errc::success) {
             connection_manager.destroy(connection);
-            init_accept();
+            init_accept(index);
             throw error::acceptor_error_exception(out::string::stream(error.message(), " (", error, ')'));
         }
 
         connection_manager.start(connection);
 
         if (!is_stopped.load()) {
-            init_accept();
+            init_accept(index);
         }
         else {
-            acc.close();
+            listeners[index]->close();
         }
     }
 
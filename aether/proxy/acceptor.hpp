@@ -8,6 +8,8 @@
 #pragma once
 
 #include <atomic>
+#include <vector>
+#include <memory>
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 #include <boost/lexical_cast.hpp>
@@ -25,13 +27,16 @@ namespace proxy {
     /*
         Wrapping class for boost::asio::ip::tcp::acceptor.
         Accepts new connections.
+        In sharded mode (--reuse-port), one SO_REUSEPORT listener is opened per io_context,
+            and each connection stays on the io_context of the listener that accepted it.
     */
     class acceptor 
         : private boost::noncopyable {
     private:
         boost::asio::ip::tcp::endpoint endpoint;
-        boost::asio::ip::tcp::acceptor acc;
+        std::vector<std::unique_ptr<boost::asio::ip::tcp::acceptor>> listeners;
         std::atomic<bool> is_stopped;
+        bool is_sharded;
 
         // Dependency injection services
         // Owned by server object (which owns this object)
@@ -39,13 +44,18 @@ namespace proxy {
         concurrent::io_context_pool &io_contexts;
         connection::connection_manager &connection_manager;
 
+        /*
+            Opens, configures, and binds a new listener on the given io_context.
+        */
+        void open_listener(boost::asio::io_context &ioc, std::size_t index);
+
     public:
         acceptor(concurrent::io_context_pool &io_contexts, connection::connection_manager &connection_manager);
 
         void start();
         void stop();
-        void init_accept();
-        void on_accept(connection::connection_flow &connection, const boost::system::error_code &error);
+        void init_accept(std::size_t index);
+        void on_accept(std::size_t index, connection::connection_flow &connection, const boost::system::error_code &error);
         
         boost::asio::ip::tcp::endpoint get_endpoint() const;
     };
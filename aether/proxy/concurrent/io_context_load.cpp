@@ -0,0 +1,69 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "io_context_load.hpp"
+
+namespace proxy::concurrent {
+    boost::asio::execution_context::id io_context_load::id;
+
+    io_context_load::io_context_load(boost::asio::io_context &ioc)
+        : boost::asio::execution_context::service(ioc),
+        flows(0),
+        pending_operations(0),
+        window_bytes(0),
+        window_start(now()),
+        last_bytes_per_second(0)
+    { }
+
+    void io_context_load::shutdown() { }
+
+    std::int64_t io_context_load::now() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void io_context_load::flow_started() {
+        flows.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void io_context_load::flow_finished() {
+        flows.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    void io_context_load::operation_started() {
+        pending_operations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void io_context_load::operation_finished(std::size_t bytes_transferred) {
+        pending_operations.fetch_sub(1, std::memory_order_relaxed);
+        window_bytes.fetch_add(bytes_transferred, std::memory_order_relaxed);
+    }
+
+    std::size_t io_context_load::live_flows() const {
+        return flows.load(std::memory_order_relaxed);
+    }
+
+    std::size_t io_context_load::queue_depth() const {
+        return pending_operations.load(std::memory_order_relaxed);
+    }
+
+    std::size_t io_context_load::bytes_per_second() {
+        std::int64_t start = window_start.load(std::memory_order_relaxed);
+        std::int64_t current = now();
+        std::int64_t elapsed = current - start;
+
+        // Only one thread closes the window, the rest use the last sample
+        if (elapsed >= sample_interval.count() && window_start.compare_exchange_strong(start, current)) {
+            std::uint64_t bytes = window_bytes.exchange(0, std::memory_order_relaxed);
+            last_bytes_per_second.store(static_cast<std::size_t>(bytes * 1000 / elapsed), std::memory_order_relaxed);
+        }
+        return last_bytes_per_second.load(std::memory_order_relaxed);
+    }
+
+    std::size_t io_context_load::score() {
+        return live_flows() + queue_depth() + bytes_per_second() / bytes_per_second_per_flow;
+    }
+}
\ No newline at end of file
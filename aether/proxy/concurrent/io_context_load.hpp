@@ -0,0 +1,77 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <boost/asio.hpp>
+
+namespace proxy::concurrent {
+    /*
+        Load statistics for a single io_context.
+        Attached to each io_context as an Asio service, so any object holding an io_context
+            can report load without a reference to the io_context pool.
+        All counters are atomic because flows may be created on a different thread than the one
+            running the io_context.
+    */
+    class io_context_load
+        : public boost::asio::execution_context::service {
+    public:
+        static boost::asio::execution_context::id id;
+
+        // Throughput (in bytes per second) that weighs as much as a single live flow
+        static constexpr std::size_t bytes_per_second_per_flow = 1024 * 1024;
+
+        // Minimum amount of time between throughput samples
+        static constexpr std::chrono::milliseconds sample_interval { 1000 };
+
+    private:
+        std::atomic<std::size_t> flows;
+        std::atomic<std::size_t> pending_operations;
+        std::atomic<std::uint64_t> window_bytes;
+        std::atomic<std::int64_t> window_start;
+        std::atomic<std::size_t> last_bytes_per_second;
+
+        static std::int64_t now();
+
+        void shutdown() override;
+
+    public:
+        explicit io_context_load(boost::asio::io_context &ioc);
+
+        void flow_started();
+        void flow_finished();
+
+        /*
+            Marks an asynchronous operation as queued on the io_context.
+        */
+        void operation_started();
+
+        /*
+            Marks an asynchronous operation as completed, recording the bytes it transferred.
+        */
+        void operation_finished(std::size_t bytes_transferred = 0);
+
+        std::size_t live_flows() const;
+        std::size_t queue_depth() const;
+
+        /*
+            Returns the throughput of the io_context over the last sample window.
+            Starts a new sample window if the current one is older than sample_interval.
+        */
+        std::size_t bytes_per_second();
+
+        /*
+            Returns a single comparable load score.
+            Live flows, pending operations, and throughput (scaled by bytes_per_second_per_flow)
+                are weighted equally.
+        */
+        std::size_t score();
+    };
+}
\ No newline at end of file
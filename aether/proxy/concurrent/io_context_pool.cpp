@@ -7,10 +7,18 @@
 
 #include "io_context_pool.hpp"
 
+#include <random>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 namespace proxy::concurrent {
-    io_context_pool::io_context_pool(std::size_t size) 
+    io_context_pool::io_context_pool(std::size_t size, scheduler_policy policy)
         : next(0),
-        size(size)
+        size(size),
+        policy(policy)
     {
         if (size == 0) {
             throw error::invalid_option_exception("Number of threads cannot be 0");
@@ -19,6 +27,7 @@ namespace proxy::concurrent {
         for (std::size_t i = 0; i < size; ++i) {
             std::unique_ptr<boost::asio::io_context> new_service = std::make_unique<boost::asio::io_context>();
             boost::asio::io_context::work new_work(*new_service);
+            loads.push_back(&boost::asio::use_service<io_context_load>(*new_service));
             io_contexts.push_back(std::move(new_service));
             work.push_back(new_work);
         }
@@ -27,6 +36,15 @@ namespace proxy::concurrent {
     void io_context_pool::run(const std::function<void(boost::asio::io_context &ioc)> &thread_fun) {
         for (std::size_t i = 0; i < size; ++i) {
             std::unique_ptr<std::thread> thr = std::make_unique<std::thread>(boost::bind(thread_fun, std::ref(*io_contexts[i])));
+#ifdef __linux__
+            // Keep each thread on the core its listener steers connections to
+            if (program::options::instance().incoming_cpu) {
+                cpu_set_t cpus;
+                CPU_ZERO(&cpus);
+                CPU_SET(i % std::max(std::thread::hardware_concurrency(), 1u), &cpus);
+                pthread_setaffinity_np(thr->native_handle(), sizeof(cpus), &cpus);
+            }
+#endif
             thread_pool.push_back(std::move(thr));
         }
     }
@@ -43,9 +61,63 @@ namespace proxy::concurrent {
         }
     }
 
+    std::size_t io_context_pool::next_index() {
+        return next.fetch_add(1, std::memory_order_relaxed) % size;
+    }
+
+    std::size_t io_context_pool::least_loaded_index() {
+        // Start at a rotating index so ties do not always land on the first io_context
+        std::size_t start = next_index();
+        std::size_t best = start;
+        std::size_t best_score = loads[start]->score();
+        for (std::size_t i = 1; i < size && best_score != 0; ++i) {
+            std::size_t index = (start + i) % size;
+            std::size_t score = loads[index]->score();
+            if (score < best_score) {
+                best = index;
+                best_score = score;
+            }
+        }
+        return best;
+    }
+
+    std::size_t io_context_pool::power_of_two_index() {
+        if (size == 1) {
+            return 0;
+        }
+
+        thread_local std::minstd_rand generator { std::random_device { }() };
+        std::uniform_int_distribution<std::size_t> distribution(0, size - 1);
+        std::size_t first = distribution(generator);
+        std::size_t second = distribution(generator);
+        if (first == second) {
+            second = (second + 1) % size;
+        }
+        return loads[second]->score() < loads[first]->score() ? second : first;
+    }
+
     boost::asio::io_context &io_context_pool::get_io_context() {
-        auto &out = io_contexts[next];
-        next = (next + 1) % size;
-        return *out;
+        return *io_contexts[next_index()];
+    }
+
+    boost::asio::io_context &io_context_pool::select_io_context() {
+        switch (policy) {
+            case scheduler_policy::least_connections: return *io_contexts[least_loaded_index()];
+            case scheduler_policy::power_of_two: return *io_contexts[power_of_two_index()];
+            case scheduler_policy::round_robin:
+            default: return *io_contexts[next_index()];
+        }
+    }
+
+    boost::asio::io_context &io_context_pool::get_io_context(std::size_t index) {
+        return *io_contexts[index % size];
+    }
+
+    std::size_t io_context_pool::pool_size() const {
+        return size;
+    }
+
+    io_context_load &io_context_pool::get_load(std::size_t index) {
+        return *loads[index % size];
     }
 }
\ No newline at end of file
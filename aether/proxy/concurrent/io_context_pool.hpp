@@ -8,6 +8,7 @@
 #pragma once
 
 #include <vector>
+#include <atomic>
 #include <thread>
 #include <memory>
 #include <functional>
@@ -17,6 +18,9 @@
 
 #include <aether/proxy/types.hpp>
 #include <aether/proxy/error/exceptions.hpp>
+#include <aether/proxy/concurrent/io_context_load.hpp>
+#include <aether/proxy/concurrent/scheduler_policy.hpp>
+#include <aether/program/options.hpp>
 #include <aether/util/console.hpp>
 
 namespace proxy::concurrent {
@@ -34,17 +38,29 @@ namespace proxy::concurrent {
 
         std::vector<std::unique_ptr<std::thread>> thread_pool;
 
+        // Load statistics for each io_context, owned by the io_context itself
+        std::vector<io_context_load *> loads;
+
         // The index of the next io_context to give
-        std::size_t next;
+        // Atomic because io_contexts are given out from multiple threads
+        std::atomic<std::size_t> next;
 
         // The number of io_contexts
         std::size_t size;
 
+        // How new connection flows are assigned to io_contexts
+        scheduler_policy policy;
+
+        std::size_t next_index();
+        std::size_t least_loaded_index();
+        std::size_t power_of_two_index();
+
     public:
-        io_context_pool(std::size_t size);
+        io_context_pool(std::size_t size, scheduler_policy policy = scheduler_policy::round_robin);
 
         /*
             Runs a single io_context in a thread that starts at the function given.
+            If CPU steering is enabled, each thread is pinned to the core matching its index.
         */
         void run(const std::function<void(boost::asio::io_context &ioc)> &thread_fun);
 
@@ -52,6 +68,30 @@ namespace proxy::concurrent {
             Stops all io_contexts.
         */
         void stop();
+
+        /*
+            Returns the next io_context in round-robin order.
+        */
         boost::asio::io_context &get_io_context();
+
+        /*
+            Selects the io_context for a new connection flow according to the scheduler policy.
+        */
+        boost::asio::io_context &select_io_context();
+
+        /*
+            Returns the io_context at the given index, which is always run by the same thread.
+        */
+        boost::asio::io_context &get_io_context(std::size_t index);
+
+        /*
+            Returns the number of io_contexts in the pool.
+        */
+        std::size_t pool_size() const;
+
+        /*
+            Returns the load statistics for the io_context at the given index.
+        */
+        io_context_load &get_load(std::size_t index);
     };
 }
\ No newline at end of file
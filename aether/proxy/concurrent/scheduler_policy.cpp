@@ -0,0 +1,46 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "scheduler_policy.hpp"
+
+namespace proxy::concurrent {
+    namespace convert {
+        struct scheduler_policy_map
+            : public std::unordered_map<std::string, scheduler_policy, util::string::ihash, util::string::iequals> {
+            scheduler_policy_map() {
+#define X(name, str) this->operator[](str) = scheduler_policy::name;
+                SCHEDULER_POLICIES(X)
+#undef X
+            }
+        };
+
+        scheduler_policy to_scheduler_policy(const std::string &str) {
+            static scheduler_policy_map map;
+            auto ptr = map.find(str);
+            if (ptr == map.end()) {
+                throw error::invalid_option_exception { "Invalid scheduler policy" };
+            }
+            return ptr->second;
+        }
+    }
+
+    std::ostream &operator<<(std::ostream &output, scheduler_policy policy) {
+        return output << convert::to_string(policy);
+    }
+}
+
+namespace boost {
+    template <>
+    proxy::concurrent::scheduler_policy lexical_cast(const std::string &str) {
+        try {
+            return proxy::concurrent::convert::to_scheduler_policy(str);
+        }
+        catch (...) {
+            throw bad_lexical_cast { };
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <boost/lexical_cast.hpp>
+
+#include <aether/util/string.hpp>
+#include <aether/proxy/error/exceptions.hpp>
+
+// Policies for assigning new connection flows to io_contexts
+#define SCHEDULER_POLICIES(X) \
+X(round_robin, "round-robin") \
+X(least_connections, "least-connections") \
+X(power_of_two, "power-of-two")
+
+namespace proxy::concurrent {
+    /*
+        Enumeration type for how the io_context pool assigns new connection flows.
+    */
+    enum class scheduler_policy {
+#define X(name, str) name,
+        SCHEDULER_POLICIES(X)
+#undef X
+    };
+
+    namespace convert {
+        constexpr std::string_view to_string(scheduler_policy policy) {
+            switch (policy) {
+#define X(name, str) case scheduler_policy::name: return str;
+                SCHEDULER_POLICIES(X)
+#undef X
+            }
+            throw error::invalid_option_exception { "Invalid scheduler policy" };
+        }
+
+        scheduler_policy to_scheduler_policy(const std::string &str);
+    }
+
+    std::ostream &operator<<(std::ostream &output, scheduler_policy policy);
+}
+
+namespace boost {
+    template <>
+    proxy::concurrent::scheduler_policy lexical_cast(const std::string &str);
+}
\ No newline at end of file
@@ -0,0 +1,210 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "timing_wheel.hpp"
+#include <aether/program/options.hpp>
+
+namespace proxy::concurrent {
+    boost::asio::execution_context::id timing_wheel::id;
+
+    timing_wheel::entry::entry()
+        : prev(nullptr),
+        next(nullptr),
+        expiry(0),
+        handler()
+    { }
+
+    timing_wheel::entry::entry(const callback &handler)
+        : prev(nullptr),
+        next(nullptr),
+        expiry(0),
+        handler(handler)
+    { }
+
+    bool timing_wheel::entry::armed() const {
+        return prev != nullptr;
+    }
+
+    timing_wheel::timing_wheel(boost::asio::io_context &ioc)
+        : boost::asio::execution_context::service(ioc),
+        ticker(ioc),
+        resolution(program::options::instance().timer_resolution),
+        epoch(std::chrono::steady_clock::now()),
+        current_tick(0),
+        armed_entries(0),
+        ticking(false)
+    {
+        // Every slot is the sentinel of a circular list
+        for (auto &lvl : wheel) {
+            for (auto &s : lvl) {
+                s.prev = &s;
+                s.next = &s;
+            }
+        }
+    }
+
+    void timing_wheel::shutdown() {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &lvl : wheel) {
+            for (auto &s : lvl) {
+                while (s.next != &s) {
+                    unlink(*s.next);
+                }
+            }
+        }
+        armed_entries = 0;
+        ticking = false;
+        boost::system::error_code error;
+        ticker.cancel(error);
+    }
+
+    std::uint64_t timing_wheel::elapsed_ticks() const {
+        return static_cast<std::uint64_t>((std::chrono::steady_clock::now() - epoch) / resolution);
+    }
+
+    void timing_wheel::link(slot &list, entry &e) {
+        e.prev = list.prev;
+        e.next = &list;
+        list.prev->next = &e;
+        list.prev = &e;
+    }
+
+    void timing_wheel::unlink(entry &e) {
+        e.prev->next = e.next;
+        e.next->prev = e.prev;
+        e.prev = nullptr;
+        e.next = nullptr;
+    }
+
+    void timing_wheel::place(entry &e) {
+        // Already expired, fire on the next processed tick
+        if (e.expiry < current_tick) {
+            e.expiry = current_tick;
+        }
+
+        std::uint64_t delta = e.expiry - current_tick;
+        if (delta >= max_ticks) {
+            e.expiry = current_tick + max_ticks - 1;
+            delta = max_ticks - 1;
+        }
+
+        std::size_t level_index = 0;
+        while (delta >= (std::uint64_t(1) << (slot_bits * (level_index + 1)))) {
+            ++level_index;
+        }
+        std::size_t slot_index = static_cast<std::size_t>(e.expiry >> (slot_bits * level_index)) & slot_mask;
+        link(wheel[level_index][slot_index], e);
+    }
+
+    void timing_wheel::cascade(std::size_t level_index, std::size_t slot_index) {
+        slot &s = wheel[level_index][slot_index];
+        // Detach the whole list first, since entries may be placed back in the same slot
+        slot pending;
+        if (s.next == &s) {
+            return;
+        }
+        pending.next = s.next;
+        pending.prev = s.prev;
+        pending.next->prev = &pending;
+        pending.prev->next = &pending;
+        s.next = &s;
+        s.prev = &s;
+
+        while (pending.next != &pending) {
+            entry &e = *pending.next;
+            unlink(e);
+            place(e);
+        }
+    }
+
+    void timing_wheel::process_tick() {
+        std::size_t index = static_cast<std::size_t>(current_tick) & slot_mask;
+
+        // Lower level wrapped around, pull down the entries of the next level's slot
+        for (std::size_t level_index = 1; index == 0 && level_index < levels; ++level_index) {
+            index = static_cast<std::size_t>(current_tick >> (slot_bits * level_index)) & slot_mask;
+            cascade(level_index, index);
+        }
+
+        // Handlers are called with the wheel locked, so destroying an entry waits for them to finish
+        // A handler must not arm or cancel entries itself
+        slot &expired = wheel[0][static_cast<std::size_t>(current_tick) & slot_mask];
+        while (expired.next != &expired) {
+            entry &e = *expired.next;
+            unlink(e);
+            --armed_entries;
+            e.handler();
+        }
+
+        ++current_tick;
+    }
+
+    void timing_wheel::schedule_tick() {
+        ticking = true;
+        ticker.expires_at(epoch + resolution * static_cast<std::int64_t>(current_tick + 1));
+        ticker.async_wait(boost::bind(&timing_wheel::on_tick, this, boost::asio::placeholders::error));
+    }
+
+    void timing_wheel::on_tick(const boost::system::error_code &error) {
+        if (error == boost::asio::error::operation_aborted) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        std::uint64_t target = elapsed_ticks();
+        while (current_tick <= target) {
+            process_tick();
+        }
+
+        // Stop ticking while the wheel is empty, the next arm call restarts it
+        if (armed_entries == 0) {
+            ticking = false;
+        }
+        else {
+            schedule_tick();
+        }
+    }
+
+    void timing_wheel::arm(entry &e, const milliseconds &delay) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::uint64_t now = elapsed_ticks();
+
+        if (e.armed()) {
+            unlink(e);
+        }
+        else {
+            ++armed_entries;
+        }
+
+        // Nothing else is in the wheel, so it can jump straight to the current time
+        if (!ticking) {
+            current_tick = now;
+        }
+
+        std::int64_t ms = delay.total_milliseconds();
+        std::uint64_t ticks = ms <= 0 ? 0 : static_cast<std::uint64_t>((ms + resolution.count() - 1) / resolution.count());
+        e.expiry = now + ticks;
+        place(e);
+
+        if (!ticking) {
+            schedule_tick();
+        }
+    }
+
+    void timing_wheel::cancel(entry &e) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (e.armed()) {
+            unlink(e);
+            --armed_entries;
+        }
+    }
+
+    std::size_t timing_wheel::size() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return armed_entries;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,121 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <aether/proxy/types.hpp>
+
+namespace proxy::concurrent {
+    /*
+        Hierarchical timing wheel for coarse socket deadlines.
+        Attached to each io_context as an Asio service, so every connection on an io_context
+            shares a single underlying timer instead of arming its own.
+        Arming, re-arming, and cancelling an entry are O(1) intrusive list operations.
+        Expired entries are fired in batches, once per tick.
+    */
+    class timing_wheel
+        : public boost::asio::execution_context::service {
+    public:
+        static boost::asio::execution_context::id id;
+
+        static constexpr std::size_t slot_bits = 6;
+        static constexpr std::size_t slots_per_level = 1 << slot_bits;
+        static constexpr std::size_t slot_mask = slots_per_level - 1;
+        static constexpr std::size_t levels = 4;
+
+        // Longest delay (in ticks) that can be stored without being clamped
+        static constexpr std::uint64_t max_ticks = std::uint64_t(1) << (slot_bits * levels);
+
+        /*
+            A single deadline that can be linked into the wheel.
+            Owned by the caller, the wheel only links it into its slots.
+            Must be cancelled before it is destroyed.
+        */
+        class entry
+            : private boost::noncopyable {
+            friend class timing_wheel;
+
+        private:
+            entry *prev;
+            entry *next;
+            std::uint64_t expiry;
+            callback handler;
+
+        public:
+            entry();
+            entry(const callback &handler);
+
+            bool armed() const;
+        };
+
+    private:
+        using slot = entry;
+        using level = std::array<slot, slots_per_level>;
+
+        std::mutex mutex;
+        boost::asio::steady_timer ticker;
+        std::chrono::milliseconds resolution;
+        std::chrono::steady_clock::time_point epoch;
+        std::array<level, levels> wheel;
+
+        // Next tick to be processed
+        std::uint64_t current_tick;
+        std::size_t armed_entries;
+        bool ticking;
+
+        std::uint64_t elapsed_ticks() const;
+
+        static void link(slot &list, entry &e);
+        static void unlink(entry &e);
+
+        /*
+            Places an entry in the slot matching its expiry relative to current_tick.
+        */
+        void place(entry &e);
+
+        /*
+            Moves every entry in a higher-level slot down to the level matching its remaining time.
+        */
+        void cascade(std::size_t level_index, std::size_t slot_index);
+
+        /*
+            Processes a single tick, cascading higher levels and firing expired entries.
+        */
+        void process_tick();
+
+        void schedule_tick();
+        void on_tick(const boost::system::error_code &error);
+
+        void shutdown() override;
+
+    public:
+        explicit timing_wheel(boost::asio::io_context &ioc);
+
+        /*
+            Links the entry into the wheel to fire after the given delay.
+            An already armed entry is moved to its new slot.
+            Delays are rounded up to the next tick.
+        */
+        void arm(entry &e, const milliseconds &delay);
+
+        /*
+            Unlinks the entry so that it will not fire.
+            Does nothing if the entry is not armed.
+        */
+        void cancel(entry &e);
+
+        std::size_t size();
+    };
+}
\ No newline at end of file
@@ -11,10 +11,11 @@
 namespace proxy::connection {
     base_connection::base_connection(boost::asio::io_context &ioc)
         : ioc(ioc),
+        load(boost::asio::use_service<concurrent::io_context_load>(ioc)),
         // TODO: boost::asio::detail::win_mutex leak
         strand(boost::asio::make_strand(ioc)),
-        socket(strand),
-        timeout(ioc),
+        socket(std::make_unique<boost::asio::ip::tcp::socket>(strand)),
+        timeout(ioc, boost::bind(&base_connection::on_timeout, this)),
         mode(io_mode::regular),
         tls_established(false),
         secure_socket(),
@@ -24,12 +25,65 @@ namespace proxy::connection {
 
     base_connection::~base_connection() { }
 
-    void base_connection::set_timeout() {
+    base_connection::io_completion::io_completion(ptr self, io_callback &&handler, completion_function complete, handler_memory &memory)
+        : self(std::move(self)),
+        handler(std::move(handler)),
+        complete(complete),
+        memory(&memory)
+    { }
+
+    base_connection::io_completion::allocator_type base_connection::io_completion::get_allocator() const noexcept {
+        return allocator_type(*memory);
+    }
+
+    void base_connection::io_completion::operator()(const boost::system::error_code &error, std::size_t bytes_transferred) {
+        ((*self).*complete)(handler, error, bytes_transferred);
+    }
+
+    void base_connection::io_completion::operator()(const boost::system::error_code &error) {
+        ((*self).*complete)(handler, error, 0);
+    }
+
+    base_connection::io_completion base_connection::make_completion(io_callback &&handler, completion_function complete, handler_memory &memory) {
+        return io_completion(shared_from_this(), std::move(handler), complete, memory);
+    }
+
+    void base_connection::complete(io_callback &handler, const boost::system::error_code &error, std::size_t bytes_transferred) {
+        // Completions run on the strand, which is always inside the io_context's thread
+        if (ioc.get_executor().running_in_this_thread()) {
+            handler(error, bytes_transferred);
+        }
+        else {
+            boost::asio::post(ioc, std::bind(std::move(handler), error, bytes_transferred));
+        }
+    }
+
+    void base_connection::reset() {
+        timeout.cancel_timeout();
+        boost::system::error_code error;
+        socket->close(error);
+        input.consume(input.size());
+        output.consume(output.size());
+        mode = io_mode::regular;
+        tls_established = false;
+        secure_socket.reset();
+        ssl_context.reset();
+        cert = tcp::tls::x509::certificate(nullptr);
+        alpn.clear();
+    }
+
+    void base_connection::set_timeout(deadline operation) {
+        const auto &options = program::options::instance();
         switch (mode) {
+            case io_mode::idle:
+                if (operation == deadline::read) {
+                    timeout.set_timeout(options.idle_timeout); return;
+                }
+                [[fallthrough]];
             case io_mode::regular:
-                timeout.set_timeout(program::options::instance().timeout, boost::bind(&base_connection::on_timeout, this)); return;
+                timeout.set_timeout(operation == deadline::connect ? options.connect_timeout : options.timeout); return;
             case io_mode::tunnel: 
-                timeout.set_timeout(program::options::instance().tunnel_timeout, boost::bind(&base_connection::on_timeout, this)); return;
+                timeout.set_timeout(options.tunnel_timeout); return;
             case io_mode::no_timeout: 
                 return;
         }
@@ -38,9 +92,9 @@ namespace proxy::connection {
     bool base_connection::has_been_closed() {
         boost::system::error_code error;
 
-        socket.non_blocking(true);
-        socket.receive(input.prepare(1), boost::asio::ip::tcp::socket::message_peek, error);
-        socket.non_blocking(false);
+        socket->non_blocking(true);
+        socket->receive(input.prepare(1), boost::asio::ip::tcp::socket::message_peek, error);
+        socket->non_blocking(false);
 
         if (error == boost::asio::error::eof) {
             return true;
@@ -48,6 +102,15 @@ namespace proxy::connection {
         return false;
     }
 
+    bool base_connection::has_pending_input() {
+        if (input.size() != 0) {
+            return true;
+        }
+        boost::system::error_code error;
+        std::size_t pending = socket->available(error);
+        return !error && pending != 0;
+    }
+
     void base_connection::set_mode(io_mode new_mode) {
         mode = new_mode;
     }
@@ -74,14 +137,14 @@ namespace proxy::connection {
     }
 
     std::size_t base_connection::read(std::size_t buffer_size, boost::system::error_code &error) {
-        set_timeout();
+        set_timeout(deadline::read);
         
         std::size_t bytes_read = 0;
         if (tls_established) {
             bytes_read = secure_socket->read_some(input.prepare(buffer_size), error);
         }
         else {
-            bytes_read = socket.read_some(input.prepare(buffer_size), error);
+            bytes_read = socket->read_some(input.prepare(buffer_size), error);
         }
 
         input.commit(bytes_read);
@@ -90,11 +153,11 @@ namespace proxy::connection {
     }
     
     std::size_t base_connection::read_available(boost::system::error_code &error) {
-        socket.non_blocking(true);
+        socket->non_blocking(true);
 
         std::size_t bytes_read = 0;
         if (tls_established) {
-            bytes_read = boost::asio::read(socket, input, error);
+            bytes_read = boost::asio::read(*socket, input, error);
         }
         else {
             bytes_read = boost::asio::read(*secure_socket, input, error);
@@ -103,111 +166,172 @@ namespace proxy::connection {
         if (error == boost::asio::error::would_block) {
             error = boost::system::errc::make_error_code(boost::system::errc::success);
         }
-        socket.non_blocking(false);
+        socket->non_blocking(false);
         return bytes_read;
     }
 
-    void base_connection::read_async(const io_callback &handler) {
-        read_async(default_buffer_size, handler);
+    void base_connection::read_async(io_callback handler) {
+        read_async(default_buffer_size, std::move(handler));
     }
 
-    void base_connection::read_async(std::size_t buffer_size, const io_callback &handler) {
-        set_timeout();
+    void base_connection::read_async(std::size_t buffer_size, io_callback handler) {
+        set_timeout(deadline::read);
+        load.operation_started();
         if (tls_established) {
             secure_socket->async_read_some(input.prepare(buffer_size), boost::asio::bind_executor(strand, 
-                boost::bind(&base_connection::on_read_need_to_commit, shared_from_this(), handler,
-                    boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
+                make_completion(std::move(handler), &base_connection::on_read_need_to_commit, read_memory)));
+        }
+        else {
+            socket->async_read_some(input.prepare(buffer_size), boost::asio::bind_executor(strand,
+                make_completion(std::move(handler), &base_connection::on_read_need_to_commit, read_memory)));
+        }
+    }
+
+    void base_connection::read_async(boost::asio::mutable_buffer buffer, io_callback handler) {
+        set_timeout(deadline::read);
+        load.operation_started();
+        if (tls_established) {
+            secure_socket->async_read_some(buffer, boost::asio::bind_executor(strand,
+                make_completion(std::move(handler), &base_connection::on_read, read_memory)));
         }
         else {
-            socket.async_read_some(input.prepare(buffer_size), boost::asio::bind_executor(strand,
-                boost::bind(&base_connection::on_read_need_to_commit, shared_from_this(), handler,
-                    boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
+            socket->async_read_some(buffer, boost::asio::bind_executor(strand,
+                make_completion(std::move(handler), &base_connection::on_read, read_memory)));
         }
     }
 
-    void base_connection::read_until_async(std::string_view delim, const io_callback &handler) {
-        set_timeout();
+    void base_connection::read_until_async(std::string_view delim, io_callback handler) {
+        set_timeout(deadline::read);
+        load.operation_started();
         if (tls_established) {
             boost::asio::async_read_until(*secure_socket, input, delim, boost::asio::bind_executor(strand,
-                boost::bind(&base_connection::on_read, shared_from_this(), handler,
-                    boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
+                make_completion(std::move(handler), &base_connection::on_read, read_memory)));
         }
         else {
-            boost::asio::async_read_until(socket, input, delim, boost::asio::bind_executor(strand,
-                boost::bind(&base_connection::on_read, shared_from_this(), handler,
-                    boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
+            boost::asio::async_read_until(*socket, input, delim, boost::asio::bind_executor(strand,
+                make_completion(std::move(handler), &base_connection::on_read, read_memory)));
         }
     }
 
-    void base_connection::on_read(const io_callback &handler, const boost::system::error_code &error, std::size_t bytes_transferred) {
+    void base_connection::wait_readable_async(io_callback handler) {
+        set_timeout(deadline::read);
+        load.operation_started();
+        socket->async_wait(boost::asio::ip::tcp::socket::wait_read, boost::asio::bind_executor(strand,
+            make_completion(std::move(handler), &base_connection::on_read, read_memory)));
+    }
+
+    void base_connection::wait_writable_async(io_callback handler) {
+        load.operation_started();
+        socket->async_wait(boost::asio::ip::tcp::socket::wait_write, boost::asio::bind_executor(strand,
+            make_completion(std::move(handler), &base_connection::on_untimed_write, write_memory)));
+    }
+
+    void base_connection::on_read(io_callback &handler, const boost::system::error_code &error, std::size_t bytes_transferred) {
         timeout.cancel_timeout();
-        boost::asio::post(ioc, boost::bind(handler, error, bytes_transferred));
+        load.operation_finished(bytes_transferred);
+        complete(handler, error, bytes_transferred);
     }
 
-    void base_connection::on_read_need_to_commit(const io_callback &handler, const boost::system::error_code &error, std::size_t bytes_transferred) {
+    void base_connection::on_read_need_to_commit(io_callback &handler, const boost::system::error_code &error, std::size_t bytes_transferred) {
         input.commit(bytes_transferred);
         on_read(handler, error, bytes_transferred);
     }
 
     std::size_t base_connection::write(boost::system::error_code &error) {
-        set_timeout();
+        set_timeout(deadline::write);
 
         std::size_t bytes_written = 0;
         if (tls_established) {
             bytes_written = boost::asio::write(*secure_socket, output, error);
         }
         else {
-            bytes_written = boost::asio::write(socket, output, error);
+            bytes_written = boost::asio::write(*socket, output, error);
         }
 
         timeout.cancel_timeout();
         return bytes_written;
     }
 
-    void base_connection::write_async(const io_callback &handler) {
-        set_timeout();
+    void base_connection::write_async(io_callback handler) {
+        set_timeout(deadline::write);
+        load.operation_started();
         if (tls_established) {
             boost::asio::async_write(*secure_socket, output, boost::asio::bind_executor(strand,
-                boost::bind(&base_connection::on_write, shared_from_this(), handler,
-                    boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
+                make_completion(std::move(handler), &base_connection::on_write, write_memory)));
         }
         else {
-            boost::asio::async_write(socket, output, boost::asio::bind_executor(strand,
-                boost::bind(&base_connection::on_write, shared_from_this(), handler,
-                    boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
+            boost::asio::async_write(*socket, output, boost::asio::bind_executor(strand,
+                make_completion(std::move(handler), &base_connection::on_write, write_memory)));
         }
     }
 
-    void base_connection::write_untimed_async(const io_callback &handler) {
+    void base_connection::write_async(const std::array<boost::asio::const_buffer, 2> &buffers, io_callback handler) {
+        if (buffers[0].size() == 0 && buffers[1].size() == 0) {
+            write_async(std::move(handler));
+            return;
+        }
+
+        std::array<boost::asio::const_buffer, 3> sequence = { output.data(), buffers[0], buffers[1] };
+        set_timeout(deadline::write);
+        load.operation_started();
+        if (tls_established) {
+            boost::asio::async_write(*secure_socket, sequence, boost::asio::bind_executor(strand,
+                make_completion(std::move(handler), &base_connection::on_gathered_write, write_memory)));
+        }
+        else {
+            boost::asio::async_write(*socket, sequence, boost::asio::bind_executor(strand,
+                make_completion(std::move(handler), &base_connection::on_gathered_write, write_memory)));
+        }
+    }
+
+    void base_connection::write_untimed_async(io_callback handler) {
+        load.operation_started();
         if (tls_established) {
             boost::asio::async_write(*secure_socket, output, boost::asio::bind_executor(strand,
-                boost::bind(&base_connection::on_untimed_write, shared_from_this(), handler,
-                    boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
+                make_completion(std::move(handler), &base_connection::on_untimed_write, write_memory)));
+        }
+        else {
+            boost::asio::async_write(*socket, output, boost::asio::bind_executor(strand,
+                make_completion(std::move(handler), &base_connection::on_untimed_write, write_memory)));
+        }
+    }
+
+    void base_connection::write_untimed_async(boost::asio::const_buffer buffer, io_callback handler) {
+        load.operation_started();
+        if (tls_established) {
+            boost::asio::async_write(*secure_socket, buffer, boost::asio::bind_executor(strand,
+                make_completion(std::move(handler), &base_connection::on_untimed_write, write_memory)));
         }
         else {
-            boost::asio::async_write(socket, output, boost::asio::bind_executor(strand,
-            boost::bind(&base_connection::on_untimed_write, shared_from_this(), handler,
-                boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred)));
+            boost::asio::async_write(*socket, buffer, boost::asio::bind_executor(strand,
+                make_completion(std::move(handler), &base_connection::on_untimed_write, write_memory)));
         }
     }
 
-    void base_connection::on_write(const io_callback &handler, const boost::system::error_code &error, std::size_t bytes_transferred) {
+    void base_connection::on_write(io_callback &handler, const boost::system::error_code &error, std::size_t bytes_transferred) {
         timeout.cancel_timeout();
-        boost::asio::post(ioc, boost::bind(handler, error, bytes_transferred));
+        load.operation_finished(bytes_transferred);
+        complete(handler, error, bytes_transferred);
+    }
+
+    void base_connection::on_gathered_write(io_callback &handler, const boost::system::error_code &error, std::size_t bytes_transferred) {
+        output.consume(output.size());
+        on_write(handler, error, bytes_transferred);
     }
 
-    void base_connection::on_untimed_write(const io_callback &handler, const boost::system::error_code &error, std::size_t bytes_transferred) {
-        boost::asio::post(ioc, boost::bind(handler, error, bytes_transferred));
+    void base_connection::on_untimed_write(io_callback &handler, const boost::system::error_code &error, std::size_t bytes_transferred) {
+        load.operation_finished(bytes_transferred);
+        complete(handler, error, bytes_transferred);
     }
 
     void base_connection::shutdown() {
-        socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both);
+        socket->shutdown(boost::asio::ip::tcp::socket::shutdown_both);
     }
 
     void base_connection::on_timeout() {
         // TODO: Maybe ignore error here altogether? Timeout usually means we're finished anyway
         boost::system::error_code error;
-        socket.cancel(error);
+        socket->cancel(error);
         switch (error.value()) {
             case boost::system::errc::success:
             case boost::system::errc::no_such_device_or_address:
@@ -219,18 +343,18 @@ namespace proxy::connection {
     }
 
     void base_connection::cancel(boost::system::error_code &error) {
-        socket.cancel(error);
+        socket->cancel(error);
     }
 
     void base_connection::close() {
         // shutdown();
         // Cancel any pending timeouts
         timeout.cancel_timeout();
-        socket.close();
+        socket->close();
     }
 
     boost::asio::ip::tcp::socket &base_connection::get_socket() {
-        return socket;
+        return *socket;
     }
 
     boost::asio::io_context &base_connection::io_context() {
@@ -238,7 +362,7 @@ namespace proxy::connection {
     }
 
     std::size_t base_connection::available_bytes() const {
-        return socket.available();
+        return socket->available();
     }
 
     std::istream base_connection::input_stream() {
@@ -261,12 +385,16 @@ namespace proxy::connection {
         return input.data();
     }
 
+    std::size_t base_connection::buffer_capacity() const {
+        return input.capacity() + output.capacity();
+    }
+
     boost::asio::ip::tcp::endpoint base_connection::get_endpoint() const {
-        return socket.remote_endpoint();
+        return socket->remote_endpoint();
     }
 
     boost::asio::ip::address base_connection::get_address() const {
-        return socket.remote_endpoint().address();
+        return socket->remote_endpoint().address();
     }
 
     base_connection &base_connection::operator<<(const byte_array &data) {
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <array>
 #include <iterator>
 
 #include <boost/asio.hpp>
@@ -14,7 +15,9 @@
 #include <boost/asio/ssl.hpp>
 
 #include <aether/proxy/types.hpp>
+#include <aether/proxy/connection/handler_memory.hpp>
 #include <aether/proxy/connection/timeout_service.hpp>
+#include <aether/proxy/concurrent/io_context_load.hpp>
 #include <aether/proxy/tcp/tls/openssl/ssl_context.hpp>
 #include <aether/util/console.hpp>
 
@@ -38,11 +41,48 @@ namespace proxy::connection {
         */
         enum class io_mode {
             regular,
+            idle,
             tunnel,
             no_timeout
         };
 
+        /*
+            Enumeration type to represent the kind of operation a timeout is placed on.
+            Each kind has its own deadline in regular mode.
+        */
+        enum class deadline {
+            connect,
+            read,
+            write
+        };
+
     protected:
+        using completion_function = void (base_connection::*)(io_callback &, const boost::system::error_code &, std::size_t);
+
+        /*
+            Move-only completion handler for socket operations.
+            Keeps the connection alive and tells Asio to allocate the operation from the connection's handler memory.
+        */
+        class io_completion {
+        private:
+            ptr self;
+            io_callback handler;
+            completion_function complete;
+            handler_memory *memory;
+
+        public:
+            using allocator_type = handler_allocator<void>;
+
+            io_completion(ptr self, io_callback &&handler, completion_function complete, handler_memory &memory);
+            io_completion(io_completion &&other) = default;
+            io_completion(const io_completion &other) = delete;
+
+            allocator_type get_allocator() const noexcept;
+
+            void operator()(const boost::system::error_code &error, std::size_t bytes_transferred);
+            void operator()(const boost::system::error_code &error);
+        };
+
         static milliseconds default_timeout;
         static milliseconds default_tunnel_timeout;
 
@@ -50,11 +90,18 @@ namespace proxy::connection {
         streambuf output;
 
         boost::asio::io_context &ioc;
+        concurrent::io_context_load &load;
         boost::asio::strand<boost::asio::io_context::executor_type> strand;
-        boost::asio::ip::tcp::socket socket;
+        // Heap allocated so an established connection can be handed to another connection object,
+        // along with the TLS stream that refers to it
+        std::unique_ptr<boost::asio::ip::tcp::socket> socket;
         timeout_service timeout;
         io_mode mode;
 
+        // One read and one write may be in flight at the same time
+        handler_memory read_memory;
+        handler_memory write_memory;
+
         bool tls_established;
         tcp::tls::x509::certificate cert;
         std::unique_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket &>> secure_socket;
@@ -72,38 +119,62 @@ namespace proxy::connection {
         /*
             Handler for asynchronous operation timeouts.
         */
-        void on_timeout();
+        virtual void on_timeout();
 
         /*
-            Turns on the timeout service to cancel the socket after timeout_ms.
+            Turns on the timeout service to cancel the socket after the deadline for the operation.
+            The deadline depends on both the operation and the current mode.
             Must call timeout.cancel_timeout() to stop the timer.
             Calls the handler with a timeout error code if applicable.
         */
-        void set_timeout();
+        void set_timeout(deadline operation);
+
+        /*
+            Wraps a completion callback for a read or write on this connection.
+        */
+        io_completion make_completion(io_callback &&handler, completion_function complete, handler_memory &memory);
+
+        /*
+            Passes the result of an operation to the service that started it.
+            The callback is called directly when already running on the io_context, otherwise it is posted.
+        */
+        void complete(io_callback &handler, const boost::system::error_code &error, std::size_t bytes_transferred);
 
         /*
             Callback for read_async.
             Use when commit is called automatically.
         */
-        void on_read(const io_callback &handler, const boost::system::error_code &error, std::size_t bytes_transferred);
+        void on_read(io_callback &handler, const boost::system::error_code &error, std::size_t bytes_transferred);
 
         /*
             Callback for read_async.
             Commits the bytes_transferred to the buffer.
         */
-        void on_read_need_to_commit(const io_callback &handler, const boost::system::error_code &error, std::size_t bytes_transferred);
+        void on_read_need_to_commit(io_callback &handler, const boost::system::error_code &error, std::size_t bytes_transferred);
 
         /*
             Callback for write_async.
         */
-        void on_write(const io_callback &handler, const boost::system::error_code &error, std::size_t bytes_transferred);
+        void on_write(io_callback &handler, const boost::system::error_code &error, std::size_t bytes_transferred);
+
+        /*
+            Callback for a gathered write_async.
+            Drops the output buffer, which was written without consuming it.
+        */
+        void on_gathered_write(io_callback &handler, const boost::system::error_code &error, std::size_t bytes_transferred);
 
         /*
             Callback for write_untimed_async.
         */
-        void on_untimed_write(const io_callback &handler, const boost::system::error_code &error, std::size_t bytes_transferred);
+        void on_untimed_write(io_callback &handler, const boost::system::error_code &error, std::size_t bytes_transferred);
 
     public:
+        /*
+            Returns the connection to its freshly-constructed state so it can be reused by a new flow.
+            The socket is closed, TLS state is dropped, and buffers are emptied without releasing their memory.
+        */
+        virtual void reset();
+
         void set_mode(io_mode new_mode);
         io_mode get_mode() const;
         bool secured() const;
@@ -120,6 +191,12 @@ namespace proxy::connection {
         */
         bool has_been_closed();
 
+        /*
+            Tests if the peer has sent data that has not been read yet, without reading it.
+            Only meaningful for plain connections, since TLS records may not carry any data.
+        */
+        bool has_pending_input();
+
         /*
             Reads from the socket synchronously with a custom buffer size.
             Calls socket.read_some.
@@ -143,19 +220,40 @@ namespace proxy::connection {
             Reads from the socket asynchronously with a custom buffer size.
             Calls socket.async_read_some.
         */
-        void read_async(std::size_t buffer_size, const io_callback &handler);
+        void read_async(std::size_t buffer_size, io_callback handler);
 
         /*
             Reads from the socket asynchronously.
             Calls socket.async_read_some.
         */
-        void read_async(const io_callback &handler);
+        void read_async(io_callback handler);
+
+        /*
+            Reads from the socket asynchronously into a caller-owned buffer instead of the input buffer.
+            Calls socket.async_read_some.
+        */
+        void read_async(boost::asio::mutable_buffer buffer, io_callback handler);
 
         /*
             Reads from the socket asynchronously until the given delimiter is in the buffer.
             Calls boost::asio::async_read_until.
         */
-        void read_until_async(std::string_view delim, const io_callback &handler);
+        void read_until_async(std::string_view delim, io_callback handler);
+
+        /*
+            Waits asynchronously until the socket has data to read, without reading it.
+            Only meaningful when TLS is not established, since it waits on the raw socket.
+            Calls socket.async_wait.
+        */
+        void wait_readable_async(io_callback handler);
+
+        /*
+            Waits asynchronously until the socket can accept more data, without writing anything.
+            Only meaningful when TLS is not established, since it waits on the raw socket.
+            Does not put a timeout on the operation, like write_untimed_async.
+            Calls socket.async_wait.
+        */
+        void wait_writable_async(io_callback handler);
 
         /*
             Writes to the socket synchronously.
@@ -166,14 +264,27 @@ namespace proxy::connection {
         /*
             Writes to the socket asynchronously using the output buffer.
         */
-        void write_async(const io_callback &handler);
+        void write_async(io_callback handler);
+
+        /*
+            Writes the output buffer followed by caller-owned buffers asynchronously, in a single gathered write.
+            The caller's buffers are not copied, so they must stay valid until the handler is called.
+        */
+        void write_async(const std::array<boost::asio::const_buffer, 2> &buffers, io_callback handler);
 
         /*
             Writes to the socket asynchronously using the output buffer.
             Does not put a timeout on the operation.
             Only use when a timeout is placed on another concurrent operation.
         */
-        void write_untimed_async(const io_callback &handler);
+        void write_untimed_async(io_callback handler);
+
+        /*
+            Writes all of a caller-owned buffer to the socket asynchronously, bypassing the output buffer.
+            Does not put a timeout on the operation.
+            The buffer must stay valid until the handler is called.
+        */
+        void write_untimed_async(boost::asio::const_buffer buffer, io_callback handler);
         
         /*
             Closes the socket.
@@ -219,6 +330,11 @@ namespace proxy::connection {
         */
         const_streambuf const_input_buffer() const;
 
+        /*
+            Returns the memory currently held by the input and output buffers.
+        */
+        std::size_t buffer_capacity() const;
+
         template <typename T>
         base_connection &operator<<(const T &data) {
             std::ostream(&output) << data;
@@ -13,6 +13,13 @@ namespace proxy::connection {
         ssl_method(tcp::tls::openssl::ssl_method::sslv23)
     { }
 
+    void client_connection::reset() {
+        base_connection::reset();
+        sni.clear();
+        cipher_name.clear();
+        ssl_method = tcp::tls::openssl::ssl_method::sslv23;
+    }
+
     void client_connection::establish_tls_async(tcp::tls::openssl::ssl_server_context_args &args, const err_callback &handler) {
         ssl_context = tcp::tls::openssl::create_ssl_context(args.base_args);
         
@@ -38,12 +45,12 @@ namespace proxy::connection {
             }
         }
 
-        secure_socket = std::make_unique<std::remove_reference_t<decltype(*secure_socket)>>(socket, *ssl_context);
+        secure_socket = std::make_unique<std::remove_reference_t<decltype(*secure_socket)>>(*socket, *ssl_context);
         SSL_set_accept_state(secure_socket->native_handle());
 
         secure_socket->async_handshake(boost::asio::ssl::stream_base::handshake_type::server, input.data(),
             boost::asio::bind_executor(strand,
-                boost::bind(&client_connection::on_handshake, this,
+                boost::bind(&client_connection::on_handshake, std::static_pointer_cast<client_connection>(shared_from_this()),
                     boost::asio::placeholders::error, handler)));
     }
 
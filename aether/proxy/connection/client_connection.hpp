@@ -27,6 +27,7 @@ namespace proxy::connection {
 
     public:
         client_connection(boost::asio::io_context &ioc);
+        void reset() override;
         void establish_tls_async(tcp::tls::openssl::ssl_server_context_args &args, const err_callback &handler);
     };
 }
\ No newline at end of file
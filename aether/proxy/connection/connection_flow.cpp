@@ -6,6 +6,7 @@
 *********************************************/
 
 #include "connection_flow.hpp"
+#include "upstream_pool.hpp"
 
 namespace proxy::connection {
     connection_flow::connection_flow(boost::asio::io_context &ioc)
@@ -19,9 +20,32 @@ namespace proxy::connection {
         intercept_websocket_flag(false)
     { }
 
+    void connection_flow::reset() {
+        client.reset();
+        server.reset();
+        target_host.clear();
+        target_port = 0;
+        intercept_tls_flag = false;
+        intercept_websocket_flag = false;
+        error.clear();
+        upstream_session.reset();
+    }
+
+    bool connection_flow::reusable(std::size_t buffer_limit) const {
+        return client_ptr.use_count() == 1 && server_ptr.use_count() == 1
+            && client.buffer_capacity() <= buffer_limit && server.buffer_capacity() <= buffer_limit;
+    }
+
+    void connection_flow::release_server() {
+        // Handlers still holding the connection may yet use it
+        if (server_ptr.use_count() != 1 || !server.release_to_pool()) {
+            server.disconnect();
+        }
+    }
+
     void connection_flow::set_server(const std::string &host, port_t port) {
         if (server.connected()) {
-            server.disconnect();
+            release_server();
         }
         target_host = host;
         target_port = port;
@@ -31,6 +55,14 @@ namespace proxy::connection {
         server.connect_async(target_host, target_port, handler);
     }
 
+    bool connection_flow::reuse_secure_server(const tcp::tls::openssl::ssl_context_args &args) {
+        return server.acquire_pooled(target_host, target_port, upstream_pool::tls_key(args));
+    }
+
+    std::string connection_flow::secure_server_key(const tcp::tls::openssl::ssl_context_args &args) const {
+        return upstream_pool::make_key(target_host, target_port, upstream_pool::tls_key(args));
+    }
+
     void connection_flow::establish_tls_with_client_async(tcp::tls::openssl::ssl_server_context_args &args, const err_callback &handler) {
         client.establish_tls_async(args, handler);
     }
@@ -41,7 +73,12 @@ namespace proxy::connection {
 
     void connection_flow::disconnect() {
         client.close();
-        server.disconnect();
+        if (server.connected()) {
+            release_server();
+        }
+        else {
+            server.disconnect();
+        }
     }
 
     boost::asio::io_context &connection_flow::io_context() const {
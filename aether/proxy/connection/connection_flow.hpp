@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <memory>
 #include <optional>
 #include <boost/asio.hpp>
 
@@ -16,6 +17,10 @@
 #include <aether/proxy/error/error_state.hpp>
 #include <aether/util/identifiable.hpp>
 
+namespace proxy::tcp::http::http2 {
+    class client_session;
+}
+
 namespace proxy::connection {
     /*
         A thin wrapper for a connection pair (client and server).
@@ -40,6 +45,11 @@ namespace proxy::connection {
         bool intercept_tls_flag;
         bool intercept_websocket_flag;
 
+        /*
+            Pools the server connection if possible, otherwise disconnects it.
+        */
+        void release_server();
+
     public:
         // "Interfaces" to the shared pointers
 
@@ -48,12 +58,28 @@ namespace proxy::connection {
 
         error::error_state error;
 
+        // Shared HTTP/2 connection to the intercepted server, used in place of the server connection
+        std::shared_ptr<tcp::http::http2::client_session> upstream_session;
+
         connection_flow(boost::asio::io_context &ioc);
         ~connection_flow() = default;
 
+        /*
+            Returns the flow to its freshly-constructed state so it can be handed to a new client.
+            Both connections are reset, keeping their strands, timers, and buffer memory.
+        */
+        void reset();
+
+        /*
+            Checks if the flow can be safely reset and reused.
+            No asynchronous handlers may still hold the connections, and the buffers
+                must not have grown past the given limit.
+        */
+        bool reusable(std::size_t buffer_limit) const;
+
         /*
             Sets the server to connect to later.
-            Any existing server connection is closed.
+            Any existing server connection is handed to the upstream pool or closed.
         */
         void set_server(const std::string &host, port_t port);
 
@@ -63,6 +89,19 @@ namespace proxy::connection {
         */
         void connect_server_async(const err_callback &handler);
 
+        /*
+            Takes an idle connection to the target server from the upstream pool that was secured with
+                the same TLS parameters, skipping both the connect and the handshake.
+            Set server details using set_server.
+        */
+        bool reuse_secure_server(const tcp::tls::openssl::ssl_context_args &args);
+
+        /*
+            Returns the key connections to the target server secured with the given TLS parameters are pooled under.
+            Set server details using set_server.
+        */
+        std::string secure_server_key(const tcp::tls::openssl::ssl_context_args &args) const;
+
         /*
             Establishes a TLS connection with the client.
         */
@@ -76,6 +115,7 @@ namespace proxy::connection {
         
         /*
             Disconnects both the client and server connections if applicable.
+            A server connection that can be reused is handed to the upstream pool instead.
         */
         void disconnect();
 
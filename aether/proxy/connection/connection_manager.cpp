@@ -8,42 +8,152 @@
 #include "connection_manager.hpp"
 
 namespace proxy::connection {
-    connection_manager::connection_manager(tcp::intercept::interceptor_manager &interceptors)
-        : interceptors(interceptors)
+    connection_manager::shard::shard(concurrent::io_context_load &load)
+        : load(load)
     { }
 
+    connection_manager::connection_manager(concurrent::io_context_pool &io_contexts, tcp::intercept::interceptor_manager &interceptors)
+        : interceptors(interceptors),
+        flows_created(0),
+        flows_reused(0),
+        flows_discarded(0)
+    {
+        for (std::size_t i = 0; i < io_contexts.pool_size(); ++i) {
+            shards.push_back(std::make_unique<shard>(io_contexts.get_load(i)));
+            shard_map.emplace(&io_contexts.get_io_context(i), shards.back().get());
+        }
+    }
+
+    connection_manager::shard &connection_manager::shard_for(const boost::asio::io_context &ioc) {
+        return *shard_map.at(&ioc);
+    }
+
     connection_flow &connection_manager::new_connection(boost::asio::io_context &ioc) {
-        auto ptr = std::make_unique<connection_flow>(ioc);
-        std::lock_guard<std::mutex> lock(data_mutex);
-        auto res = connections.emplace(ptr->id(), std::move(ptr));
-        return *res.first->second;
+        shard &owner = shard_for(ioc);
+        owner.load.flow_started();
+
+        std::unique_ptr<connection_flow> ptr;
+        {
+            std::lock_guard<std::mutex> lock(owner.data_mutex);
+            if (!owner.idle.empty()) {
+                ptr = std::move(owner.idle.back());
+                owner.idle.pop_back();
+            }
+        }
+
+        if (ptr) {
+            flows_reused.fetch_add(1, std::memory_order_relaxed);
+        }
+        else {
+            ptr = std::make_unique<connection_flow>(ioc);
+            flows_created.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        connection_flow &flow = *ptr;
+        std::lock_guard<std::mutex> lock(owner.data_mutex);
+        owner.connections.emplace(flow.id(), std::move(ptr));
+        return flow;
     }
 
     void connection_manager::start(connection_flow &flow) {
-        std::lock_guard<std::mutex> lock(data_mutex);
-        auto res = services.emplace(std::make_unique<connection_handler>(flow, interceptors));
-        connection_handler &new_handler = *res.first->get();
-        new_handler.start(boost::bind(&connection_manager::stop, this, std::cref(*res.first)));
+        shard &owner = shard_for(flow.io_context());
+        auto ptr = std::make_unique<connection_handler>(flow, interceptors);
+        connection_handler &new_handler = *ptr;
+        {
+            std::lock_guard<std::mutex> lock(owner.data_mutex);
+            owner.services.emplace(flow.id(), std::move(ptr));
+        }
+        // Started outside of the lock, since the handler may finish immediately
+        new_handler.start(boost::bind(&connection_manager::stop, this, std::ref(owner), flow.id()));
     }
 
     void connection_manager::destroy(connection_flow &flow) {
-        std::lock_guard<std::mutex> lock(data_mutex);
-        connections.erase(flow.id());
+        shard &owner = shard_for(flow.io_context());
+        std::unique_ptr<connection_flow> removed;
+        {
+            std::lock_guard<std::mutex> lock(owner.data_mutex);
+            auto it = owner.connections.find(flow.id());
+            if (it != owner.connections.end()) {
+                removed = std::move(it->second);
+                owner.connections.erase(it);
+            }
+        }
+        if (removed) {
+            release(owner, std::move(removed));
+        }
     }
 
-    void connection_manager::stop(const std::unique_ptr<connection_handler> &service_ptr) {
-        connection_flow &flow = service_ptr->get_connection_flow();
-        std::lock_guard<std::mutex> lock(data_mutex);
-        services.erase(service_ptr);
-        connections.erase(flow.id());
+    void connection_manager::stop(shard &owner, connection_flow::id_t id) {
+        // Objects are moved out and destroyed after the lock is released
+        std::unique_ptr<connection_handler> service;
+        std::unique_ptr<connection_flow> flow;
+        {
+            std::lock_guard<std::mutex> lock(owner.data_mutex);
+            if (auto it = owner.services.find(id); it != owner.services.end()) {
+                service = std::move(it->second);
+                owner.services.erase(it);
+            }
+            if (auto it = owner.connections.find(id); it != owner.connections.end()) {
+                flow = std::move(it->second);
+                owner.connections.erase(it);
+            }
+        }
+
+        // The service refers to the flow, so it must go first
+        service.reset();
+        if (flow) {
+            release(owner, std::move(flow));
+        }
+    }
+
+    void connection_manager::release(shard &owner, std::unique_ptr<connection_flow> flow) {
+        owner.load.flow_finished();
+
+        const auto &options = program::options::instance();
+        if (options.recycle_pool_size != 0 && flow->reusable(options.recycle_buffer_limit)) {
+            flow->reset();
+            std::lock_guard<std::mutex> lock(owner.data_mutex);
+            if (owner.idle.size() < options.recycle_pool_size) {
+                owner.idle.push_back(std::move(flow));
+                return;
+            }
+        }
+
+        flows_discarded.fetch_add(1, std::memory_order_relaxed);
     }
 
     void connection_manager::stop_all() {
-        std::lock_guard<std::mutex> lock(data_mutex);
-        for (auto &current_service : services) {
-            current_service->stop();
+        for (auto &current_shard : shards) {
+            std::unordered_map<connection_flow::id_t, std::unique_ptr<connection_handler>> services;
+            std::unordered_map<connection_flow::id_t, std::unique_ptr<connection_flow>> connections;
+            {
+                std::lock_guard<std::mutex> lock(current_shard->data_mutex);
+                services.swap(current_shard->services);
+                connections.swap(current_shard->connections);
+            }
+
+            // Stopping a service calls back into stop(), so the shard lock must not be held here
+            for (auto &[id, current_service] : services) {
+                current_service->stop();
+            }
+            for (std::size_t i = 0; i < connections.size(); ++i) {
+                current_shard->load.flow_finished();
+            }
+
+            std::lock_guard<std::mutex> lock(current_shard->data_mutex);
+            current_shard->idle.clear();
+        }
+    }
+
+    connection_manager::pool_statistics connection_manager::get_pool_statistics() {
+        pool_statistics stats { };
+        stats.created = flows_created.load(std::memory_order_relaxed);
+        stats.reused = flows_reused.load(std::memory_order_relaxed);
+        stats.discarded = flows_discarded.load(std::memory_order_relaxed);
+        for (auto &current_shard : shards) {
+            std::lock_guard<std::mutex> lock(current_shard->data_mutex);
+            stats.idle += current_shard->idle.size();
         }
-        services.clear();
-        connections.clear();
+        return stats;
     }
 }
\ No newline at end of file
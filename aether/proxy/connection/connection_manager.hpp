@@ -7,13 +7,18 @@
 
 #pragma once
 
-#include <set>
+#include <atomic>
+#include <memory>
 #include <mutex>
+#include <unordered_map>
+#include <vector>
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
 
 #include <aether/proxy/connection/connection_flow.hpp>
 #include <aether/proxy/connection_handler.hpp>
+#include <aether/proxy/concurrent/io_context_pool.hpp>
+#include <aether/program/options.hpp>
 #include <aether/proxy/tcp/intercept/interceptor_services.hpp>
 
 namespace proxy::connection {
@@ -21,23 +26,68 @@ namespace proxy::connection {
         Small class to manage ongoing connection flows.
         Owns connection flows and connection handlers to assure they are not destroyed until
             their work is finished.
+        Records are sharded by io_context, so threads only contend with the acceptor
+            handing them new connections.
+        Finished connection flows are reset and kept in a per-io_context free list, so
+            steady-state traffic reuses existing sockets, timers, strands, and buffers.
     */
     class connection_manager 
         : private boost::noncopyable {
+    public:
+        /*
+            Counters for the connection flow recycling pool.
+        */
+        struct pool_statistics {
+            // Connection flows allocated from scratch
+            std::size_t created;
+            // Connection flows taken from a free list
+            std::size_t reused;
+            // Finished connection flows that were freed instead of recycled
+            std::size_t discarded;
+            // Connection flows currently waiting in a free list
+            std::size_t idle;
+        };
+
     private:
-        std::mutex data_mutex;
-        std::map<connection_flow::id_t, std::unique_ptr<connection_flow>> connections;
-        std::set<std::unique_ptr<connection_handler>> services;
+        /*
+            Connection flows and handlers for a single io_context.
+        */
+        struct shard {
+            concurrent::io_context_load &load;
+            std::mutex data_mutex;
+            std::unordered_map<connection_flow::id_t, std::unique_ptr<connection_flow>> connections;
+            std::unordered_map<connection_flow::id_t, std::unique_ptr<connection_handler>> services;
+            std::vector<std::unique_ptr<connection_flow>> idle;
+
+            shard(concurrent::io_context_load &load);
+        };
+
+        std::vector<std::unique_ptr<shard>> shards;
+
+        // Built once at construction and only read afterwards, so it needs no lock
+        std::unordered_map<const boost::asio::io_context *, shard *> shard_map;
 
         tcp::intercept::interceptor_manager &interceptors;
 
+        std::atomic<std::size_t> flows_created;
+        std::atomic<std::size_t> flows_reused;
+        std::atomic<std::size_t> flows_discarded;
+
+        shard &shard_for(const boost::asio::io_context &ioc);
+
+        /*
+            Returns a finished connection flow to its shard's free list, or frees it
+                if it cannot be recycled.
+        */
+        void release(shard &owner, std::unique_ptr<connection_flow> flow);
+
         /*
             Stops an existing service, deleting it from the records.
         */
-        void stop(const std::unique_ptr<connection_handler> &service_ptr);
+        void stop(shard &owner, connection_flow::id_t id);
 
     public:
-        connection_manager(tcp::intercept::interceptor_manager &interceptors);
+        connection_manager(concurrent::io_context_pool &io_contexts, tcp::intercept::interceptor_manager &interceptors);
 
         connection_flow &new_connection(boost::asio::io_context &ioc);
 
@@ -57,5 +107,7 @@ namespace proxy::connection {
             Stop all connections immediately.
         */
         void stop_all();
+
+        pool_statistics get_pool_statistics();
     };
 }
\ No newline at end of file
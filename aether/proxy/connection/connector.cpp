@@ -0,0 +1,153 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "connector.hpp"
+
+#include <boost/bind.hpp>
+#include <aether/program/options.hpp>
+
+namespace proxy::connection {
+    connector::connector(boost::asio::strand<boost::asio::io_context::executor_type> &strand,
+        const dns_cache::address_list &addresses, port_t port, dns_cache::address_family preferred)
+        : strand(strand),
+        stagger(strand),
+        attempt_delay(program::options::instance().connect_attempt_delay),
+        attempts(),
+        handler(),
+        next_attempt(0),
+        in_flight(0),
+        finished(false),
+        last_error(boost::asio::error::host_unreachable)
+    {
+        for (const auto &address : interleave(addresses, preferred)) {
+            attempts.push_back({ nullptr, boost::asio::ip::tcp::endpoint(address, port) });
+        }
+    }
+
+    dns_cache::address_list connector::interleave(const dns_cache::address_list &addresses, dns_cache::address_family preferred) {
+        dns_cache::address_list v6;
+        dns_cache::address_list v4;
+        for (const auto &address : addresses) {
+            (address.is_v6() ? v6 : v4).push_back(address);
+        }
+
+        // Without a recorded preference, the family of the first resolved address goes first
+        bool v6_first = preferred == dns_cache::address_family::unknown
+            ? !addresses.empty() && addresses.front().is_v6()
+            : preferred == dns_cache::address_family::v6;
+        auto &first = v6_first ? v6 : v4;
+        auto &second = v6_first ? v4 : v6;
+
+        dns_cache::address_list result;
+        result.reserve(addresses.size());
+        for (std::size_t i = 0; i < first.size() || i < second.size(); ++i) {
+            if (i < first.size()) {
+                result.push_back(first[i]);
+            }
+            if (i < second.size()) {
+                result.push_back(second[i]);
+            }
+        }
+        return result;
+    }
+
+    void connector::connect_async(const connect_callback &handler) {
+        this->handler = handler;
+        start_next();
+    }
+
+    void connector::start_next() {
+        if (finished || next_attempt == attempts.size()) {
+            return;
+        }
+
+        std::size_t index = next_attempt++;
+        auto &next = attempts[index];
+        next.socket = std::make_unique<boost::asio::ip::tcp::socket>(strand);
+        ++in_flight;
+        next.socket->async_connect(next.endpoint, boost::asio::bind_executor(strand,
+            boost::bind(&connector::on_connect, shared_from_this(), boost::asio::placeholders::error, index)));
+
+        if (next_attempt != attempts.size()) {
+            stagger.expires_after(attempt_delay);
+            stagger.async_wait(boost::asio::bind_executor(strand,
+                boost::bind(&connector::on_stagger, shared_from_this(), boost::asio::placeholders::error)));
+        }
+    }
+
+    void connector::on_stagger(const boost::system::error_code &error) {
+        // Cancelled because an attempt finished first, which starts the next attempt itself
+        if (error != boost::asio::error::operation_aborted) {
+            start_next();
+        }
+    }
+
+    void connector::on_connect(const boost::system::error_code &error, std::size_t index) {
+        --in_flight;
+        if (finished) {
+            // Cancelled, report once the last attempt is gone
+            if (in_flight == 0) {
+                complete(boost::asio::error::operation_aborted, nullptr, { });
+            }
+            return;
+        }
+
+        if (error == boost::system::errc::success) {
+            finished = true;
+            close_others(index);
+            complete(error, std::move(attempts[index].socket), attempts[index].endpoint);
+            return;
+        }
+
+        last_error = error;
+        boost::system::error_code close_error;
+        attempts[index].socket->close(close_error);
+
+        // Do not wait out the stagger once an attempt has failed
+        if (next_attempt != attempts.size()) {
+            stagger.cancel();
+            start_next();
+        }
+        else if (in_flight == 0) {
+            finished = true;
+            complete(last_error, nullptr, { });
+        }
+    }
+
+    void connector::close_others(std::size_t keep) {
+        stagger.cancel();
+        for (std::size_t i = 0; i < attempts.size(); ++i) {
+            if (i != keep && attempts[i].socket) {
+                boost::system::error_code error;
+                attempts[i].socket->close(error);
+            }
+        }
+    }
+
+    void connector::cancel() {
+        if (finished) {
+            return;
+        }
+        finished = true;
+        close_others(attempts.size());
+        // Otherwise the last aborted attempt reports the cancellation
+        if (in_flight == 0) {
+            boost::asio::post(strand, [self = shared_from_this()]() {
+                self->complete(boost::asio::error::operation_aborted, nullptr, { });
+            });
+        }
+    }
+
+    void connector::complete(const boost::system::error_code &error, socket_ptr socket, const boost::asio::ip::tcp::endpoint &endpoint) {
+        // Only ever called once
+        connect_callback callback;
+        std::swap(callback, handler);
+        if (callback) {
+            callback(error, std::move(socket), endpoint);
+        }
+    }
+}
\ No newline at end of file
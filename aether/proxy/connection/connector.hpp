@@ -0,0 +1,84 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <aether/proxy/connection/dns_cache.hpp>
+#include <aether/proxy/types.hpp>
+
+namespace proxy::connection {
+    /*
+        Races connection attempts to a list of addresses, as described by Happy Eyeballs (RFC 8305).
+        Address families are interleaved, starting with the family that connected last time.
+        A new attempt starts whenever the previous one fails or after --connect-attempt-delay,
+            whichever comes first.
+        The first socket to connect is kept and every other attempt is closed.
+    */
+    class connector
+        : public std::enable_shared_from_this<connector>,
+        private boost::noncopyable {
+    public:
+        using ptr = std::shared_ptr<connector>;
+        using socket_ptr = std::unique_ptr<boost::asio::ip::tcp::socket>;
+        using connect_callback = std::function<void(const boost::system::error_code &, socket_ptr, const boost::asio::ip::tcp::endpoint &)>;
+
+    private:
+        struct attempt {
+            socket_ptr socket;
+            boost::asio::ip::tcp::endpoint endpoint;
+        };
+
+        boost::asio::strand<boost::asio::io_context::executor_type> strand;
+        boost::asio::steady_timer stagger;
+        std::chrono::milliseconds attempt_delay;
+        std::vector<attempt> attempts;
+        connect_callback handler;
+
+        std::size_t next_attempt;
+        std::size_t in_flight;
+        bool finished;
+        boost::system::error_code last_error;
+
+        /*
+            Starts the next attempt, if any, and restarts the stagger timer.
+        */
+        void start_next();
+        void on_stagger(const boost::system::error_code &error);
+        void on_connect(const boost::system::error_code &error, std::size_t index);
+
+        /*
+            Closes every attempt except the one given and stops the stagger timer.
+        */
+        void close_others(std::size_t keep);
+
+        void complete(const boost::system::error_code &error, socket_ptr socket, const boost::asio::ip::tcp::endpoint &endpoint);
+
+    public:
+        connector(boost::asio::strand<boost::asio::io_context::executor_type> &strand,
+            const dns_cache::address_list &addresses, port_t port, dns_cache::address_family preferred);
+
+        /*
+            Orders addresses for connection attempts, alternating between families.
+            The relative order within each family is preserved.
+        */
+        static dns_cache::address_list interleave(const dns_cache::address_list &addresses, dns_cache::address_family preferred);
+
+        void connect_async(const connect_callback &handler);
+
+        /*
+            Closes every attempt. The handler receives operation_aborted.
+        */
+        void cancel();
+    };
+}
\ No newline at end of file
@@ -0,0 +1,216 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "dns_cache.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <boost/bind.hpp>
+
+#include <aether/program/options.hpp>
+#include <aether/util/console.hpp>
+#include <aether/util/string.hpp>
+
+namespace proxy::connection {
+    boost::asio::execution_context::id dns_cache::id;
+
+    dns_cache::dns_cache(boost::asio::io_context &ioc)
+        : boost::asio::execution_context::service(ioc),
+        ioc(ioc),
+        resolver(ioc),
+        ttl(program::options::instance().dns_cache_ttl),
+        negative_ttl(program::options::instance().dns_negative_ttl),
+        last_sweep(std::chrono::steady_clock::now()),
+        hits(0),
+        negative_hits(0),
+        misses(0),
+        collapsed(0),
+        overrides(0)
+    { }
+
+    void dns_cache::shutdown() {
+        resolver.cancel();
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.clear();
+        pending.clear();
+        families.clear();
+    }
+
+    dns_cache::hosts_table dns_cache::load_hosts_file(const std::string &path) {
+        hosts_table table;
+        std::ifstream file(path);
+        if (!file) {
+            out::warn::log(out::string::stream("Could not open hosts file \"", path, "\". No DNS overrides will be used."));
+            return table;
+        }
+
+        std::string line;
+        while (std::getline(file, line)) {
+            auto comment = line.find('#');
+            if (comment != std::string::npos) {
+                line.erase(comment);
+            }
+
+            std::istringstream fields(line);
+            std::string address_field;
+            if (!(fields >> address_field)) {
+                continue;
+            }
+
+            boost::system::error_code error;
+            auto address = boost::asio::ip::make_address(address_field, error);
+            std::vector<std::string> names { std::istream_iterator<std::string>(fields), std::istream_iterator<std::string>() };
+            if (error != boost::system::errc::success || names.empty()) {
+                out::warn::log(out::string::stream("Ignoring malformed hosts file entry \"", line, "\"."));
+                continue;
+            }
+
+            for (const auto &name : names) {
+                auto &addresses = table[util::string::lowercase(name)];
+                auto list = addresses ? std::make_shared<address_list>(*addresses) : std::make_shared<address_list>();
+                list->push_back(address);
+                addresses = std::move(list);
+            }
+        }
+        return table;
+    }
+
+    const dns_cache::hosts_table &dns_cache::static_hosts() {
+        static const hosts_table table = program::options::instance().dns_hosts_file.empty()
+            ? hosts_table { }
+            : load_hosts_file(program::options::instance().dns_hosts_file);
+        return table;
+    }
+
+    void dns_cache::sweep(std::chrono::steady_clock::time_point now) {
+        if (now - last_sweep < ttl) {
+            return;
+        }
+        last_sweep = now;
+        for (auto it = entries.begin(); it != entries.end(); ) {
+            if (it->second.expires <= now) {
+                it = entries.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+        // Preferences for names that are no longer cached are most likely stale too
+        for (auto it = families.begin(); it != families.end(); ) {
+            if (entries.find(it->first) == entries.end()) {
+                it = families.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+
+    void dns_cache::resolve_async(const std::string &host, const resolve_callback &handler) {
+        // Address literals never need a lookup
+        boost::system::error_code literal_error;
+        auto literal = boost::asio::ip::make_address(host, literal_error);
+        if (literal_error == boost::system::errc::success) {
+            boost::asio::post(ioc, boost::bind(handler, literal_error, std::make_shared<address_list>(1, literal)));
+            return;
+        }
+
+        std::string name = util::string::lowercase(host);
+
+        const auto &hosts = static_hosts();
+        auto override_it = hosts.find(name);
+        if (override_it != hosts.end()) {
+            ++overrides;
+            boost::asio::post(ioc, boost::bind(handler, boost::system::errc::make_error_code(boost::system::errc::success), override_it->second));
+            return;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(mutex);
+        auto cached = entries.find(name);
+        if (cached != entries.end()) {
+            if (cached->second.expires > now) {
+                ++(cached->second.error ? negative_hits : hits);
+                boost::asio::post(ioc, boost::bind(handler, cached->second.error, cached->second.addresses));
+                return;
+            }
+            entries.erase(cached);
+        }
+
+        // Someone else is already looking up this name
+        auto waiting = pending.find(name);
+        if (waiting != pending.end()) {
+            ++collapsed;
+            waiting->second.push_back(handler);
+            return;
+        }
+
+        ++misses;
+        pending[name].push_back(handler);
+        resolver.async_resolve(name, std::string { },
+            boost::bind(&dns_cache::on_resolve, this, name, boost::asio::placeholders::error, boost::asio::placeholders::results));
+    }
+
+    void dns_cache::on_resolve(const std::string &name, const boost::system::error_code &error,
+        const boost::asio::ip::tcp::resolver::results_type &results) {
+        auto addresses = std::make_shared<address_list>();
+        for (const auto &result : results) {
+            auto address = result.endpoint().address();
+            if (std::find(addresses->begin(), addresses->end(), address) == addresses->end()) {
+                addresses->push_back(address);
+            }
+        }
+
+        boost::system::error_code result_error = error;
+        if (result_error == boost::system::errc::success && addresses->empty()) {
+            result_error = boost::asio::error::host_not_found;
+        }
+
+        std::vector<resolve_callback> handlers;
+        {
+            auto now = std::chrono::steady_clock::now();
+            std::lock_guard<std::mutex> lock(mutex);
+            auto waiting = pending.find(name);
+            if (waiting != pending.end()) {
+                handlers = std::move(waiting->second);
+                pending.erase(waiting);
+            }
+
+            // A cancelled query says nothing about the name
+            if (result_error != boost::asio::error::operation_aborted) {
+                auto lifetime = result_error ? negative_ttl : ttl;
+                if (lifetime.count() != 0) {
+                    sweep(now);
+                    entries[name] = { addresses, result_error, now + lifetime };
+                }
+            }
+        }
+
+        address_list_ptr shared = std::move(addresses);
+        for (const auto &handler : handlers) {
+            handler(result_error, shared);
+        }
+    }
+
+    dns_cache::address_family dns_cache::preferred_family(const std::string &host) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = families.find(util::string::lowercase(host));
+        return it == families.end() ? address_family::unknown : it->second;
+    }
+
+    void dns_cache::record_connected(const std::string &host, const boost::asio::ip::address &address) {
+        std::lock_guard<std::mutex> lock(mutex);
+        families[util::string::lowercase(host)] = address.is_v6() ? address_family::v6 : address_family::v4;
+    }
+
+    dns_cache::statistics dns_cache::get_statistics() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return { hits.load(), negative_hits.load(), misses.load(), collapsed.load(), overrides.load(), entries.size() };
+    }
+}
\ No newline at end of file
@@ -0,0 +1,133 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/asio.hpp>
+
+#include <aether/proxy/types.hpp>
+
+namespace proxy::connection {
+    /*
+        Cache of resolved host names shared by every server connection on an io_context.
+        Attached to each io_context as an Asio service.
+        The system resolver does not report record TTLs, so successful lookups are kept for
+            --dns-cache-ttl and failed lookups for --dns-negative-ttl.
+        Concurrent lookups for the same name wait on a single in-flight query.
+        Names listed in --dns-hosts-file always resolve to the listed addresses.
+    */
+    class dns_cache
+        : public boost::asio::execution_context::service {
+    public:
+        static boost::asio::execution_context::id id;
+
+        using address_list = std::vector<boost::asio::ip::address>;
+        using address_list_ptr = std::shared_ptr<const address_list>;
+        using resolve_callback = std::function<void(const boost::system::error_code &, address_list_ptr)>;
+
+        enum class address_family {
+            unknown,
+            v4,
+            v6,
+        };
+
+        /*
+            Counters for the DNS cache.
+        */
+        struct statistics {
+            // Lookups answered by a cached address list
+            std::size_t hits;
+            // Lookups answered by a cached failure
+            std::size_t negative_hits;
+            // Lookups that started a query
+            std::size_t misses;
+            // Lookups that waited on a query already in flight
+            std::size_t collapsed;
+            // Lookups answered by the hosts file
+            std::size_t overrides;
+            // Names currently cached
+            std::size_t entries;
+        };
+
+    private:
+        struct entry {
+            address_list_ptr addresses;
+            boost::system::error_code error;
+            std::chrono::steady_clock::time_point expires;
+        };
+
+        using hosts_table = std::unordered_map<std::string, address_list_ptr>;
+
+        boost::asio::io_context &ioc;
+        boost::asio::ip::tcp::resolver resolver;
+
+        std::mutex mutex;
+        std::unordered_map<std::string, entry> entries;
+        std::unordered_map<std::string, std::vector<resolve_callback>> pending;
+        // Family of the last address each name connected to
+        std::unordered_map<std::string, address_family> families;
+        std::chrono::milliseconds ttl;
+        std::chrono::milliseconds negative_ttl;
+        std::chrono::steady_clock::time_point last_sweep;
+
+        std::atomic<std::size_t> hits;
+        std::atomic<std::size_t> negative_hits;
+        std::atomic<std::size_t> misses;
+        std::atomic<std::size_t> collapsed;
+        std::atomic<std::size_t> overrides;
+
+        /*
+            Parses a hosts file of the form "<address> <name> [<name>...]".
+            Everything after a '#' is a comment.
+        */
+        static hosts_table load_hosts_file(const std::string &path);
+
+        /*
+            Static overrides loaded once for the whole process.
+        */
+        static const hosts_table &static_hosts();
+
+        /*
+            Removes expired entries and their family preferences, at most once per positive TTL.
+        */
+        void sweep(std::chrono::steady_clock::time_point now);
+
+        void on_resolve(const std::string &name, const boost::system::error_code &error,
+            const boost::asio::ip::tcp::resolver::results_type &results);
+
+        void shutdown() override;
+
+    public:
+        explicit dns_cache(boost::asio::io_context &ioc);
+
+        /*
+            Resolves a host name to its addresses, in the order the system resolver returned them.
+            The handler is always posted to the io_context, never called from within this function.
+        */
+        void resolve_async(const std::string &host, const resolve_callback &handler);
+
+        /*
+            Returns the address family that last won a connection race for the host.
+        */
+        address_family preferred_family(const std::string &host);
+
+        /*
+            Records the address a connection to the host was established with.
+        */
+        void record_connected(const std::string &host, const boost::asio::ip::address &address);
+
+        statistics get_statistics();
+    };
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "handler_memory.hpp"
+
+#include <new>
+
+namespace proxy::connection {
+    handler_memory::handler_memory()
+        : storage(),
+        in_use(false)
+    { }
+
+    void *handler_memory::allocate(std::size_t size) {
+        if (!in_use && size <= sizeof(storage)) {
+            in_use = true;
+            return &storage;
+        }
+        return ::operator new(size);
+    }
+
+    void handler_memory::deallocate(void *pointer) {
+        if (pointer == &storage) {
+            in_use = false;
+        }
+        else {
+            ::operator delete(pointer);
+        }
+    }
+}
\ No newline at end of file
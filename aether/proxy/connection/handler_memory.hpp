@@ -0,0 +1,77 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <boost/noncopyable.hpp>
+
+namespace proxy::connection {
+    /*
+        Fixed block of memory for the intermediate state of one asynchronous operation at a time.
+        Asio releases an operation's memory before calling its handler, so a connection that only
+            has one read and one write in flight can reuse the same two blocks forever.
+        Falls back to the global heap if the block is in use or too small.
+    */
+    class handler_memory
+        : private boost::noncopyable {
+    public:
+        static constexpr std::size_t block_size = 1024;
+
+    private:
+        std::aligned_storage_t<block_size> storage;
+        bool in_use;
+
+    public:
+        handler_memory();
+
+        void *allocate(std::size_t size);
+        void deallocate(void *pointer);
+    };
+
+    /*
+        Minimal allocator that routes Asio handler allocations to a handler_memory block.
+        Exposed to Asio through a handler's get_allocator() member.
+    */
+    template <typename T>
+    class handler_allocator {
+        template <typename U>
+        friend class handler_allocator;
+
+    private:
+        handler_memory *memory;
+
+    public:
+        using value_type = T;
+
+        explicit handler_allocator(handler_memory &memory)
+            : memory(&memory)
+        { }
+
+        template <typename U>
+        handler_allocator(const handler_allocator<U> &other) noexcept
+            : memory(other.memory)
+        { }
+
+        T *allocate(std::size_t n) const {
+            return static_cast<T *>(memory->allocate(sizeof(T) * n));
+        }
+
+        void deallocate(T *pointer, std::size_t) const {
+            memory->deallocate(pointer);
+        }
+
+        bool operator==(const handler_allocator &other) const noexcept {
+            return memory == other.memory;
+        }
+
+        bool operator!=(const handler_allocator &other) const noexcept {
+            return memory != other.memory;
+        }
+    };
+}
\ No newline at end of file
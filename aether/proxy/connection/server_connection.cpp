@@ -6,18 +6,39 @@
 *********************************************/
 
 #include "server_connection.hpp"
+#include "upstream_pool.hpp"
 
 namespace proxy::connection {
     server_connection::server_connection(boost::asio::io_context &ioc)
         : base_connection(ioc),
-        resolver(ioc),
         is_connected(false),
-        port()
+        connect_generation(0),
+        port(),
+        keep_alive(false),
+        reused(false)
     { }
 
+    void server_connection::reset() {
+        ++connect_generation;
+        base_connection::reset();
+        endpoint = { };
+        if (racing) {
+            racing->cancel();
+            racing.reset();
+        }
+        is_connected = false;
+        host.clear();
+        port = 0;
+        cert_chain.clear();
+        tls_key.clear();
+        keep_alive = false;
+        reused = false;
+    }
+
     void server_connection::connect_async(const std::string &host, port_t port, const err_callback &handler) {
         // Already have an open connection
-        if (is_connected_to(host, port) && !has_been_closed()) {
+        if (is_connected_to(host, port) && is_alive()) {
+            reused = true;
             boost::asio::post(ioc, boost::bind(handler, boost::system::errc::make_error_code(boost::system::errc::success)));
             return;
         }
@@ -27,63 +48,81 @@ namespace proxy::connection {
             is_connected = false;
         }
 
+        if (acquire_pooled(host, port)) {
+            boost::asio::post(ioc, boost::bind(handler, boost::system::errc::make_error_code(boost::system::errc::success)));
+            return;
+        }
+
         this->host = host;
         this->port = port;
+        tls_key.clear();
+        reused = false;
 
-        set_timeout();
-        boost::asio::ip::tcp::resolver::query query(host, boost::lexical_cast<std::string>(port));
-        resolver.async_resolve(query, boost::asio::bind_executor(strand, 
-            boost::bind(&server_connection::on_resolve, this,
-                boost::asio::placeholders::error, boost::asio::placeholders::iterator, handler)));
+        // The cache posts its handlers to this connection's io_context
+        boost::asio::use_service<dns_cache>(ioc).resolve_async(host,
+            boost::bind(&server_connection::on_resolve, std::static_pointer_cast<server_connection>(shared_from_this()),
+                boost::placeholders::_1, boost::placeholders::_2, ++connect_generation, handler));
     }
 
     void server_connection::on_resolve(const boost::system::error_code &err,
-        boost::asio::ip::tcp::resolver::iterator endpoint_iterator,
+        dns_cache::address_list_ptr resolved,
+        std::size_t generation,
         const err_callback &handler) {
-        timeout.cancel_timeout();
-        if (err != boost::system::errc::success) {
+        // The connection was reset while waiting on the lookup
+        if (generation != connect_generation) {
+            boost::asio::post(ioc, boost::bind(handler, boost::asio::error::operation_aborted));
+        }
+        else if (err != boost::system::errc::success) {
             boost::asio::post(ioc, boost::bind(handler, err));
         }
         // No endpoints found
-        else if (endpoint_iterator == boost::asio::ip::tcp::resolver::iterator()) {
+        else if (!resolved || resolved->empty()) {
             boost::asio::post(ioc, boost::bind(handler, boost::system::errc::make_error_code(boost::system::errc::host_unreachable)));
         }
         else {
-            set_timeout();
-            endpoint = endpoint_iterator->endpoint();
-            auto &curr = *endpoint_iterator;
-            socket.async_connect(curr, boost::asio::bind_executor(strand,
-                boost::bind(&server_connection::on_connect, this,
-                    boost::asio::placeholders::error, ++endpoint_iterator, handler)));
+            // One deadline covers the whole race, rather than one per address
+            set_timeout(deadline::connect);
+            auto family = boost::asio::use_service<dns_cache>(ioc).preferred_family(host);
+            racing = std::make_shared<connector>(strand, *resolved, port, family);
+            // boost::bind cannot forward the move-only socket
+            racing->connect_async([self = std::static_pointer_cast<server_connection>(shared_from_this()), generation, handler]
+                (const boost::system::error_code &err, connector::socket_ptr connected, const boost::asio::ip::tcp::endpoint &connected_endpoint) {
+                    self->on_connect(err, std::move(connected), connected_endpoint, generation, handler);
+                });
         }
     }
 
     void server_connection::on_connect(const boost::system::error_code &err,
-        boost::asio::ip::tcp::resolver::iterator endpoint_iterator,
+        connector::socket_ptr connected,
+        const boost::asio::ip::tcp::endpoint &connected_endpoint,
+        std::size_t generation,
         const err_callback &handler) {
+        if (generation != connect_generation) {
+            boost::asio::post(ioc, boost::bind(handler, boost::asio::error::operation_aborted));
+            return;
+        }
+
         timeout.cancel_timeout();
+        racing.reset();
         if (err == boost::system::errc::success) {
+            socket = std::move(connected);
+            endpoint = connected_endpoint;
             is_connected = true;
-            boost::asio::post(ioc, boost::bind(handler, err));
+            boost::asio::use_service<dns_cache>(ioc).record_connected(host, endpoint.address());
         }
-        // Didn't connect, but other endpoints to try
-        else if (endpoint_iterator != boost::asio::ip::tcp::resolver::iterator()) {
-            set_timeout();
-            endpoint = endpoint_iterator->endpoint();
-            auto &curr = *endpoint_iterator;
-            socket.async_connect(curr, boost::asio::bind_executor(strand,
-                boost::bind(&server_connection::on_connect, this,
-                    boost::asio::placeholders::error, ++endpoint_iterator, handler)));
-        }
-        // Failed to connect
-        else {
-            boost::asio::post(ioc, boost::bind(handler, err));
+        boost::asio::post(ioc, boost::bind(handler, err));
+    }
+
+    void server_connection::on_timeout() {
+        if (racing) {
+            racing->cancel();
         }
+        base_connection::on_timeout();
     }
 
     void server_connection::establish_tls_async(tcp::tls::openssl::ssl_context_args &args, const err_callback &handler) {
         ssl_context = tcp::tls::openssl::create_ssl_context(args);
-        secure_socket = std::make_unique<std::remove_reference_t<decltype(*secure_socket)>>(socket, *ssl_context);
+        secure_socket = std::make_unique<std::remove_reference_t<decltype(*secure_socket)>>(*socket, *ssl_context);
         
         SSL_set_connect_state(secure_socket->native_handle());
 
@@ -92,9 +131,10 @@ namespace proxy::connection {
         }
 
         tcp::tls::openssl::enable_hostname_verification(*ssl_context, host);
+        tls_key = upstream_pool::tls_key(args);
 
         secure_socket->async_handshake(boost::asio::ssl::stream_base::handshake_type::client, boost::asio::bind_executor(strand,
-            boost::bind(&server_connection::on_handshake, this,
+            boost::bind(&server_connection::on_handshake, std::static_pointer_cast<server_connection>(shared_from_this()),
                 boost::asio::placeholders::error, handler)));
     }
 
@@ -153,4 +193,82 @@ namespace proxy::connection {
     std::vector<tcp::tls::x509::certificate> server_connection::get_cert_chain() const {
         return cert_chain;
     }
+
+    bool server_connection::is_alive() {
+        return upstream_pool::is_alive(*socket, tls_established);
+    }
+
+    void server_connection::set_keep_alive(bool val) {
+        keep_alive = val;
+    }
+
+    bool server_connection::was_reused() const {
+        return reused;
+    }
+
+    server_connection::detached_state server_connection::detach() {
+        timeout.cancel_timeout();
+        detached_state state;
+        state.socket = std::move(socket);
+        state.ssl_context = std::move(ssl_context);
+        state.secure_socket = std::move(secure_socket);
+        state.tls_established = tls_established;
+        state.cert = std::move(cert);
+        state.cert_chain = std::move(cert_chain);
+        state.alpn = std::move(alpn);
+        state.endpoint = endpoint;
+
+        socket = std::make_unique<boost::asio::ip::tcp::socket>(strand);
+        reset();
+        return state;
+    }
+
+    void server_connection::attach(const std::string &host, port_t port, detached_state &&state) {
+        reset();
+        socket = std::move(state.socket);
+        ssl_context = std::move(state.ssl_context);
+        secure_socket = std::move(state.secure_socket);
+        tls_established = state.tls_established;
+        cert = std::move(state.cert);
+        cert_chain = std::move(state.cert_chain);
+        alpn = std::move(state.alpn);
+        endpoint = state.endpoint;
+        this->host = host;
+        this->port = port;
+        is_connected = true;
+        reused = true;
+    }
+
+    bool server_connection::acquire_pooled(const std::string &host, port_t port, const std::string &tls_key) {
+        auto &pool = boost::asio::use_service<upstream_pool>(ioc);
+        auto state = pool.acquire(upstream_pool::make_key(host, port, tls_key));
+        if (!state) {
+            return false;
+        }
+        attach(host, port, std::move(*state));
+        this->tls_key = tls_key;
+        return true;
+    }
+
+    bool server_connection::release_to_pool() {
+        // Leftover input means the last response was not fully consumed
+        if (!is_connected || !keep_alive || mode != io_mode::regular || input.size() != 0 || !is_alive()) {
+            return false;
+        }
+        auto &pool = boost::asio::use_service<upstream_pool>(ioc);
+        if (!pool.enabled()) {
+            return false;
+        }
+        std::string key = upstream_pool::make_key(host, port, tls_key);
+        return pool.release(key, detach());
+    }
+
+    void server_connection::take_over(server_connection &other) {
+        std::string other_host = other.host;
+        port_t other_port = other.port;
+        std::string other_tls_key = other.tls_key;
+        attach(other_host, other_port, other.detach());
+        tls_key = other_tls_key;
+        reused = false;
+    }
 }
\ No newline at end of file
@@ -11,6 +11,8 @@
 #include <boost/lexical_cast.hpp>
 
 #include <aether/proxy/connection/base_connection.hpp>
+#include <aether/proxy/connection/connector.hpp>
+#include <aether/proxy/connection/dns_cache.hpp>
 #include <aether/proxy/tcp/tls/x509/certificate.hpp>
 #include <aether/proxy/types.hpp>
 
@@ -20,26 +22,71 @@ namespace proxy::connection {
     */
     class server_connection
         : public base_connection {
+    public:
+        /*
+            Established connection state detached from a server connection.
+            Kept idle in the upstream pool until a flow to the same server needs it.
+        */
+        struct detached_state {
+            // Declared in this order so the TLS stream is destroyed before the socket it refers to
+            std::unique_ptr<boost::asio::ip::tcp::socket> socket;
+            std::unique_ptr<boost::asio::ssl::context> ssl_context;
+            std::unique_ptr<boost::asio::ssl::stream<boost::asio::ip::tcp::socket &>> secure_socket;
+            bool tls_established = false;
+            tcp::tls::x509::certificate cert { nullptr };
+            std::vector<tcp::tls::x509::certificate> cert_chain;
+            std::string alpn;
+            boost::asio::ip::tcp::endpoint endpoint;
+        };
+
     private:
-        boost::asio::ip::tcp::resolver resolver;
         boost::asio::ip::tcp::endpoint endpoint;
         bool is_connected;
 
+        // Incremented whenever a pending lookup or connect should be ignored, since the cache cannot cancel it
+        std::size_t connect_generation;
+        connector::ptr racing;
+
         std::string host;
         port_t port;
 
         std::vector<tcp::tls::x509::certificate> cert_chain;
 
+        // Identifies the TLS parameters the connection was established with, empty for plain connections
+        std::string tls_key;
+        bool keep_alive;
+        bool reused;
+
         void on_resolve(const boost::system::error_code &err,
-            boost::asio::ip::tcp::resolver::iterator endpoint_iterator,
+            dns_cache::address_list_ptr resolved,
+            std::size_t generation,
             const err_callback &handler);
         void on_connect(const boost::system::error_code &err,
-            boost::asio::ip::tcp::resolver::iterator endpoint_iterator,
+            connector::socket_ptr connected,
+            const boost::asio::ip::tcp::endpoint &connected_endpoint,
+            std::size_t generation,
             const err_callback &handler);
         void on_handshake(const boost::system::error_code &err, const err_callback &handler);
 
+        /*
+            Moves the established connection out, leaving a fresh unconnected socket behind.
+        */
+        detached_state detach();
+
+        /*
+            Takes over an established connection to the given server.
+        */
+        void attach(const std::string &host, port_t port, detached_state &&state);
+
+    protected:
+        /*
+            Cancels the connection race as well as the socket.
+        */
+        void on_timeout() override;
+
     public:
         server_connection(boost::asio::io_context &ioc);
+        void reset() override;
         void connect_async(const std::string &host, port_t port, const err_callback &handler);
         void establish_tls_async(tcp::tls::openssl::ssl_context_args &args, const err_callback &handler);
         void disconnect();
@@ -49,5 +96,40 @@ namespace proxy::connection {
         port_t get_port() const;
         bool is_connected_to(std::string_view host, port_t port) const;
         std::vector<tcp::tls::x509::certificate> get_cert_chain() const;
+
+        /*
+            Tests if the connection is still usable without reading from it or changing its blocking mode.
+        */
+        bool is_alive();
+
+        /*
+            Marks whether the last exchange finished cleanly and the server expects the connection to stay open.
+            Only such connections are handed to the upstream pool.
+        */
+        void set_keep_alive(bool val);
+
+        /*
+            Returns if the connection was used before the current request, either by this flow or
+                by another flow through the upstream pool.
+            Requests on reused connections may fail because the server closed the connection while it was idle.
+        */
+        bool was_reused() const;
+
+        /*
+            Takes an idle connection to the given server from the upstream pool, if one is available.
+            A non-empty TLS key only matches connections secured with the same parameters.
+        */
+        bool acquire_pooled(const std::string &host, port_t port, const std::string &tls_key = { });
+
+        /*
+            Hands the connection to the upstream pool if it can be reused by another flow.
+            Returns false if the connection was not pooled, in which case it should be disconnected.
+        */
+        bool release_to_pool();
+
+        /*
+            Takes over the established connection of another server connection, which is left unconnected.
+        */
+        void take_over(server_connection &other);
     };
 }
\ No newline at end of file
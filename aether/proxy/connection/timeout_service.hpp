@@ -8,40 +8,35 @@
 #pragma once
 
 #include <boost/asio.hpp>
-#include <boost/bind.hpp>
 
 #include <aether/proxy/types.hpp>
+#include <aether/proxy/concurrent/timing_wheel.hpp>
 
 namespace proxy::connection {
     /*
         Service to timeout connect, read, and write requests on the connection class.
+        Deadlines are kept in the io_context's timing wheel, so re-arming does not touch the timer queue.
     */
     class timeout_service {
     private:
-        boost::asio::io_context &ioc;
-        boost::asio::deadline_timer timer;
-
-        /*
-            Resets the timer to infinity.
-        */
-        void reset_timer();
+        concurrent::timing_wheel &wheel;
+        concurrent::timing_wheel::entry entry;
 
+    public:
         /*
-            Callback for the timer function.
-            Will call if the timer is met or if the timer is cancelled.
+            Creates the service with the handler called whenever a deadline is met.
         */
-        void on_timeout(const callback &handler, const boost::system::error_code &error);
-
-    public:
-        timeout_service(boost::asio::io_context &ioc);
+        timeout_service(boost::asio::io_context &ioc, const callback &handler);
+        ~timeout_service();
     
         /*
-            Set the timer to call the handler in a given amount of time.
+            Set the deadline to call the handler in a given amount of time.
+            Replaces any previous deadline.
         */
-        void set_timeout(const milliseconds &time, const callback &handler);
+        void set_timeout(const milliseconds &time);
 
         /*
-            Cancel the timeout, preventing the previous set_timeout handler to be called.
+            Cancel the timeout, preventing the handler from being called.
         */
         void cancel_timeout();
     };
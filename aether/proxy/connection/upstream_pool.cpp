@@ -0,0 +1,155 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "upstream_pool.hpp"
+
+#include <cerrno>
+#include <aether/program/options.hpp>
+
+namespace proxy::connection {
+    boost::asio::execution_context::id upstream_pool::id;
+
+    upstream_pool::upstream_pool(boost::asio::io_context &ioc)
+        : boost::asio::execution_context::service(ioc),
+        max_idle_per_host(program::options::instance().upstream_pool_size),
+        ttl(program::options::instance().upstream_idle_ttl),
+        last_sweep(std::chrono::steady_clock::now()),
+        hits(0),
+        misses(0),
+        stale(0),
+        evicted(0),
+        idle(0)
+    { }
+
+    void upstream_pool::shutdown() {
+        std::lock_guard<std::mutex> lock(mutex);
+        connections.clear();
+        idle = 0;
+    }
+
+    std::string upstream_pool::make_key(std::string_view host, port_t port, std::string_view tls_key) {
+        return out::string::stream(host, ':', port, tls_key.empty() ? "" : "|", tls_key);
+    }
+
+    std::string upstream_pool::tls_key(const tcp::tls::openssl::ssl_context_args &args) {
+        std::stringstream key;
+        key << static_cast<int>(args.method) << ',' << args.verify << ',' << args.options << ',' << args.verify_file;
+        key << "|ciphers";
+        for (const auto &cipher : args.cipher_suites) {
+            key << ',' << static_cast<int>(cipher);
+        }
+        key << "|alpn";
+        for (const auto &protocol : args.alpn_protos) {
+            key << ',' << protocol;
+        }
+        return key.str();
+    }
+
+    bool upstream_pool::is_alive(boost::asio::ip::tcp::socket &socket, bool secured) {
+        if (!socket.is_open()) {
+            return false;
+        }
+#ifdef MSG_DONTWAIT
+        char byte;
+        auto result = ::recv(socket.native_handle(), &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+        if (result == 0) {
+            return false;
+        }
+        else if (result < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        return secured;
+#else
+        boost::system::error_code error;
+        std::size_t available = socket.available(error);
+        return error == boost::system::errc::success && (available == 0 || secured);
+#endif
+    }
+
+    bool upstream_pool::enabled() const {
+        return max_idle_per_host != 0;
+    }
+
+    void upstream_pool::expire(std::deque<idle_connection> &list, std::chrono::steady_clock::time_point now) {
+        while (!list.empty() && now - list.front().released >= ttl) {
+            list.pop_front();
+            --idle;
+            ++evicted;
+        }
+    }
+
+    void upstream_pool::sweep(std::chrono::steady_clock::time_point now) {
+        if (now - last_sweep < ttl) {
+            return;
+        }
+        last_sweep = now;
+        for (auto it = connections.begin(); it != connections.end(); ) {
+            expire(it->second, now);
+            if (it->second.empty()) {
+                it = connections.erase(it);
+            }
+            else {
+                ++it;
+            }
+        }
+    }
+
+    bool upstream_pool::release(const std::string &key, server_connection::detached_state &&state) {
+        if (!enabled()) {
+            return false;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(mutex);
+        sweep(now);
+
+        auto &list = connections[key];
+        list.push_back({ std::move(state), now });
+        ++idle;
+
+        // Over the per-host limit, close the connection that has been idle the longest
+        if (list.size() > max_idle_per_host) {
+            list.pop_front();
+            --idle;
+            ++evicted;
+        }
+        return true;
+    }
+
+    std::optional<server_connection::detached_state> upstream_pool::acquire(const std::string &key) {
+        if (!enabled()) {
+            return std::nullopt;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = connections.find(key);
+        if (it != connections.end()) {
+            auto &list = it->second;
+            expire(list, now);
+
+            // Most recently used first, it is the least likely to have been closed by the server
+            while (!list.empty()) {
+                idle_connection entry = std::move(list.back());
+                list.pop_back();
+                --idle;
+                if (is_alive(*entry.state.socket, entry.state.tls_established)) {
+                    ++hits;
+                    return std::move(entry.state);
+                }
+                ++stale;
+            }
+            connections.erase(it);
+        }
+        ++misses;
+        return std::nullopt;
+    }
+
+    upstream_pool::statistics upstream_pool::get_statistics() const {
+        return { hits.load(), misses.load(), stale.load(), evicted.load(), idle.load() };
+    }
+}
\ No newline at end of file
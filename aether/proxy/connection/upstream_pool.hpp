@@ -0,0 +1,115 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <boost/asio.hpp>
+
+#include <aether/proxy/types.hpp>
+#include <aether/proxy/connection/server_connection.hpp>
+#include <aether/proxy/tcp/tls/openssl/ssl_context.hpp>
+
+namespace proxy::connection {
+    /*
+        Idle upstream connections that can be taken over by any flow on the same io_context.
+        Attached to each io_context as an Asio service.
+        Connections are keyed by host, port, and the TLS parameters they were secured with,
+            so a flow only receives a connection it could have established itself.
+        Each key holds at most --upstream-pool-size connections, and connections idle for
+            longer than --upstream-idle-ttl are closed.
+    */
+    class upstream_pool
+        : public boost::asio::execution_context::service {
+    public:
+        static boost::asio::execution_context::id id;
+
+        /*
+            Counters for the upstream connection pool.
+        */
+        struct statistics {
+            // Connections taken from the pool
+            std::size_t hits;
+            // Lookups that found no usable connection
+            std::size_t misses;
+            // Pooled connections found closed or out of sync when taken
+            std::size_t stale;
+            // Pooled connections closed for being idle too long or over the per-host limit
+            std::size_t evicted;
+            // Connections currently idle in the pool
+            std::size_t idle;
+        };
+
+    private:
+        struct idle_connection {
+            server_connection::detached_state state;
+            std::chrono::steady_clock::time_point released;
+        };
+
+        std::mutex mutex;
+        std::unordered_map<std::string, std::deque<idle_connection>> connections;
+        std::size_t max_idle_per_host;
+        std::chrono::milliseconds ttl;
+        std::chrono::steady_clock::time_point last_sweep;
+
+        std::atomic<std::size_t> hits;
+        std::atomic<std::size_t> misses;
+        std::atomic<std::size_t> stale;
+        std::atomic<std::size_t> evicted;
+        std::atomic<std::size_t> idle;
+
+        /*
+            Closes connections at the front of the list that have been idle longer than the TTL.
+        */
+        void expire(std::deque<idle_connection> &list, std::chrono::steady_clock::time_point now);
+
+        /*
+            Expires connections for every key, at most once per TTL.
+        */
+        void sweep(std::chrono::steady_clock::time_point now);
+
+        void shutdown() override;
+
+    public:
+        explicit upstream_pool(boost::asio::io_context &ioc);
+
+        static std::string make_key(std::string_view host, port_t port, std::string_view tls_key);
+
+        /*
+            Builds a key identifying every TLS parameter that affects the established connection.
+        */
+        static std::string tls_key(const tcp::tls::openssl::ssl_context_args &args);
+
+        /*
+            Tests if an idle socket is still usable without reading from it or changing its blocking mode.
+            Any pending data on a plain connection means it is out of sync with the server.
+            TLS connections may legitimately receive records while idle, such as session tickets.
+        */
+        static bool is_alive(boost::asio::ip::tcp::socket &socket, bool secured);
+
+        bool enabled() const;
+
+        /*
+            Adds an established connection to the pool.
+            Returns false if the connection was closed instead.
+        */
+        bool release(const std::string &key, server_connection::detached_state &&state);
+
+        /*
+            Takes the most recently released live connection for the given key.
+        */
+        std::optional<server_connection::detached_state> acquire(const std::string &key);
+
+        statistics get_statistics() const;
+    };
+}
\ No newline at end of file
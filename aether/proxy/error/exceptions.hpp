@@ -15,7 +15,8 @@
 X(0, proxy, PROXY, "Proxy error", false, other) \
 X(1, http, HTTP, "HTTP error", true, other) \
 X(2, tls, TLS, "TLS error", true, other) \
-X(3, websocket, WEBSOCKET, "WebSocket error", true, other)
+X(3, websocket, WEBSOCKET, "WebSocket error", true, other) \
+X(4, http2, HTTP2, "HTTP/2 error", true, other)
 
 #define PROXY_EXCEPTIONS(X, other) \
 X(1, invalid_option, "Invalid option", other) \
@@ -72,6 +73,15 @@ X(5, unexpected_opcode, "Unexpected opcode", other) \
 X(6, serialization_error, "Frame serialization error", other) \
 X(7, zlib_error, "zlib error", other)
 
+#define HTTP2_EXCEPTIONS(X, other) \
+X(1, invalid_preface, "Invalid HTTP/2 connection preface", other) \
+X(2, protocol_error, "HTTP/2 protocol error", other) \
+X(3, frame_size_error, "Invalid HTTP/2 frame size", other) \
+X(4, flow_control_error, "HTTP/2 flow control error", other) \
+X(5, compression_error, "HPACK compression error", other) \
+X(6, header_list_too_large, "HTTP/2 header list exceeds limit", other) \
+X(7, malformed_message, "Malformed HTTP/2 message", other)
+
 namespace proxy {
     namespace errc {
 
@@ -9,12 +9,12 @@
 
 namespace proxy {
     server::server()
-        : io_contexts(program::options::instance().thread_pool_size),
+        : io_contexts(program::options::instance().thread_pool_size, program::options::instance().scheduler),
         is_running(false),
         needs_cleanup(false),
         interceptors(),
         log_manager(),
-        connection_manager(interceptors)
+        connection_manager(io_contexts, interceptors)
     {
         log_manager.unsync_with_stdio();
 
@@ -37,6 +37,11 @@ namespace proxy {
         if (!program::options::instance().ssl_passthrough_strict) {
             tcp::tls::tls_service::create_cert_store();
         }
+
+        // The disk tier of the cache is loaded before any request can miss in memory
+        if (program::options::instance().cache) {
+            tcp::http::cache::response_cache::instance();
+        }
     }
 
     server::~server() {
@@ -142,4 +147,43 @@ namespace proxy {
     boost::asio::io_context &server::get_io_context() {
         return io_contexts.get_io_context();
     }
+
+    connection::connection_manager::pool_statistics server::connection_pool_statistics() {
+        return connection_manager.get_pool_statistics();
+    }
+
+    connection::upstream_pool::statistics server::upstream_pool_statistics() {
+        connection::upstream_pool::statistics total { };
+        for (std::size_t i = 0; i < io_contexts.pool_size(); ++i) {
+            auto stats = boost::asio::use_service<connection::upstream_pool>(io_contexts.get_io_context(i)).get_statistics();
+            total.hits += stats.hits;
+            total.misses += stats.misses;
+            total.stale += stats.stale;
+            total.evicted += stats.evicted;
+            total.idle += stats.idle;
+        }
+        return total;
+    }
+
+    connection::dns_cache::statistics server::dns_cache_statistics() {
+        connection::dns_cache::statistics total { };
+        for (std::size_t i = 0; i < io_contexts.pool_size(); ++i) {
+            auto stats = boost::asio::use_service<connection::dns_cache>(io_contexts.get_io_context(i)).get_statistics();
+            total.hits += stats.hits;
+            total.negative_hits += stats.negative_hits;
+            total.misses += stats.misses;
+            total.collapsed += stats.collapsed;
+            total.overrides += stats.overrides;
+            total.entries += stats.entries;
+        }
+        return total;
+    }
+
+    tcp::http::cache::response_cache::statistics server::response_cache_statistics() {
+        return tcp::http::cache::response_cache::instance().get_statistics();
+    }
+
+    tcp::http::cache::disk_cache::statistics server::disk_cache_statistics() {
+        return tcp::http::cache::disk_cache::instance().get_statistics();
+    }
 }
\ No newline at end of file
@@ -16,6 +16,9 @@
 #include <aether/proxy/types.hpp>
 #include <aether/proxy/concurrent/io_context_pool.hpp>
 #include <aether/proxy/connection/connection_manager.hpp>
+#include <aether/proxy/connection/dns_cache.hpp>
+#include <aether/proxy/connection/upstream_pool.hpp>
+#include <aether/proxy/tcp/http/cache/response_cache.hpp>
 #include <aether/proxy/tcp/intercept/interceptor_services.hpp>
 #include <aether/program/options.hpp>
 #include <aether/util/signal_handler.hpp>
@@ -76,5 +79,30 @@ namespace proxy {
         bool running() const;
         std::string endpoint_string() const;
         boost::asio::io_context &get_io_context();
+
+        /*
+            Returns the counters for the connection flow recycling pool.
+        */
+        connection::connection_manager::pool_statistics connection_pool_statistics();
+
+        /*
+            Returns the counters for the upstream connection pools of every io_context combined.
+        */
+        connection::upstream_pool::statistics upstream_pool_statistics();
+
+        /*
+            Returns the counters for the DNS caches of every io_context combined.
+        */
+        connection::dns_cache::statistics dns_cache_statistics();
+
+        /*
+            Returns the counters for the response cache shared by every io_context.
+        */
+        tcp::http::cache::response_cache::statistics response_cache_statistics();
+
+        /*
+            Returns the counters for the disk tier of the response cache.
+        */
+        tcp::http::cache::disk_cache::statistics disk_cache_statistics();
     };
 }
\ No newline at end of file
@@ -0,0 +1,246 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "cache_control.hpp"
+
+#include <array>
+#include <cctype>
+#include <vector>
+
+#include <aether/util/string.hpp>
+
+namespace proxy::tcp::http::cache {
+    namespace {
+        /*
+            Parses delta seconds, which are clamped rather than rejected when too large.
+            An invalid value is treated as zero, so the response is never fresh because of it.
+        */
+        cache_control::seconds parse_delta_seconds(std::string_view value) {
+            if (value.empty()) {
+                return cache_control::seconds(0);
+            }
+            long long result = 0;
+            for (char c : value) {
+                if (!std::isdigit(static_cast<unsigned char>(c))) {
+                    return cache_control::seconds(0);
+                }
+                result = result * 10 + (c - '0');
+                if (result >= cache_control::max_delta_seconds.count()) {
+                    return cache_control::max_delta_seconds;
+                }
+            }
+            return cache_control::seconds(result);
+        }
+
+        /*
+            Calls the handler with the name and value of each directive in a Cache-Control value.
+            Quoted values may contain commas, so the list cannot just be split.
+        */
+        template <typename Handler>
+        void for_each_directive(std::string_view list, Handler &&handler) {
+            std::size_t pos = 0;
+            while (pos < list.length()) {
+                while (pos < list.length() && (list[pos] == ',' || list[pos] == ' ' || list[pos] == '\t')) {
+                    ++pos;
+                }
+                std::size_t name_start = pos;
+                while (pos < list.length() && list[pos] != '=' && list[pos] != ',') {
+                    ++pos;
+                }
+                std::string_view name = util::string::trim(list.substr(name_start, pos - name_start));
+
+                std::string_view value;
+                if (pos < list.length() && list[pos] == '=') {
+                    ++pos;
+                    while (pos < list.length() && (list[pos] == ' ' || list[pos] == '\t')) {
+                        ++pos;
+                    }
+                    if (pos < list.length() && list[pos] == '"') {
+                        std::size_t value_start = ++pos;
+                        while (pos < list.length() && list[pos] != '"') {
+                            pos += list[pos] == '\\' ? 2 : 1;
+                        }
+                        value = list.substr(value_start, std::min(pos, list.length()) - value_start);
+                        ++pos;
+                    }
+                    else {
+                        std::size_t value_start = pos;
+                        while (pos < list.length() && list[pos] != ',') {
+                            ++pos;
+                        }
+                        value = util::string::trim(list.substr(value_start, pos - value_start));
+                    }
+                }
+
+                if (!name.empty()) {
+                    handler(name, value);
+                }
+            }
+        }
+
+        constexpr std::array<std::string_view, 12> month_names = {
+            "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"
+        };
+
+        std::optional<int> parse_month(std::string_view str) {
+            for (std::size_t i = 0; i < month_names.size(); ++i) {
+                if (util::string::iequals_fn(str, month_names[i])) {
+                    return static_cast<int>(i) + 1;
+                }
+            }
+            return { };
+        }
+
+        std::optional<int> parse_number(std::string_view str) {
+            if (str.empty() || str.length() > 4) {
+                return { };
+            }
+            int result = 0;
+            for (char c : str) {
+                if (!std::isdigit(static_cast<unsigned char>(c))) {
+                    return { };
+                }
+                result = result * 10 + (c - '0');
+            }
+            return result;
+        }
+
+        /*
+            Counts days since 1970-01-01 in the proleptic Gregorian calendar.
+        */
+        long long days_from_civil(int year, int month, int day) {
+            year -= month <= 2;
+            long long era = (year >= 0 ? year : year - 399) / 400;
+            long long year_of_era = year - era * 400;
+            long long day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+            long long day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+            return era * 146097 + day_of_era - 719468;
+        }
+    }
+
+    cache_control::cache_control()
+        : max_age(),
+        s_maxage(),
+        max_stale(),
+        min_fresh(),
+        no_cache(false),
+        no_store(false),
+        is_private(false),
+        is_public(false),
+        must_revalidate(false),
+        proxy_revalidate(false),
+        only_if_cached(false)
+    { }
+
+    cache_control cache_control::parse(const message &msg) {
+        cache_control result;
+        const header_collection &headers = msg.all_headers();
+        if (!headers.contains(header_id::cache_control)) {
+            result.no_cache = headers.has_token(header_id::pragma, "no-cache", true);
+            return result;
+        }
+
+        for (std::string_view list : headers.find_all(convert::to_string(header_id::cache_control))) {
+            for_each_directive(list, [&result](std::string_view name, std::string_view value) {
+                auto is = [name](std::string_view directive) { return util::string::iequals_fn(name, directive); };
+                if (is("max-age")) {
+                    result.max_age = parse_delta_seconds(value);
+                }
+                else if (is("s-maxage")) {
+                    result.s_maxage = parse_delta_seconds(value);
+                }
+                else if (is("max-stale")) {
+                    result.max_stale = value.empty() ? max_delta_seconds : parse_delta_seconds(value);
+                }
+                else if (is("min-fresh")) {
+                    result.min_fresh = parse_delta_seconds(value);
+                }
+                else if (is("no-cache")) {
+                    result.no_cache = true;
+                }
+                else if (is("no-store")) {
+                    result.no_store = true;
+                }
+                else if (is("private")) {
+                    result.is_private = true;
+                }
+                else if (is("public")) {
+                    result.is_public = true;
+                }
+                else if (is("must-revalidate")) {
+                    result.must_revalidate = true;
+                }
+                else if (is("proxy-revalidate")) {
+                    result.proxy_revalidate = true;
+                }
+                else if (is("only-if-cached")) {
+                    result.only_if_cached = true;
+                }
+            });
+        }
+        return result;
+    }
+
+    std::optional<std::chrono::system_clock::time_point> parse_http_date(std::string_view str) {
+        // Commas and dashes only separate fields, so all three formats split into the same kind of tokens
+        std::vector<std::string_view> tokens;
+        std::size_t pos = 0;
+        while (pos < str.length()) {
+            while (pos < str.length() && (str[pos] == ' ' || str[pos] == ',' || str[pos] == '-' || str[pos] == '\t')) {
+                ++pos;
+            }
+            std::size_t start = pos;
+            while (pos < str.length() && str[pos] != ' ' && str[pos] != ',' && str[pos] != '-' && str[pos] != '\t') {
+                ++pos;
+            }
+            if (pos > start) {
+                tokens.push_back(str.substr(start, pos - start));
+            }
+        }
+
+        // The day name is not needed
+        if (!tokens.empty() && !parse_number(tokens[0]).has_value() && !parse_month(tokens[0]).has_value()) {
+            tokens.erase(tokens.begin());
+        }
+        if (tokens.size() < 4) {
+            return { };
+        }
+
+        std::optional<int> day, month, year;
+        std::string_view time;
+        // asctime: Nov 6 08:49:37 1994
+        if ((month = parse_month(tokens[0])).has_value()) {
+            day = parse_number(tokens[1]);
+            time = tokens[2];
+            year = parse_number(tokens[3]);
+        }
+        // IMF-fixdate: 06 Nov 1994 08:49:37 GMT
+        // RFC 850: 06-Nov-94 08:49:37 GMT
+        else {
+            day = parse_number(tokens[0]);
+            month = parse_month(tokens[1]);
+            year = parse_number(tokens[2]);
+            time = tokens[3];
+            if (year.has_value() && tokens[2].length() == 2) {
+                year = *year + (*year < 70 ? 2000 : 1900);
+            }
+        }
+
+        if (!day || !month || !year || time.length() != 8 || time[2] != ':' || time[5] != ':') {
+            return { };
+        }
+        std::optional<int> hours = parse_number(time.substr(0, 2));
+        std::optional<int> minutes = parse_number(time.substr(3, 2));
+        std::optional<int> secs = parse_number(time.substr(6, 2));
+        if (!hours || !minutes || !secs || *day < 1 || *day > 31 || *hours > 23 || *minutes > 59 || *secs > 60) {
+            return { };
+        }
+
+        long long seconds_since_epoch = days_from_civil(*year, *month, *day) * 86400LL + *hours * 3600LL + *minutes * 60LL + *secs;
+        return std::chrono::system_clock::time_point(std::chrono::seconds(seconds_since_epoch));
+    }
+}
\ No newline at end of file
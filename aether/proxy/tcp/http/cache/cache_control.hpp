@@ -0,0 +1,51 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <string_view>
+
+#include <aether/proxy/tcp/http/message/message.hpp>
+
+namespace proxy::tcp::http::cache {
+    /*
+        Cache directives of a single request or response, from its Cache-Control header.
+        Pragma: no-cache counts as no-cache when there is no Cache-Control header.
+        Directives that list field names apply to the whole message, which is the conservative reading.
+    */
+    struct cache_control {
+        using seconds = std::chrono::seconds;
+
+        // Delta seconds larger than this are treated as this, as RFC 9111 requires
+        static constexpr seconds max_delta_seconds { 2147483648LL };
+
+        std::optional<seconds> max_age;
+        std::optional<seconds> s_maxage;
+        // Set to the largest value when given without one
+        std::optional<seconds> max_stale;
+        std::optional<seconds> min_fresh;
+        bool no_cache;
+        bool no_store;
+        bool is_private;
+        bool is_public;
+        bool must_revalidate;
+        bool proxy_revalidate;
+        bool only_if_cached;
+
+        cache_control();
+
+        static cache_control parse(const message &msg);
+    };
+
+    /*
+        Parses an HTTP date in any of the three formats HTTP allows.
+        Returns nothing if the date is invalid.
+    */
+    std::optional<std::chrono::system_clock::time_point> parse_http_date(std::string_view str);
+}
\ No newline at end of file
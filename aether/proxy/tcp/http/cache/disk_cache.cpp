@@ -0,0 +1,752 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "disk_cache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#include <aether/program/options.hpp>
+#include <aether/proxy/error/exceptions.hpp>
+#include <aether/proxy/tcp/http/cache/response_cache.hpp>
+#include <aether/proxy/tcp/http/exchange.hpp>
+#include <aether/proxy/tcp/http/http1/http_parser.hpp>
+#include <aether/util/console.hpp>
+
+namespace proxy::tcp::http::cache {
+    namespace {
+        // Written at the start of the index, so a file from an incompatible version is never misread
+        constexpr std::string_view index_magic = "AETHRIX1";
+
+        template <typename T>
+        void append_value(std::string &out, T value) {
+            char bytes[sizeof(T)];
+            std::memcpy(bytes, &value, sizeof(T));
+            out.append(bytes, sizeof(T));
+        }
+
+        void append_string(std::string &out, std::string_view str) {
+            append_value<std::uint32_t>(out, static_cast<std::uint32_t>(str.length()));
+            out.append(str.data(), str.length());
+        }
+
+        /*
+            Reads values written by append_value and append_string, failing once the input runs out.
+        */
+        class index_reader {
+        private:
+            std::string_view input;
+            std::size_t pos;
+
+        public:
+            index_reader(std::string_view input)
+                : input(input),
+                pos(0)
+            { }
+
+            template <typename T>
+            bool read(T &value) {
+                if (input.length() - pos < sizeof(T)) {
+                    return false;
+                }
+                std::memcpy(&value, input.data() + pos, sizeof(T));
+                pos += sizeof(T);
+                return true;
+            }
+
+            bool read(std::string &str) {
+                std::uint32_t length;
+                if (!read(length) || input.length() - pos < length) {
+                    return false;
+                }
+                str.assign(input.data() + pos, length);
+                pos += length;
+                return true;
+            }
+        };
+
+        std::int64_t to_seconds(cache_entry::clock::time_point time) {
+            return std::chrono::duration_cast<std::chrono::seconds>(time.time_since_epoch()).count();
+        }
+    }
+
+    boost::asio::const_buffer disk_body::buffer(std::uint64_t position, std::size_t size) const {
+        const char *data = static_cast<const char *>(mapping->region.get_address()) + offset + position;
+        return boost::asio::buffer(data, static_cast<std::size_t>(std::min<std::uint64_t>(size, length - position)));
+    }
+
+    disk_writer::disk_writer(disk_cache &owner, std::shared_ptr<cache_entry> entry, std::uint32_t segment, std::uint64_t offset, std::uint32_t head_length, std::uint64_t length)
+        : owner(owner),
+        entry(std::move(entry)),
+        segment(segment),
+        offset(offset),
+        head_length(head_length),
+        length(length),
+        written(0),
+        failed(false)
+    { }
+
+    bool disk_writer::write(boost::asio::const_buffer data) {
+        if (failed) {
+            return false;
+        }
+        if (written + data.size() > length || owner.queued_bytes + data.size() > disk_cache::max_queued_bytes) {
+            failed = true;
+            ++owner.dropped;
+            return false;
+        }
+
+        auto copy = std::make_shared<std::string>(static_cast<const char *>(data.data()), data.size());
+        std::uint64_t position = offset + head_length + written;
+        owner.queue([this_owner = &owner, segment = segment, position, copy]() {
+            this_owner->write_segment(segment, position, copy->data(), copy->size());
+        }, copy->size());
+        written += data.size();
+
+        if (written == length) {
+            disk_cache::record rec = disk_cache::make_record(*entry);
+            rec.segment = segment;
+            rec.offset = offset;
+            rec.head_length = head_length;
+            rec.body_segment = segment;
+            rec.body_offset = offset + head_length;
+            rec.body_length = length;
+            owner.queue([this_owner = &owner, key = entry->key, rec]() {
+                this_owner->commit(key, rec);
+            });
+        }
+        return true;
+    }
+
+    disk_cache::disk_cache()
+        : enabled(false),
+        dir(),
+        capacity(0),
+        segment_size(0),
+        max_object_size(0),
+        mutex(),
+        records(),
+        variants(),
+        segments(),
+        mappings(),
+        current_segment(0),
+        total_size(0),
+        eviction_queued(false),
+        queue_mutex(),
+        queue_ready(),
+        jobs(),
+        stopping(false),
+        worker(),
+        queued_bytes(0),
+        segment_files(),
+        index_file(),
+        index_size(0),
+        compacted_index_size(0),
+        hits(0),
+        stores(0),
+        dropped(0),
+        evictions(0)
+    { }
+
+    disk_cache::~disk_cache() {
+        // The worker must be stopped before the members it uses are destroyed
+        cleanup();
+    }
+
+    void disk_cache::init() {
+        const program::options &options = program::options::instance();
+        if (!options.cache || options.cache_dir.empty()) {
+            return;
+        }
+
+        dir = boost::filesystem::path(options.cache_dir).make_preferred();
+        capacity = options.cache_disk_size;
+        // About sixteen segments fit in the cache, so evicting one only gives up a small part of it
+        segment_size = std::clamp<std::uint64_t>(capacity / 16, min_segment_size, max_segment_size);
+        max_object_size = capacity / 4;
+
+        boost::system::error_code error;
+        boost::filesystem::create_directories(dir, error);
+        if (error) {
+            out::safe_error::log("Could not create the cache directory", dir.string(), ':', error.message());
+            return;
+        }
+
+        load();
+        enabled = true;
+        worker = std::thread(&disk_cache::run_worker, this);
+    }
+
+    void disk_cache::cleanup() {
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            stopping = true;
+        }
+        queue_ready.notify_all();
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+
+    bool disk_cache::is_enabled() const {
+        return enabled;
+    }
+
+    boost::filesystem::path disk_cache::segment_path(std::uint32_t segment) const {
+        std::ostringstream name;
+        name << segment_file_prefix << std::setw(8) << std::setfill('0') << segment;
+        return dir / name.str();
+    }
+
+    void disk_cache::load() {
+        // Segments are found on disk, since they may have outlived the index
+        boost::system::error_code error;
+        for (boost::filesystem::directory_iterator it(dir, error), end; !error && it != end; it.increment(error)) {
+            std::string name = it->path().filename().string();
+            if (name.rfind(segment_file_prefix, 0) != 0) {
+                continue;
+            }
+            try {
+                std::uint32_t segment = static_cast<std::uint32_t>(std::stoul(name.substr(segment_file_prefix.length())));
+                segments[segment] = boost::filesystem::file_size(it->path());
+                current_segment = std::max(current_segment, segment);
+            }
+            catch (const std::exception &) { }
+        }
+
+        std::string contents;
+        {
+            std::ifstream file((dir / index_file_name.data()).string(), std::ios::binary);
+            std::ostringstream buffer;
+            buffer << file.rdbuf();
+            contents = buffer.str();
+        }
+
+        if (contents.compare(0, index_magic.length(), index_magic) == 0) {
+            index_reader reader(std::string_view(contents).substr(index_magic.length()));
+
+            // A record cut off by a crash ends the index, since nothing after it was written
+            while (true) {
+                std::uint8_t operation;
+                std::string key;
+                if (!reader.read(operation) || !reader.read(key)) {
+                    break;
+                }
+                if (static_cast<index_operation>(operation) == index_operation::remove) {
+                    records.erase(key);
+                    continue;
+                }
+
+                record rec;
+                std::string vary;
+                if (!reader.read(rec.segment) || !reader.read(rec.offset) || !reader.read(rec.head_length)
+                    || !reader.read(rec.body_segment) || !reader.read(rec.body_offset) || !reader.read(rec.body_length)
+                    || !reader.read(rec.response_time) || !reader.read(rec.corrected_initial_age) || !reader.read(rec.freshness_lifetime)
+                    || !reader.read(rec.flags) || !reader.read(vary)) {
+                    break;
+                }
+                if (!vary.empty()) {
+                    rec.vary = util::string::split(vary, ',');
+                }
+                records[key] = std::move(rec);
+            }
+        }
+
+        // Only records whose data is all in segments that still exist can be served
+        for (auto it = records.begin(); it != records.end();) {
+            const record &rec = it->second;
+            auto head_segment = segments.find(rec.segment);
+            auto body_segment = segments.find(rec.body_segment);
+            bool valid = head_segment != segments.end() && body_segment != segments.end()
+                && rec.offset + rec.head_length <= head_segment->second
+                && rec.body_offset + rec.body_length <= body_segment->second;
+            it = valid ? std::next(it) : records.erase(it);
+        }
+        for (const auto &[key, rec] : records) {
+            variant_set &set = variants[key.substr(0, key.find('\n'))];
+            set.vary = rec.vary;
+            set.keys.push_back(key);
+        }
+        for (const auto &[segment, size] : segments) {
+            total_size += size;
+        }
+
+        // New responses never go into a segment that may end with a partial write
+        ++current_segment;
+        segments[current_segment] = 0;
+
+        rewrite_index();
+        out::debug::log("Loaded ", records.size(), " cached responses from ", dir.string());
+
+        if (total_size > capacity) {
+            eviction_queued = true;
+            jobs.push_back([this]() { evict(); });
+        }
+    }
+
+    void disk_cache::run_worker() {
+        while (true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(queue_mutex);
+                queue_ready.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                if (jobs.empty()) {
+                    break;
+                }
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            try {
+                job();
+            }
+            catch (const std::exception &ex) {
+                out::safe_error::log("Error in the disk cache:", ex.what());
+            }
+        }
+
+        for (auto &[segment, file] : segment_files) {
+            file.close();
+        }
+        index_file.close();
+    }
+
+    void disk_cache::queue(std::function<void()> job, std::size_t bytes) {
+        queued_bytes += bytes;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            if (bytes == 0) {
+                jobs.push_back(std::move(job));
+            }
+            else {
+                jobs.push_back([this, job = std::move(job), bytes]() {
+                    job();
+                    queued_bytes -= bytes;
+                });
+            }
+        }
+        queue_ready.notify_one();
+    }
+
+    std::pair<std::uint32_t, std::uint64_t> disk_cache::reserve(std::uint64_t size) {
+        std::lock_guard<std::mutex> lock(mutex);
+        // A response larger than a segment gets a segment of its own
+        if (segments[current_segment] != 0 && segments[current_segment] + size > segment_size) {
+            ++current_segment;
+        }
+        std::uint64_t &end = segments[current_segment];
+        std::uint64_t offset = end;
+        end += size;
+        total_size += size;
+
+        if (total_size > capacity && !eviction_queued) {
+            eviction_queued = true;
+            queue([this]() { evict(); });
+        }
+        return { current_segment, offset };
+    }
+
+    std::shared_ptr<const mapped_segment> disk_cache::map_segment(std::uint32_t segment, std::uint64_t end) {
+        auto it = mappings.find(segment);
+        if (it != mappings.end() && it->second->region.get_size() >= end) {
+            return it->second;
+        }
+
+        // Segments still being written grow, so they are mapped again once a response is past the old end
+        auto mapping = std::make_shared<mapped_segment>();
+        std::string path = segment_path(segment).string();
+        mapping->file = boost::interprocess::file_mapping(path.c_str(), boost::interprocess::read_only);
+        mapping->region = boost::interprocess::mapped_region(mapping->file, boost::interprocess::read_only, 0,
+            static_cast<std::size_t>(boost::filesystem::file_size(path)));
+        if (mapping->region.get_size() < end) {
+            return nullptr;
+        }
+        mappings[segment] = mapping;
+        return mapping;
+    }
+
+    std::optional<std::vector<std::string>> disk_cache::variant_names(const std::string &primary_key) {
+        if (!enabled) {
+            return { };
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = variants.find(primary_key);
+        if (it == variants.end()) {
+            return { };
+        }
+        return it->second.vary;
+    }
+
+    std::shared_ptr<cache_entry> disk_cache::find(const std::string &key, std::size_t inline_limit) {
+        if (!enabled) {
+            return nullptr;
+        }
+
+        record rec;
+        std::shared_ptr<const mapped_segment> head_mapping;
+        std::shared_ptr<const mapped_segment> body_mapping;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = records.find(key);
+            if (it == records.end()) {
+                return nullptr;
+            }
+            rec = it->second;
+            try {
+                head_mapping = map_segment(rec.segment, rec.offset + rec.head_length);
+                body_mapping = map_segment(rec.body_segment, rec.body_offset + rec.body_length);
+            }
+            catch (const std::exception &) { }
+            if (!head_mapping || !body_mapping) {
+                erase(key);
+                return nullptr;
+            }
+        }
+
+        auto entry = std::make_shared<cache_entry>();
+        try {
+            streambuf head;
+            const char *head_data = static_cast<const char *>(head_mapping->region.get_address()) + rec.offset;
+            head.commit(boost::asio::buffer_copy(head.prepare(rec.head_length), boost::asio::buffer(head_data, rec.head_length)));
+            exchange exch;
+            http1::http_parser parser(exch);
+            exch.make_response();
+            if (!parser.scan_head(head)) {
+                return nullptr;
+            }
+            parser.read_response_head(head);
+            entry->res = std::move(exch.response());
+        }
+        catch (const error::base_exception &) {
+            return nullptr;
+        }
+
+        entry->key = key;
+        entry->primary_key = key.substr(0, key.find('\n'));
+        entry->vary = rec.vary;
+        entry->response_time = cache_entry::clock::time_point(std::chrono::seconds(rec.response_time));
+        entry->corrected_initial_age = std::chrono::seconds(rec.corrected_initial_age);
+        entry->freshness_lifetime = std::chrono::seconds(rec.freshness_lifetime);
+        entry->must_revalidate = rec.flags & must_revalidate_flag;
+        entry->no_cache = rec.flags & no_cache_flag;
+        entry->size = rec.head_length + rec.body_length + key.length() * 3 + entry->primary_key.length() + 256;
+
+        auto body = std::make_shared<disk_body>();
+        body->segment = rec.body_segment;
+        body->path = segment_path(rec.body_segment);
+        body->offset = rec.body_offset;
+        body->length = rec.body_length;
+        body->mapping = std::move(body_mapping);
+        if (rec.body_length <= inline_limit) {
+            auto data = body->buffer(0, static_cast<std::size_t>(rec.body_length));
+            entry->res.set_body({ static_cast<const char *>(data.data()), data.size() });
+        }
+        else {
+            entry->body = std::move(body);
+        }
+
+        ++hits;
+        return entry;
+    }
+
+    disk_cache::record disk_cache::make_record(const cache_entry &entry) {
+        record rec { };
+        rec.response_time = to_seconds(entry.response_time);
+        rec.corrected_initial_age = entry.corrected_initial_age.count();
+        rec.freshness_lifetime = entry.freshness_lifetime.count();
+        rec.flags = (entry.must_revalidate ? must_revalidate_flag : 0) | (entry.no_cache ? no_cache_flag : 0);
+        rec.vary = entry.vary;
+        return rec;
+    }
+
+    void disk_cache::store(const std::shared_ptr<const cache_entry> &entry) {
+        if (!enabled) {
+            return;
+        }
+        std::uint64_t body_length = entry->body ? entry->body->length : entry->res.content_length();
+        if (body_length > max_object_size) {
+            return;
+        }
+
+        record rec = make_record(*entry);
+        {
+            // Responses are offered again each time they leave memory, but are only written once
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = records.find(entry->key);
+            if (it != records.end() && it->second.response_time == rec.response_time && it->second.body_length == body_length) {
+                return;
+            }
+        }
+
+        std::ostringstream out;
+        entry->res.write_head(out);
+        auto head = std::make_shared<std::string>(out.str());
+        std::uint64_t size = head->length() + (entry->body ? 0 : body_length);
+        if (queued_bytes + size > max_queued_bytes) {
+            ++dropped;
+            return;
+        }
+
+        auto [segment, offset] = reserve(size);
+        rec.segment = segment;
+        rec.offset = offset;
+        rec.head_length = static_cast<std::uint32_t>(head->length());
+        rec.body_length = body_length;
+        if (entry->body) {
+            rec.body_segment = entry->body->segment;
+            rec.body_offset = entry->body->offset;
+        }
+        else {
+            rec.body_segment = segment;
+            rec.body_offset = offset + head->length();
+        }
+
+        queue([this, entry, head, rec]() {
+            bool written = write_segment(rec.segment, rec.offset, head->data(), head->length());
+            if (written && !entry->body) {
+                std::string body = entry->res.get_body();
+                written = write_segment(rec.segment, rec.body_offset, body.data(), body.length());
+            }
+            if (written) {
+                commit(entry->key, rec);
+            }
+        }, static_cast<std::size_t>(size));
+    }
+
+    std::unique_ptr<disk_writer> disk_cache::open_writer(const std::shared_ptr<cache_entry> &entry, std::uint64_t length) {
+        if (!enabled || length > max_object_size) {
+            return nullptr;
+        }
+
+        std::ostringstream out;
+        entry->res.write_head(out);
+        auto head = std::make_shared<std::string>(out.str());
+        if (queued_bytes + head->length() > max_queued_bytes) {
+            ++dropped;
+            return nullptr;
+        }
+
+        auto [segment, offset] = reserve(head->length() + length);
+        queue([this, segment = segment, offset = offset, head]() {
+            write_segment(segment, offset, head->data(), head->length());
+        }, head->length());
+        return std::make_unique<disk_writer>(*this, entry, segment, offset, static_cast<std::uint32_t>(head->length()), length);
+    }
+
+    bool disk_cache::write_segment(std::uint32_t segment, std::uint64_t offset, const char *data, std::size_t size) {
+        {
+            // An evicted segment must not be created again
+            std::lock_guard<std::mutex> lock(mutex);
+            if (segments.find(segment) == segments.end()) {
+                return false;
+            }
+        }
+
+        auto it = segment_files.find(segment);
+        if (it == segment_files.end()) {
+            std::string path = segment_path(segment).string();
+            if (!boost::filesystem::exists(path)) {
+                std::ofstream(path, std::ios::binary);
+            }
+            it = segment_files.emplace(segment, std::fstream(path, std::ios::in | std::ios::out | std::ios::binary)).first;
+        }
+
+        std::fstream &file = it->second;
+        file.seekp(static_cast<std::streamoff>(offset));
+        file.write(data, static_cast<std::streamsize>(size));
+        if (!file) {
+            file.clear();
+            ++dropped;
+            return false;
+        }
+        return true;
+    }
+
+    void disk_cache::commit(const std::string &key, const record &rec) {
+        // Data must reach the file before the index points to it
+        for (std::uint32_t segment : { rec.segment, rec.body_segment }) {
+            if (auto it = segment_files.find(segment); it != segment_files.end()) {
+                it->second.flush();
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (segments.find(rec.segment) == segments.end() || segments.find(rec.body_segment) == segments.end()) {
+                return;
+            }
+
+            if (records.find(key) != records.end()) {
+                erase(key);
+            }
+            // Variants selected by different headers can no longer be told apart
+            std::string primary_key = key.substr(0, key.find('\n'));
+            if (auto it = variants.find(primary_key); it != variants.end() && it->second.vary != rec.vary) {
+                for (const auto &variant : std::vector<std::string>(it->second.keys)) {
+                    erase(variant);
+                }
+            }
+            variant_set &set = variants[primary_key];
+            set.vary = rec.vary;
+            set.keys.push_back(key);
+            records[key] = rec;
+        }
+
+        append_index(index_operation::put, key, &rec);
+        compact_index();
+        ++stores;
+    }
+
+    void disk_cache::erase(const std::string &key) {
+        std::string primary_key = key.substr(0, key.find('\n'));
+        if (auto it = variants.find(primary_key); it != variants.end()) {
+            auto &keys = it->second.keys;
+            keys.erase(std::remove(keys.begin(), keys.end(), key), keys.end());
+            if (keys.empty()) {
+                variants.erase(it);
+            }
+        }
+        records.erase(key);
+    }
+
+    void disk_cache::invalidate(const std::string &primary_key) {
+        if (!enabled) {
+            return;
+        }
+
+        std::vector<std::string> keys;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = variants.find(primary_key);
+            if (it == variants.end()) {
+                return;
+            }
+            keys = it->second.keys;
+            for (const auto &key : keys) {
+                erase(key);
+            }
+        }
+        queue([this, keys]() {
+            for (const auto &key : keys) {
+                append_index(index_operation::remove, key, nullptr);
+            }
+            compact_index();
+        });
+    }
+
+    void disk_cache::append_index(index_operation operation, const std::string &key, const record *rec) {
+        std::string data;
+        append_value(data, static_cast<std::uint8_t>(operation));
+        append_string(data, key);
+        if (rec) {
+            append_value(data, rec->segment);
+            append_value(data, rec->offset);
+            append_value(data, rec->head_length);
+            append_value(data, rec->body_segment);
+            append_value(data, rec->body_offset);
+            append_value(data, rec->body_length);
+            append_value(data, rec->response_time);
+            append_value(data, rec->corrected_initial_age);
+            append_value(data, rec->freshness_lifetime);
+            append_value(data, rec->flags);
+            append_string(data, util::string::join(rec->vary, ","));
+        }
+        index_file.write(data.data(), static_cast<std::streamsize>(data.length()));
+        index_file.flush();
+        index_size += data.length();
+    }
+
+    void disk_cache::compact_index() {
+        // Replaced and removed records pile up, so the index is rewritten once they outweigh the live ones
+        if (index_size > compacted_index_size * 2 + 1024 * 1024) {
+            rewrite_index();
+        }
+    }
+
+    void disk_cache::rewrite_index() {
+        std::unordered_map<std::string, record> live;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            live = records;
+        }
+
+        boost::filesystem::path path = dir / index_file_name.data();
+        boost::filesystem::path temporary = path;
+        temporary += ".tmp";
+
+        index_file.close();
+        index_file.clear();
+        index_file.open(temporary.string(), std::ios::binary | std::ios::trunc);
+        index_file.write(index_magic.data(), static_cast<std::streamsize>(index_magic.length()));
+        index_size = index_magic.length();
+        for (const auto &[key, rec] : live) {
+            append_index(index_operation::put, key, &rec);
+        }
+        index_file.close();
+
+        // Renaming replaces the old index all at once, so a crash leaves one index or the other
+        boost::system::error_code error;
+        boost::filesystem::rename(temporary, path, error);
+        if (error) {
+            out::safe_error::log("Could not replace the cache index:", error.message());
+        }
+        index_file.clear();
+        index_file.open(path.string(), std::ios::binary | std::ios::app);
+        compacted_index_size = index_size;
+    }
+
+    void disk_cache::evict() {
+        std::vector<std::uint32_t> removed;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            eviction_queued = false;
+            while (total_size > capacity && segments.size() > 1 && segments.begin()->first != current_segment) {
+                auto [segment, size] = *segments.begin();
+                for (auto it = records.begin(); it != records.end();) {
+                    if (it->second.segment == segment || it->second.body_segment == segment) {
+                        std::string key = it->first;
+                        ++it;
+                        erase(key);
+                    }
+                    else {
+                        ++it;
+                    }
+                }
+                mappings.erase(segment);
+                segments.erase(segments.begin());
+                total_size -= size;
+                removed.push_back(segment);
+                ++evictions;
+            }
+        }
+        if (removed.empty()) {
+            return;
+        }
+
+        // Readers hold their own mappings, which stay valid after the file is gone
+        for (std::uint32_t segment : removed) {
+            segment_files.erase(segment);
+            boost::system::error_code error;
+            boost::filesystem::remove(segment_path(segment), error);
+        }
+        rewrite_index();
+    }
+
+    disk_cache::statistics disk_cache::get_statistics() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return {
+            hits.load(),
+            stores.load(),
+            dropped.load(),
+            evictions.load(),
+            records.size(),
+            enabled ? segments.size() : 0,
+            static_cast<std::size_t>(total_size)
+        };
+    }
+}
\ No newline at end of file
@@ -0,0 +1,301 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <aether/util/singleton.hpp>
+
+namespace proxy::tcp::http::cache {
+    struct cache_entry;
+
+    /*
+        Read-only mapping of a segment file, shared by every body read from it.
+        Stays valid after the segment is evicted, until the last reader lets go of it.
+    */
+    struct mapped_segment {
+        boost::interprocess::file_mapping file;
+        boost::interprocess::mapped_region region;
+    };
+
+    /*
+        Body of a stored response that stays on disk until it is sent.
+    */
+    struct disk_body {
+        std::uint32_t segment;
+        boost::filesystem::path path;
+        std::uint64_t offset;
+        std::uint64_t length;
+        std::shared_ptr<const mapped_segment> mapping;
+
+        /*
+            Returns part of the body, read through the mapping.
+        */
+        boost::asio::const_buffer buffer(std::uint64_t position, std::size_t size) const;
+    };
+
+    class disk_cache;
+
+    /*
+        Copies a response body to disk as it is relayed to the client.
+        The response is only added to the index once its whole body has been written,
+            so dropping the writer early abandons it.
+    */
+    class disk_writer
+        : private boost::noncopyable {
+        friend class disk_cache;
+
+    private:
+        disk_cache &owner;
+        std::shared_ptr<cache_entry> entry;
+        std::uint32_t segment;
+        // Where the head starts in the segment, with the body right after it
+        std::uint64_t offset;
+        std::uint32_t head_length;
+        std::uint64_t length;
+        std::uint64_t written;
+        bool failed;
+
+    public:
+        disk_writer(disk_cache &owner, std::shared_ptr<cache_entry> entry, std::uint32_t segment, std::uint64_t offset, std::uint32_t head_length, std::uint64_t length);
+
+        /*
+            Queues the next part of the body to be written.
+            Returns false once the writer has given up, after which nothing more is written.
+        */
+        bool write(boost::asio::const_buffer data);
+    };
+
+    /*
+        Disk tier of the response cache, for responses the memory tier has no room for.
+        Responses are appended to segment files, which are read through memory mappings.
+        An append-only index file records where each response is, so the cache survives restarts.
+        All file writes and evictions happen on a background thread, never on an io_context thread.
+        Eviction removes whole segments, oldest first, once the cache grows past its size.
+    */
+    class disk_cache
+        : public util::singleton<disk_cache> {
+        friend class disk_writer;
+
+    public:
+        // Smallest size a segment grows to before responses go to a new one
+        static constexpr std::uint64_t min_segment_size = 4 * 1024 * 1024;
+
+        // Largest size a segment grows to before responses go to a new one
+        static constexpr std::uint64_t max_segment_size = 64 * 1024 * 1024;
+
+        // Bytes waiting for the disk are capped, so a slow disk drops responses instead of holding their bodies in memory
+        static constexpr std::size_t max_queued_bytes = 64 * 1024 * 1024;
+
+        static constexpr std::string_view index_file_name = "index";
+        static constexpr std::string_view segment_file_prefix = "segment-";
+
+        /*
+            Counters for the disk tier of the response cache.
+        */
+        struct statistics {
+            std::size_t hits;
+            std::size_t stores;
+            // Responses given up on because the disk could not keep up or a write failed
+            std::size_t dropped;
+            // Segments removed to keep the cache within its size
+            std::size_t evictions;
+            std::size_t entries;
+            std::size_t segments;
+            // Bytes taken by segment files, including responses that are no longer indexed
+            std::size_t size;
+        };
+
+    private:
+        /*
+            Location and freshness of one stored response, as kept in the index.
+        */
+        struct record {
+            std::uint32_t segment;
+            std::uint64_t offset;
+            std::uint32_t head_length;
+            // The body may be in another segment when only the head was rewritten after a revalidation
+            std::uint32_t body_segment;
+            std::uint64_t body_offset;
+            std::uint64_t body_length;
+            std::int64_t response_time;
+            std::int64_t corrected_initial_age;
+            std::int64_t freshness_lifetime;
+            std::uint8_t flags;
+            std::vector<std::string> vary;
+        };
+
+        enum class index_operation : std::uint8_t {
+            put = 1,
+            remove = 2
+        };
+
+        enum record_flags : std::uint8_t {
+            must_revalidate_flag = 1 << 0,
+            no_cache_flag = 1 << 1
+        };
+
+        /*
+            Vary header names of the responses stored under one primary key, and the keys they were stored with.
+        */
+        struct variant_set {
+            std::vector<std::string> vary;
+            std::vector<std::string> keys;
+        };
+
+        bool enabled;
+        boost::filesystem::path dir;
+        std::uint64_t capacity;
+        std::uint64_t segment_size;
+        std::uint64_t max_object_size;
+
+        // Guards the index and segment tables, which are read on io_context threads
+        std::mutex mutex;
+        std::unordered_map<std::string, record> records;
+        std::unordered_map<std::string, variant_set> variants;
+        // Bytes reserved in each segment, which is at least its file size
+        std::map<std::uint32_t, std::uint64_t> segments;
+        std::unordered_map<std::uint32_t, std::shared_ptr<const mapped_segment>> mappings;
+        std::uint32_t current_segment;
+        std::uint64_t total_size;
+        bool eviction_queued;
+
+        std::mutex queue_mutex;
+        std::condition_variable queue_ready;
+        std::deque<std::function<void()>> jobs;
+        bool stopping;
+        std::thread worker;
+        std::atomic<std::size_t> queued_bytes;
+
+        // Only used on the worker thread
+        std::map<std::uint32_t, std::fstream> segment_files;
+        std::ofstream index_file;
+        std::uint64_t index_size;
+        // Size of the index when it was last rewritten
+        std::uint64_t compacted_index_size;
+
+        std::atomic<std::size_t> hits;
+        std::atomic<std::size_t> stores;
+        std::atomic<std::size_t> dropped;
+        std::atomic<std::size_t> evictions;
+
+        boost::filesystem::path segment_path(std::uint32_t segment) const;
+
+        /*
+            Loads the index, dropping records whose data did not survive, and rewrites it without them.
+        */
+        void load();
+
+        void run_worker();
+        void queue(std::function<void()> job, std::size_t bytes = 0);
+
+        /*
+            Reserves space at the end of the current segment, starting a new segment when it is full.
+        */
+        std::pair<std::uint32_t, std::uint64_t> reserve(std::uint64_t size);
+
+        /*
+            Returns a mapping that covers the segment up to the given end.
+        */
+        std::shared_ptr<const mapped_segment> map_segment(std::uint32_t segment, std::uint64_t end);
+
+        /*
+            Removes a record from the index tables. The lock must be held.
+        */
+        void erase(const std::string &key);
+
+        /*
+            Writes data at an offset in a segment. Only called on the worker thread.
+        */
+        bool write_segment(std::uint32_t segment, std::uint64_t offset, const char *data, std::size_t size);
+
+        /*
+            Makes a written record visible to lookups and appends it to the index. Only called on the worker thread.
+        */
+        void commit(const std::string &key, const record &rec);
+
+        void append_index(index_operation operation, const std::string &key, const record *rec);
+
+        /*
+            Rewrites the index with only the live records if it has grown well past them.
+        */
+        void compact_index();
+        void rewrite_index();
+
+        /*
+            Removes the oldest segments until the cache fits in its size. Only called on the worker thread.
+        */
+        void evict();
+
+        static record make_record(const cache_entry &entry);
+
+    public:
+        disk_cache();
+        ~disk_cache();
+
+        /*
+            Reads the cache directory from the program options, loads the index, and starts the worker thread.
+        */
+        void init();
+
+        /*
+            Stops the worker thread after it finishes the writes already queued.
+        */
+        void cleanup();
+
+        bool is_enabled() const;
+
+        /*
+            Returns the Vary header names of the responses stored under the primary key, if there are any.
+        */
+        std::optional<std::vector<std::string>> variant_names(const std::string &primary_key);
+
+        /*
+            Finds the stored response with the given key.
+            Bodies no larger than inline_limit are read into the response, others are left on disk.
+        */
+        std::shared_ptr<cache_entry> find(const std::string &key, std::size_t inline_limit);
+
+        /*
+            Queues a response to be written to disk, unless the same response is already there.
+            A response whose body is on disk only has its head written again.
+        */
+        void store(const std::shared_ptr<const cache_entry> &entry);
+
+        /*
+            Reserves room for a response whose body is relayed to the client as it arrives.
+            Returns nothing if the response cannot be stored.
+        */
+        std::unique_ptr<disk_writer> open_writer(const std::shared_ptr<cache_entry> &entry, std::uint64_t length);
+
+        /*
+            Removes every response stored under the primary key.
+        */
+        void invalidate(const std::string &primary_key);
+
+        statistics get_statistics();
+    };
+}
\ No newline at end of file
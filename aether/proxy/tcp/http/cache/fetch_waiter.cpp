@@ -0,0 +1,73 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "fetch_waiter.hpp"
+
+namespace proxy::tcp::http::cache {
+    fetch_waiter::fetch_waiter(boost::asio::io_context &ioc, std::chrono::milliseconds timeout, std::atomic<std::size_t> &timeouts)
+        : ioc(ioc),
+        timer(ioc),
+        timeout(timeout),
+        timeouts(timeouts),
+        handler()
+    { }
+
+    boost::asio::io_context &fetch_waiter::io_context() {
+        return ioc;
+    }
+
+    void fetch_waiter::wait(const callback &handler) {
+        this->handler = handler;
+        timer.expires_after(timeout);
+        // The timer must not keep the waiter alive, or it would call back an exchange that is gone
+        timer.async_wait([waiter = weak_from_this()](const boost::system::error_code &error) {
+            if (auto self = waiter.lock()) {
+                self->on_timeout(error);
+            }
+        });
+    }
+
+    void fetch_waiter::on_timeout(const boost::system::error_code &error) {
+        if (error != boost::asio::error::operation_aborted && handler) {
+            ++timeouts;
+            finish();
+        }
+    }
+
+    void fetch_waiter::finish() {
+        if (!handler) {
+            return;
+        }
+        timer.cancel();
+        // The handler usually drops the waiter, which the caller keeps alive until it returns
+        callback done = std::move(handler);
+        handler = nullptr;
+        done();
+    }
+
+    void fetch_waiter::wake(boost::asio::io_context &ioc, const std::weak_ptr<fetch_waiter> &waiter) {
+        boost::asio::post(ioc, [waiter]() {
+            if (auto self = waiter.lock()) {
+                self->finish();
+            }
+        });
+    }
+
+    pending_fetch::pending_fetch()
+        : waiters()
+    { }
+
+    pending_fetch::~pending_fetch() {
+        for (const auto &waiting : waiters) {
+            fetch_waiter::wake(*waiting.ioc, waiting.waiter);
+        }
+    }
+
+    void pending_fetch::add(const std::shared_ptr<fetch_waiter> &waiter) {
+        waiters.push_back({ &waiter->io_context(), waiter });
+    }
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <aether/proxy/types.hpp>
+
+namespace proxy::tcp::http::cache {
+    /*
+        An exchange waiting for another exchange to fetch the response it needs from the server.
+        The wait ends when that fetch is done with or when the timeout passes, whichever comes first.
+        The handler is called once, on the io_context the waiter was made for.
+        Nothing else keeps the waiter alive, so an exchange that drops it is never called back.
+    */
+    class fetch_waiter
+        : public std::enable_shared_from_this<fetch_waiter>,
+        private boost::noncopyable {
+    private:
+        boost::asio::io_context &ioc;
+        boost::asio::steady_timer timer;
+        std::chrono::milliseconds timeout;
+        // Counts the waits that end because the fetch took too long
+        std::atomic<std::size_t> &timeouts;
+        callback handler;
+
+        void finish();
+        void on_timeout(const boost::system::error_code &error);
+
+    public:
+        fetch_waiter(boost::asio::io_context &ioc, std::chrono::milliseconds timeout, std::atomic<std::size_t> &timeouts);
+
+        boost::asio::io_context &io_context();
+
+        /*
+            Starts waiting, calling the handler when the wait ends.
+            Must be called on the waiter's io_context, in the same handler that looked up the request.
+        */
+        void wait(const callback &handler);
+
+        /*
+            Ends the wait of a waiter that may still exist. Safe to call from any thread.
+        */
+        static void wake(boost::asio::io_context &ioc, const std::weak_ptr<fetch_waiter> &waiter);
+    };
+
+    /*
+        A response being fetched from the server on behalf of every exchange that needs it.
+        Held by the exchange that sends the request, and by whatever stores the response,
+            so the exchanges waiting for it are woken once the response is in the cache or will never be.
+    */
+    class pending_fetch
+        : private boost::noncopyable {
+    private:
+        struct waiting_exchange {
+            boost::asio::io_context *ioc;
+            std::weak_ptr<fetch_waiter> waiter;
+        };
+
+        std::vector<waiting_exchange> waiters;
+
+    public:
+        pending_fetch();
+        ~pending_fetch();
+
+        /*
+            Adds a waiter to wake when the fetch is done with.
+            The lock of the cache shard the fetch is registered in must be held.
+        */
+        void add(const std::shared_ptr<fetch_waiter> &waiter);
+    };
+}
\ No newline at end of file
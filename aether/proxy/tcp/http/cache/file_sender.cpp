@@ -0,0 +1,100 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "file_sender.hpp"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+#endif
+
+namespace proxy::tcp::http::cache {
+    file_sender::file_sender()
+        : fd(-1),
+        offset(0),
+        remaining(0)
+    { }
+
+    file_sender::~file_sender() {
+        close();
+    }
+
+    bool file_sender::is_open() const {
+        return fd != -1;
+    }
+
+    std::uint64_t file_sender::size() const {
+        return remaining;
+    }
+
+#ifdef __linux__
+    namespace {
+        boost::system::error_code last_error() {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return boost::asio::error::would_block;
+            }
+            return boost::system::error_code(errno, boost::system::system_category());
+        }
+    }
+
+    void file_sender::open(const disk_body &body, boost::system::error_code &error) {
+        close();
+        // The mapping keeps an evicted segment alive, but a new descriptor can only be opened while the file exists
+        fd = ::open(body.path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            error = last_error();
+            return;
+        }
+        offset = body.offset;
+        remaining = body.length;
+        error = boost::system::errc::make_error_code(boost::system::errc::success);
+    }
+
+    void file_sender::close() {
+        if (fd != -1) {
+            ::close(fd);
+            fd = -1;
+        }
+        remaining = 0;
+    }
+
+    std::size_t file_sender::send(native_handle socket_fd, boost::system::error_code &error) {
+        std::size_t total = 0;
+        while (remaining > 0) {
+            off_t position = static_cast<off_t>(offset);
+            ssize_t sent = ::sendfile(socket_fd, fd, &position, static_cast<std::size_t>(std::min<std::uint64_t>(remaining, chunk_size)));
+            if (sent <= 0) {
+                // The file is shorter than the index says
+                error = sent < 0 ? last_error() : boost::asio::error::eof;
+                return total;
+            }
+            offset += static_cast<std::uint64_t>(sent);
+            remaining -= static_cast<std::uint64_t>(sent);
+            total += static_cast<std::size_t>(sent);
+        }
+        error = boost::system::errc::make_error_code(boost::system::errc::success);
+        return total;
+    }
+#else
+    void file_sender::open(const disk_body &, boost::system::error_code &error) {
+        error = boost::asio::error::operation_not_supported;
+    }
+
+    void file_sender::close() {
+        remaining = 0;
+    }
+
+    std::size_t file_sender::send(native_handle, boost::system::error_code &error) {
+        error = boost::asio::error::operation_not_supported;
+        return 0;
+    }
+#endif
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <aether/proxy/tcp/http/cache/disk_cache.hpp>
+
+namespace proxy::tcp::http::cache {
+    /*
+        Sends a body stored on disk to a socket with sendfile().
+        The body goes from the page cache to the socket without ever being copied into user space.
+        Only available on Linux. On other platforms, is_supported() is always false.
+    */
+    class file_sender
+        : private boost::noncopyable {
+    public:
+        using native_handle = boost::asio::ip::tcp::socket::native_handle_type;
+
+        // Maximum number of bytes handed to sendfile() at once
+        static constexpr std::size_t chunk_size = 1024 * 1024;
+
+    private:
+        int fd;
+        std::uint64_t offset;
+        std::uint64_t remaining;
+
+    public:
+        file_sender();
+        ~file_sender();
+
+        static constexpr bool is_supported() {
+#ifdef __linux__
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        /*
+            Opens the segment file the body is stored in.
+        */
+        void open(const disk_body &body, boost::system::error_code &error);
+
+        /*
+            Closes the segment file.
+        */
+        void close();
+
+        bool is_open() const;
+
+        /*
+            Sends as much of the body as the socket accepts.
+            Sets error to would_block if the socket cannot accept any more data.
+        */
+        std::size_t send(native_handle socket_fd, boost::system::error_code &error);
+
+        /*
+            Returns the number of bytes of the body not yet sent.
+        */
+        std::uint64_t size() const;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,67 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "frequency_sketch.hpp"
+
+#include <algorithm>
+
+namespace proxy::tcp::http::cache {
+    frequency_sketch::frequency_sketch(std::size_t width)
+        : counters(),
+        mask(0),
+        additions(0),
+        sample_size(0)
+    {
+        std::size_t size = 64;
+        while (size < width) {
+            size <<= 1;
+        }
+        counters.assign(size * depth, 0);
+        mask = size - 1;
+        // Counts are halved often enough that each counter stays well below saturation on average
+        sample_size = size * 10;
+    }
+
+    std::size_t frequency_sketch::index(std::uint64_t hash, std::size_t row) const {
+        static constexpr std::array<std::uint64_t, depth> seeds = {
+            0x9e3779b97f4a7c15, 0xc2b2ae3d27d4eb4f, 0x165667b19e3779f9, 0x27d4eb2f165667c5
+        };
+
+        // Each row mixes the hash with its own seed, so collisions in one row are unlikely to repeat in another
+        std::uint64_t h = (hash ^ seeds[row]) * 0xbf58476d1ce4e5b9;
+        h ^= h >> 31;
+        return row * (mask + 1) + static_cast<std::size_t>(h & mask);
+    }
+
+    void frequency_sketch::record(std::uint64_t hash) {
+        for (std::size_t row = 0; row < depth; ++row) {
+            std::uint8_t &counter = counters[index(hash, row)];
+            if (counter < max_count) {
+                ++counter;
+            }
+        }
+
+        if (++additions >= sample_size) {
+            age();
+        }
+    }
+
+    std::uint8_t frequency_sketch::estimate(std::uint64_t hash) const {
+        std::uint8_t count = max_count;
+        for (std::size_t row = 0; row < depth; ++row) {
+            count = std::min(count, counters[index(hash, row)]);
+        }
+        return count;
+    }
+
+    void frequency_sketch::age() {
+        for (auto &counter : counters) {
+            counter >>= 1;
+        }
+        additions /= 2;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,56 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace proxy::tcp::http::cache {
+    /*
+        Approximate count of how often each key has been used, for TinyLFU admission.
+        A count-min sketch of small saturating counters, so it takes a fixed amount of memory
+            however many keys it sees.
+        Every count is halved after a set number of uses, so keys that were popular long ago fade out.
+        Not thread-safe.
+    */
+    class frequency_sketch {
+    public:
+        static constexpr std::size_t depth = 4;
+        static constexpr std::uint8_t max_count = 15;
+
+    private:
+        std::vector<std::uint8_t> counters;
+        std::size_t mask;
+        std::size_t additions;
+        std::size_t sample_size;
+
+        std::size_t index(std::uint64_t hash, std::size_t row) const;
+
+        /*
+            Halves every counter.
+        */
+        void age();
+
+    public:
+        /*
+            Creates a sketch with at least the given number of counters per row.
+        */
+        explicit frequency_sketch(std::size_t width);
+
+        /*
+            Counts one use of the key with the given hash.
+        */
+        void record(std::uint64_t hash);
+
+        /*
+            Returns how often the key with the given hash has been used, possibly too high but never too low.
+        */
+        std::uint8_t estimate(std::uint64_t hash) const;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,633 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "response_cache.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <boost/lexical_cast.hpp>
+
+#include <aether/program/options.hpp>
+#include <aether/proxy/tcp/http/cache/cache_control.hpp>
+#include <aether/util/string.hpp>
+
+namespace proxy::tcp::http::cache {
+    namespace {
+        // Never stored, and never taken from a 304 response
+        constexpr std::array<std::string_view, 8> hop_by_hop_headers = {
+            "Connection", "Keep-Alive", "Proxy-Connection", "Proxy-Authenticate", "TE", "Trailer", "Transfer-Encoding", "Upgrade"
+        };
+
+        // Request headers that make the client expect a response to a condition of its own
+        constexpr std::array<std::string_view, 5> conditional_headers = {
+            "If-None-Match", "If-Modified-Since", "If-Match", "If-Unmodified-Since", "If-Range"
+        };
+
+        bool is_hop_by_hop(std::string_view name) {
+            return std::any_of(hop_by_hop_headers.begin(), hop_by_hop_headers.end(),
+                [name](std::string_view header) { return util::string::iequals_fn(name, header); });
+        }
+
+        void remove_hop_by_hop_headers(response &res) {
+            for (const auto &value : res.get_all_of_header("Connection")) {
+                for (const auto &name : util::string::split_trim(value, ',')) {
+                    res.remove_header(name);
+                }
+            }
+            for (auto name : hop_by_hop_headers) {
+                res.remove_header(name);
+            }
+        }
+
+        /*
+            Statuses RFC 9110 allows to be cached without explicit freshness.
+        */
+        bool is_heuristically_cacheable(status code) {
+            switch (code) {
+                case status::ok:
+                case status::non_authoritative_information:
+                case status::no_content:
+                case status::multiple_choices:
+                case status::moved_permanently:
+                case status::permanent_redirect:
+                case status::not_found:
+                case status::method_not_allowed:
+                case status::gone:
+                case status::uri_too_long:
+                case status::not_implemented:
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        /*
+            Compares entity tags, ignoring whether either is weak.
+        */
+        bool etags_match(std::string_view a, std::string_view b) {
+            auto strip = [](std::string_view tag) { return tag.substr(0, 2) == "W/" ? tag.substr(2) : tag; };
+            return strip(a) == strip(b);
+        }
+
+        std::chrono::seconds parse_seconds(std::string_view value) {
+            std::chrono::seconds result(0);
+            for (char c : value) {
+                if (c < '0' || c > '9') {
+                    return std::chrono::seconds(0);
+                }
+                result = result * 10 + std::chrono::seconds(c - '0');
+                if (result >= cache_control::max_delta_seconds) {
+                    return cache_control::max_delta_seconds;
+                }
+            }
+            return result;
+        }
+    }
+
+    std::chrono::seconds cache_entry::current_age(clock::time_point now) const {
+        auto resident_time = std::chrono::duration_cast<std::chrono::seconds>(now - response_time);
+        return corrected_initial_age + std::max(resident_time, std::chrono::seconds(0));
+    }
+
+    bool cache_entry::has_validators() const {
+        return res.has_header(header_id::etag) || res.has_header(header_id::last_modified);
+    }
+
+    lookup_result::lookup_result()
+        : status(lookup_status::bypass),
+        res(),
+        entry(),
+        request_time()
+    { }
+
+    response_cache::shard::shard()
+        : mutex(),
+        lru(),
+        entries(),
+        variants(),
+        sketch(4096),
+        size(0)
+    { }
+
+    response_cache::response_cache()
+        : shards(),
+        shard_capacity(0),
+        max_object_size(0),
+        hits(0),
+        misses(0),
+        revalidations(0),
+        validated(0),
+        stores(0),
+        rejected(0),
+        evictions(0),
+        invalidations(0),
+        bytes_served(0),
+        bytes_fetched(0),
+        entry_count(0),
+        total_size(0)
+    { }
+
+    void response_cache::init() {
+        const program::options &options = program::options::instance();
+        shard_capacity = options.cache_size / shard_count;
+        // A single response may never take more than half of its shard
+        max_object_size = std::min(options.cache_max_object_size, shard_capacity / 2);
+
+        // The disk tier loads its index now, rather than on the first request that misses in memory
+        disk_cache::instance();
+    }
+
+    std::string response_cache::make_primary_key(const request &req) {
+        // HEAD requests are answered from stored GET responses, so the method is not part of the key
+        const url &target = req.get_target();
+        std::string key = target.scheme.empty() ? "http" : util::string::lowercase(target.scheme);
+        key += "://";
+        key += util::string::lowercase(target.netloc.host);
+        key += ':';
+        key += std::to_string(req.get_host_port());
+        key += target.path.empty() ? "/" : target.path;
+        key += target.search;
+        return key;
+    }
+
+    std::uint64_t response_cache::hash_key(const std::string &key) {
+        return static_cast<std::uint64_t>(std::hash<std::string>()(key));
+    }
+
+    std::string response_cache::make_variant_key(const std::string &primary_key, const std::vector<std::string> &vary, const request &req) {
+        std::string key = primary_key;
+        for (const auto &name : vary) {
+            key += '\n';
+            key += name;
+            key += ':';
+            bool first = true;
+            for (const auto &value : req.get_all_of_header(name)) {
+                if (!first) {
+                    key += ',';
+                }
+                key += util::string::trim(value);
+                first = false;
+            }
+        }
+        return key;
+    }
+
+    response_cache::shard &response_cache::shard_for(std::uint64_t hash) {
+        // std::hash may only be 32 bits wide, so both halves are folded in
+        return shards[(hash ^ (hash >> 32)) % shard_count];
+    }
+
+    response_cache::entry_ptr response_cache::find(const std::string &primary_key, std::uint64_t hash, const request &req) {
+        {
+            shard &s = shard_for(hash);
+            std::lock_guard<std::mutex> lock(s.mutex);
+            s.sketch.record(hash);
+
+            if (auto variants = s.variants.find(primary_key); variants != s.variants.end()) {
+                if (auto it = s.entries.find(make_variant_key(primary_key, variants->second.vary, req)); it != s.entries.end()) {
+                    s.lru.splice(s.lru.begin(), s.lru, it->second);
+                    return *it->second;
+                }
+            }
+        }
+
+        disk_cache &disk = disk_cache::instance();
+        auto vary = disk.variant_names(primary_key);
+        if (!vary.has_value()) {
+            return nullptr;
+        }
+        std::shared_ptr<cache_entry> entry = disk.find(make_variant_key(primary_key, vary.value(), req), max_object_size);
+        if (!entry) {
+            return nullptr;
+        }
+        entry->hash = hash;
+        // Its body was read into memory, so it competes for a place there like a new response
+        if (!entry->body) {
+            insert(entry);
+        }
+        return entry;
+    }
+
+    std::shared_ptr<cache_entry> response_cache::make_entry(const request &req, const response &res, cache_entry::clock::time_point request_time, std::uint64_t body_length) const {
+        if (req.get_method() != method::GET || req.has_header(header_id::range)) {
+            return nullptr;
+        }
+
+        status code = res.get_status();
+        bool heuristic = is_heuristically_cacheable(code);
+        if (!heuristic && code != status::found && code != status::temporary_redirect) {
+            return nullptr;
+        }
+
+        cache_control request_directives = cache_control::parse(req);
+        cache_control directives = cache_control::parse(res);
+        if (request_directives.no_store || directives.no_store || directives.is_private) {
+            return nullptr;
+        }
+        // Responses to authorized requests are only shared when the server says so
+        if (req.has_header(header_id::authorization) && !directives.is_public && !directives.must_revalidate && !directives.s_maxage.has_value()) {
+            return nullptr;
+        }
+        // Cookies set for one client are never given to another
+        if (res.has_header(header_id::set_cookie) || res.header_has_token("Vary", "*")) {
+            return nullptr;
+        }
+        auto now = cache_entry::clock::now();
+        auto date = cache_entry::clock::time_point(now);
+        if (auto value = res.get_optional_header("Date"); value.has_value()) {
+            date = parse_http_date(value.value()).value_or(now);
+        }
+
+        std::chrono::seconds lifetime(0);
+        bool explicit_lifetime = true;
+        if (directives.s_maxage.has_value()) {
+            lifetime = directives.s_maxage.value();
+        }
+        else if (directives.max_age.has_value()) {
+            lifetime = directives.max_age.value();
+        }
+        else if (auto value = res.get_optional_header("Expires"); value.has_value()) {
+            // An invalid date means the response has already expired
+            if (auto expires = parse_http_date(value.value()); expires.has_value()) {
+                lifetime = std::max(std::chrono::duration_cast<std::chrono::seconds>(expires.value() - date), std::chrono::seconds(0));
+            }
+        }
+        else {
+            explicit_lifetime = false;
+            // A tenth of the time since the resource last changed, as RFC 9111 suggests
+            if (auto value = res.get_optional_header("Last-Modified"); value.has_value() && heuristic) {
+                if (auto last_modified = parse_http_date(value.value()); last_modified.has_value() && last_modified.value() < date) {
+                    lifetime = std::min(std::chrono::duration_cast<std::chrono::seconds>(date - last_modified.value()) / 10, max_heuristic_lifetime);
+                }
+            }
+        }
+        if (!explicit_lifetime && !heuristic && !directives.is_public) {
+            return nullptr;
+        }
+
+        auto entry = std::make_shared<cache_entry>();
+        entry->res = res;
+        remove_hop_by_hop_headers(entry->res);
+        entry->res.remove_header("Age");
+        if (code == status::no_content) {
+            entry->res.remove_header("Content-Length");
+        }
+        else {
+            entry->res.set_header_to_value("Content-Length", std::to_string(body_length));
+        }
+
+        // Nothing could ever be served without a validator to check it with
+        if (lifetime.count() == 0 && !entry->has_validators()) {
+            return nullptr;
+        }
+
+        for (const auto &value : res.get_all_of_header("Vary")) {
+            for (const auto &name : util::string::split_trim(value, ',')) {
+                entry->vary.push_back(util::string::lowercase(name));
+            }
+        }
+        std::sort(entry->vary.begin(), entry->vary.end());
+        entry->vary.erase(std::unique(entry->vary.begin(), entry->vary.end()), entry->vary.end());
+
+        entry->primary_key = make_primary_key(req);
+        entry->key = make_variant_key(entry->primary_key, entry->vary, req);
+        entry->hash = hash_key(entry->primary_key);
+
+        // The age calculation from RFC 9111, section 4.2.3
+        auto apparent_age = std::max(std::chrono::duration_cast<std::chrono::seconds>(now - date), std::chrono::seconds(0));
+        auto response_delay = std::chrono::duration_cast<std::chrono::seconds>(now - request_time);
+        auto age_value = parse_seconds(res.get_optional_header("Age").value_or("0"));
+        entry->corrected_initial_age = std::max(apparent_age, age_value + response_delay);
+        entry->response_time = now;
+        entry->freshness_lifetime = lifetime;
+        entry->must_revalidate = directives.must_revalidate || directives.proxy_revalidate || directives.s_maxage.has_value();
+        entry->no_cache = directives.no_cache;
+
+        // Headers are counted roughly, along with the bookkeeping for the entry
+        std::size_t header_size = 0;
+        for (const auto &field : entry->res.all_headers()) {
+            header_size += field.name.length() + field.value.length() + 4;
+        }
+        entry->size = static_cast<std::size_t>(body_length) + header_size + entry->key.length() * 3 + entry->primary_key.length() + 256;
+        return entry;
+    }
+
+    void response_cache::store(const entry_ptr &entry) {
+        if (!entry->body && entry->res.content_length() <= max_object_size) {
+            insert(entry);
+        }
+        else {
+            disk_cache::instance().store(entry);
+        }
+    }
+
+    void response_cache::insert(const entry_ptr &entry) {
+        // Entries leaving memory are written to disk once the shard is unlocked
+        std::vector<entry_ptr> demoted;
+        {
+            shard &s = shard_for(entry->hash);
+            std::lock_guard<std::mutex> lock(s.mutex);
+
+            bool admitted = true;
+            auto existing = s.entries.find(entry->key);
+            if (existing != s.entries.end()) {
+                erase(s, existing->second);
+            }
+            // TinyLFU admission: the new response must be more popular than everything it pushes out
+            else if (s.size + entry->size > shard_capacity) {
+                std::uint8_t frequency = s.sketch.estimate(entry->hash);
+                std::size_t freed = 0;
+                std::size_t needed = s.size + entry->size - shard_capacity;
+                for (auto it = s.lru.rbegin(); it != s.lru.rend() && freed < needed; ++it) {
+                    if (s.sketch.estimate((*it)->hash) >= frequency) {
+                        admitted = false;
+                        break;
+                    }
+                    freed += (*it)->size;
+                }
+            }
+
+            if (!admitted) {
+                ++rejected;
+                demoted.push_back(entry);
+            }
+            else {
+                while (!s.lru.empty() && s.size + entry->size > shard_capacity) {
+                    demoted.push_back(s.lru.back());
+                    erase(s, std::prev(s.lru.end()));
+                    ++evictions;
+                }
+
+                // Variants selected by different headers can no longer be told apart
+                variant_set &variants = s.variants[entry->primary_key];
+                if (variants.vary != entry->vary) {
+                    for (const auto &key : std::vector<std::string>(variants.keys)) {
+                        if (auto it = s.entries.find(key); it != s.entries.end()) {
+                            erase(s, it->second);
+                        }
+                    }
+                    variant_set &replaced = s.variants[entry->primary_key];
+                    replaced.vary = entry->vary;
+                    replaced.keys.clear();
+                }
+                s.variants[entry->primary_key].keys.push_back(entry->key);
+
+                s.lru.push_front(entry);
+                s.entries[entry->key] = s.lru.begin();
+                s.size += entry->size;
+                total_size += entry->size;
+                ++entry_count;
+                ++stores;
+            }
+        }
+
+        for (const auto &demoted_entry : demoted) {
+            disk_cache::instance().store(demoted_entry);
+        }
+    }
+
+    void response_cache::invalidate(const std::string &primary_key) {
+        disk_cache::instance().invalidate(primary_key);
+
+        shard &s = shard_for(hash_key(primary_key));
+        std::lock_guard<std::mutex> lock(s.mutex);
+
+        auto variants = s.variants.find(primary_key);
+        if (variants == s.variants.end()) {
+            return;
+        }
+        for (const auto &key : std::vector<std::string>(variants->second.keys)) {
+            if (auto it = s.entries.find(key); it != s.entries.end()) {
+                erase(s, it->second);
+                ++invalidations;
+            }
+        }
+    }
+
+    void response_cache::erase(shard &s, lru_list::iterator it) {
+        entry_ptr entry = *it;
+        if (auto variants = s.variants.find(entry->primary_key); variants != s.variants.end()) {
+            auto &keys = variants->second.keys;
+            keys.erase(std::remove(keys.begin(), keys.end(), entry->key), keys.end());
+            if (keys.empty()) {
+                s.variants.erase(variants);
+            }
+        }
+        s.entries.erase(entry->key);
+        s.lru.erase(it);
+        s.size -= entry->size;
+        total_size -= entry->size;
+        --entry_count;
+    }
+
+    response response_cache::make_response(const cache_entry &entry, const request &req, cache_entry::clock::time_point now, bool answer_conditionals) {
+        response res = entry.res;
+        res.set_header_to_value("Age", std::to_string(entry.current_age(now).count()));
+
+        bool not_modified = false;
+        if (answer_conditionals) {
+            auto etag = entry.res.get_optional_header("ETag");
+            if (req.has_header(header_id::if_none_match)) {
+                for (const auto &value : req.get_all_of_header("If-None-Match")) {
+                    for (const auto &tag : util::string::split_trim(value, ',')) {
+                        not_modified = not_modified || tag == "*" || (etag.has_value() && etags_match(tag, etag.value()));
+                    }
+                }
+            }
+            else if (auto since = req.get_optional_header("If-Modified-Since"); since.has_value()) {
+                auto last_modified = entry.res.get_optional_header("Last-Modified");
+                auto since_date = parse_http_date(since.value());
+                auto last_modified_date = last_modified.has_value() ? parse_http_date(last_modified.value()) : std::nullopt;
+                not_modified = since_date.has_value() && last_modified_date.has_value() && last_modified_date.value() <= since_date.value();
+            }
+        }
+
+        // Content-Length still describes the stored body, which is allowed for both
+        if (not_modified) {
+            res.set_status(status::not_modified);
+            res.set_body("");
+        }
+        else if (req.get_method() == method::HEAD) {
+            res.set_body("");
+        }
+        return res;
+    }
+
+    lookup_result response_cache::lookup(request &req) {
+        lookup_result result;
+        result.request_time = cache_entry::clock::now();
+
+        method verb = req.get_method();
+        if (verb != method::GET && verb != method::HEAD) {
+            // Invalidated before the response arrives, which at worst costs a miss if the request fails
+            if (verb != method::OPTIONS && verb != method::TRACE) {
+                invalidate(make_primary_key(req));
+            }
+            return result;
+        }
+        if (req.has_header(header_id::range) || req.has_header(header_id::upgrade)) {
+            return result;
+        }
+
+        cache_control directives = cache_control::parse(req);
+        std::string primary_key = make_primary_key(req);
+        entry_ptr entry = find(primary_key, hash_key(primary_key), req);
+        if (!entry) {
+            ++misses;
+            result.status = directives.only_if_cached ? lookup_status::unavailable : lookup_status::miss;
+            return result;
+        }
+
+        auto age = entry->current_age(result.request_time);
+        auto remaining = entry->freshness_lifetime - age;
+        bool usable = !entry->no_cache && !directives.no_cache;
+        if (usable && remaining.count() <= 0) {
+            // Stale responses are only served to clients that explicitly accept them
+            usable = !entry->must_revalidate && directives.max_stale.has_value() && -remaining <= directives.max_stale.value();
+        }
+        // Ages are only counted in whole seconds, so max-age=0 could otherwise be met by a response that is not new
+        if (usable && directives.max_age.has_value() && (age > directives.max_age.value() || directives.max_age.value().count() == 0)) {
+            usable = false;
+        }
+        if (usable && directives.min_fresh.has_value() && remaining < directives.min_fresh.value()) {
+            usable = false;
+        }
+
+        if (usable) {
+            ++hits;
+            result.status = lookup_status::hit;
+            result.res = make_response(*entry, req, result.request_time, true);
+            // Neither a 304 response nor a response to HEAD has a body to read from disk
+            if (entry->body && verb == method::GET && result.res.get_status() == entry->res.get_status()) {
+                result.body = entry->body;
+            }
+            bytes_served += result.body ? static_cast<std::size_t>(result.body->length) : result.res.content_length();
+            return result;
+        }
+
+        if (directives.only_if_cached) {
+            ++misses;
+            result.status = lookup_status::unavailable;
+            return result;
+        }
+
+        // A response to the client's own conditions could not be told apart from a response to the cache's
+        bool client_conditional = std::any_of(conditional_headers.begin(), conditional_headers.end(),
+            [&req](std::string_view name) { return req.has_header(name); });
+        if (verb == method::HEAD || client_conditional || !entry->has_validators()) {
+            ++misses;
+            result.status = lookup_status::miss;
+            return result;
+        }
+
+        if (auto etag = entry->res.get_optional_header("ETag"); etag.has_value()) {
+            req.set_header_to_value("If-None-Match", etag.value());
+        }
+        if (auto last_modified = entry->res.get_optional_header("Last-Modified"); last_modified.has_value()) {
+            req.set_header_to_value("If-Modified-Since", last_modified.value());
+        }
+        ++revalidations;
+        result.status = lookup_status::revalidate;
+        result.entry = entry;
+        return result;
+    }
+
+    void response_cache::complete(const request &req, response &res, lookup_result &result) {
+        if (result.status != lookup_status::miss && result.status != lookup_status::revalidate) {
+            return;
+        }
+        lookup_status status = result.status;
+        result.status = lookup_status::bypass;
+
+        if (status == lookup_status::revalidate && res.get_status() == status::not_modified) {
+            ++validated;
+
+            // Header fields from the 304 response replace the stored ones, as RFC 9111 section 4.3.4 describes
+            response merged = result.entry->res;
+            for (const auto &field : res.all_headers()) {
+                if (!is_hop_by_hop(field.name) && !util::string::iequals_fn(field.name, "Content-Length")) {
+                    merged.remove_header(field.name);
+                }
+            }
+            for (const auto &field : res.all_headers()) {
+                if (!is_hop_by_hop(field.name) && !util::string::iequals_fn(field.name, "Content-Length")) {
+                    merged.add_header(field.name, field.value);
+                }
+            }
+
+            bool close = res.should_close_connection();
+            const auto &body = result.entry->body;
+            std::uint64_t body_length = body ? body->length : merged.content_length();
+            if (auto entry = make_entry(req, merged, result.request_time, body_length)) {
+                // Only the new head is written when the body is on disk
+                entry->body = body;
+                store(entry);
+                res = make_response(*entry, req, cache_entry::clock::now(), false);
+            }
+            else {
+                invalidate(result.entry->primary_key);
+                res = std::move(merged);
+            }
+            if (close) {
+                res.set_header_to_value("Connection", "close");
+            }
+            bytes_served += static_cast<std::size_t>(body_length);
+            result.body = body;
+            result.entry.reset();
+            return;
+        }
+
+        result.entry.reset();
+        bytes_fetched += res.content_length();
+        if (auto entry = make_entry(req, res, result.request_time, res.content_length())) {
+            store(entry);
+        }
+    }
+
+    std::unique_ptr<disk_writer> response_cache::begin_fill(const request &req, const response &res, lookup_result &result) {
+        if (result.status != lookup_status::miss && result.status != lookup_status::revalidate) {
+            return nullptr;
+        }
+        result.status = lookup_status::bypass;
+        result.entry.reset();
+
+        // Only a body of a known length can be given its place in a segment before it arrives
+        disk_cache &disk = disk_cache::instance();
+        auto length = res.get_optional_header("Content-Length");
+        if (!disk.is_enabled() || !length.has_value() || res.has_header(header_id::transfer_encoding)) {
+            return nullptr;
+        }
+        std::uint64_t body_length;
+        try {
+            body_length = boost::lexical_cast<std::uint64_t>(length.value());
+        }
+        catch (const boost::bad_lexical_cast &) {
+            return nullptr;
+        }
+
+        bytes_fetched += static_cast<std::size_t>(body_length);
+        auto entry = make_entry(req, res, result.request_time, body_length);
+        return entry ? disk.open_writer(entry, body_length) : nullptr;
+    }
+
+    response_cache::statistics response_cache::get_statistics() {
+        return {
+            hits.load(),
+            misses.load(),
+            revalidations.load(),
+            validated.load(),
+            stores.load(),
+            rejected.load(),
+            evictions.load(),
+            invalidations.load(),
+            bytes_served.load(),
+            bytes_fetched.load(),
+            entry_count.load(),
+            total_size.load()
+        };
+    }
+}
\ No newline at end of file
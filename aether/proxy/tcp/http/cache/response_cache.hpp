@@ -0,0 +1,256 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <aether/proxy/tcp/http/cache/disk_cache.hpp>
+#include <aether/proxy/tcp/http/cache/frequency_sketch.hpp>
+#include <aether/proxy/tcp/http/message/request.hpp>
+#include <aether/proxy/tcp/http/message/response.hpp>
+#include <aether/util/singleton.hpp>
+
+namespace proxy::tcp::http::cache {
+    /*
+        A response stored in the cache, with what is needed to work out its age.
+        Never changed once stored, so readers share it without holding a lock.
+    */
+    struct cache_entry {
+        using clock = std::chrono::system_clock;
+
+        // Primary key followed by the request values named by the response's Vary header
+        std::string key;
+        std::string primary_key;
+        std::uint64_t hash;
+        // Lowercase names of the request headers the response varies by, sorted
+        std::vector<std::string> vary;
+
+        // Stored without hop-by-hop headers, with its body and a Content-Length
+        response res;
+        // Set when the body stays on disk, in which case res only has the head
+        std::shared_ptr<const disk_body> body;
+
+        clock::time_point response_time;
+        std::chrono::seconds corrected_initial_age;
+        std::chrono::seconds freshness_lifetime;
+
+        // Never served stale, even to clients that would accept it
+        bool must_revalidate;
+        // Revalidated with the server before every use
+        bool no_cache;
+
+        // Approximate memory taken by the entry
+        std::size_t size;
+
+        std::chrono::seconds current_age(clock::time_point now) const;
+        bool has_validators() const;
+    };
+
+    /*
+        What happened when a request was looked up in the cache.
+    */
+    enum class lookup_status {
+        // The request cannot be answered from the cache, and its response is not stored
+        bypass,
+        // Nothing usable is stored, the response from the server may be stored
+        miss,
+        // The response was answered from the cache
+        hit,
+        // A stored response must be validated by the server, conditional headers were added to the request
+        revalidate,
+        // The client only accepts a stored response, and there is none it can use
+        unavailable
+    };
+
+    /*
+        Cache state of a single exchange, kept from the lookup until the server's response is complete.
+    */
+    struct lookup_result {
+        lookup_status status;
+        // Response to send when the status is hit
+        response res;
+        // Body to send after the head of res when it is read from disk
+        std::shared_ptr<const disk_body> body;
+        // Entry being revalidated
+        std::shared_ptr<const cache_entry> entry;
+        cache_entry::clock::time_point request_time;
+
+        lookup_result();
+    };
+
+    /*
+        Shared cache of HTTP responses, following the rules RFC 9111 sets for shared caches.
+        One cache serves every thread, split into shards that each have their own lock.
+        Each shard evicts its least recently used entries, but only admits a new response over them
+            if it is requested more often than they are, as estimated by a TinyLFU frequency sketch.
+        Only complete responses to GET requests, small enough to be buffered, are stored.
+    */
+    class response_cache
+        : public util::singleton<response_cache> {
+    public:
+        static constexpr std::size_t shard_count = 16;
+
+        // Heuristic freshness is never longer than this, whatever the Last-Modified date says
+        static constexpr std::chrono::seconds max_heuristic_lifetime { 24 * 60 * 60 };
+
+        /*
+            Counters for the response cache.
+        */
+        struct statistics {
+            // Requests answered from the cache without contacting the server
+            std::size_t hits;
+            // Requests sent to the server because nothing usable was stored
+            std::size_t misses;
+            // Requests sent to the server to validate a stored response
+            std::size_t revalidations;
+            // Revalidations answered with 304, so the stored body was sent instead
+            std::size_t validated;
+            std::size_t stores;
+            // Responses kept out because the entries they would replace are used more often
+            std::size_t rejected;
+            std::size_t evictions;
+            // Entries removed because an unsafe request changed the resource
+            std::size_t invalidations;
+            // Body bytes sent to clients from the cache instead of fetched from servers
+            std::size_t bytes_served;
+            // Body bytes of cacheable responses fetched from servers
+            std::size_t bytes_fetched;
+            std::size_t entries;
+            std::size_t size;
+        };
+
+    private:
+        using entry_ptr = std::shared_ptr<const cache_entry>;
+        using lru_list = std::list<entry_ptr>;
+
+        /*
+            Vary header names of the responses stored under one primary key, and the keys they were stored with.
+        */
+        struct variant_set {
+            std::vector<std::string> vary;
+            std::vector<std::string> keys;
+        };
+
+        struct shard {
+            std::mutex mutex;
+            // Most recently used first
+            lru_list lru;
+            std::unordered_map<std::string, lru_list::iterator> entries;
+            std::unordered_map<std::string, variant_set> variants;
+            frequency_sketch sketch;
+            std::size_t size;
+
+            shard();
+        };
+
+        std::array<shard, shard_count> shards;
+        std::size_t shard_capacity;
+        std::size_t max_object_size;
+
+        std::atomic<std::size_t> hits;
+        std::atomic<std::size_t> misses;
+        std::atomic<std::size_t> revalidations;
+        std::atomic<std::size_t> validated;
+        std::atomic<std::size_t> stores;
+        std::atomic<std::size_t> rejected;
+        std::atomic<std::size_t> evictions;
+        std::atomic<std::size_t> invalidations;
+        std::atomic<std::size_t> bytes_served;
+        std::atomic<std::size_t> bytes_fetched;
+        std::atomic<std::size_t> entry_count;
+        std::atomic<std::size_t> total_size;
+
+        static std::string make_primary_key(const request &req);
+        static std::uint64_t hash_key(const std::string &key);
+
+        /*
+            Adds the request's values for each header named by Vary to the primary key.
+        */
+        static std::string make_variant_key(const std::string &primary_key, const std::vector<std::string> &vary, const request &req);
+
+        shard &shard_for(std::uint64_t hash);
+
+        /*
+            Finds the entry the request selects, marking it as recently used.
+            Entries only found on disk are brought back into memory if they are small enough.
+        */
+        entry_ptr find(const std::string &primary_key, std::uint64_t hash, const request &req);
+
+        /*
+            Builds an entry for the response if RFC 9111 allows a shared cache to store it.
+            The body may not be in the response, so its length is given separately.
+        */
+        std::shared_ptr<cache_entry> make_entry(const request &req, const response &res, cache_entry::clock::time_point request_time, std::uint64_t body_length) const;
+
+        /*
+            Keeps an entry in memory if it is small enough, and otherwise on disk.
+        */
+        void store(const entry_ptr &entry);
+
+        /*
+            Stores an entry, replacing any entry with the same key.
+            A new key is only admitted if it is used more often than every entry it would evict.
+            Entries that are evicted or not admitted go to the disk tier instead.
+        */
+        void insert(const entry_ptr &entry);
+
+        /*
+            Removes every variant stored under the primary key.
+        */
+        void invalidate(const std::string &primary_key);
+
+        /*
+            Unlinks an entry. The shard's lock must be held.
+        */
+        void erase(shard &s, lru_list::iterator it);
+
+        /*
+            Copies a stored response to send to the client.
+            The client's own conditional headers may be answered with a 304 response.
+        */
+        response make_response(const cache_entry &entry, const request &req, cache_entry::clock::time_point now, bool answer_conditionals);
+
+    public:
+        response_cache();
+
+        /*
+            Reads the cache size from the program options.
+        */
+        void init();
+
+        /*
+            Looks up the response to a request that is about to be sent to its server.
+            Unsafe requests remove what is stored for their target, since they may change it.
+        */
+        lookup_result lookup(request &req);
+
+        /*
+            Handles the complete response from the server to a request that was looked up.
+            A 304 response to a revalidation is replaced by the stored response it refers to.
+            Otherwise, the response is stored if allowed.
+        */
+        void complete(const request &req, response &res, lookup_result &result);
+
+        /*
+            Starts copying a response to the disk tier while its body is relayed to the client.
+            Returns nothing if the response cannot be stored, in which case it is only relayed.
+        */
+        std::unique_ptr<disk_writer> begin_fill(const request &req, const response &res, lookup_result &result);
+
+        statistics get_statistics();
+    };
+}
\ No newline at end of file
@@ -49,4 +49,12 @@ namespace proxy::tcp::http {
     bool exchange::mask_connect() const {
         return mask_connect_flag;
     }
+
+    void exchange::set_buffer_response(bool val) {
+        buffer_response_flag = val;
+    }
+
+    bool exchange::buffer_response() const {
+        return buffer_response_flag;
+    }
 }
\ No newline at end of file
@@ -24,6 +24,7 @@ namespace proxy::tcp::http {
         std::optional<http::response> res;
 
         bool mask_connect_flag = false;
+        bool buffer_response_flag = false;
 
     public:
         http::request &request();
@@ -60,5 +61,18 @@ namespace proxy::tcp::http {
                 like a normal HTTP request.
         */
         bool mask_connect() const;
+
+        /*
+            Sets if the response body must be read in full before the response is forwarded.
+            Large and unbounded response bodies are otherwise streamed to the client, in which
+                case response interceptors only see the response head.
+            Only has an effect if set before the response body is read.
+        */
+        void set_buffer_response(bool val);
+
+        /*
+            Returns if the response body must be read in full before the response is forwarded.
+        */
+        bool buffer_response() const;
     };
 }
\ No newline at end of file
@@ -0,0 +1,88 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "head_parser.hpp"
+
+#include <aether/util/byte_search.hpp>
+
+namespace proxy::tcp::http::http1 {
+    head_parser::head_parser()
+        : start(0),
+        scanned(0),
+        line_ends(),
+        head_length(0)
+    {
+        // Enough for most heads without reallocating
+        line_ends.reserve(32);
+    }
+
+    bool head_parser::scan(std::string_view buffer) {
+        if (complete()) {
+            return true;
+        }
+
+        const char *begin = buffer.data();
+        const char *end = begin + buffer.size();
+        const char *next = begin + scanned;
+        while (next != end) {
+            const char *lf = util::bytes::find(next, end, '\n');
+            if (lf == end) {
+                break;
+            }
+
+            std::size_t line_start = line_ends.empty() ? start : line_ends.back();
+            std::size_t line_end = static_cast<std::size_t>(lf - begin) + 1;
+            std::size_t content_length = line_end - 1 - line_start;
+            next = lf + 1;
+
+            // Line endings may be CRLF or a bare LF
+            bool empty_line = content_length == 0 || (content_length == 1 && begin[line_start] == '\r');
+            if (empty_line) {
+                // Clients may send extra line breaks after a body, which come before the next message
+                if (line_ends.empty()) {
+                    start = line_end;
+                    continue;
+                }
+                scanned = line_end;
+                head_length = line_end;
+                return true;
+            }
+            line_ends.push_back(line_end);
+        }
+
+        scanned = buffer.size();
+        return false;
+    }
+
+    bool head_parser::complete() const {
+        return head_length != 0;
+    }
+
+    std::size_t head_parser::length() const {
+        return head_length;
+    }
+
+    std::size_t head_parser::line_count() const {
+        return line_ends.size();
+    }
+
+    std::string_view head_parser::line(std::string_view buffer, std::size_t index) const {
+        std::size_t line_start = index == 0 ? start : line_ends[index - 1];
+        std::size_t line_end = line_ends[index] - 1;
+        if (line_end > line_start && buffer[line_end - 1] == '\r') {
+            --line_end;
+        }
+        return buffer.substr(line_start, line_end - line_start);
+    }
+
+    void head_parser::reset() {
+        start = 0;
+        scanned = 0;
+        line_ends.clear();
+        head_length = 0;
+    }
+}
\ No newline at end of file
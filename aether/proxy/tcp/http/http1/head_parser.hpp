@@ -0,0 +1,63 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+namespace proxy::tcp::http::http1 {
+    /*
+        Finds the lines of an HTTP/1.x message head directly in the bytes of an input buffer.
+        Remembers where the last scan stopped, so a head that arrives over several reads
+            is only scanned once.
+        Lines are views into the buffer, so they are only valid until the head is consumed from it.
+    */
+    class head_parser {
+    private:
+        // Offset of the first line, after any empty lines that came before the message
+        std::size_t start;
+
+        // Offset of the first byte that has not been scanned yet
+        std::size_t scanned;
+
+        // Offset one past the line feed of every line found so far
+        std::vector<std::size_t> line_ends;
+
+        // Length of the whole head, including the empty line that ends it, once it is found
+        std::size_t head_length;
+
+    public:
+        head_parser();
+
+        /*
+            Scans the bytes added to the buffer since the last call for the empty line that ends the head.
+            The buffer must start at the same byte on every call until the parser is reset.
+            Returns true once the whole head is in the buffer.
+        */
+        bool scan(std::string_view buffer);
+
+        bool complete() const;
+
+        /*
+            Number of bytes from the start of the buffer to the end of the head.
+        */
+        std::size_t length() const;
+
+        /*
+            Number of lines in the head, not counting the empty line that ends it.
+        */
+        std::size_t line_count() const;
+
+        /*
+            Returns the line at the given index, without its line ending.
+        */
+        std::string_view line(std::string_view buffer, std::size_t index) const;
+
+        void reset();
+    };
+}
\ No newline at end of file
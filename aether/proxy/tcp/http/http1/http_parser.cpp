@@ -7,7 +7,21 @@
 
 #include "http_parser.hpp"
 
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <limits>
+
+#include <aether/util/byte_search.hpp>
+
 namespace proxy::tcp::http::http1 {
+    namespace {
+        std::string_view buffer_view(const streambuf &in) {
+            auto data = in.data();
+            return { static_cast<const char *>(data.data()), data.size() };
+        }
+    }
+
     http_parser::http_parser(exchange &exch) 
         : exch(exch)
     { }
@@ -23,67 +37,83 @@ namespace proxy::tcp::http::http1 {
         return mode == message_mode::request ? static_cast<message &>(exch.request()) : static_cast<message &>(exch.response());
     }
 
-    void http_parser::read_request_line(std::istream &in) {
-        if (!request_method_buf.read_until(in, message::SP)
-            || !request_target_buf.read_until(in, message::SP)
-            || !request_version_buf.read_until(in, message::CRLF)) {
+    bool http_parser::scan_head(const streambuf &in) {
+        return head.scan(buffer_view(in));
+    }
+
+    void http_parser::read_request_head(streambuf &in) {
+        peek_request_head(in);
+        consume_head(in);
+    }
+
+    void http_parser::peek_request_head(const streambuf &in) {
+        std::string_view buffer = buffer_view(in);
+        if (!head.complete()) {
+            throw error::http::invalid_request_line_exception { "Could not read request line" };
+        }
+
+        std::string_view line = head.line(buffer, 0);
+        std::size_t method_end = line.find(message::SP);
+        std::size_t target_end = method_end == std::string_view::npos ? method_end : line.find(message::SP, method_end + 1);
+        if (target_end == std::string_view::npos) {
             throw error::http::invalid_request_line_exception { "Could not read request line" };
         }
 
         // Exceptions will propogate
         request &req = exch.request();
-        method verb = convert::to_method(request_method_buf.export_data());
+        method verb = convert::to_method(line.substr(0, method_end));
         req.set_method(verb);
-        req.set_version(convert::to_version(request_version_buf.export_data()));
-        url target = url::parse_target(request_target_buf.export_data(), verb);
-        req.set_target(target);
+        req.set_version(convert::to_version(line.substr(target_end + 1)));
+        req.set_target(url::parse_target(line.substr(method_end + 1, target_end - method_end - 1), verb));
+
+        read_headers(buffer, message_mode::request);
+    }
 
-        request_method_buf.reset();
-        request_target_buf.reset();
-        request_version_buf.reset();
+    void http_parser::consume_head(streambuf &in) {
+        in.consume(head.length());
+        head.reset();
     }
 
-    void http_parser::read_response_line(std::istream &in) {
-        if (!response_version_buf.read_until(in, message::SP)
-            || !response_code_buf.read_until(in, message::SP)
-            || !response_msg_buf.read_until(in, message::CRLF)) {
+    void http_parser::read_response_head(streambuf &in) {
+        std::string_view buffer = buffer_view(in);
+        if (!head.complete()) {
+            throw error::http::invalid_response_line_exception { "Could not read response line" };
+        }
+
+        std::string_view line = head.line(buffer, 0);
+        std::size_t version_end = line.find(message::SP);
+        if (version_end == std::string_view::npos) {
             throw error::http::invalid_response_line_exception { "Could not read response line" };
         }
+        // Some servers leave out the reason phrase entirely
+        std::size_t code_end = line.find(message::SP, version_end + 1);
+        std::string_view code = code_end == std::string_view::npos
+            ? line.substr(version_end + 1)
+            : line.substr(version_end + 1, code_end - version_end - 1);
 
         // Exceptions will propogate
         response &res = exch.response();
-        res.set_version(convert::to_version(response_version_buf.export_data()));
-        res.set_status(convert::to_status_from_code(response_code_buf.export_data()));
+        res.set_version(convert::to_version(line.substr(0, version_end)));
+        res.set_status(convert::to_status_from_code(code));
         // Message is discarded, we generate it ourselves when we need it
 
-        response_version_buf.reset();
-        response_code_buf.reset();
-        response_msg_buf.reset();
+        read_headers(buffer, message_mode::response);
+        in.consume(head.length());
+        head.reset();
     }
-    
-    void http_parser::read_headers(std::istream &in, message_mode mode) {
-        message &msg = get_data_for_mode(mode);
-        while (true) {
-            if (!header_buf.read_until(in, message::CRLF)) {
-                throw error::http::invalid_header_exception { "Error when reading header" };
-            }
-
-            auto next_line = header_buf.export_data();
-            header_buf.reset();
 
-            if (next_line.empty()) {
-                break;
-            }
-            std::size_t delim = next_line.find(':');
-            if (delim == std::string::npos) {
-                throw error::http::invalid_header_exception { "No value set for header \"" + next_line + "\"" };
+    void http_parser::read_headers(std::string_view buffer, message_mode mode) {
+        message &msg = get_data_for_mode(mode);
+        std::size_t lines = head.line_count();
+        for (std::size_t i = 1; i < lines; ++i) {
+            std::string_view line = head.line(buffer, i);
+            const char *line_end = line.data() + line.size();
+            const char *colon = util::bytes::find(line.data(), line_end, ':');
+            if (colon == line_end) {
+                throw error::http::invalid_header_exception { "No value set for header \"" + std::string(line) + "\"" };
             }
-            std::string name = next_line.substr(0, delim);
-            std::string value = next_line.substr(delim + 1);
-            value = util::string::trim(value);
-            msg.add_header(name, value);
-
-            header_buf.reset();
+            std::size_t delim = static_cast<std::size_t>(colon - line.data());
+            msg.add_header(line.substr(0, delim), util::string::trim(line.substr(delim + 1)));
         }
     }
 
@@ -92,7 +122,7 @@ namespace proxy::tcp::http::http1 {
         bool for_request = mode == message_mode::request;
         request &req = exch.request();
         if (for_request) {
-            if (req.has_header("Expect") && req.get_header("Expect") == "100-continue") {
+            if (req.all_headers().find(header_id::expect) == "100-continue") {
                 return none;
             }
         }
@@ -116,26 +146,24 @@ namespace proxy::tcp::http::http1 {
         }
         message &msg = get_data_for_mode(mode);
 
-        if (msg.header_has_token("Transfer-Encoding", "chunked")) {
+        if (msg.header_has_token(header_id::transfer_encoding, "chunked")) {
             return { body_size_type::chunked, 0 };
         }
 
-        if (msg.has_header("Content-Length")) {
-            auto sizes = msg.get_all_of_header("Content-Length");
+        if (msg.has_header(header_id::content_length)) {
+            auto sizes = msg.all_headers().find_all("Content-Length");
             bool different_sizes = std::adjacent_find(sizes.begin(), sizes.end(), std::not_equal_to<>()) != sizes.end();
             if (different_sizes) {
                 throw error::http::invalid_body_size_exception { "Conflicting Content-Length headers" };
             }
-            try {
-                long long size = boost::lexical_cast<long long>(sizes[0]);
-                if (size < 0) {
-                    throw boost::bad_lexical_cast { };
-                }
-                return { body_size_type::given, static_cast<std::size_t>(size) };
-            }
-            catch (const boost::bad_lexical_cast &) {
+            std::string_view value = sizes[0];
+            const char *value_end = value.data() + value.size();
+            std::size_t size;
+            auto result = std::from_chars(value.data(), value_end, size);
+            if (result.ec != std::errc() || result.ptr != value_end) {
                 throw error::http::invalid_body_size_exception { "Invalid Content-Length value" };
             }
+            return { body_size_type::given, size };
         }
 
         // Default cases
@@ -276,4 +304,145 @@ namespace proxy::tcp::http::http1 {
 
         return false;
     }
+
+    std::pair<http_parser::body_size_type, std::size_t> http_parser::body_size(message_mode mode) {
+        return expected_body_size(mode);
+    }
+
+    std::size_t http_parser::frame_chunked_body(const char *data, std::size_t size, streambuf *decoded) {
+        std::size_t pos = 0;
+        while (pos < size && !bp_status.finished) {
+            switch (bp_status.position) {
+                case chunk_position::size_line: {
+                    char c = data[pos++];
+                    if (c == '\n') {
+                        if (bp_status.chunk_size_digits == 0) {
+                            throw error::http::invalid_chunked_body_exception { };
+                        }
+                        bp_status.chunk_size_digits = 0;
+                        bp_status.chunk_extension = false;
+                        bp_status.read = 0;
+                        bp_status.position = bp_status.expected_size == 0 ? chunk_position::trailer : chunk_position::data;
+                    }
+                    else if (c == '\r') {
+                        continue;
+                    }
+                    else if (!bp_status.chunk_extension && std::isxdigit(static_cast<unsigned char>(c))) {
+                        if (bp_status.expected_size > (std::numeric_limits<std::size_t>::max() >> 4)) {
+                            throw error::http::invalid_chunked_body_exception { };
+                        }
+                        int digit = std::isdigit(static_cast<unsigned char>(c)) ? c - '0' : std::tolower(static_cast<unsigned char>(c)) - 'a' + 10;
+                        bp_status.expected_size = (bp_status.expected_size << 4) | static_cast<std::size_t>(digit);
+                        ++bp_status.chunk_size_digits;
+                    }
+                    // Chunk extensions are passed along untouched
+                    else if (bp_status.chunk_size_digits != 0) {
+                        bp_status.chunk_extension = true;
+                    }
+                    else {
+                        throw error::http::invalid_chunked_body_exception { };
+                    }
+                    break;
+                }
+                case chunk_position::data: {
+                    std::size_t length = std::min(size - pos, bp_status.expected_size - bp_status.read);
+                    if (decoded) {
+                        decoded->commit(boost::asio::buffer_copy(decoded->prepare(length), boost::asio::buffer(data + pos, length)));
+                    }
+                    pos += length;
+                    bp_status.read += length;
+                    if (bp_status.read == bp_status.expected_size) {
+                        bp_status.position = chunk_position::data_end;
+                    }
+                    break;
+                }
+                case chunk_position::data_end: {
+                    char c = data[pos++];
+                    if (c == '\n') {
+                        bp_status.expected_size = 0;
+                        bp_status.position = chunk_position::size_line;
+                    }
+                    else if (c != '\r') {
+                        throw error::http::invalid_chunked_body_exception { };
+                    }
+                    break;
+                }
+                case chunk_position::trailer: {
+                    char c = data[pos++];
+                    if (c == '\n') {
+                        // An empty line ends the body
+                        if (bp_status.trailer_line_length == 0) {
+                            bp_status.finished = true;
+                        }
+                        bp_status.trailer_line_length = 0;
+                    }
+                    else if (c != '\r') {
+                        ++bp_status.trailer_line_length;
+                    }
+                    break;
+                }
+            }
+        }
+        return pos;
+    }
+
+    bool http_parser::relay_body(streambuf &in, streambuf &out, message_mode mode, bool eof) {
+        return move_body(in, out, mode, eof, true);
+    }
+
+    bool http_parser::decode_body(streambuf &in, streambuf &out, message_mode mode, bool eof) {
+        return move_body(in, out, mode, eof, false);
+    }
+
+    bool http_parser::move_body(streambuf &in, streambuf &out, message_mode mode, bool eof, bool keep_framing) {
+        // Initial call, set up state
+        if (bp_status.mode == message_mode::unknown) {
+            auto pair = expected_body_size(mode);
+            if (pair.first == body_size_type::none) {
+                return true;
+            }
+            bp_status = { mode, pair.first, pair.first == body_size_type::chunked ? 0 : pair.second, 0 };
+        }
+
+        auto input = in.data();
+        const char *data = static_cast<const char *>(input.data());
+        std::size_t available = input.size();
+        std::size_t length = 0;
+        bool copied = false;
+
+        switch (bp_status.type) {
+            case body_size_type::given:
+                length = std::min(available, bp_status.expected_size - bp_status.read);
+                bp_status.read += length;
+                bp_status.finished = bp_status.read == bp_status.expected_size;
+                break;
+            case body_size_type::chunked:
+                copied = !keep_framing;
+                length = frame_chunked_body(data, available, copied ? &out : nullptr);
+                break;
+            // The caller decides when the stream has ended
+            default:
+                length = available;
+                bp_status.read += length;
+                bp_status.finished = eof;
+                break;
+        }
+
+        if (length != 0) {
+            if (!copied) {
+                out.commit(boost::asio::buffer_copy(out.prepare(length), boost::asio::buffer(data, length)));
+            }
+            in.consume(length);
+        }
+
+        if (bp_status.finished) {
+            reset_body_parsing_status();
+            return true;
+        }
+        return false;
+    }
+
+    void http_parser::abort_relay() {
+        reset_body_parsing_status();
+    }
 }
\ No newline at end of file
@@ -13,6 +13,7 @@
 
 #include <aether/proxy/types.hpp>
 #include <aether/proxy/tcp/http/exchange.hpp>
+#include <aether/proxy/tcp/http/http1/head_parser.hpp>
 #include <aether/program/options.hpp>
 #include <aether/util/buffer_segment.hpp>
 #include <aether/util/console.hpp>
@@ -47,6 +48,20 @@ namespace proxy::tcp::http::http1 {
             all
         };
 
+        /*
+            Position in a chunked body that is being relayed rather than buffered.
+        */
+        enum class chunk_position {
+            // Chunk size and any extensions
+            size_line,
+            // Chunk data
+            data,
+            // CRLF after the chunk data
+            data_end,
+            // Trailer fields after the last chunk
+            trailer
+        };
+
         struct body_parsing_status {
             message_mode mode = message_mode::unknown;
             body_size_type type = body_size_type::none;
@@ -54,6 +69,10 @@ namespace proxy::tcp::http::http1 {
             std::size_t read = 0;
             bool finished = false;
             bool next_chunk_size_known = false;
+            chunk_position position = chunk_position::size_line;
+            std::size_t chunk_size_digits = 0;
+            bool chunk_extension = false;
+            std::size_t trailer_line_length = 0;
         };
 
     private:
@@ -63,15 +82,11 @@ namespace proxy::tcp::http::http1 {
         // Internal state for parsing a HTTP body, since it can span multiple calls
         body_parsing_status bp_status;
 
+        // Lines of the message head currently in the input buffer
+        head_parser head;
+
         // Buffer segments for managing compound reads
 
-        util::buffer::buffer_segment request_method_buf;
-        util::buffer::buffer_segment request_target_buf;
-        util::buffer::buffer_segment request_version_buf;
-        util::buffer::buffer_segment response_version_buf;
-        util::buffer::buffer_segment response_code_buf;
-        util::buffer::buffer_segment response_msg_buf;
-        util::buffer::buffer_segment header_buf;
         util::buffer::buffer_segment chunk_header_buf;
         util::buffer::buffer_segment chunk_suffix_buf;
         util::buffer::buffer_segment body_buf;
@@ -96,23 +111,52 @@ namespace proxy::tcp::http::http1 {
         */
         void reset_body_parsing_status();
 
+        /*
+            Advances through the framing of a chunked body.
+            Returns the number of bytes that belong to the body.
+            If given, the chunk data alone is also copied to the decoded buffer.
+        */
+        std::size_t frame_chunked_body(const char *data, std::size_t size, streambuf *decoded = nullptr);
+
+        /*
+            Shared implementation of relay_body and decode_body.
+        */
+        bool move_body(streambuf &in, streambuf &out, message_mode mode, bool eof, bool keep_framing);
+
+        /*
+            Parses the header lines found by the head parser into the message.
+        */
+        void read_headers(std::string_view buffer, message_mode mode);
+
     public:
         http_parser(exchange &exch);
 
         /*
-            Parses the request line from the stream.
+            Scans the input buffer for the end of a message head, starting where the last call stopped.
+            Returns true once the whole head is in the buffer.
+        */
+        bool scan_head(const streambuf &in);
+
+        /*
+            Parses the request line and headers found by scan_head, then consumes them from the buffer.
+        */
+        void read_request_head(streambuf &in);
+
+        /*
+            Parses the request line and headers found by scan_head, leaving them in the buffer.
+            Lets a request be looked at before deciding whether to take it out of the buffer.
         */
-        void read_request_line(std::istream &in);
+        void peek_request_head(const streambuf &in);
 
         /*
-            Parses the response line from the stream..
+            Consumes the head found by scan_head from the buffer.
         */
-        void read_response_line(std::istream &in);
+        void consume_head(streambuf &in);
 
         /*
-            Reads the headers from the stream.
+            Parses the response line and headers found by scan_head, then consumes them from the buffer.
         */
-        void read_headers(std::istream &in, message_mode mode);
+        void read_response_head(streambuf &in);
 
         /*
             Reads the message body from the stream.
@@ -121,5 +165,30 @@ namespace proxy::tcp::http::http1 {
             Do not switch message mode between reads.
         */
         bool read_body(std::istream &in, message_mode mode);
+
+        /*
+            Returns how the body of the message is delimited, and its size if it is given.
+        */
+        std::pair<body_size_type, std::size_t> body_size(message_mode mode);
+
+        /*
+            Moves the message body from one buffer to another without storing it in the message.
+            Chunked bodies are moved as they are, framing included.
+            Like read_body, this method is stateful and returns true once the whole body has been moved.
+            The body size limit does not apply, since only what is in the input buffer is held at once.
+            A body that is read until the end of the stream finishes once eof is given.
+        */
+        bool relay_body(streambuf &in, streambuf &out, message_mode mode, bool eof = false);
+
+        /*
+            Moves the message body from one buffer to another like relay_body, but strips any chunk framing.
+            Used when the body is carried to the other side in another protocol's frames.
+        */
+        bool decode_body(streambuf &in, streambuf &out, message_mode mode, bool eof = false);
+
+        /*
+            Abandons a body that is being relayed, so that another body can be parsed.
+        */
+        void abort_relay();
     };
 }
\ No newline at end of file
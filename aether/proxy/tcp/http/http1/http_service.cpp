@@ -7,6 +7,7 @@
 
 #include "http_service.hpp"
 #include <aether/proxy/connection_handler.hpp>
+#include <aether/proxy/tcp/http/http2/session_pool.hpp>
 
 namespace proxy::tcp::http::http1 {
     const response http_service::continue_response = { version::http1_1, status::continue_, { }, "" };
@@ -16,14 +17,87 @@ namespace proxy::tcp::http::http1 {
         tcp::intercept::interceptor_manager &interceptors)
         : base_service(flow, owner, interceptors),
         exch(),
-        parser(exch)
+        parser(exch),
+        retried(false),
+        streaming_request(false),
+        request_body_done(false),
+        streaming_response(false),
+        response_body_done(false),
+        held_response(),
+        from_pipeline(false),
+        request_forwarded(false),
+        pipeline(),
+        upstream_session(),
+        upstream_stream(),
+        upstream_error(),
+        reading_request_body(false),
+        writing_response(false),
+        upstream_response_started(false),
+        holding_upstream_response(false),
+        chunked_response(false),
+        cache_state(),
+        cached_body(),
+        cached_body_sent(0),
+        body_sender(),
+        cache_fill(),
+        http1_tls_args()
     { }
 
+    http_service::http_service(connection::connection_flow &flow, connection_handler &owner,
+        tcp::intercept::interceptor_manager &interceptors, request_pipeline &pipeline)
+        : base_service(flow, owner, interceptors),
+        exch(std::move(pipeline.front().exch)),
+        parser(exch),
+        retried(false),
+        streaming_request(false),
+        request_body_done(false),
+        streaming_response(false),
+        response_body_done(false),
+        held_response(),
+        from_pipeline(true),
+        request_forwarded(pipeline.front().forwarded),
+        pipeline(),
+        upstream_session(),
+        upstream_stream(),
+        upstream_error(),
+        reading_request_body(false),
+        writing_response(false),
+        upstream_response_started(false),
+        holding_upstream_response(false),
+        chunked_response(false),
+        cache_state(),
+        cached_body(),
+        cached_body_sent(0),
+        body_sender(),
+        cache_fill(),
+        http1_tls_args()
+    {
+        pipeline.pop_front();
+        this->pipeline = std::move(pipeline);
+    }
+
+    http_service::~http_service() {
+        // The stream's callbacks refer to this service
+        if (upstream_stream) {
+            upstream_session->cancel(upstream_stream);
+        }
+    }
+
     void http_service::start() {
         // Errors may be stored up to be sent over HTTP
         if (flow.error.has_proxy_error()) {
             send_error_response(status::bad_gateway, flow.error.get_message_or_proxy());
         }
+        else if (from_pipeline) {
+            // The server connection is only pooled after a response finishes cleanly
+            flow.server.set_keep_alive(false);
+            if (request_forwarded) {
+                read_response_head();
+            }
+            else {
+                route_request();
+            }
+        }
         else {
             // Client connection has the initial HTTP request
             // We read the request headers and then handle it accordingly
@@ -32,15 +106,25 @@ namespace proxy::tcp::http::http1 {
     }
 
     void http_service::read_request_head() {
-        // Read until the end of headers delimiter is found
-        flow.client.read_until_async(message::CRLF_CRLF, boost::bind(&http_service::on_read_request_head, this,
-            boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+        // Waiting for a new request is bounded by the idle timeout
+        flow.client.set_mode(connection::base_connection::io_mode::idle);
+
+        // Bytes left over from the previous request may already hold the next head
+        if (flow.client.input_buffer().size() != 0) {
+            on_read_request_head(boost::system::error_code(), 0);
+        }
+        else {
+            flow.client.read_async(boost::bind(&http_service::on_read_request_head, this,
+                boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+        }
     }
 
     void http_service::on_read_request_head(const boost::system::error_code &error, std::size_t bytes_transferred) {
+        flow.client.set_mode(connection::base_connection::io_mode::regular);
+
         if (error != boost::system::errc::success) {
             // No new request started
-            if (bytes_transferred == 0) {
+            if (flow.client.input_buffer().size() == 0) {
                 stop();
                 return;
             }
@@ -55,10 +139,21 @@ namespace proxy::tcp::http::http1 {
         }
         else {
             try {
-                std::istream input = flow.client.input_stream();
-                parser.read_request_line(input);
-                parser.read_headers(input, http_parser::message_mode::request);
-                read_request_body(boost::bind(&http_service::handle_request, this));
+                // Only part of the head has arrived, the next scan picks up where this one stopped
+                if (!parser.scan_head(flow.client.input_buffer())) {
+                    flow.client.read_async(boost::bind(&http_service::on_read_request_head, this,
+                        boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+                    return;
+                }
+
+                parser.read_request_head(flow.client.input_buffer());
+                if (should_stream_request_body()) {
+                    streaming_request = true;
+                    handle_request();
+                }
+                else {
+                    read_request_body(boost::bind(&http_service::handle_request, this));
+                }
             }
             catch (const error::base_exception &ex) {
                 flow.error.set_proxy_error(ex);
@@ -112,11 +207,22 @@ namespace proxy::tcp::http::http1 {
         }
     }
 
+    bool http_service::should_stream_request_body() {
+        if (!program::options::instance().stream_request_body || interceptors.http.has_interceptors(intercept::http_event::request_body)) {
+            return false;
+        }
+        auto type = parser.body_size(http_parser::message_mode::request).first;
+        return type == http_parser::body_size_type::given || type == http_parser::body_size_type::chunked;
+    }
+
     void http_service::handle_request() {
         try {
             request &req = exch.request();
 
-            validate_target();
+            // The server connection is only pooled after a response finishes cleanly
+            flow.server.set_keep_alive(false);
+
+            validate_target(req);
 
             interceptors.http.run(intercept::http_event::any_request, flow, exch);
 
@@ -149,9 +255,43 @@ namespace proxy::tcp::http::http1 {
                     return;
                 }
                 req.remove_header("Expect");
+
+                // The body only follows the interim response
+                if (should_stream_request_body()) {
+                    streaming_request = true;
+                }
+                else {
+                    read_request_body(boost::bind(&http_service::dispatch_request, this));
+                    return;
+                }
             }
 
+            dispatch_request();
+        }
+        catch (const error::base_exception &ex) {
+            flow.error.set_proxy_error(ex);
+            send_error_response(status::bad_request, ex.what());
+        }
+    }
+
+    void http_service::dispatch_request() {
+        try {
+            if (!streaming_request) {
+                interceptors.http.run(intercept::http_event::request_body, flow, exch);
+            }
             interceptors.http.run(intercept::http_event::request, flow, exch);
+        }
+        catch (const error::base_exception &ex) {
+            flow.error.set_proxy_error(ex);
+            send_error_response(status::bad_request, ex.what());
+            return;
+        }
+        route_request();
+    }
+
+    void http_service::route_request() {
+        try {
+            request &req = exch.request();
             set_server(req.get_host_name(), req.get_host_port());
 
             // Response set by an interceptor
@@ -163,6 +303,9 @@ namespace proxy::tcp::http::http1 {
                 if (websocket::handshake::is_handshake(req)) {
                     interceptors.http.run(intercept::http_event::websocket_handshake, flow, exch);
                 }
+                else if (serve_from_cache()) {
+                    return;
+                }
                 connect_server();
             }
         }
@@ -172,15 +315,33 @@ namespace proxy::tcp::http::http1 {
         }
     }
 
-    void http_service::validate_target() {
-        request &req = exch.request();
+    bool http_service::serve_from_cache() {
+        if (!program::options::instance().cache) {
+            return false;
+        }
+
+        cache_state = cache::response_cache::instance().lookup(exch.request());
+        switch (cache_state.status) {
+            case cache::lookup_status::hit:
+                exch.make_response() = std::move(cache_state.res);
+                forward_response();
+                return true;
+            case cache::lookup_status::unavailable:
+                send_error_response(status::gateway_timeout, "No cached response is available.");
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    void http_service::validate_target(request &req) {
         url target = req.get_target();
 
         // Make sure target URL and host header are OK to be forwarded
         // This form is when the client knows it is talking to a proxy
         if (target.form == url::target_form::absolute) {
             // Add missing host header
-            if (!req.has_header("Host")) {
+            if (!req.has_header(header_id::host)) {
                 req.set_header_to_value("Host", target.netloc.to_host_string());
             }
 
@@ -192,7 +353,7 @@ namespace proxy::tcp::http::http1 {
         // No host information in target, so we need to parse it and set it to keep things uniform
         else if (target.form == url::target_form::origin && !target.netloc.has_hostname()) {
             // Absolutely no way to get the intended host
-            if (!req.has_header("Host")) {
+            if (!req.has_header(header_id::host)) {
                 send_error_response(status::bad_request, "No host given.");
                 return;
             }
@@ -201,19 +362,24 @@ namespace proxy::tcp::http::http1 {
         }
 
         // Set scheme based on server connection
+        bool secured = flow.server.secured() || flow.upstream_session;
         if (target.form != url::target_form::authority && target.scheme.empty()) {
-            target.scheme = flow.server.secured() ? "https" : "http";
+            target.scheme = secured ? "https" : "http";
         }
 
         // Set default port
         if (!target.netloc.has_port()) {
-            target.netloc.port = (target.scheme == "https" || flow.server.secured()) ? 443 : 80;
+            target.netloc.port = (target.scheme == "https" || secured) ? 443 : 80;
         }
 
         req.set_target(target);
     }
 
     void http_service::connect_server() {
+        if (use_upstream_session()) {
+            forward_request_upstream();
+            return;
+        }
         connect_server_async(boost::bind(&http_service::on_connect_server, this,
             boost::asio::placeholders::error));
     }
@@ -228,19 +394,63 @@ namespace proxy::tcp::http::http1 {
                 send_error_response(status::bad_gateway, error.message());
             }
         }
+        // Requests that cannot share the HTTP/2 connection go over HTTP/1.1, secured with the same parameters
+        else if (flow.upstream_session && !flow.server.secured() && exch.request().get_target().scheme == "https") {
+            http1_tls_args = std::make_unique<tls::openssl::ssl_context_args>(flow.upstream_session->get_tls_args());
+            http1_tls_args->alpn_protos = { std::string(tls::tls_service::default_alpn) };
+            flow.establish_tls_with_server_async(*http1_tls_args, boost::bind(&http_service::on_establish_tls_with_server, this,
+                boost::asio::placeholders::error));
+        }
+        else {
+            forward_request();
+        }
+    }
+
+    void http_service::on_establish_tls_with_server(const boost::system::error_code &error) {
+        if (error != boost::system::errc::success) {
+            flow.error.set_boost_error(error);
+            flow.error.set_proxy_error(errc::upstream_handshake_failed);
+            send_error_response(status::bad_gateway, error.message());
+        }
         else {
             forward_request();
         }
     }
 
     void http_service::forward_request() {
-        flow.server << exch.request();
-        flow.server.write_async(boost::bind(&http_service::on_forward_request, this,
+        message::body_buffers body { };
+        if (streaming_request) {
+            std::ostream out = flow.server.output_stream();
+            exch.request().write_head(out);
+            // Send whatever part of the body came with the head right away
+            try {
+                relay_request_body();
+            }
+            catch (const error::base_exception &ex) {
+                flow.error.set_proxy_error(ex);
+                send_error_response(status::bad_request, ex.what());
+                return;
+            }
+        }
+        else {
+            std::ostream out = flow.server.output_stream();
+            body = exch.request().serialize(out);
+        }
+        flow.server.write_async(body, boost::bind(&http_service::on_forward_request, this,
             boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
     }
 
     void http_service::on_forward_request(const boost::system::error_code &error, std::size_t bytes_transferred) {
         if (error != boost::system::errc::success) {
+            if (error != boost::asio::error::operation_aborted && retry_on_stale_server()) {
+                return;
+            }
+            // The server may have rejected the request early and closed the connection, so relay its response if there is one
+            if (error != boost::asio::error::operation_aborted && streaming_request && !request_body_done) {
+                parser.abort_relay();
+                read_response_head();
+                return;
+            }
             flow.error.set_boost_error(error);
             if (error == boost::asio::error::operation_aborted) {
                 send_error_response(status::gateway_timeout, error.message());
@@ -249,19 +459,442 @@ namespace proxy::tcp::http::http1 {
                 send_error_response(status::internal_server_error, error.message());
             }
         }
-        else {
+        // Wait for the server to take each part of the body before reading more from the client
+        else if (streaming_request && !request_body_done) {
+            // A plain server that answers before the body is done will not read the rest of it
+            if (!flow.server.secured() && flow.server.has_pending_input()) {
+                parser.abort_relay();
+                read_response_head();
+            }
+            else {
+                read_streamed_request_body();
+            }
+        }
+        else if (!pipeline_requests()) {
             read_response_head();
         }
     }
 
-    void http_service::read_response_head() {
-        // Read until the end of headers delimiter is found
-        flow.server.read_until_async(message::CRLF_CRLF, boost::bind(&http_service::on_read_response_head, this,
+    bool http_service::can_pipeline(const request &req) const {
+        return req.is_idempotent()
+            && req.get_target().form != url::target_form::authority
+            && !req.has_header(header_id::upgrade)
+            && !req.has_header(header_id::expect)
+            && !req.should_close_connection();
+    }
+
+    bool http_service::pipeline_requests() {
+        bool send = false;
+        std::ostream out = flow.server.output_stream();
+        for (const auto &queued : pipeline) {
+            if (queued.forwarded) {
+                out << queued.exch.request();
+                send = true;
+            }
+        }
+
+        if (!streaming_request && can_pipeline(exch.request())) {
+            std::size_t depth = program::options::instance().http_pipeline_depth;
+            while (pipeline.size() < depth && (pipeline.empty() || pipeline.back().forwarded)) {
+                exchange next;
+                if (!read_pipelined_request(next)) {
+                    break;
+                }
+
+                // An interceptor may answer the request itself or send it somewhere else,
+                // in which case it waits for the responses before it
+                const request &req = next.request();
+                bool forwarded = !next.has_response() && flow.server.is_connected_to(req.get_host_name(), req.get_host_port());
+                if (forwarded) {
+                    out << req;
+                    send = true;
+                }
+                pipeline.push_back({ std::move(next), forwarded });
+            }
+        }
+
+        if (!send) {
+            return false;
+        }
+        flow.server.write_async(boost::bind(&http_service::on_pipeline_requests, this,
+            boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+        return true;
+    }
+
+    bool http_service::read_pipelined_request(exchange &next) {
+        streambuf &input = flow.client.input_buffer();
+        if (input.size() == 0) {
+            return false;
+        }
+
+        http_parser lookahead(next);
+        try {
+            if (!lookahead.scan_head(input)) {
+                return false;
+            }
+            lookahead.peek_request_head(input);
+
+            request &req = next.request();
+            auto [type, size] = lookahead.body_size(http_parser::message_mode::request);
+            bool has_body = type != http_parser::body_size_type::none && !(type == http_parser::body_size_type::given && size == 0);
+            const url &target = req.get_target();
+            bool has_host = target.netloc.has_hostname() || req.has_header(header_id::host);
+            if (has_body || !has_host || !can_pipeline(req)) {
+                return false;
+            }
+            validate_target(req);
+            if (!flow.server.is_connected_to(req.get_host_name(), req.get_host_port())) {
+                return false;
+            }
+
+            interceptors.http.run(intercept::http_event::any_request, flow, next);
+            req.add_header("Via", out::string::stream("1.1 ", constants::lowercase_name));
+            interceptors.http.run(intercept::http_event::request_body, flow, next);
+            interceptors.http.run(intercept::http_event::request, flow, next);
+        }
+        // Left in the buffer, so the error is reported when the request is read in order
+        catch (const error::base_exception &) {
+            return false;
+        }
+
+        lookahead.consume_head(input);
+        return true;
+    }
+
+    void http_service::on_pipeline_requests(const boost::system::error_code &error, std::size_t bytes_transferred) {
+        if (error != boost::system::errc::success) {
+            if (error != boost::asio::error::operation_aborted && retry_on_stale_server()) {
+                return;
+            }
+            flow.error.set_boost_error(error);
+            stop();
+            return;
+        }
+        read_response_head();
+    }
+
+    void http_service::relay_request_body() {
+        request_body_done = parser.relay_body(flow.client.input_buffer(), flow.server.output_buffer(), http_parser::message_mode::request);
+    }
+
+    void http_service::read_streamed_request_body() {
+        flow.client.read_async(boost::bind(&http_service::on_read_streamed_request_body, this,
+            boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+    }
+
+    void http_service::on_read_streamed_request_body(const boost::system::error_code &error, std::size_t bytes_transferred) {
+        if (error != boost::system::errc::success) {
+            flow.error.set_boost_error(error);
+            if (error == boost::asio::error::operation_aborted) {
+                send_error_response(status::request_timeout, error.message());
+            }
+            else {
+                send_error_response(status::bad_request, error.message());
+            }
+            return;
+        }
+
+        try {
+            relay_request_body();
+        }
+        catch (const error::base_exception &ex) {
+            flow.error.set_proxy_error(ex);
+            send_error_response(status::bad_request, ex.what());
+            return;
+        }
+        flow.server.write_async(boost::bind(&http_service::on_forward_request, this,
             boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
     }
 
+    bool http_service::use_upstream_session() const {
+        const request &req = exch.request();
+        return flow.upstream_session && !retried && program::options::instance().http2_upstream
+            && req.get_target().scheme == "https"
+            && req.get_host_name() == flow.upstream_session->get_host() && req.get_host_port() == flow.upstream_session->get_port()
+            && !req.has_header(header_id::upgrade);
+    }
+
+    void http_service::forward_request_upstream() {
+        const request &req = exch.request();
+        upstream_session = boost::asio::use_service<http2::session_pool>(ioc).acquire(req.get_host_name(), req.get_host_port(), flow.upstream_session->get_tls_args());
+        flow.upstream_session = upstream_session;
+
+        upstream_stream = upstream_session->submit(req, streaming_request);
+        upstream_stream->on_response_head = boost::bind(&http_service::on_upstream_event, this);
+        upstream_stream->on_response_data = boost::bind(&http_service::on_upstream_event, this);
+        upstream_stream->on_error = boost::bind(&http_service::on_upstream_error, this, boost::placeholders::_1);
+        if (streaming_request) {
+            upstream_stream->on_request_data_sent = boost::bind(&http_service::read_upstream_request_body, this);
+            relay_upstream_request_body();
+        }
+    }
+
+    void http_service::relay_upstream_request_body() {
+        try {
+            // The body is carried in DATA frames, so any chunk framing is removed
+            request_body_done = parser.decode_body(flow.client.input_buffer(), upstream_stream->request_data, http_parser::message_mode::request);
+        }
+        catch (const error::base_exception &ex) {
+            upstream_session->cancel(upstream_stream);
+            upstream_stream.reset();
+            flow.error.set_proxy_error(ex);
+            send_error_response(status::bad_request, ex.what());
+            return;
+        }
+        upstream_stream->request_done = request_body_done;
+        upstream_session->send(upstream_stream);
+
+        if (request_body_done || upstream_error || upstream_stream->response_done) {
+            on_upstream_event();
+        }
+        // Otherwise, more is read once the server has taken what it was given
+        else if (upstream_stream->request_data.size() == 0) {
+            read_upstream_request_body();
+        }
+    }
+
+    void http_service::read_upstream_request_body() {
+        if (reading_request_body || request_body_done) {
+            return;
+        }
+        reading_request_body = true;
+        flow.client.read_async(boost::bind(&http_service::on_read_upstream_request_body, this,
+            boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+    }
+
+    void http_service::on_read_upstream_request_body(const boost::system::error_code &error, std::size_t bytes_transferred) {
+        reading_request_body = false;
+        if (error != boost::system::errc::success) {
+            upstream_session->cancel(upstream_stream);
+            upstream_stream.reset();
+            flow.error.set_boost_error(error);
+            if (error == boost::asio::error::operation_aborted) {
+                send_error_response(status::request_timeout, error.message());
+            }
+            else {
+                send_error_response(status::bad_request, error.message());
+            }
+            return;
+        }
+        relay_upstream_request_body();
+    }
+
+    void http_service::on_upstream_error(const boost::system::error_code &error) {
+        upstream_error = error;
+        on_upstream_event();
+    }
+
+    void http_service::on_upstream_event() {
+        // The handler of the operation in progress comes back here
+        if (reading_request_body || writing_response) {
+            return;
+        }
+        if (upstream_error) {
+            handle_upstream_error();
+            return;
+        }
+        if ((streaming_request && !request_body_done && !upstream_stream->response_done) || !upstream_stream->head_received) {
+            return;
+        }
+
+        if (!upstream_response_started) {
+            upstream_response_started = true;
+            start_upstream_response();
+        }
+        else if (streaming_response) {
+            relay_upstream_response();
+        }
+        else {
+            collect_upstream_response();
+        }
+    }
+
+    void http_service::handle_upstream_error() {
+        // A request the server never processed is sent once more over HTTP/1.1, which also covers servers that stopped speaking HTTP/2
+        if (upstream_stream->retryable && !retried && !streaming_request) {
+            retried = true;
+            out::debug::log("Retrying request to ", upstream_session->get_host(), ':', upstream_session->get_port(), " over HTTP/1.1");
+            upstream_stream.reset();
+            upstream_error.clear();
+            connect_server();
+            return;
+        }
+
+        flow.error.set_boost_error(upstream_error);
+        upstream_stream.reset();
+        // Part of the response may already be on its way, so the client can only be told by closing the connection
+        if (streaming_response) {
+            stop();
+        }
+        else if (upstream_error == boost::asio::error::operation_aborted) {
+            send_error_response(status::gateway_timeout, upstream_error.message());
+        }
+        else {
+            send_error_response(status::bad_gateway, upstream_error.message());
+        }
+    }
+
+    void http_service::start_upstream_response() {
+        exch.set_response(upstream_stream->response_head);
+        interceptors.http.run(intercept::http_event::response_head, flow, exch);
+
+        const program::options &options = program::options::instance();
+        std::pair<http_parser::body_size_type, std::size_t> body_size;
+        try {
+            body_size = parser.body_size(http_parser::message_mode::response);
+        }
+        catch (const error::base_exception &ex) {
+            upstream_session->cancel(upstream_stream);
+            upstream_stream.reset();
+            flow.error.set_proxy_error(ex);
+            send_error_response(status::bad_gateway, ex.what());
+            return;
+        }
+
+        // Bodies without a length end with the stream rather than the connection, so they are not handled like HTTP/1.x ones
+        auto [type, size] = body_size;
+        if (!options.stream_response_body || exch.buffer_response() || type == http_parser::body_size_type::none) {
+            collect_upstream_response();
+        }
+        else if (exch.response().is_event_stream() || (type == http_parser::body_size_type::given && size > options.stream_response_threshold)) {
+            stream_upstream_response();
+        }
+        else {
+            holding_upstream_response = type != http_parser::body_size_type::given;
+            collect_upstream_response();
+        }
+    }
+
+    void http_service::collect_upstream_response() {
+        streambuf &data = upstream_stream->response_data;
+        std::size_t size = data.size();
+        held_response.commit(boost::asio::buffer_copy(held_response.prepare(size), data.data()));
+        upstream_session->consume(upstream_stream, size);
+
+        if (holding_upstream_response && held_response.size() > program::options::instance().stream_response_threshold) {
+            stream_upstream_response();
+            return;
+        }
+        if (!upstream_stream->response_done) {
+            return;
+        }
+
+        response &res = exch.response();
+        res.set_body({ static_cast<const char *>(held_response.data().data()), held_response.size() });
+        held_response.consume(held_response.size());
+
+        // The whole body is sent at once, so a body that ended with the stream is given a length
+        if (parser.body_size(http_parser::message_mode::response).first == http_parser::body_size_type::all) {
+            res.set_content_length();
+        }
+        forward_response();
+    }
+
+    void http_service::stream_upstream_response() {
+        streaming_response = true;
+
+        // Interceptors only get to see the head, since the body is never stored
+        interceptors.http.run(intercept::http_event::response, flow, exch);
+        begin_cache_fill();
+
+        response &res = exch.response();
+        if (!res.has_header(header_id::content_length)) {
+            if (exch.request().get_version() == version::http1_1) {
+                res.add_header("Transfer-Encoding", "chunked");
+                chunked_response = true;
+            }
+            else {
+                res.set_header_to_value("Connection", "close");
+            }
+        }
+
+        std::ostream out = flow.client.output_stream();
+        res.write_head(out);
+        relay_upstream_response();
+    }
+
+    void http_service::relay_upstream_response() {
+        streambuf &output = flow.client.output_buffer();
+        streambuf &data = upstream_stream->response_data;
+        std::size_t size = held_response.size() + data.size();
+        if (size != 0) {
+            std::ostream out(&output);
+            if (chunked_response) {
+                out << std::hex << size << std::dec << message::CRLF;
+                out.flush();
+            }
+            std::size_t body_start = output.size();
+            output.commit(boost::asio::buffer_copy(output.prepare(held_response.size()), held_response.data()));
+            held_response.consume(held_response.size());
+            std::size_t data_size = data.size();
+            output.commit(boost::asio::buffer_copy(output.prepare(data_size), data.data()));
+            upstream_session->consume(upstream_stream, data_size);
+            fill_cache(boost::asio::buffer(static_cast<const char *>(output.data().data()) + body_start, output.size() - body_start));
+            if (chunked_response) {
+                out << message::CRLF;
+            }
+        }
+        if (upstream_stream->response_done) {
+            if (chunked_response) {
+                std::ostream out(&output);
+                out << '0' << message::CRLF_CRLF;
+            }
+            response_body_done = true;
+        }
+
+        if (output.size() == 0) {
+            if (response_body_done) {
+                handle_response();
+            }
+            return;
+        }
+        writing_response = true;
+        flow.client.write_async(boost::bind(&http_service::on_relay_upstream_response, this,
+            boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+    }
+
+    void http_service::on_relay_upstream_response(const boost::system::error_code &error, std::size_t bytes_transferred) {
+        writing_response = false;
+        if (error != boost::system::errc::success) {
+            flow.error.set_boost_error(error);
+            stop();
+        }
+        else if (response_body_done) {
+            handle_response();
+        }
+        else {
+            on_upstream_event();
+        }
+    }
+
+    bool http_service::retry_on_stale_server() {
+        // Nothing from the server may have been read, or it could have processed the request
+        // A streamed body has already been consumed and cannot be sent again
+        if (retried || streaming_request || !flow.server.was_reused() || !exch.request().is_idempotent() || flow.server.input_buffer().size() != 0) {
+            return false;
+        }
+        retried = true;
+        out::debug::log("Retrying request on a new connection to ", flow.server.get_host(), ':', flow.server.get_port());
+        flow.server.disconnect();
+        connect_server();
+        return true;
+    }
+
+    void http_service::read_response_head() {
+        if (flow.server.input_buffer().size() != 0) {
+            on_read_response_head(boost::system::error_code(), 0);
+        }
+        else {
+            flow.server.read_async(boost::bind(&http_service::on_read_response_head, this,
+                boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+        }
+    }
+
     void http_service::on_read_response_head(const boost::system::error_code &error, std::size_t bytes_transferred) {
         if (error != boost::system::errc::success) {
+            if (error != boost::asio::error::operation_aborted && retry_on_stale_server()) {
+                return;
+            }
             flow.error.set_boost_error(error);
             if (error == boost::asio::error::operation_aborted) {
                 send_error_response(status::gateway_timeout, error.message());
@@ -271,12 +904,65 @@ namespace proxy::tcp::http::http1 {
             }
         }
         else {
-            std::istream input = flow.server.input_stream();
-            exch.make_response();
-            parser.read_response_line(input);
-            parser.read_headers(input, http_parser::message_mode::response);
+            try {
+                // Only part of the head has arrived, the next scan picks up where this one stopped
+                if (!parser.scan_head(flow.server.input_buffer())) {
+                    flow.server.read_async(boost::bind(&http_service::on_read_response_head, this,
+                        boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+                    return;
+                }
+
+                exch.make_response();
+                parser.read_response_head(flow.server.input_buffer());
+            }
+            catch (const error::base_exception &ex) {
+                flow.error.set_proxy_error(ex);
+                send_error_response(status::internal_server_error, ex.what());
+                return;
+            }
+            start_response_body();
+        }
+    }
+
+    void http_service::start_response_body() {
+        interceptors.http.run(intercept::http_event::response_head, flow, exch);
+
+        const program::options &options = program::options::instance();
+        std::pair<http_parser::body_size_type, std::size_t> body_size;
+        try {
+            body_size = parser.body_size(http_parser::message_mode::response);
+        }
+        catch (const error::base_exception &ex) {
+            flow.error.set_proxy_error(ex);
+            send_error_response(status::internal_server_error, ex.what());
+            return;
+        }
+
+        auto [type, size] = body_size;
+
+        // A body that ends with the server connection cannot be followed by another response to the client
+        if (type == http_parser::body_size_type::all) {
+            exch.response().set_header_to_value("Connection", "close");
+        }
+
+        if (!options.stream_response_body || exch.buffer_response() || type == http_parser::body_size_type::none) {
             read_response_body(boost::bind(&http_service::forward_response, this));
         }
+        // Events must reach the client as soon as they are sent, however small they are
+        else if (exch.response().is_event_stream()) {
+            stream_response();
+        }
+        else if (type == http_parser::body_size_type::given) {
+            if (size > options.stream_response_threshold) {
+                stream_response();
+            }
+            else {
+                read_response_body(boost::bind(&http_service::forward_response, this));
+            }
+        }
+        else {
+            hold_response_body();
+        }
     }
 
     void http_service::read_response_body(const callback &handler, bool eof) {
@@ -286,7 +972,9 @@ namespace proxy::tcp::http::http1 {
             std::istream input = flow.server.input_stream();
 
             // Body is finished, call finished handler
-            if (parser.read_body(input, http_parser::message_mode::response)) {
+            // At the end of the stream, a second pass finishes a body that is read until EOF
+            if (parser.read_body(input, http_parser::message_mode::response)
+                || (eof && parser.read_body(input, http_parser::message_mode::response))) {
                 handler();
             }
             // Body is not finished, and nothing more to read
@@ -329,25 +1017,251 @@ namespace proxy::tcp::http::http1 {
         }
     }
 
+    void http_service::hold_response_body(bool eof) {
+        try {
+            if (parser.relay_body(flow.server.input_buffer(), held_response, http_parser::message_mode::response, eof) || eof) {
+                // Small enough after all, so put the body back in front of the input and buffer it as usual
+                parser.abort_relay();
+                streambuf &input = flow.server.input_buffer();
+                held_response.commit(boost::asio::buffer_copy(held_response.prepare(input.size()), input.data()));
+                input.consume(input.size());
+                input.commit(boost::asio::buffer_copy(input.prepare(held_response.size()), held_response.data()));
+                held_response.consume(held_response.size());
+                read_response_body(boost::bind(&http_service::forward_response, this), eof);
+                return;
+            }
+        }
+        catch (const error::base_exception &ex) {
+            flow.error.set_proxy_error(ex);
+            send_error_response(status::internal_server_error, ex.what());
+            return;
+        }
+
+        if (held_response.size() > program::options::instance().stream_response_threshold) {
+            stream_response();
+        }
+        else {
+            flow.server.read_async(boost::bind(&http_service::on_hold_response_body, this,
+                boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+        }
+    }
+
+    void http_service::on_hold_response_body(const boost::system::error_code &error, std::size_t bytes_transferred) {
+        if (error != boost::system::errc::success) {
+            if (error == boost::asio::error::eof) {
+                hold_response_body(true);
+            }
+            else {
+                flow.error.set_boost_error(error);
+                if (error == boost::asio::error::operation_aborted) {
+                    send_error_response(status::gateway_timeout, error.message());
+                }
+                else {
+                    send_error_response(status::internal_server_error, error.message());
+                }
+            }
+        }
+        else {
+            hold_response_body(bytes_transferred == 0);
+        }
+    }
+
+    void http_service::stream_response() {
+        streaming_response = true;
+
+        // Interceptors only get to see the head, since the body is never stored
+        interceptors.http.run(intercept::http_event::response, flow, exch);
+        begin_cache_fill();
+
+        try {
+            std::ostream out = flow.client.output_stream();
+            exch.response().write_head(out);
+            streambuf &output = flow.client.output_buffer();
+            std::size_t body_start = output.size();
+            output.commit(boost::asio::buffer_copy(output.prepare(held_response.size()), held_response.data()));
+            held_response.consume(held_response.size());
+
+            response_body_done = parser.relay_body(flow.server.input_buffer(), output, http_parser::message_mode::response);
+            fill_cache(boost::asio::buffer(static_cast<const char *>(output.data().data()) + body_start, output.size() - body_start));
+        }
+        // Part of the response may already be on its way, so the client can only be told by closing the connection
+        catch (const error::base_exception &ex) {
+            flow.error.set_proxy_error(ex);
+            stop();
+            return;
+        }
+        flow.client.write_async(boost::bind(&http_service::on_stream_response, this,
+            boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+    }
+
+    void http_service::on_stream_response(const boost::system::error_code &error, std::size_t bytes_transferred) {
+        if (error != boost::system::errc::success) {
+            flow.error.set_boost_error(error);
+            stop();
+        }
+        else if (response_body_done) {
+            handle_response();
+        }
+        // Wait for the client to take each part of the body before reading more from the server
+        else {
+            flow.server.read_async(boost::bind(&http_service::on_read_streamed_response_body, this,
+                boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+        }
+    }
+
+    void http_service::on_read_streamed_response_body(const boost::system::error_code &error, std::size_t bytes_transferred) {
+        bool eof = error == boost::asio::error::eof;
+        if (error != boost::system::errc::success && !eof) {
+            flow.error.set_boost_error(error);
+            stop();
+            return;
+        }
+
+        try {
+            streambuf &output = flow.client.output_buffer();
+            std::size_t body_start = output.size();
+            response_body_done = parser.relay_body(flow.server.input_buffer(), output, http_parser::message_mode::response, eof);
+            fill_cache(boost::asio::buffer(static_cast<const char *>(output.data().data()) + body_start, output.size() - body_start));
+        }
+        catch (const error::base_exception &ex) {
+            flow.error.set_proxy_error(ex);
+            stop();
+            return;
+        }
+
+        // The server closed the connection in the middle of the body
+        if (eof && !response_body_done) {
+            flow.error.set_boost_error(error);
+            flow.error.set_proxy_error(errc::malformed_response_body);
+            stop();
+            return;
+        }
+        flow.client.write_async(boost::bind(&http_service::on_stream_response, this,
+            boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+    }
+
+    void http_service::begin_cache_fill() {
+        if (cache_state.status != cache::lookup_status::bypass) {
+            cache_fill = cache::response_cache::instance().begin_fill(exch.request(), exch.response(), cache_state);
+        }
+    }
+
+    void http_service::fill_cache(boost::asio::const_buffer data) {
+        // Relaying goes on whether or not the disk keeps up
+        if (cache_fill && data.size() != 0 && !cache_fill->write(data)) {
+            cache_fill.reset();
+        }
+    }
+
     void http_service::forward_response() {
+        // Interceptors see the response the client gets, which is the stored one if the server only validated it
+        if (cache_state.status != cache::lookup_status::bypass) {
+            cache::response_cache::instance().complete(exch.request(), exch.response(), cache_state);
+        }
+        // Only the head of a response whose body is on disk is in the message, like a streamed response
+        cached_body = std::move(cache_state.body);
+
         interceptors.http.run(intercept::http_event::response, flow, exch);
 
-        flow.client << exch.response();
-        flow.client.write_async(boost::bind(&http_service::on_forward_response, this,
+        std::ostream out = flow.client.output_stream();
+        message::body_buffers body = exch.response().serialize(out);
+        flow.client.write_async(body, boost::bind(&http_service::on_forward_response, this,
             boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
     }
+
     void http_service::on_forward_response(const boost::system::error_code &error, std::size_t bytes_transferred) {
         if (error != boost::system::errc::success) {
             flow.error.set_boost_error(error);
             stop();
         }
+        else if (cached_body) {
+            send_cached_body();
+        }
         else {
             handle_response();
         }
     }
 
+    void http_service::send_cached_body() {
+        if (cache::file_sender::is_supported() && !flow.client.secured() && cached_body_sent == 0 && !body_sender.is_open()) {
+            boost::system::error_code error;
+            body_sender.open(*cached_body, error);
+            // sendfile() must never block the io_context
+            if (error == boost::system::errc::success) {
+                flow.client.get_socket().native_non_blocking(true, error);
+            }
+            // The segment may have been evicted since the lookup, but its mapping is still readable
+            if (error != boost::system::errc::success) {
+                body_sender.close();
+            }
+        }
+        if (body_sender.is_open()) {
+            send_cached_body_file();
+            return;
+        }
+
+        boost::asio::const_buffer chunk = cached_body->buffer(cached_body_sent, cached_body_chunk_size);
+        flow.client.write_async({ chunk, boost::asio::const_buffer() }, boost::bind(&http_service::on_send_cached_body, this,
+            boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+    }
+
+    void http_service::on_send_cached_body(const boost::system::error_code &error, std::size_t bytes_transferred) {
+        if (error != boost::system::errc::success) {
+            flow.error.set_boost_error(error);
+            stop();
+            return;
+        }
+        cached_body_sent += bytes_transferred;
+        if (cached_body_sent < cached_body->length) {
+            send_cached_body();
+        }
+        else {
+            finish_cached_body();
+        }
+    }
+
+    void http_service::send_cached_body_file() {
+        boost::system::error_code error;
+        body_sender.send(flow.client.get_socket().native_handle(), error);
+        if (error == boost::asio::error::would_block) {
+            flow.client.wait_writable_async(boost::bind(&http_service::on_cached_body_writable, this,
+                boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+        }
+        else if (error != boost::system::errc::success) {
+            flow.error.set_boost_error(error);
+            stop();
+        }
+        else {
+            finish_cached_body();
+        }
+    }
+
+    void http_service::on_cached_body_writable(const boost::system::error_code &error, std::size_t bytes_transferred) {
+        if (error != boost::system::errc::success) {
+            flow.error.set_boost_error(error);
+            stop();
+        }
+        else {
+            send_cached_body_file();
+        }
+    }
+
+    void http_service::finish_cached_body() {
+        // The next service writes to the socket the usual way
+        if (body_sender.is_open()) {
+            body_sender.close();
+            boost::system::error_code error;
+            flow.client.get_socket().native_non_blocking(false, error);
+        }
+        cached_body.reset();
+        handle_response();
+    }
+
     void http_service::handle_response() {
-        bool should_close = exch.request().should_close_connection() || exch.response().should_close_connection();
+        // A streamed request body that was never read leaves the client connection out of sync
+        bool should_close = exch.request().should_close_connection() || exch.response().should_close_connection()
+            || (streaming_request && !request_body_done);
+        flow.server.set_keep_alive(!should_close && exch.response().get_status() != status::switching_protocols);
         if (should_close) {
             stop();
             return;
@@ -363,6 +1277,10 @@ namespace proxy::tcp::http::http1 {
                 owner.switch_service<tunnel::tunnel_service>();
             }
         }
+        // Responses to pipelined requests follow on the same server connection
+        else if (!pipeline.empty()) {
+            owner.switch_service<http_service>(pipeline);
+        }
         else {
             owner.switch_service<http_service>();
         }
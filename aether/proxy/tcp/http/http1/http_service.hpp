@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <deque>
 #include <memory>
 #include <boost/asio.hpp>
 
@@ -15,7 +16,10 @@
 #include <aether/proxy/tcp/base_service.hpp>
 #include <aether/proxy/connection/connection_flow.hpp>
 #include <aether/proxy/tcp/http/exchange.hpp>
+#include <aether/proxy/tcp/http/cache/file_sender.hpp>
+#include <aether/proxy/tcp/http/cache/response_cache.hpp>
 #include <aether/proxy/tcp/http/http1/http_parser.hpp>
+#include <aether/proxy/tcp/http/http2/client_session.hpp>
 #include <aether/proxy/tcp/websocket/handshake/handshake.hpp>
 #include <aether/proxy/tcp/tunnel/tunnel_service.hpp>
 #include <aether/proxy/tcp/tls/tls_service.hpp>
@@ -27,6 +31,23 @@ namespace proxy::tcp::http::http1 {
     */
     class http_service
         : public base_service {
+    public:
+        /*
+            A request read from the client ahead of the one being handled.
+            Request interceptors have already been run for it.
+        */
+        struct pipelined_request {
+            exchange exch;
+            // Sent on the current server connection, so its response follows the ones before it
+            bool forwarded;
+        };
+
+        /*
+            Requests handled in order by the services that follow the current one.
+            Only the last request may not have been forwarded.
+        */
+        using request_pipeline = std::deque<pipelined_request>;
+
     private:
         // Static continue response used whenever client expects it
         static const response continue_response;
@@ -34,26 +55,197 @@ namespace proxy::tcp::http::http1 {
         // Static response to CONNECT requests used whenever client needs it
         static const response connect_response;
 
+        // Largest part of a body read from disk that is written to a TLS connection at once
+        static constexpr std::size_t cached_body_chunk_size = 256 * 1024;
+
         exchange exch;
         http_parser parser;
 
+        // A request is only retried once on a fresh connection
+        bool retried;
+
+        // The request body is relayed to the server as it arrives instead of being buffered
+        bool streaming_request;
+        bool request_body_done;
+
+        // The response body is relayed to the client as it arrives instead of being buffered
+        bool streaming_response;
+        bool response_body_done;
+
+        // Start of a response body of unknown size, held until it ends or grows too large to buffer
+        streambuf held_response;
+
+        // The exchange was taken from the previous service's pipeline instead of being read here
+        bool from_pipeline;
+        bool request_forwarded;
+        request_pipeline pipeline;
+
+        // Stream the request was sent on, when it shares an HTTP/2 connection to the server
+        http2::client_session::ptr upstream_session;
+        http2::client_stream::ptr upstream_stream;
+        boost::system::error_code upstream_error;
+        // Events from the stream wait while an operation on the client connection is in progress
+        bool reading_request_body;
+        bool writing_response;
+        bool upstream_response_started;
+        // The response body may still be streamed once it grows past the streaming threshold
+        bool holding_upstream_response;
+        bool chunked_response;
+
+        cache::lookup_result cache_state;
+
+        // Body of a cached response that is sent from disk after the head
+        std::shared_ptr<const cache::disk_body> cached_body;
+        std::uint64_t cached_body_sent;
+        cache::file_sender body_sender;
+
+        // Copies a streamed response body to the disk tier of the response cache
+        std::unique_ptr<cache::disk_writer> cache_fill;
+
+        // Parameters for securing a connection of its own, for requests that cannot share the HTTP/2 connection
+        std::unique_ptr<tls::openssl::ssl_context_args> http1_tls_args;
+
         // Methods are quite broken up because socket operations are asynchronous
 
         void read_request_head();
         void on_read_request_head(const boost::system::error_code &error, std::size_t bytes_transferred);
         void read_request_body(const callback &handler);
         void on_read_request_body(const callback &handler, const boost::system::error_code &error, std::size_t bytes_transferred);
+        /*
+            Tests if the request body can be relayed without buffering it.
+            Only possible if no interceptor is attached to the request_body event, since those
+                interceptors expect the whole request, body included.
+        */
+        bool should_stream_request_body();
         void handle_request();
+
+        /*
+            Runs request interceptors and sends the request on, once the body has been read or
+                it has been decided to stream it.
+        */
+        void dispatch_request();
+
+        /*
+            Sends the request to its server, or answers it with a response an interceptor set.
+        */
+        void route_request();
+
+        /*
+            Answers the request from the response cache if it can be.
+            Returns false if the request must be sent to the server, possibly with conditional headers added.
+        */
+        bool serve_from_cache();
         void connect_server();
         void on_connect_server(const boost::system::error_code &error);
+        void on_establish_tls_with_server(const boost::system::error_code &error);
         void forward_request();
         void on_forward_request(const boost::system::error_code &error, std::size_t bytes_transferred);
+        /*
+            Sends the request again if it failed on a reused server connection that went stale while idle.
+            Returns false if the request cannot be safely retried.
+        */
+        bool retry_on_stale_server();
+
+        /*
+            Tests if a request can be sent to the server before the response to the one before it arrives.
+            Only idempotent requests without a body that cannot change the protocol are pipelined.
+        */
+        bool can_pipeline(const request &req) const;
+
+        /*
+            Forwards the requests the client has already pipelined behind the current one on the same server connection.
+            Requests that were forwarded before are sent again, since this only happens when the request was retried.
+            Returns false if there is nothing to send.
+        */
+        bool pipeline_requests();
+
+        /*
+            Reads the next request from the client input buffer if it can be pipelined.
+            The request is left in the buffer if it cannot.
+        */
+        bool read_pipelined_request(exchange &next);
+        void on_pipeline_requests(const boost::system::error_code &error, std::size_t bytes_transferred);
+
+        /*
+            Moves whatever part of a streamed request body the client has sent into the server's output buffer.
+        */
+        void relay_request_body();
+        void read_streamed_request_body();
+        void on_read_streamed_request_body(const boost::system::error_code &error, std::size_t bytes_transferred);
+
+        /*
+            Tests if the request can be sent as a stream on the shared HTTP/2 connection to the server.
+            Requests that change the protocol and retried requests are sent over HTTP/1.1 instead.
+        */
+        bool use_upstream_session() const;
+        void forward_request_upstream();
+        void relay_upstream_request_body();
+        void read_upstream_request_body();
+        void on_read_upstream_request_body(const boost::system::error_code &error, std::size_t bytes_transferred);
+
+        /*
+            Moves the exchange along after anything happens on the upstream stream.
+            The response is only handled once the request body has been sent, like it is over HTTP/1.1.
+        */
+        void on_upstream_event();
+        void on_upstream_error(const boost::system::error_code &error);
+        void handle_upstream_error();
+
+        /*
+            Runs response interceptors on the head from the server and decides whether the body is buffered or streamed.
+        */
+        void start_upstream_response();
+        void collect_upstream_response();
+
+        /*
+            Sends the response head to the client, then relays the body as the server sends it.
+            Without a length, the body is chunked for HTTP/1.1 clients or ends with the connection.
+        */
+        void stream_upstream_response();
+        void relay_upstream_response();
+        void on_relay_upstream_response(const boost::system::error_code &error, std::size_t bytes_transferred);
         void read_response_head();
         void on_read_response_head(const boost::system::error_code &error, std::size_t bytes_transferred);
+
+        /*
+            Decides whether the response body is buffered or streamed once the response head is read.
+            Event streams and bodies larger than the streaming threshold are streamed right away.
+            Bodies of unknown size are held until they end or grow larger than the threshold.
+        */
+        void start_response_body();
         void read_response_body(const callback &handler, bool eof = false);
         void on_read_response_body(const callback &handler, const boost::system::error_code &error, std::size_t bytes_transferred);
+        void hold_response_body(bool eof = false);
+        void on_hold_response_body(const boost::system::error_code &error, std::size_t bytes_transferred);
+
+        /*
+            Sends the response head and whatever part of the body has been read to the client,
+                then relays the rest of the body as the server sends it.
+        */
+        void stream_response();
+        void on_stream_response(const boost::system::error_code &error, std::size_t bytes_transferred);
+        void on_read_streamed_response_body(const boost::system::error_code &error, std::size_t bytes_transferred);
+        /*
+            Starts copying a streamed response to the disk tier of the response cache, if it can be stored.
+        */
+        void begin_cache_fill();
+
+        /*
+            Copies part of a streamed response body to the disk tier of the response cache.
+        */
+        void fill_cache(boost::asio::const_buffer data);
         void forward_response();
         void on_forward_response(const boost::system::error_code &error, std::size_t bytes_transferred);
+
+        /*
+            Sends the body of a cached response from disk once its head has been written.
+            Plain connections are given the body with sendfile(), secured connections read it through the segment's mapping.
+        */
+        void send_cached_body();
+        void on_send_cached_body(const boost::system::error_code &error, std::size_t bytes_transferred);
+        void send_cached_body_file();
+        void on_cached_body_writable(const boost::system::error_code &error, std::size_t bytes_transferred);
+        void finish_cached_body();
         void handle_response();
 
         void send_connect_response();
@@ -63,7 +255,7 @@ namespace proxy::tcp::http::http1 {
             Modifies the request target if needed for transmission.
             Host information is kept primarily in the request.target.netloc field.
         */
-        void validate_target();
+        void validate_target(request &req);
 
         /*
             Sends an HTML error response to the client.
@@ -75,6 +267,13 @@ namespace proxy::tcp::http::http1 {
     public:
         http_service(connection::connection_flow &flow, connection_handler &owner,
             tcp::intercept::interceptor_manager &interceptors);
+
+        /*
+            Continues with the requests that were pipelined by the previous service.
+        */
+        http_service(connection::connection_flow &flow, connection_handler &owner,
+            tcp::intercept::interceptor_manager &interceptors, request_pipeline &pipeline);
+        ~http_service() override;
         void start() override;
         exchange get_exchange() const;
     };
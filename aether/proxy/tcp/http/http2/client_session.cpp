@@ -0,0 +1,891 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "client_session.hpp"
+#include "session_pool.hpp"
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include <aether/proxy/connection/upstream_pool.hpp>
+
+namespace proxy::tcp::http::http2 {
+    namespace {
+        // Fields that only apply to a single HTTP/1.x connection, which HTTP/2 does not allow
+        constexpr std::array<std::string_view, 6> connection_specific_headers = {
+            "connection",
+            "keep-alive",
+            "proxy-connection",
+            "transfer-encoding",
+            "upgrade",
+            "host"
+        };
+
+        constexpr std::uint32_t max_stream_id = 0x7fffffff;
+
+        std::uint32_t read_uint32(const std::uint8_t *data) {
+            return (static_cast<std::uint32_t>(data[0]) << 24) | (static_cast<std::uint32_t>(data[1]) << 16)
+                | (static_cast<std::uint32_t>(data[2]) << 8) | data[3];
+        }
+
+        void append_uint32(std::string &out, std::uint32_t value) {
+            out.push_back(static_cast<char>(value >> 24));
+            out.push_back(static_cast<char>(value >> 16));
+            out.push_back(static_cast<char>(value >> 8));
+            out.push_back(static_cast<char>(value));
+        }
+
+        void append_setting(std::string &out, setting id, std::uint32_t value) {
+            out.push_back(static_cast<char>(static_cast<std::uint16_t>(id) >> 8));
+            out.push_back(static_cast<char>(id));
+            append_uint32(out, value);
+        }
+
+        error_type to_error_type(const error_code &code) {
+            switch (code.value()) {
+                case errc::frame_size_error: return error_type::frame_size_error;
+                case errc::flow_control_error: return error_type::flow_control_error;
+                case errc::compression_error: return error_type::compression_error;
+                default: return error_type::protocol_error;
+            }
+        }
+    }
+
+    client_session::client_session(boost::asio::io_context &ioc, const std::string &host, port_t port, const tls::openssl::ssl_context_args &tls_args)
+        : ioc(ioc),
+        connection(),
+        host(host),
+        port(port),
+        key(connection::upstream_pool::make_key(host, port, connection::upstream_pool::tls_key(tls_args))),
+        tls_args(tls_args),
+        decoder(default_header_table_size),
+        encoder(),
+        streams(),
+        waiting(),
+        next_stream_id(1),
+        header_block_stream(0),
+        header_block_end_stream(false),
+        header_block(),
+        max_concurrent_streams(default_max_concurrent_streams),
+        initial_send_window(default_window_size),
+        max_send_frame_size(default_max_frame_size),
+        send_window(default_window_size),
+        receive_window(default_window_size),
+        unacknowledged_data(0),
+        queued_frames(),
+        ready(false),
+        writing(false),
+        goaway_received(false),
+        closed(false)
+    { }
+
+    void client_session::connect() {
+        connection = std::make_shared<connection::server_connection>(ioc);
+        connection->connect_async(host, port, boost::bind(&client_session::on_connect, shared_from_this(),
+            boost::asio::placeholders::error));
+    }
+
+    void client_session::on_connect(const boost::system::error_code &error) {
+        if (closed) {
+            return;
+        }
+        if (error != boost::system::errc::success) {
+            close(error);
+            return;
+        }
+
+        try {
+            connection->establish_tls_async(tls_args, boost::bind(&client_session::on_establish_tls, shared_from_this(),
+                boost::asio::placeholders::error));
+        }
+        catch (const error::base_exception &) {
+            close(boost::asio::error::no_protocol_option);
+        }
+    }
+
+    void client_session::on_establish_tls(const boost::system::error_code &error) {
+        if (closed) {
+            return;
+        }
+        if (error != boost::system::errc::success) {
+            close(error);
+        }
+        // The server no longer speaks HTTP/2, so waiting requests go over HTTP/1.1 instead
+        else if (connection->get_alpn() != "h2") {
+            close(boost::asio::error::no_protocol_option);
+        }
+        else {
+            start();
+        }
+    }
+
+    void client_session::adopt(connection::server_connection &established) {
+        connection = std::make_shared<connection::server_connection>(ioc);
+        connection->take_over(established);
+        start();
+    }
+
+    void client_session::start() {
+        ready = true;
+
+        streambuf::mutable_buffers_type preface = queued_frames.prepare(connection_preface.length());
+        queued_frames.commit(boost::asio::buffer_copy(preface, boost::asio::buffer(connection_preface.data(), connection_preface.length())));
+
+        std::string settings;
+        append_setting(settings, setting::enable_push, 0);
+        append_setting(settings, setting::initial_window_size, stream_window_size);
+        append_setting(settings, setting::max_header_list_size, max_header_list_size);
+        queue_frame(frame_type::settings, 0, 0, settings);
+
+        // The connection window can only be changed with a window update
+        queue_window_update(0, connection_window_size - default_window_size);
+        receive_window = connection_window_size;
+
+        open_waiting_streams();
+        send_frames();
+        read_frames();
+    }
+
+    const std::string &client_session::get_host() const {
+        return host;
+    }
+
+    port_t client_session::get_port() const {
+        return port;
+    }
+
+    const std::string &client_session::get_key() const {
+        return key;
+    }
+
+    const tls::openssl::ssl_context_args &client_session::get_tls_args() const {
+        return tls_args;
+    }
+
+    tcp::tls::x509::certificate client_session::get_cert() const {
+        return ready ? connection->get_cert() : tcp::tls::x509::certificate { nullptr };
+    }
+
+    std::vector<tcp::tls::x509::certificate> client_session::get_cert_chain() const {
+        return ready ? connection->get_cert_chain() : std::vector<tcp::tls::x509::certificate> { };
+    }
+
+    bool client_session::connected() const {
+        return ready && !closed;
+    }
+
+    bool client_session::usable() const {
+        return !closed && !goaway_received && next_stream_id <= max_stream_id;
+    }
+
+    std::size_t client_session::load() const {
+        return streams.size() + waiting.size();
+    }
+
+    bool client_session::has_capacity() const {
+        return usable() && load() < max_concurrent_streams;
+    }
+
+    client_stream::ptr client_session::submit(const request &req, bool stream_body) {
+        auto s = std::make_shared<client_stream>();
+
+        const url &target = req.get_target();
+        std::string path = target.full_path();
+        auto &fields = s->request_headers;
+        fields.emplace_back(":method", http::convert::to_string(req.get_method()));
+        fields.emplace_back(":scheme", "https");
+        fields.emplace_back(":authority", req.get_optional_header("Host").value_or(target.netloc.to_host_string()));
+        fields.emplace_back(":path", path.empty() ? "/" : path);
+
+        // Fields named by the Connection header only apply to the connection as well
+        std::vector<std::string> connection_tokens;
+        for (const auto &token : req.get_all_of_header("Connection")) {
+            for (const auto &name : util::string::split_trim(token, ',')) {
+                connection_tokens.push_back(util::string::lowercase(name));
+            }
+        }
+
+        for (const auto &field : req.all_headers()) {
+            std::string name = util::string::lowercase(field.name);
+            if (std::find(connection_specific_headers.begin(), connection_specific_headers.end(), name) != connection_specific_headers.end()
+                || std::find(connection_tokens.begin(), connection_tokens.end(), name) != connection_tokens.end()
+                || (name == "te" && field.value != "trailers")) {
+                continue;
+            }
+            fields.emplace_back(std::move(name), field.value);
+        }
+
+        if (!stream_body) {
+            std::string body = req.get_body();
+            s->request_data.commit(boost::asio::buffer_copy(s->request_data.prepare(body.length()), boost::asio::buffer(body)));
+            s->request_done = true;
+        }
+
+        waiting.push_back(s);
+        open_waiting_streams();
+        send_frames();
+        return s;
+    }
+
+    void client_session::send(const client_stream::ptr &s) {
+        send_frames();
+    }
+
+    void client_session::consume(const client_stream::ptr &s, std::size_t size) {
+        s->response_data.consume(size);
+
+        // Closed streams need no more window
+        if (s->response_done || closed) {
+            return;
+        }
+
+        // Updates are batched, so that small frames do not each get one
+        s->unacknowledged_data += static_cast<std::uint32_t>(size);
+        if (s->unacknowledged_data >= stream_window_size / 2) {
+            queue_window_update(s->id, s->unacknowledged_data);
+            s->receive_window += s->unacknowledged_data;
+            s->unacknowledged_data = 0;
+            send_frames();
+        }
+    }
+
+    void client_session::cancel(const client_stream::ptr &s) {
+        s->cancelled = true;
+        s->clear_callbacks();
+
+        auto it = streams.find(s->id);
+        if (s->id != 0 && it != streams.end() && it->second == s) {
+            reset_stream(s->id, error_type::cancel);
+            streams.erase(it);
+            open_waiting_streams();
+            send_frames();
+        }
+        else {
+            waiting.erase(std::remove(waiting.begin(), waiting.end(), s), waiting.end());
+        }
+
+        if (goaway_received && streams.empty()) {
+            close(boost::asio::error::connection_aborted);
+        }
+    }
+
+    void client_session::open_waiting_streams() {
+        while (ready && usable() && streams.size() < max_concurrent_streams && !waiting.empty()) {
+            client_stream::ptr s = waiting.front();
+            waiting.pop_front();
+            open_stream(s);
+        }
+    }
+
+    void client_session::open_stream(const client_stream::ptr &s) {
+        s->id = next_stream_id;
+        next_stream_id += 2;
+        s->send_window = initial_send_window;
+        s->receive_window = stream_window_size;
+        streams.emplace(s->id, s);
+
+        std::string block;
+        encoder.begin_block(block);
+        for (const auto &[name, value] : s->request_headers) {
+            encoder.encode(name, value, block);
+        }
+        s->request_headers.clear();
+
+        // A request without a body ends with its head
+        bool end_stream = s->request_done && s->request_data.size() == 0;
+        std::size_t pos = 0;
+        do {
+            std::size_t length = std::min<std::size_t>(block.length() - pos, max_send_frame_size);
+            std::uint8_t frame_flags = pos + length == block.length() ? flags::end_headers : 0;
+            if (pos == 0 && end_stream) {
+                frame_flags |= flags::end_stream;
+            }
+            queue_frame(pos == 0 ? frame_type::headers : frame_type::continuation, frame_flags, s->id, { block.data() + pos, length });
+            pos += length;
+        } while (pos < block.length());
+        s->end_stream_sent = end_stream;
+    }
+
+    void client_session::close_stream(const client_stream::ptr &s) {
+        streams.erase(s->id);
+        open_waiting_streams();
+        if (goaway_received && streams.empty()) {
+            close(boost::asio::error::connection_aborted);
+        }
+    }
+
+    void client_session::fail_stream(const client_stream::ptr &s, const boost::system::error_code &error, bool retryable) {
+        auto it = streams.find(s->id);
+        if (s->id != 0 && it != streams.end() && it->second == s) {
+            streams.erase(it);
+        }
+        else {
+            waiting.erase(std::remove(waiting.begin(), waiting.end(), s), waiting.end());
+        }
+
+        // The server may have acted on a request it started answering
+        s->retryable = retryable && !s->head_received;
+        auto handler = std::move(s->on_error);
+        s->clear_callbacks();
+        if (handler) {
+            handler(error);
+        }
+    }
+
+    void client_session::read_frames() {
+        // An unused connection is closed after the idle timeout
+        connection->set_mode(streams.empty() && waiting.empty() ? connection::base_connection::io_mode::idle : connection::base_connection::io_mode::regular);
+        connection->read_async(boost::bind(&client_session::on_read_frames, shared_from_this(),
+            boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+    }
+
+    void client_session::on_read_frames(const boost::system::error_code &error, std::size_t bytes_transferred) {
+        if (closed) {
+            return;
+        }
+        if (error != boost::system::errc::success) {
+            close(error);
+            return;
+        }
+
+        try {
+            handle_frames();
+        }
+        catch (const error::base_exception &ex) {
+            out::debug::log("HTTP/2 error from ", host, ':', port, ": ", ex.what());
+            std::string payload;
+            append_uint32(payload, 0);
+            append_uint32(payload, static_cast<std::uint32_t>(to_error_type(ex.error_code())));
+            queue_frame(frame_type::goaway, 0, 0, payload);
+            close(boost::asio::error::connection_aborted);
+            return;
+        }
+
+        if (!closed) {
+            send_frames();
+            read_frames();
+        }
+    }
+
+    void client_session::handle_frames() {
+        streambuf &input = connection->input_buffer();
+        while (!closed && input.size() >= frame_header::size) {
+            const std::uint8_t *data = static_cast<const std::uint8_t *>(input.data().data());
+            frame_header header = frame_header::parse(data);
+
+            // The maximum frame size is never raised from its default
+            if (header.length > default_max_frame_size) {
+                throw error::http2::frame_size_error_exception { };
+            }
+            if (input.size() < frame_header::size + header.length) {
+                break;
+            }
+
+            handle_frame(header, data + frame_header::size);
+            input.consume(frame_header::size + header.length);
+        }
+    }
+
+    void client_session::handle_frame(const frame_header &header, const std::uint8_t *payload) {
+        // Nothing may come between the frames of a header block
+        if (header_block_stream != 0 && (header.type != frame_type::continuation || header.stream_id != header_block_stream)) {
+            throw error::http2::protocol_error_exception { "Expected CONTINUATION frame" };
+        }
+
+        switch (header.type) {
+            case frame_type::data: on_data_frame(header, payload); break;
+            case frame_type::headers: on_headers_frame(header, payload); break;
+            case frame_type::rst_stream: on_rst_stream_frame(header, payload); break;
+            case frame_type::settings: on_settings_frame(header, payload); break;
+            case frame_type::push_promise:
+                throw error::http2::protocol_error_exception { "Server push is disabled" };
+            case frame_type::ping: on_ping_frame(header, payload); break;
+            case frame_type::goaway: on_goaway_frame(header, payload); break;
+            case frame_type::window_update: on_window_update_frame(header, payload); break;
+            case frame_type::continuation: on_continuation_frame(header, payload); break;
+            // Priorities and unknown frame types are ignored
+            default: break;
+        }
+    }
+
+    void client_session::on_data_frame(const frame_header &header, const std::uint8_t *payload) {
+        if (header.stream_id == 0 || header.stream_id >= next_stream_id) {
+            throw error::http2::protocol_error_exception { "DATA frame on idle stream" };
+        }
+
+        // Padding counts against the flow-control windows as well
+        if (header.length > receive_window) {
+            throw error::http2::flow_control_error_exception { };
+        }
+        receive_window -= header.length;
+
+        // Data is taken out of the connection window as soon as it arrives, since each stream's own window bounds what it holds
+        unacknowledged_data += header.length;
+        if (unacknowledged_data >= connection_window_size / 2) {
+            queue_window_update(0, unacknowledged_data);
+            receive_window += unacknowledged_data;
+            unacknowledged_data = 0;
+        }
+
+        std::size_t offset = 0;
+        std::size_t padding = 0;
+        if (header.has_flag(flags::padded)) {
+            if (header.length == 0) {
+                throw error::http2::frame_size_error_exception { };
+            }
+            padding = payload[0];
+            offset = 1;
+        }
+        if (offset + padding > header.length) {
+            throw error::http2::protocol_error_exception { "Padding is longer than the frame" };
+        }
+
+        // Frames may still arrive for streams that were just cancelled
+        auto it = streams.find(header.stream_id);
+        if (it == streams.end()) {
+            return;
+        }
+
+        client_stream::ptr s = it->second;
+        if (!s->head_received) {
+            reset_stream(s->id, error_type::protocol_error);
+            fail_stream(s, boost::asio::error::connection_reset, false);
+            return;
+        }
+        if (header.length > s->receive_window) {
+            reset_stream(s->id, error_type::flow_control_error);
+            fail_stream(s, boost::asio::error::connection_reset, false);
+            return;
+        }
+        s->receive_window -= header.length;
+
+        std::size_t length = header.length - offset - padding;
+        s->response_data.commit(boost::asio::buffer_copy(s->response_data.prepare(length), boost::asio::buffer(payload + offset, length)));
+
+        // Padding is never consumed by the service, so it is acknowledged right away
+        s->unacknowledged_data += static_cast<std::uint32_t>(offset + padding);
+
+        if (header.has_flag(flags::end_stream)) {
+            s->response_done = true;
+            close_stream(s);
+        }
+
+        auto handler = s->on_response_data;
+        if (handler) {
+            handler();
+        }
+    }
+
+    void client_session::on_headers_frame(const frame_header &header, const std::uint8_t *payload) {
+        if (header.stream_id == 0) {
+            throw error::http2::protocol_error_exception { "HEADERS frame on stream 0" };
+        }
+
+        std::size_t offset = 0;
+        std::size_t padding = 0;
+        if (header.has_flag(flags::padded)) {
+            if (header.length == 0) {
+                throw error::http2::frame_size_error_exception { };
+            }
+            padding = payload[0];
+            offset = 1;
+        }
+        if (header.has_flag(flags::priority)) {
+            offset += 5;
+        }
+        if (offset + padding > header.length) {
+            throw error::http2::protocol_error_exception { "Padding is longer than the frame" };
+        }
+
+        header_block.assign(reinterpret_cast<const char *>(payload + offset), header.length - offset - padding);
+        header_block_stream = header.stream_id;
+        header_block_end_stream = header.has_flag(flags::end_stream);
+        if (header.has_flag(flags::end_headers)) {
+            on_header_block();
+        }
+    }
+
+    void client_session::on_continuation_frame(const frame_header &header, const std::uint8_t *payload) {
+        if (header_block_stream == 0) {
+            throw error::http2::protocol_error_exception { "CONTINUATION frame without a header block" };
+        }
+        header_block.append(reinterpret_cast<const char *>(payload), header.length);
+
+        // Even a compressed block this large could not be accepted
+        if (header_block.length() > 4 * max_header_list_size) {
+            throw error::http2::header_list_too_large_exception { };
+        }
+        if (header.has_flag(flags::end_headers)) {
+            on_header_block();
+        }
+    }
+
+    void client_session::on_header_block() {
+        std::uint32_t stream_id = header_block_stream;
+        header_block_stream = 0;
+
+        // Every block must be decoded to keep the dynamic table in sync, even if the stream is gone
+        hpack::header_list headers;
+        bool too_large = false;
+        try {
+            headers = decoder.decode(header_block, max_header_list_size);
+        }
+        catch (const error::http2::header_list_too_large_exception &) {
+            too_large = true;
+        }
+        header_block.clear();
+
+        auto it = streams.find(stream_id);
+        if (it == streams.end()) {
+            if (stream_id >= next_stream_id) {
+                throw error::http2::protocol_error_exception { "HEADERS frame on idle stream" };
+            }
+            return;
+        }
+
+        client_stream::ptr s = it->second;
+        if (too_large) {
+            reset_stream(s->id, error_type::cancel);
+            fail_stream(s, boost::asio::error::message_size, false);
+            return;
+        }
+
+        // Trailers end the stream, and are dropped since HTTP/1.x clients may not expect them
+        if (s->head_received) {
+            if (!header_block_end_stream) {
+                reset_stream(s->id, error_type::protocol_error);
+                fail_stream(s, boost::asio::error::connection_reset, false);
+                return;
+            }
+            s->response_done = true;
+            close_stream(s);
+            auto handler = s->on_response_data;
+            if (handler) {
+                handler();
+            }
+            return;
+        }
+
+        response res;
+        res.set_version(version::http1_1);
+        try {
+            if (headers.empty() || headers.front().first != ":status") {
+                throw error::http2::malformed_message_exception { "Response has no status" };
+            }
+            res.set_status(http::convert::to_status_from_code(headers.front().second));
+            for (auto field = headers.begin() + 1; field != headers.end(); ++field) {
+                if (field->first.empty() || field->first[0] == ':') {
+                    throw error::http2::malformed_message_exception { "Unexpected pseudo-header field" };
+                }
+                res.add_header(field->first, field->second);
+            }
+        }
+        catch (const error::base_exception &) {
+            reset_stream(s->id, error_type::protocol_error);
+            fail_stream(s, boost::asio::error::connection_reset, false);
+            return;
+        }
+
+        // Interim responses are not passed on, since the request is sent whole
+        if (res.is_1xx()) {
+            return;
+        }
+
+        s->response_head = std::move(res);
+        s->head_received = true;
+        if (header_block_end_stream) {
+            s->response_done = true;
+            close_stream(s);
+        }
+
+        auto head_handler = s->on_response_head;
+        if (head_handler) {
+            head_handler();
+        }
+        if (s->response_done) {
+            auto data_handler = s->on_response_data;
+            if (data_handler) {
+                data_handler();
+            }
+        }
+    }
+
+    void client_session::on_rst_stream_frame(const frame_header &header, const std::uint8_t *payload) {
+        if (header.stream_id == 0 || header.stream_id >= next_stream_id) {
+            throw error::http2::protocol_error_exception { "RST_STREAM frame on idle stream" };
+        }
+        if (header.length != 4) {
+            throw error::http2::frame_size_error_exception { };
+        }
+
+        auto it = streams.find(header.stream_id);
+        if (it != streams.end()) {
+            // A refused stream was never processed by the server
+            bool refused = static_cast<error_type>(read_uint32(payload)) == error_type::refused_stream;
+            fail_stream(it->second, boost::asio::error::connection_reset, refused);
+        }
+    }
+
+    void client_session::on_settings_frame(const frame_header &header, const std::uint8_t *payload) {
+        if (header.stream_id != 0) {
+            throw error::http2::protocol_error_exception { "SETTINGS frame on a stream" };
+        }
+        if (header.has_flag(flags::ack)) {
+            if (header.length != 0) {
+                throw error::http2::frame_size_error_exception { };
+            }
+            return;
+        }
+        if (header.length % 6 != 0) {
+            throw error::http2::frame_size_error_exception { };
+        }
+
+        for (std::size_t pos = 0; pos < header.length; pos += 6) {
+            std::uint16_t id = static_cast<std::uint16_t>((payload[pos] << 8) | payload[pos + 1]);
+            std::uint32_t value = read_uint32(payload + pos + 2);
+            switch (static_cast<setting>(id)) {
+                case setting::header_table_size:
+                    encoder.set_allowed_table_size(value);
+                    break;
+                case setting::max_concurrent_streams:
+                    max_concurrent_streams = value;
+                    break;
+                case setting::initial_window_size: {
+                    if (value > max_window_size) {
+                        throw error::http2::flow_control_error_exception { };
+                    }
+                    // Changes every open stream's window by the difference
+                    std::int64_t delta = static_cast<std::int64_t>(value) - initial_send_window;
+                    for (auto &[stream_id, s] : streams) {
+                        s->send_window += delta;
+                        if (s->send_window > max_window_size) {
+                            throw error::http2::flow_control_error_exception { };
+                        }
+                    }
+                    initial_send_window = value;
+                    break;
+                }
+                case setting::max_frame_size:
+                    if (value < default_max_frame_size || value > max_frame_size_limit) {
+                        throw error::http2::protocol_error_exception { "Invalid SETTINGS_MAX_FRAME_SIZE value" };
+                    }
+                    max_send_frame_size = value;
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        queue_frame(frame_type::settings, flags::ack, 0, { });
+
+        // The server may have raised its concurrency limit
+        open_waiting_streams();
+    }
+
+    void client_session::on_ping_frame(const frame_header &header, const std::uint8_t *payload) {
+        if (header.stream_id != 0) {
+            throw error::http2::protocol_error_exception { "PING frame on a stream" };
+        }
+        if (header.length != 8) {
+            throw error::http2::frame_size_error_exception { };
+        }
+        if (!header.has_flag(flags::ack)) {
+            queue_frame(frame_type::ping, flags::ack, 0, { reinterpret_cast<const char *>(payload), 8 });
+        }
+    }
+
+    void client_session::on_goaway_frame(const frame_header &header, const std::uint8_t *payload) {
+        if (header.stream_id != 0) {
+            throw error::http2::protocol_error_exception { "GOAWAY frame on a stream" };
+        }
+        if (header.length < 8) {
+            throw error::http2::frame_size_error_exception { };
+        }
+
+        goaway_received = true;
+        std::uint32_t last_stream_id = read_uint32(payload) & max_stream_id;
+
+        // Streams the server did not get to can be sent again on another connection
+        std::vector<client_stream::ptr> unprocessed;
+        for (auto &[stream_id, s] : streams) {
+            if (stream_id > last_stream_id) {
+                unprocessed.push_back(s);
+            }
+        }
+        unprocessed.insert(unprocessed.end(), waiting.begin(), waiting.end());
+        for (const auto &s : unprocessed) {
+            fail_stream(s, boost::asio::error::connection_aborted, true);
+        }
+
+        if (streams.empty()) {
+            close(boost::asio::error::connection_aborted);
+        }
+    }
+
+    void client_session::on_window_update_frame(const frame_header &header, const std::uint8_t *payload) {
+        if (header.length != 4) {
+            throw error::http2::frame_size_error_exception { };
+        }
+        std::uint32_t increment = read_uint32(payload) & max_stream_id;
+
+        if (header.stream_id == 0) {
+            if (increment == 0) {
+                throw error::http2::protocol_error_exception { "Window update of 0" };
+            }
+            send_window += increment;
+            if (send_window > max_window_size) {
+                throw error::http2::flow_control_error_exception { };
+            }
+            return;
+        }
+
+        // Updates may still arrive for streams that have just been closed
+        auto it = streams.find(header.stream_id);
+        if (it == streams.end()) {
+            return;
+        }
+
+        client_stream::ptr s = it->second;
+        s->send_window += increment;
+        if (increment == 0 || s->send_window > max_window_size) {
+            reset_stream(s->id, increment == 0 ? error_type::protocol_error : error_type::flow_control_error);
+            fail_stream(s, boost::asio::error::connection_reset, false);
+        }
+    }
+
+    void client_session::queue_frame(frame_type type, std::uint8_t flags, std::uint32_t stream_id, std::string_view payload) {
+        frame_header { static_cast<std::uint32_t>(payload.length()), type, flags, stream_id }.write(queued_frames);
+        queued_frames.commit(boost::asio::buffer_copy(queued_frames.prepare(payload.length()), boost::asio::buffer(payload)));
+    }
+
+    void client_session::queue_window_update(std::uint32_t stream_id, std::uint32_t increment) {
+        std::string payload;
+        append_uint32(payload, increment);
+        queue_frame(frame_type::window_update, 0, stream_id, payload);
+    }
+
+    void client_session::reset_stream(std::uint32_t stream_id, error_type code) {
+        std::string payload;
+        append_uint32(payload, static_cast<std::uint32_t>(code));
+        queue_frame(frame_type::rst_stream, 0, stream_id, payload);
+    }
+
+    void client_session::send_frames() {
+        // Frames are sent once the connection is ready and the write in progress finishes
+        if (!ready || writing || closed) {
+            return;
+        }
+
+        streambuf &output = connection->output_buffer();
+        output.commit(boost::asio::buffer_copy(output.prepare(queued_frames.size()), queued_frames.data()));
+        queued_frames.consume(queued_frames.size());
+
+        // Streams take turns sending one frame at a time, as far as the flow-control windows allow
+        bool sent = true;
+        while (sent) {
+            sent = false;
+            for (auto &[stream_id, s] : streams) {
+                if (s->end_stream_sent) {
+                    continue;
+                }
+
+                // The body ended after everything before it was sent
+                if (s->request_done && s->request_data.size() == 0) {
+                    frame_header { 0, frame_type::data, flags::end_stream, stream_id }.write(output);
+                    s->end_stream_sent = true;
+                    continue;
+                }
+
+                std::size_t length = std::min<std::size_t>({ s->request_data.size(), static_cast<std::size_t>(std::max<std::int64_t>(send_window, 0)),
+                    static_cast<std::size_t>(std::max<std::int64_t>(s->send_window, 0)), max_send_frame_size });
+                if (length == 0) {
+                    continue;
+                }
+
+                bool last = s->request_done && length == s->request_data.size();
+                frame_header { static_cast<std::uint32_t>(length), frame_type::data, last ? flags::end_stream : std::uint8_t(0), stream_id }.write(output);
+                output.commit(boost::asio::buffer_copy(output.prepare(length), s->request_data.data(), length));
+                s->request_data.consume(length);
+
+                send_window -= length;
+                s->send_window -= length;
+                s->end_stream_sent = last;
+                sent = true;
+            }
+        }
+
+        if (output.size() == 0) {
+            return;
+        }
+
+        writing = true;
+        connection->write_async(boost::bind(&client_session::on_send_frames, shared_from_this(),
+            boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+    }
+
+    void client_session::on_send_frames(const boost::system::error_code &error, std::size_t bytes_transferred) {
+        writing = false;
+        if (closed) {
+            return;
+        }
+        if (error != boost::system::errc::success) {
+            close(error);
+            return;
+        }
+
+        // Services streaming a request body read more once what they gave has been sent
+        std::vector<client_stream::ptr> drained;
+        for (auto &[stream_id, s] : streams) {
+            if (!s->request_done && s->request_data.size() == 0 && s->on_request_data_sent) {
+                drained.push_back(s);
+            }
+        }
+        for (const auto &s : drained) {
+            auto handler = s->on_request_data_sent;
+            if (handler) {
+                handler();
+            }
+        }
+
+        send_frames();
+    }
+
+    void client_session::close(const boost::system::error_code &error) {
+        if (closed) {
+            return;
+        }
+
+        // The pool may hold the last reference
+        ptr self = shared_from_this();
+
+        // A queued GOAWAY frame is sent on a best-effort basis before the connection goes
+        if (ready && !writing && queued_frames.size() != 0) {
+            streambuf &output = connection->output_buffer();
+            output.commit(boost::asio::buffer_copy(output.prepare(queued_frames.size()), queued_frames.data()));
+            boost::system::error_code write_error;
+            connection->write(write_error);
+        }
+
+        closed = true;
+        boost::asio::use_service<session_pool>(ioc).remove(*this);
+
+        // Requests that never reached the server can be sent again
+        std::vector<client_stream::ptr> failed;
+        for (auto &[stream_id, s] : streams) {
+            failed.push_back(s);
+        }
+        failed.insert(failed.end(), waiting.begin(), waiting.end());
+        for (const auto &s : failed) {
+            fail_stream(s, error, !ready || s->id == 0);
+        }
+
+        if (connection) {
+            connection->disconnect();
+        }
+    }
+}
\ No newline at end of file
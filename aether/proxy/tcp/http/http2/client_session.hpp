@@ -0,0 +1,212 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <deque>
+#include <map>
+#include <memory>
+#include <string>
+#include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <aether/proxy/types.hpp>
+#include <aether/proxy/connection/server_connection.hpp>
+#include <aether/proxy/tcp/http/message/request.hpp>
+#include <aether/proxy/tcp/http/http2/frame.hpp>
+#include <aether/proxy/tcp/http/http2/client_stream.hpp>
+#include <aether/proxy/tcp/http/http2/hpack/decoder.hpp>
+#include <aether/proxy/tcp/http/http2/hpack/encoder.hpp>
+#include <aether/proxy/tcp/tls/openssl/ssl_context.hpp>
+
+namespace proxy::tcp::http::http2 {
+    /*
+        An HTTP/2 connection to a server, shared by every flow on the same io_context that
+            sends requests to that server.
+        Each request is a stream, and streams beyond the server's concurrency limit wait
+            until an earlier one finishes.
+        Kept alive by the session pool and by its own pending operations.
+    */
+    class client_session
+        : public std::enable_shared_from_this<client_session>,
+        private boost::noncopyable {
+    public:
+        using ptr = std::shared_ptr<client_session>;
+
+        static constexpr std::uint32_t connection_window_size = 16 * 1024 * 1024;
+        static constexpr std::uint32_t stream_window_size = 1024 * 1024;
+        static constexpr std::uint32_t max_header_list_size = 64 * 1024;
+
+        // Assumed until the server says otherwise, since the protocol default is unlimited
+        static constexpr std::size_t default_max_concurrent_streams = 100;
+
+    private:
+        boost::asio::io_context &ioc;
+        std::shared_ptr<connection::server_connection> connection;
+
+        std::string host;
+        port_t port;
+        std::string key;
+
+        // Parameters the connection was secured with, kept so the pool can open another like it
+        tls::openssl::ssl_context_args tls_args;
+
+        hpack::decoder decoder;
+        hpack::encoder encoder;
+
+        std::map<std::uint32_t, client_stream::ptr> streams;
+        // Streams that cannot be opened yet, because of the server's concurrency limit or because the connection is not ready
+        std::deque<client_stream::ptr> waiting;
+        std::uint32_t next_stream_id;
+
+        // Header block being collected from a HEADERS frame and its CONTINUATION frames
+        std::uint32_t header_block_stream;
+        bool header_block_end_stream;
+        std::string header_block;
+
+        // Settings sent by the server
+        std::size_t max_concurrent_streams;
+        std::int64_t initial_send_window;
+        std::uint32_t max_send_frame_size;
+
+        // Flow-control windows for the whole connection
+        std::int64_t send_window;
+        std::int64_t receive_window;
+        std::uint32_t unacknowledged_data;
+
+        streambuf queued_frames;
+
+        bool ready;
+        bool writing;
+        bool goaway_received;
+        bool closed;
+
+        void on_connect(const boost::system::error_code &error);
+        void on_establish_tls(const boost::system::error_code &error);
+
+        /*
+            Sends the connection preface and settings, then starts reading frames.
+        */
+        void start();
+
+        void read_frames();
+        void on_read_frames(const boost::system::error_code &error, std::size_t bytes_transferred);
+
+        /*
+            Handles every complete frame in the input buffer.
+            Throws an HTTP/2 exception for errors that affect the whole connection.
+        */
+        void handle_frames();
+        void handle_frame(const frame_header &header, const std::uint8_t *payload);
+        void on_data_frame(const frame_header &header, const std::uint8_t *payload);
+        void on_headers_frame(const frame_header &header, const std::uint8_t *payload);
+        void on_continuation_frame(const frame_header &header, const std::uint8_t *payload);
+        void on_rst_stream_frame(const frame_header &header, const std::uint8_t *payload);
+        void on_settings_frame(const frame_header &header, const std::uint8_t *payload);
+        void on_ping_frame(const frame_header &header, const std::uint8_t *payload);
+        void on_goaway_frame(const frame_header &header, const std::uint8_t *payload);
+        void on_window_update_frame(const frame_header &header, const std::uint8_t *payload);
+
+        /*
+            Decodes a complete header block, which is either a response head or trailers.
+        */
+        void on_header_block();
+
+        /*
+            Opens waiting streams while the server's concurrency limit allows it.
+        */
+        void open_waiting_streams();
+        void open_stream(const client_stream::ptr &s);
+
+        /*
+            Removes a stream that has finished or failed.
+        */
+        void close_stream(const client_stream::ptr &s);
+        void fail_stream(const client_stream::ptr &s, const boost::system::error_code &error, bool retryable);
+
+        void queue_frame(frame_type type, std::uint8_t flags, std::uint32_t stream_id, std::string_view payload);
+        void queue_window_update(std::uint32_t stream_id, std::uint32_t increment);
+        void reset_stream(std::uint32_t stream_id, error_type code);
+
+        /*
+            Writes queued frames and as much request data as the flow-control windows allow.
+        */
+        void send_frames();
+        void on_send_frames(const boost::system::error_code &error, std::size_t bytes_transferred);
+
+        /*
+            Closes the connection and fails every stream.
+        */
+        void close(const boost::system::error_code &error);
+
+    public:
+        client_session(boost::asio::io_context &ioc, const std::string &host, port_t port, const tls::openssl::ssl_context_args &tls_args);
+
+        /*
+            Opens a new connection to the server.
+            Streams submitted in the meantime wait until it is ready.
+        */
+        void connect();
+
+        /*
+            Takes over a connection that has already negotiated HTTP/2 with the server.
+        */
+        void adopt(connection::server_connection &established);
+
+        const std::string &get_host() const;
+        port_t get_port() const;
+        const std::string &get_key() const;
+        const tls::openssl::ssl_context_args &get_tls_args() const;
+
+        /*
+            Returns the server certificate, or an empty certificate while connecting.
+        */
+        tcp::tls::x509::certificate get_cert() const;
+        std::vector<tcp::tls::x509::certificate> get_cert_chain() const;
+
+        /*
+            Returns if the connection to the server is established and still open.
+        */
+        bool connected() const;
+
+        /*
+            Returns if new streams can still be submitted.
+        */
+        bool usable() const;
+
+        /*
+            Returns the number of streams open or waiting.
+        */
+        std::size_t load() const;
+
+        /*
+            Returns if a new stream would be opened right away.
+        */
+        bool has_capacity() const;
+
+        /*
+            Submits a request, translating its fields and leaving out those that only apply to HTTP/1.x connections.
+            A streamed body is sent from the stream's request data as it is added, otherwise the request's own body is sent.
+        */
+        client_stream::ptr submit(const request &req, bool stream_body);
+
+        /*
+            Sends request data that was added to the stream.
+        */
+        void send(const client_stream::ptr &s);
+
+        /*
+            Takes response data out of the stream, letting the server send more.
+        */
+        void consume(const client_stream::ptr &s, std::size_t size);
+
+        /*
+            Abandons a stream, telling the server to stop if it is still open.
+        */
+        void cancel(const client_stream::ptr &s);
+    };
+}
\ No newline at end of file
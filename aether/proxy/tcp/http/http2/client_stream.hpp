@@ -0,0 +1,98 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+
+#include <aether/proxy/types.hpp>
+#include <aether/proxy/tcp/http/message/response.hpp>
+
+namespace proxy::tcp::http::http2 {
+    /*
+        One request sent to a server over a shared HTTP/2 connection, and the response to it.
+        Owned by the service that opened it, which is told about progress through the callbacks.
+        Callbacks run on the connection's io_context, and are cleared when the stream is cancelled.
+    */
+    struct client_stream
+        : private boost::noncopyable {
+        using ptr = std::shared_ptr<client_stream>;
+        using error_callback = std::function<void(const boost::system::error_code &)>;
+
+        // Assigned once the stream is opened on the connection
+        std::uint32_t id;
+
+        // Request fields in HTTP/2 form, pseudo-header fields first
+        std::vector<std::pair<std::string, std::string>> request_headers;
+
+        // Request body waiting to be sent
+        streambuf request_data;
+        // The whole request body is in request_data
+        bool request_done;
+        // The final frame of the request has been sent
+        bool end_stream_sent;
+
+        response response_head;
+        bool head_received;
+
+        // Response body received and not yet consumed
+        streambuf response_data;
+        bool response_done;
+
+        std::int64_t send_window;
+        std::int64_t receive_window;
+        // Response body consumed but not yet acknowledged with a window update
+        std::uint32_t unacknowledged_data;
+
+        // The stream failed before the server could have processed the request, so it can be sent again
+        bool retryable;
+        bool cancelled;
+
+        // Called when the final response head has been received
+        callback on_response_head;
+        // Called whenever response data is received, and once more when the response ends
+        callback on_response_data;
+        // Called when everything in request_data has been sent
+        callback on_request_data_sent;
+        // Called if the stream fails, after which no other callback runs
+        error_callback on_error;
+
+        client_stream()
+            : id(0),
+            request_headers(),
+            request_data(),
+            request_done(false),
+            end_stream_sent(false),
+            response_head(),
+            head_received(false),
+            response_data(),
+            response_done(false),
+            send_window(0),
+            receive_window(0),
+            unacknowledged_data(0),
+            retryable(false),
+            cancelled(false)
+        { }
+
+        /*
+            Drops every callback, so the stream no longer refers to the service that owns it.
+        */
+        void clear_callbacks() {
+            on_response_head = nullptr;
+            on_response_data = nullptr;
+            on_request_data_sent = nullptr;
+            on_error = nullptr;
+        }
+    };
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "frame.hpp"
+
+namespace proxy::tcp::http::http2 {
+    frame_header frame_header::parse(const std::uint8_t *data) {
+        frame_header header;
+        header.length = (static_cast<std::uint32_t>(data[0]) << 16) | (static_cast<std::uint32_t>(data[1]) << 8) | data[2];
+        header.type = static_cast<frame_type>(data[3]);
+        header.flags = data[4];
+        header.stream_id = ((static_cast<std::uint32_t>(data[5]) << 24) | (static_cast<std::uint32_t>(data[6]) << 16)
+            | (static_cast<std::uint32_t>(data[7]) << 8) | data[8]) & 0x7fffffff;
+        return header;
+    }
+
+    void frame_header::write(streambuf &out) const {
+        std::uint8_t *data = static_cast<std::uint8_t *>(out.prepare(size).data());
+        data[0] = static_cast<std::uint8_t>(length >> 16);
+        data[1] = static_cast<std::uint8_t>(length >> 8);
+        data[2] = static_cast<std::uint8_t>(length);
+        data[3] = static_cast<std::uint8_t>(type);
+        data[4] = flags;
+        data[5] = static_cast<std::uint8_t>(stream_id >> 24) & 0x7f;
+        data[6] = static_cast<std::uint8_t>(stream_id >> 16);
+        data[7] = static_cast<std::uint8_t>(stream_id >> 8);
+        data[8] = static_cast<std::uint8_t>(stream_id);
+        out.commit(size);
+    }
+
+    namespace convert {
+        std::string_view to_string(frame_type type) {
+            switch (type) {
+#define X(name, num, string) case frame_type::name: return string;
+                HTTP2_FRAME_TYPES(X)
+#undef X
+            }
+            return "UNKNOWN";
+        }
+
+        std::string_view to_string(error_type code) {
+            switch (code) {
+#define X(num, name, string) case error_type::name: return string;
+                HTTP2_ERROR_CODES(X)
+#undef X
+            }
+            return "UNKNOWN";
+        }
+    }
+
+    std::ostream &operator<<(std::ostream &output, frame_type type) {
+        output << convert::to_string(type);
+        return output;
+    }
+
+    std::ostream &operator<<(std::ostream &output, error_type code) {
+        output << convert::to_string(code);
+        return output;
+    }
+}
\ No newline at end of file
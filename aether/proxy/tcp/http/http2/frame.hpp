@@ -0,0 +1,145 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <string_view>
+
+#include <aether/proxy/types.hpp>
+
+#define HTTP2_FRAME_TYPES(X) \
+X(data, 0x0, "DATA") \
+X(headers, 0x1, "HEADERS") \
+X(priority, 0x2, "PRIORITY") \
+X(rst_stream, 0x3, "RST_STREAM") \
+X(settings, 0x4, "SETTINGS") \
+X(push_promise, 0x5, "PUSH_PROMISE") \
+X(ping, 0x6, "PING") \
+X(goaway, 0x7, "GOAWAY") \
+X(window_update, 0x8, "WINDOW_UPDATE") \
+X(continuation, 0x9, "CONTINUATION")
+
+#define HTTP2_ERROR_CODES(X) \
+X(0x0, no_error, "NO_ERROR") \
+X(0x1, protocol_error, "PROTOCOL_ERROR") \
+X(0x2, internal_error, "INTERNAL_ERROR") \
+X(0x3, flow_control_error, "FLOW_CONTROL_ERROR") \
+X(0x4, settings_timeout, "SETTINGS_TIMEOUT") \
+X(0x5, stream_closed, "STREAM_CLOSED") \
+X(0x6, frame_size_error, "FRAME_SIZE_ERROR") \
+X(0x7, refused_stream, "REFUSED_STREAM") \
+X(0x8, cancel, "CANCEL") \
+X(0x9, compression_error, "COMPRESSION_ERROR") \
+X(0xa, connect_error, "CONNECT_ERROR") \
+X(0xb, enhance_your_calm, "ENHANCE_YOUR_CALM") \
+X(0xc, inadequate_security, "INADEQUATE_SECURITY") \
+X(0xd, http_1_1_required, "HTTP_1_1_REQUIRED")
+
+#define HTTP2_SETTINGS(X) \
+X(0x1, header_table_size) \
+X(0x2, enable_push) \
+X(0x3, max_concurrent_streams) \
+X(0x4, initial_window_size) \
+X(0x5, max_frame_size) \
+X(0x6, max_header_list_size)
+
+namespace proxy::tcp::http::http2 {
+    /*
+        Enumeration type for HTTP/2 frame types.
+    */
+    enum class frame_type : std::uint8_t {
+#define X(name, num, string) name = num,
+        HTTP2_FRAME_TYPES(X)
+#undef X
+    };
+
+    /*
+        Enumeration type for the error codes carried by RST_STREAM and GOAWAY frames.
+    */
+    enum class error_type : std::uint32_t {
+#define X(num, name, string) name = num,
+        HTTP2_ERROR_CODES(X)
+#undef X
+    };
+
+    /*
+        Enumeration type for SETTINGS frame parameters.
+    */
+    enum class setting : std::uint16_t {
+#define X(num, name) name = num,
+        HTTP2_SETTINGS(X)
+#undef X
+    };
+
+    /*
+        Flags that may be set on a frame.
+        Their meaning depends on the frame type.
+    */
+    namespace flags {
+        constexpr std::uint8_t end_stream = 0x1;
+        constexpr std::uint8_t ack = 0x1;
+        constexpr std::uint8_t end_headers = 0x4;
+        constexpr std::uint8_t padded = 0x8;
+        constexpr std::uint8_t priority = 0x20;
+    }
+
+    /*
+        Sequence every client starts its connection with, before its first SETTINGS frame.
+    */
+    constexpr std::string_view connection_preface = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+    // Limits defined by the protocol
+    constexpr std::uint32_t default_window_size = 65535;
+    constexpr std::uint32_t max_window_size = 0x7fffffff;
+    constexpr std::uint32_t default_max_frame_size = 16384;
+    constexpr std::uint32_t max_frame_size_limit = 0xffffff;
+    constexpr std::uint32_t default_header_table_size = 4096;
+
+    /*
+        Data structure for the fixed 9-byte header that starts every HTTP/2 frame.
+    */
+    struct frame_header {
+        static constexpr std::size_t size = 9;
+
+        std::uint32_t length;
+        frame_type type;
+        std::uint8_t flags;
+        std::uint32_t stream_id;
+
+        constexpr bool has_flag(std::uint8_t flag) const {
+            return (flags & flag) != 0;
+        }
+
+        /*
+            Reads a frame header from the first 9 bytes of the given data.
+            The reserved bit of the stream identifier is ignored.
+        */
+        static frame_header parse(const std::uint8_t *data);
+
+        /*
+            Writes the frame header to the buffer.
+        */
+        void write(streambuf &out) const;
+    };
+
+    namespace convert {
+        /*
+            Converts an HTTP/2 frame type to string.
+        */
+        std::string_view to_string(frame_type type);
+
+        /*
+            Converts an HTTP/2 error code to string.
+        */
+        std::string_view to_string(error_type code);
+    }
+
+    std::ostream &operator<<(std::ostream &output, frame_type type);
+    std::ostream &operator<<(std::ostream &output, error_type code);
+}
\ No newline at end of file
@@ -0,0 +1,128 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "decoder.hpp"
+#include "huffman.hpp"
+
+#include <limits>
+
+namespace proxy::tcp::http::http2::hpack {
+    decoder::decoder(std::size_t allowed_table_size)
+        : table(allowed_table_size),
+        allowed_table_size(allowed_table_size)
+    { }
+
+    std::size_t decoder::decode_integer(const std::uint8_t *&pos, const std::uint8_t *end, std::size_t prefix_bits) {
+        if (pos == end) {
+            throw error::http2::compression_error_exception { "Header block ended in the middle of an integer" };
+        }
+
+        std::size_t prefix_max = (std::size_t(1) << prefix_bits) - 1;
+        std::size_t value = *pos++ & prefix_max;
+        if (value < prefix_max) {
+            return value;
+        }
+
+        // No field in a valid block needs more than 32 bits
+        std::size_t shift = 0;
+        while (true) {
+            if (pos == end) {
+                throw error::http2::compression_error_exception { "Header block ended in the middle of an integer" };
+            }
+            std::uint8_t byte = *pos++;
+            value += static_cast<std::size_t>(byte & 0x7f) << shift;
+            shift += 7;
+            if (shift > 35 || value > std::numeric_limits<std::uint32_t>::max()) {
+                throw error::http2::compression_error_exception { "Integer is too large" };
+            }
+            if ((byte & 0x80) == 0) {
+                return value;
+            }
+        }
+    }
+
+    std::string decoder::decode_string(const std::uint8_t *&pos, const std::uint8_t *end) {
+        if (pos == end) {
+            throw error::http2::compression_error_exception { "Header block ended before a string" };
+        }
+        bool huffman_encoded = (*pos & 0x80) != 0;
+        std::size_t length = decode_integer(pos, end, 7);
+        if (length > static_cast<std::size_t>(end - pos)) {
+            throw error::http2::compression_error_exception { "String is longer than the header block" };
+        }
+
+        std::string_view raw { reinterpret_cast<const char *>(pos), length };
+        pos += length;
+
+        std::string result;
+        if (huffman_encoded) {
+            result.reserve(length * 8 / 5);
+            huffman::decode(raw, result);
+        }
+        else {
+            result.assign(raw);
+        }
+        return result;
+    }
+
+    header_list decoder::decode(std::string_view block, std::size_t max_list_size) {
+        header_list headers;
+        std::size_t list_size = 0;
+        bool fields_started = false;
+
+        const std::uint8_t *pos = reinterpret_cast<const std::uint8_t *>(block.data());
+        const std::uint8_t *end = pos + block.size();
+        while (pos != end) {
+            std::uint8_t first = *pos;
+            std::string name;
+            std::string value;
+
+            // Indexed header field
+            if (first & 0x80) {
+                auto field = table.get(decode_integer(pos, end, 7));
+                name.assign(field.first);
+                value.assign(field.second);
+            }
+            // Literal header field with incremental indexing
+            else if (first & 0x40) {
+                std::size_t index = decode_integer(pos, end, 6);
+                name = index == 0 ? decode_string(pos, end) : std::string(table.get(index).first);
+                value = decode_string(pos, end);
+                table.insert(name, value);
+            }
+            // Dynamic table size update
+            else if (first & 0x20) {
+                if (fields_started) {
+                    throw error::http2::compression_error_exception { "Dynamic table size update after the first header field" };
+                }
+                std::size_t size = decode_integer(pos, end, 5);
+                if (size > allowed_table_size) {
+                    throw error::http2::compression_error_exception { "Dynamic table size update exceeds the advertised limit" };
+                }
+                table.set_maximum_size(size);
+                continue;
+            }
+            // Literal header field without indexing or never indexed
+            else {
+                std::size_t index = decode_integer(pos, end, 4);
+                name = index == 0 ? decode_string(pos, end) : std::string(table.get(index).first);
+                value = decode_string(pos, end);
+            }
+
+            fields_started = true;
+            list_size += name.length() + value.length() + header_table::entry_overhead;
+            if (list_size <= max_list_size) {
+                headers.emplace_back(std::move(name), std::move(value));
+            }
+        }
+
+        if (list_size > max_list_size) {
+            throw error::http2::header_list_too_large_exception { };
+        }
+        return headers;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <boost/noncopyable.hpp>
+
+#include <aether/proxy/error/exceptions.hpp>
+#include <aether/proxy/tcp/http/http2/hpack/header_table.hpp>
+
+namespace proxy::tcp::http::http2::hpack {
+    using header_list = std::vector<std::pair<std::string, std::string>>;
+
+    /*
+        Stateful decoder for the header blocks one endpoint sends over a connection.
+        Blocks must be decoded in the order they were received, since each one may change
+            the dynamic table the ones after it refer to.
+    */
+    class decoder
+        : private boost::noncopyable {
+    private:
+        header_table table;
+
+        // Largest dynamic table the peer is allowed to use, as advertised in our settings
+        std::size_t allowed_table_size;
+
+        static std::size_t decode_integer(const std::uint8_t *&pos, const std::uint8_t *end, std::size_t prefix_bits);
+        static std::string decode_string(const std::uint8_t *&pos, const std::uint8_t *end);
+
+    public:
+        explicit decoder(std::size_t allowed_table_size);
+
+        /*
+            Decodes a complete header block.
+            Throws a compression error if the block is malformed, which leaves the decoder unusable.
+            A header list larger than the given limit throws only after the whole block is decoded,
+                so the dynamic table stays in sync with the peer's.
+        */
+        header_list decode(std::string_view block, std::size_t max_list_size);
+    };
+}
\ No newline at end of file
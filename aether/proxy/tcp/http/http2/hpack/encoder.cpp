@@ -0,0 +1,112 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "encoder.hpp"
+#include "huffman.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace proxy::tcp::http::http2::hpack {
+    encoder::encoder()
+        : table(preferred_table_size),
+        smallest_size_update(),
+        final_size_update()
+    { }
+
+    void encoder::encode_integer(std::size_t value, std::size_t prefix_bits, std::uint8_t first_byte, std::string &out) {
+        std::size_t prefix_max = (std::size_t(1) << prefix_bits) - 1;
+        if (value < prefix_max) {
+            out.push_back(static_cast<char>(first_byte | value));
+            return;
+        }
+        out.push_back(static_cast<char>(first_byte | prefix_max));
+        value -= prefix_max;
+        while (value >= 0x80) {
+            out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    void encoder::encode_string(std::string_view str, std::string &out) {
+        std::size_t huffman_size = huffman::encoded_size(str);
+        if (huffman_size < str.length()) {
+            encode_integer(huffman_size, 7, 0x80, out);
+            huffman::encode(str, out);
+        }
+        else {
+            encode_integer(str.length(), 7, 0x00, out);
+            out.append(str);
+        }
+    }
+
+    bool encoder::should_index(std::string_view name) {
+        static constexpr std::array<std::string_view, 7> unique_per_response = {
+            "content-length",
+            "date",
+            "etag",
+            "last-modified",
+            "age",
+            "expires",
+            "content-range"
+        };
+        return std::find(unique_per_response.begin(), unique_per_response.end(), name) == unique_per_response.end();
+    }
+
+    bool encoder::is_sensitive(std::string_view name) {
+        return name == "set-cookie" || name == "authorization" || name == "proxy-authorization" || name == "cookie";
+    }
+
+    void encoder::set_allowed_table_size(std::size_t size) {
+        std::size_t new_size = std::min(size, preferred_table_size);
+        std::size_t current = final_size_update.value_or(table.maximum());
+        if (new_size == current) {
+            return;
+        }
+        smallest_size_update = std::min(smallest_size_update.value_or(new_size), new_size);
+        final_size_update = new_size;
+    }
+
+    void encoder::begin_block(std::string &out) {
+        if (!final_size_update.has_value()) {
+            return;
+        }
+        // The peer must see the table shrink as far as it did before it grows again
+        if (*smallest_size_update < *final_size_update) {
+            table.set_maximum_size(*smallest_size_update);
+            encode_integer(*smallest_size_update, 5, 0x20, out);
+        }
+        table.set_maximum_size(*final_size_update);
+        encode_integer(*final_size_update, 5, 0x20, out);
+        smallest_size_update.reset();
+        final_size_update.reset();
+    }
+
+    void encoder::encode(std::string_view name, std::string_view value, std::string &out) {
+        auto match = table.find(name, value);
+        if (is_sensitive(name)) {
+            encode_integer(match.index, 4, 0x10, out);
+        }
+        else if (match.value_matches) {
+            encode_integer(match.index, 7, 0x80, out);
+            return;
+        }
+        else if (should_index(name)) {
+            encode_integer(match.index, 6, 0x40, out);
+            table.insert(name, value);
+        }
+        else {
+            encode_integer(match.index, 4, 0x00, out);
+        }
+
+        if (match.index == 0) {
+            encode_string(name, out);
+        }
+        encode_string(value, out);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <boost/noncopyable.hpp>
+
+#include <aether/proxy/tcp/http/http2/hpack/header_table.hpp>
+
+namespace proxy::tcp::http::http2::hpack {
+    /*
+        Stateful encoder for the header blocks sent over a connection.
+        Blocks must be sent in the order they were encoded, since each one may change
+            the dynamic table the ones after it refer to.
+    */
+    class encoder
+        : private boost::noncopyable {
+    public:
+        // The encoder never uses more than this for its dynamic table, whatever the peer allows
+        static constexpr std::size_t preferred_table_size = 4096;
+
+    private:
+        header_table table;
+
+        // Table size changes that must be signalled at the start of the next block
+        std::optional<std::size_t> smallest_size_update;
+        std::optional<std::size_t> final_size_update;
+
+        static void encode_integer(std::size_t value, std::size_t prefix_bits, std::uint8_t first_byte, std::string &out);
+        static void encode_string(std::string_view str, std::string &out);
+
+        /*
+            Checks if a field should be kept out of the dynamic table.
+            Values that change with every response would only push out entries that are reused.
+        */
+        static bool should_index(std::string_view name);
+
+        /*
+            Checks if a field must never be indexed by any intermediary, since it holds credentials.
+        */
+        static bool is_sensitive(std::string_view name);
+
+    public:
+        encoder();
+
+        /*
+            Applies the header table size the peer allows.
+        */
+        void set_allowed_table_size(std::size_t size);
+
+        /*
+            Starts a new header block, signalling any change to the dynamic table size.
+        */
+        void begin_block(std::string &out);
+
+        /*
+            Appends one header field to the current block.
+            The name must already be lowercase.
+        */
+        void encode(std::string_view name, std::string_view value, std::string &out);
+    };
+}
\ No newline at end of file
@@ -0,0 +1,157 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "header_table.hpp"
+
+namespace proxy::tcp::http::http2::hpack {
+    // See RFC 7541, Appendix A
+    const std::array<header_table::field, header_table::static_table_size> header_table::static_table = { {
+        { ":authority", "" },
+        { ":method", "GET" },
+        { ":method", "POST" },
+        { ":path", "/" },
+        { ":path", "/index.html" },
+        { ":scheme", "http" },
+        { ":scheme", "https" },
+        { ":status", "200" },
+        { ":status", "204" },
+        { ":status", "206" },
+        { ":status", "304" },
+        { ":status", "400" },
+        { ":status", "404" },
+        { ":status", "500" },
+        { "accept-charset", "" },
+        { "accept-encoding", "gzip, deflate" },
+        { "accept-language", "" },
+        { "accept-ranges", "" },
+        { "accept", "" },
+        { "access-control-allow-origin", "" },
+        { "age", "" },
+        { "allow", "" },
+        { "authorization", "" },
+        { "cache-control", "" },
+        { "content-disposition", "" },
+        { "content-encoding", "" },
+        { "content-language", "" },
+        { "content-length", "" },
+        { "content-location", "" },
+        { "content-range", "" },
+        { "content-type", "" },
+        { "cookie", "" },
+        { "date", "" },
+        { "etag", "" },
+        { "expect", "" },
+        { "expires", "" },
+        { "from", "" },
+        { "host", "" },
+        { "if-match", "" },
+        { "if-modified-since", "" },
+        { "if-none-match", "" },
+        { "if-range", "" },
+        { "if-unmodified-since", "" },
+        { "last-modified", "" },
+        { "link", "" },
+        { "location", "" },
+        { "max-forwards", "" },
+        { "proxy-authenticate", "" },
+        { "proxy-authorization", "" },
+        { "range", "" },
+        { "referer", "" },
+        { "refresh", "" },
+        { "retry-after", "" },
+        { "server", "" },
+        { "set-cookie", "" },
+        { "strict-transport-security", "" },
+        { "transfer-encoding", "" },
+        { "user-agent", "" },
+        { "vary", "" },
+        { "via", "" },
+        { "www-authenticate", "" }
+    } };
+
+    header_table::header_table(std::size_t maximum_size)
+        : entries(),
+        current_size(0),
+        maximum_size(maximum_size)
+    { }
+
+    header_table::field header_table::get(std::size_t index) const {
+        if (index == 0) {
+            throw error::http2::compression_error_exception { "Header field index 0 is not used" };
+        }
+        if (index <= static_table_size) {
+            return static_table[index - 1];
+        }
+        index -= static_table_size + 1;
+        if (index >= entries.size()) {
+            throw error::http2::compression_error_exception { "Header field index is out of range" };
+        }
+        const auto &entry = entries[index];
+        return { entry.first, entry.second };
+    }
+
+    void header_table::evict(std::size_t needed) {
+        while (!entries.empty() && current_size + needed > maximum_size) {
+            const auto &oldest = entries.back();
+            current_size -= oldest.first.length() + oldest.second.length() + entry_overhead;
+            entries.pop_back();
+        }
+    }
+
+    void header_table::insert(std::string_view name, std::string_view value) {
+        std::size_t entry_size = name.length() + value.length() + entry_overhead;
+        if (entry_size > maximum_size) {
+            entries.clear();
+            current_size = 0;
+            return;
+        }
+
+        // The name may refer to an entry that is about to be evicted
+        std::pair<std::string, std::string> entry { name, value };
+        evict(entry_size);
+        entries.push_front(std::move(entry));
+        current_size += entry_size;
+    }
+
+    header_table::match header_table::find(std::string_view name, std::string_view value) const {
+        match result { 0, false };
+        for (std::size_t i = 0; i < static_table_size; ++i) {
+            if (static_table[i].first == name) {
+                if (static_table[i].second == value) {
+                    return { i + 1, true };
+                }
+                if (result.index == 0) {
+                    result.index = i + 1;
+                }
+            }
+        }
+        for (std::size_t i = 0; i < entries.size(); ++i) {
+            if (entries[i].first == name) {
+                if (entries[i].second == value) {
+                    return { static_table_size + i + 1, true };
+                }
+                if (result.index == 0) {
+                    result.index = static_table_size + i + 1;
+                }
+            }
+        }
+        return result;
+    }
+
+    void header_table::set_maximum_size(std::size_t size) {
+        maximum_size = size;
+        evict(0);
+    }
+
+    std::size_t header_table::maximum() const {
+        return maximum_size;
+    }
+
+    std::size_t header_table::size() const {
+        return current_size;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <array>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <aether/proxy/error/exceptions.hpp>
+
+namespace proxy::tcp::http::http2::hpack {
+    /*
+        The combined static and dynamic header tables of one HPACK context.
+        Index 1 is the first entry of the static table, and the dynamic table follows it,
+            newest entry first.
+    */
+    class header_table {
+    public:
+        using field = std::pair<std::string_view, std::string_view>;
+
+        // Every entry counts its name, its value, and this overhead against the table size
+        static constexpr std::size_t entry_overhead = 32;
+        static constexpr std::size_t static_table_size = 61;
+        static const std::array<field, static_table_size> static_table;
+
+        /*
+            Result of searching the tables for a header field.
+            An index of 0 means the name was not found at all.
+        */
+        struct match {
+            std::size_t index;
+            bool value_matches;
+        };
+
+    private:
+        std::deque<std::pair<std::string, std::string>> entries;
+        std::size_t current_size;
+        std::size_t maximum_size;
+
+        /*
+            Evicts the oldest entries until the table can hold the given number of additional bytes.
+        */
+        void evict(std::size_t needed);
+
+    public:
+        explicit header_table(std::size_t maximum_size);
+
+        /*
+            Returns the field at the given index.
+            Throws if the index is not in either table.
+        */
+        field get(std::size_t index) const;
+
+        /*
+            Adds a field to the front of the dynamic table, evicting older entries to make room.
+            A field larger than the whole table only empties it.
+        */
+        void insert(std::string_view name, std::string_view value);
+
+        /*
+            Searches both tables for the field, preferring an entry whose value matches as well.
+        */
+        match find(std::string_view name, std::string_view value) const;
+
+        /*
+            Changes the maximum size of the dynamic table, evicting entries that no longer fit.
+        */
+        void set_maximum_size(std::size_t size);
+
+        std::size_t maximum() const;
+        std::size_t size() const;
+    };
+}
\ No newline at end of file
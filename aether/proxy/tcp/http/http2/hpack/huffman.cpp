@@ -0,0 +1,143 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "huffman.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+namespace proxy::tcp::http::http2::hpack::huffman {
+    namespace {
+        constexpr std::size_t symbol_count = 257;
+        constexpr std::size_t eos = 256;
+        constexpr std::size_t max_code_length = 30;
+
+        /*
+            Code lengths of the HPACK Huffman code, by symbol (RFC 7541, Appendix B).
+            The code is canonical, so the codes themselves follow from the lengths.
+        */
+        constexpr std::array<std::uint8_t, symbol_count> code_lengths = {
+            13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+            28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+            6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+            5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+            13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+            7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+            15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+            6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+            20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+            24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+            22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+            21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+            26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+            19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+            20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+            26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+            30
+        };
+
+        /*
+            Encoding and decoding tables derived from the code lengths.
+            Decoding compares the bits read so far against the first code of each length,
+                which works because codes of the same length are consecutive.
+        */
+        struct code_table {
+            std::array<std::uint32_t, symbol_count> codes;
+            std::array<std::uint16_t, symbol_count> sorted_symbols;
+            std::array<std::uint32_t, max_code_length + 1> first_code;
+            std::array<std::uint16_t, max_code_length + 1> code_count;
+            std::array<std::uint16_t, max_code_length + 1> first_index;
+
+            code_table()
+                : codes(),
+                sorted_symbols(),
+                first_code(),
+                code_count(),
+                first_index()
+            {
+                for (std::size_t i = 0; i < symbol_count; ++i) {
+                    sorted_symbols[i] = static_cast<std::uint16_t>(i);
+                }
+                std::stable_sort(sorted_symbols.begin(), sorted_symbols.end(), [](std::uint16_t a, std::uint16_t b) {
+                    return code_lengths[a] < code_lengths[b];
+                });
+
+                std::uint32_t code = 0;
+                std::size_t length = code_lengths[sorted_symbols[0]];
+                for (std::size_t i = 0; i < symbol_count; ++i) {
+                    std::uint16_t symbol = sorted_symbols[i];
+                    if (i != 0) {
+                        code = (code + 1) << (code_lengths[symbol] - length);
+                        length = code_lengths[symbol];
+                    }
+                    if (code_count[length] == 0) {
+                        first_code[length] = code;
+                        first_index[length] = static_cast<std::uint16_t>(i);
+                    }
+                    ++code_count[length];
+                    codes[symbol] = code;
+                }
+            }
+        };
+
+        const code_table table;
+    }
+
+    std::size_t encoded_size(std::string_view str) {
+        std::size_t bits = 0;
+        for (unsigned char c : str) {
+            bits += code_lengths[c];
+        }
+        return (bits + 7) / 8;
+    }
+
+    void encode(std::string_view str, std::string &out) {
+        std::uint64_t buffer = 0;
+        std::size_t buffered_bits = 0;
+        for (unsigned char c : str) {
+            buffer = (buffer << code_lengths[c]) | table.codes[c];
+            buffered_bits += code_lengths[c];
+            while (buffered_bits >= 8) {
+                buffered_bits -= 8;
+                out.push_back(static_cast<char>(buffer >> buffered_bits));
+            }
+        }
+        if (buffered_bits != 0) {
+            std::size_t padding = 8 - buffered_bits;
+            out.push_back(static_cast<char>((buffer << padding) | ((1u << padding) - 1)));
+        }
+    }
+
+    void decode(std::string_view data, std::string &out) {
+        std::uint32_t code = 0;
+        std::size_t length = 0;
+        for (unsigned char byte : data) {
+            for (int bit = 7; bit >= 0; --bit) {
+                code = (code << 1) | ((byte >> bit) & 1);
+                ++length;
+                if (table.code_count[length] != 0 && code - table.first_code[length] < table.code_count[length]) {
+                    std::uint16_t symbol = table.sorted_symbols[table.first_index[length] + (code - table.first_code[length])];
+                    if (symbol == eos) {
+                        throw error::http2::compression_error_exception { "Huffman-encoded string contains EOS" };
+                    }
+                    out.push_back(static_cast<char>(symbol));
+                    code = 0;
+                    length = 0;
+                }
+                else if (length == max_code_length) {
+                    throw error::http2::compression_error_exception { "Invalid Huffman code" };
+                }
+            }
+        }
+
+        // Padding must be shorter than a byte and made only of 1 bits
+        if (length >= 8 || code != (1u << length) - 1) {
+            throw error::http2::compression_error_exception { "Invalid Huffman padding" };
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include <aether/proxy/error/exceptions.hpp>
+
+namespace proxy::tcp::http::http2::hpack::huffman {
+    /*
+        Returns the number of bytes the string takes up once Huffman encoded.
+    */
+    std::size_t encoded_size(std::string_view str);
+
+    /*
+        Appends the Huffman encoding of the string to the output, padded with the most significant bits of EOS.
+    */
+    void encode(std::string_view str, std::string &out);
+
+    /*
+        Decodes a Huffman-encoded string, appending it to the output.
+        Throws if the string contains EOS or is not padded correctly.
+    */
+    void decode(std::string_view data, std::string &out);
+}
\ No newline at end of file
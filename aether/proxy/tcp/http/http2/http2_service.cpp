@@ -0,0 +1,1265 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "http2_service.hpp"
+#include <aether/proxy/connection_handler.hpp>
+#include <aether/proxy/connection/upstream_pool.hpp>
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+namespace proxy::tcp::http::http2 {
+    namespace {
+        // Output is written in batches of about this size, so one large response cannot take over the buffer
+        constexpr std::size_t write_batch_size = 64 * 1024;
+
+        // Fields that only apply to a single HTTP/1.x connection, which HTTP/2 does not allow
+        constexpr std::array<std::string_view, 5> connection_specific_headers = {
+            "connection",
+            "keep-alive",
+            "proxy-connection",
+            "transfer-encoding",
+            "upgrade"
+        };
+
+        bool is_connection_specific(std::string_view name) {
+            return std::find(connection_specific_headers.begin(), connection_specific_headers.end(), name) != connection_specific_headers.end();
+        }
+
+        std::uint32_t read_uint32(const std::uint8_t *data) {
+            return (static_cast<std::uint32_t>(data[0]) << 24) | (static_cast<std::uint32_t>(data[1]) << 16)
+                | (static_cast<std::uint32_t>(data[2]) << 8) | data[3];
+        }
+
+        void append_uint32(std::string &out, std::uint32_t value) {
+            out.push_back(static_cast<char>(value >> 24));
+            out.push_back(static_cast<char>(value >> 16));
+            out.push_back(static_cast<char>(value >> 8));
+            out.push_back(static_cast<char>(value));
+        }
+
+        void append_setting(std::string &out, setting id, std::uint32_t value) {
+            out.push_back(static_cast<char>(static_cast<std::uint16_t>(id) >> 8));
+            out.push_back(static_cast<char>(id));
+            append_uint32(out, value);
+        }
+
+        /*
+            Chooses the error code to close the connection with after an exception.
+        */
+        error_type to_error_type(const error_code &code) {
+            switch (code.value()) {
+                case errc::frame_size_error: return error_type::frame_size_error;
+                case errc::flow_control_error: return error_type::flow_control_error;
+                case errc::compression_error: return error_type::compression_error;
+                default: return error_type::protocol_error;
+            }
+        }
+    }
+
+    http2_service::http2_service(connection::connection_flow &flow, connection_handler &owner,
+        tcp::intercept::interceptor_manager &interceptors, tls::openssl::ssl_context_args &server_tls_args)
+        : base_service(flow, owner, interceptors),
+        server_tls_args(server_tls_args),
+        decoder(default_header_table_size),
+        encoder(),
+        streams(),
+        last_stream_id(0),
+        header_block_stream(0),
+        header_block_end_stream(false),
+        header_block(),
+        initial_send_window(default_window_size),
+        max_send_frame_size(default_max_frame_size),
+        send_window(default_window_size),
+        receive_window(default_window_size),
+        unacknowledged_data(0),
+        queued_frames(),
+        handshake_error(),
+        preface_received(false),
+        writing(false),
+        goaway_received(false),
+        closing(false),
+        stopped(false),
+        pending_operations(0)
+    { }
+
+    void http2_service::start() {
+        // Errors from the TLS service are reported on every stream
+        if (flow.error.has_proxy_error()) {
+            handshake_error = std::string(flow.error.get_message_or_proxy());
+        }
+
+        // Streams open their own server connections, so the one made for the TLS handshake goes to the pool
+        if (flow.server.connected()) {
+            flow.server.set_keep_alive(true);
+            flow.set_server(flow.server.get_host(), flow.server.get_port());
+        }
+
+        std::string settings;
+        append_setting(settings, setting::max_concurrent_streams, static_cast<std::uint32_t>(program::options::instance().http2_max_concurrent_streams));
+        append_setting(settings, setting::initial_window_size, stream_window_size);
+        append_setting(settings, setting::max_header_list_size, max_header_list_size);
+        queue_frame(frame_type::settings, 0, 0, settings);
+
+        // The connection window can only be changed with a window update
+        queue_window_update(0, connection_window_size - default_window_size);
+        receive_window = connection_window_size;
+
+        send_frames();
+        read_client();
+    }
+
+    void http2_service::read_client() {
+        // Waiting without any active stream is bounded by the idle timeout
+        flow.client.set_mode(streams.empty() ? connection::base_connection::io_mode::idle : connection::base_connection::io_mode::regular);
+        ++pending_operations;
+        flow.client.read_async(boost::bind(&http2_service::on_read_client, this,
+            boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+    }
+
+    void http2_service::on_read_client(const boost::system::error_code &error, std::size_t bytes_transferred) {
+        --pending_operations;
+        if (closing) {
+            stop_when_finished();
+            return;
+        }
+        if (error != boost::system::errc::success) {
+            flow.error.set_boost_error(error);
+            close_connection();
+            return;
+        }
+
+        try {
+            read_frames();
+        }
+        catch (const error::base_exception &ex) {
+            flow.error.set_proxy_error(ex);
+            send_goaway(to_error_type(ex.error_code()), ex.what());
+            return;
+        }
+
+        if (closing) {
+            return;
+        }
+        send_frames();
+        read_client();
+    }
+
+    void http2_service::read_frames() {
+        streambuf &input = flow.client.input_buffer();
+        if (!preface_received) {
+            if (input.size() < connection_preface.length()) {
+                return;
+            }
+            std::string_view received { static_cast<const char *>(input.data().data()), connection_preface.length() };
+            if (received != connection_preface) {
+                throw error::http2::invalid_preface_exception { };
+            }
+            input.consume(connection_preface.length());
+            preface_received = true;
+        }
+
+        while (!closing && input.size() >= frame_header::size) {
+            const std::uint8_t *data = static_cast<const std::uint8_t *>(input.data().data());
+            frame_header header = frame_header::parse(data);
+
+            // The maximum frame size is never raised from its default
+            if (header.length > default_max_frame_size) {
+                throw error::http2::frame_size_error_exception { };
+            }
+            if (input.size() < frame_header::size + header.length) {
+                break;
+            }
+
+            handle_frame(header, data + frame_header::size);
+            input.consume(frame_header::size + header.length);
+        }
+    }
+
+    void http2_service::handle_frame(const frame_header &header, const std::uint8_t *payload) {
+        // Nothing may come between the frames of a header block
+        if (header_block_stream != 0 && (header.type != frame_type::continuation || header.stream_id != header_block_stream)) {
+            throw error::http2::protocol_error_exception { "Expected CONTINUATION frame" };
+        }
+
+        switch (header.type) {
+            case frame_type::data: on_data_frame(header, payload); break;
+            case frame_type::headers: on_headers_frame(header, payload); break;
+            case frame_type::priority:
+                if (header.stream_id == 0) {
+                    throw error::http2::protocol_error_exception { "PRIORITY frame on stream 0" };
+                }
+                if (header.length != 5) {
+                    throw error::http2::frame_size_error_exception { };
+                }
+                // Streams are served as soon as they are ready, so priorities are not used
+                break;
+            case frame_type::rst_stream: on_rst_stream_frame(header, payload); break;
+            case frame_type::settings: on_settings_frame(header, payload); break;
+            case frame_type::push_promise:
+                throw error::http2::protocol_error_exception { "Clients cannot push streams" };
+            case frame_type::ping: on_ping_frame(header, payload); break;
+            case frame_type::goaway: on_goaway_frame(header, payload); break;
+            case frame_type::window_update: on_window_update_frame(header, payload); break;
+            case frame_type::continuation: on_continuation_frame(header, payload); break;
+            // Unknown frame types are ignored
+            default: break;
+        }
+    }
+
+    void http2_service::on_data_frame(const frame_header &header, const std::uint8_t *payload) {
+        if (header.stream_id == 0) {
+            throw error::http2::protocol_error_exception { "DATA frame on stream 0" };
+        }
+
+        // Padding counts against the flow-control windows as well
+        if (header.length > receive_window) {
+            throw error::http2::flow_control_error_exception { };
+        }
+        receive_window -= header.length;
+        acknowledge_data(0, unacknowledged_data, receive_window, header.length);
+
+        std::size_t offset = 0;
+        std::size_t padding = 0;
+        if (header.has_flag(flags::padded)) {
+            if (header.length == 0) {
+                throw error::http2::frame_size_error_exception { };
+            }
+            padding = payload[0];
+            offset = 1;
+        }
+        if (offset + padding > header.length) {
+            throw error::http2::protocol_error_exception { "Padding is longer than the frame" };
+        }
+
+        auto it = streams.find(header.stream_id);
+        if (it == streams.end() || it->second->request_done) {
+            if (header.stream_id > last_stream_id) {
+                throw error::http2::protocol_error_exception { "DATA frame on idle stream" };
+            }
+            reset_stream(header.stream_id, error_type::stream_closed);
+            return;
+        }
+
+        stream::ptr s = it->second;
+        if (header.length > s->receive_window) {
+            reset_stream(s->id, error_type::flow_control_error);
+            abandon_stream(s);
+            return;
+        }
+        s->receive_window -= header.length;
+
+        // Anything sent after the response has started is not needed anymore
+        if (!s->headers_sent) {
+            s->request_body.append(reinterpret_cast<const char *>(payload + offset), header.length - offset - padding);
+            if (s->request_body.length() > program::options::instance().body_size_limit) {
+                flow.error.set_proxy_error(errc::body_size_too_large);
+                send_error_response(s, status::payload_too_large, flow.error.get_proxy_error().message());
+                return;
+            }
+        }
+
+        if (header.has_flag(flags::end_stream)) {
+            s->request_done = true;
+            if (!s->headers_sent) {
+                dispatch_request(s);
+            }
+        }
+        else {
+            acknowledge_data(s->id, s->unacknowledged_data, s->receive_window, header.length);
+        }
+    }
+
+    void http2_service::on_headers_frame(const frame_header &header, const std::uint8_t *payload) {
+        if (header.stream_id == 0) {
+            throw error::http2::protocol_error_exception { "HEADERS frame on stream 0" };
+        }
+
+        std::size_t offset = 0;
+        std::size_t padding = 0;
+        if (header.has_flag(flags::padded)) {
+            if (header.length == 0) {
+                throw error::http2::frame_size_error_exception { };
+            }
+            padding = payload[0];
+            offset = 1;
+        }
+        if (header.has_flag(flags::priority)) {
+            offset += 5;
+        }
+        if (offset + padding > header.length) {
+            throw error::http2::protocol_error_exception { "Padding is longer than the frame" };
+        }
+
+        header_block.assign(reinterpret_cast<const char *>(payload + offset), header.length - offset - padding);
+        header_block_stream = header.stream_id;
+        header_block_end_stream = header.has_flag(flags::end_stream);
+        if (header.has_flag(flags::end_headers)) {
+            on_header_block();
+        }
+    }
+
+    void http2_service::on_continuation_frame(const frame_header &header, const std::uint8_t *payload) {
+        if (header_block_stream == 0) {
+            throw error::http2::protocol_error_exception { "CONTINUATION frame without a header block" };
+        }
+        header_block.append(reinterpret_cast<const char *>(payload), header.length);
+
+        // Even a compressed block this large could not be accepted
+        if (header_block.length() > 4 * max_header_list_size) {
+            throw error::http2::header_list_too_large_exception { };
+        }
+        if (header.has_flag(flags::end_headers)) {
+            on_header_block();
+        }
+    }
+
+    void http2_service::on_header_block() {
+        std::uint32_t stream_id = header_block_stream;
+        header_block_stream = 0;
+
+        // Every block must be decoded to keep the dynamic table in sync, even if the stream is refused
+        hpack::header_list headers;
+        bool too_large = false;
+        try {
+            headers = decoder.decode(header_block, max_header_list_size);
+        }
+        catch (const error::http2::header_list_too_large_exception &) {
+            too_large = true;
+        }
+        header_block.clear();
+
+        auto it = streams.find(stream_id);
+        if (it != streams.end()) {
+            stream::ptr s = it->second;
+            if (s->request_done) {
+                reset_stream(s->id, error_type::stream_closed);
+                abandon_stream(s);
+            }
+            // Trailers must end the stream
+            // They are not forwarded, since the request is sent to the server with a Content-Length
+            else if (!header_block_end_stream) {
+                reset_stream(s->id, error_type::protocol_error);
+                abandon_stream(s);
+            }
+            else {
+                s->request_done = true;
+                if (!s->headers_sent) {
+                    dispatch_request(s);
+                }
+            }
+            return;
+        }
+
+        if (stream_id <= last_stream_id || stream_id % 2 == 0) {
+            throw error::http2::protocol_error_exception { "Invalid identifier for a new stream" };
+        }
+        last_stream_id = stream_id;
+
+        if (goaway_received || streams.size() >= program::options::instance().http2_max_concurrent_streams) {
+            reset_stream(stream_id, error_type::refused_stream);
+            return;
+        }
+
+        auto s = std::make_shared<stream>(stream_id, initial_send_window, stream_window_size);
+        streams.emplace(stream_id, s);
+        s->request_done = header_block_end_stream;
+
+        if (too_large) {
+            send_error_response(s, status::bad_request, "Request header list is too large.");
+            return;
+        }
+
+        try {
+            if (!make_request(*s, headers)) {
+                reset_stream(stream_id, error_type::protocol_error);
+                abandon_stream(s);
+                return;
+            }
+        }
+        catch (const error::base_exception &ex) {
+            flow.error.set_proxy_error(ex);
+            send_error_response(s, status::bad_request, ex.what());
+            return;
+        }
+
+        if (s->request_done) {
+            dispatch_request(s);
+        }
+    }
+
+    bool http2_service::make_request(stream &s, hpack::header_list &headers) {
+        std::optional<std::string_view> method_name;
+        std::optional<std::string_view> scheme;
+        std::optional<std::string_view> authority;
+        std::optional<std::string_view> path;
+
+        // Pseudo-header fields come before all regular fields
+        auto field = headers.begin();
+        for (; field != headers.end() && !field->first.empty() && field->first[0] == ':'; ++field) {
+            std::optional<std::string_view> *target = nullptr;
+            if (field->first == ":method") {
+                target = &method_name;
+            }
+            else if (field->first == ":scheme") {
+                target = &scheme;
+            }
+            else if (field->first == ":authority") {
+                target = &authority;
+            }
+            else if (field->first == ":path") {
+                target = &path;
+            }
+            if (!target || target->has_value()) {
+                return false;
+            }
+            *target = field->second;
+        }
+
+        if (!method_name || !scheme || !path || path->empty()) {
+            return false;
+        }
+
+        request &req = s.exch.request();
+        method verb = http::convert::to_method(*method_name);
+        if (verb == method::CONNECT) {
+            throw error::http2::malformed_message_exception { "CONNECT is not supported over HTTP/2" };
+        }
+        req.set_method(verb);
+        req.set_version(version::http1_1);
+
+        // The Host header goes first, just as an HTTP/1.1 client would send it
+        std::optional<std::string_view> host = authority;
+        if (authority) {
+            req.add_header("Host", *authority);
+        }
+
+        std::string cookies;
+        for (; field != headers.end(); ++field) {
+            const std::string &name = field->first;
+            const std::string &value = field->second;
+            if (name.empty() || name[0] == ':' || std::any_of(name.begin(), name.end(), [](char c) { return c >= 'A' && c <= 'Z'; })) {
+                return false;
+            }
+            if (is_connection_specific(name) || (name == "te" && value != "trailers")) {
+                return false;
+            }
+
+            // Cookies may be split into separate fields, but HTTP/1.1 only allows one
+            if (name == "cookie") {
+                if (!cookies.empty()) {
+                    cookies.append("; ");
+                }
+                cookies.append(value);
+            }
+            else if (name == "host") {
+                if (!host) {
+                    host = value;
+                    req.add_header("Host", value);
+                }
+            }
+            // The whole body is sent at once, so the server has nothing to agree to
+            else if (name != "te" && name != "expect") {
+                req.add_header(name, value);
+            }
+        }
+
+        if (!cookies.empty()) {
+            req.add_header("Cookie", cookies);
+        }
+
+        if (!host || host->empty()) {
+            return false;
+        }
+
+        url target = url::parse_target(*path, verb);
+        target.scheme = *scheme;
+        target.netloc = url::parse_netloc(*host);
+        if (!target.netloc.has_port()) {
+            target.netloc.port = target.scheme == "https" ? 443 : 80;
+        }
+        if (target.form != url::target_form::asterisk) {
+            target.form = url::target_form::origin;
+        }
+        req.set_target(target);
+        return true;
+    }
+
+    void http2_service::acknowledge_data(std::uint32_t stream_id, std::uint32_t &unacknowledged, std::int64_t &window, std::uint32_t size) {
+        unacknowledged += size;
+
+        // Updates are batched, so that small frames do not each get one
+        std::uint32_t full_window = stream_id == 0 ? connection_window_size : stream_window_size;
+        if (unacknowledged >= full_window / 2) {
+            queue_window_update(stream_id, unacknowledged);
+            window += unacknowledged;
+            unacknowledged = 0;
+        }
+    }
+
+    void http2_service::on_rst_stream_frame(const frame_header &header, const std::uint8_t *payload) {
+        if (header.stream_id == 0 || header.stream_id > last_stream_id) {
+            throw error::http2::protocol_error_exception { "RST_STREAM frame on idle stream" };
+        }
+        if (header.length != 4) {
+            throw error::http2::frame_size_error_exception { };
+        }
+
+        auto it = streams.find(header.stream_id);
+        if (it != streams.end()) {
+            abandon_stream(it->second);
+        }
+    }
+
+    void http2_service::on_settings_frame(const frame_header &header, const std::uint8_t *payload) {
+        if (header.stream_id != 0) {
+            throw error::http2::protocol_error_exception { "SETTINGS frame on a stream" };
+        }
+        if (header.has_flag(flags::ack)) {
+            if (header.length != 0) {
+                throw error::http2::frame_size_error_exception { };
+            }
+            return;
+        }
+        if (header.length % 6 != 0) {
+            throw error::http2::frame_size_error_exception { };
+        }
+
+        for (std::size_t pos = 0; pos < header.length; pos += 6) {
+            std::uint16_t id = static_cast<std::uint16_t>((payload[pos] << 8) | payload[pos + 1]);
+            std::uint32_t value = read_uint32(payload + pos + 2);
+            switch (static_cast<setting>(id)) {
+                case setting::header_table_size:
+                    encoder.set_allowed_table_size(value);
+                    break;
+                case setting::enable_push:
+                    if (value > 1) {
+                        throw error::http2::protocol_error_exception { "Invalid SETTINGS_ENABLE_PUSH value" };
+                    }
+                    break;
+                case setting::initial_window_size: {
+                    if (value > max_window_size) {
+                        throw error::http2::flow_control_error_exception { };
+                    }
+                    // Changes every open stream's window by the difference
+                    std::int64_t delta = static_cast<std::int64_t>(value) - initial_send_window;
+                    for (auto &[stream_id, s] : streams) {
+                        s->send_window += delta;
+                        if (s->send_window > max_window_size) {
+                            throw error::http2::flow_control_error_exception { };
+                        }
+                    }
+                    initial_send_window = value;
+                    break;
+                }
+                case setting::max_frame_size:
+                    if (value < default_max_frame_size || value > max_frame_size_limit) {
+                        throw error::http2::protocol_error_exception { "Invalid SETTINGS_MAX_FRAME_SIZE value" };
+                    }
+                    max_send_frame_size = value;
+                    break;
+                // The proxy never opens streams, and header lists are sent as the server gives them
+                default:
+                    break;
+            }
+        }
+
+        queue_frame(frame_type::settings, flags::ack, 0, { });
+    }
+
+    void http2_service::on_ping_frame(const frame_header &header, const std::uint8_t *payload) {
+        if (header.stream_id != 0) {
+            throw error::http2::protocol_error_exception { "PING frame on a stream" };
+        }
+        if (header.length != 8) {
+            throw error::http2::frame_size_error_exception { };
+        }
+        if (!header.has_flag(flags::ack)) {
+            queue_frame(frame_type::ping, flags::ack, 0, { reinterpret_cast<const char *>(payload), 8 });
+        }
+    }
+
+    void http2_service::on_goaway_frame(const frame_header &header, const std::uint8_t *payload) {
+        if (header.stream_id != 0) {
+            throw error::http2::protocol_error_exception { "GOAWAY frame on a stream" };
+        }
+        if (header.length < 8) {
+            throw error::http2::frame_size_error_exception { };
+        }
+
+        // Streams that are already open are still answered
+        goaway_received = true;
+        if (streams.empty()) {
+            close_connection();
+        }
+    }
+
+    void http2_service::on_window_update_frame(const frame_header &header, const std::uint8_t *payload) {
+        if (header.length != 4) {
+            throw error::http2::frame_size_error_exception { };
+        }
+        std::uint32_t increment = read_uint32(payload) & 0x7fffffff;
+
+        if (header.stream_id == 0) {
+            if (increment == 0) {
+                throw error::http2::protocol_error_exception { "Window update of 0" };
+            }
+            send_window += increment;
+            if (send_window > max_window_size) {
+                throw error::http2::flow_control_error_exception { };
+            }
+            return;
+        }
+
+        // Updates may still arrive for streams that have just been closed
+        auto it = streams.find(header.stream_id);
+        if (it == streams.end()) {
+            return;
+        }
+
+        stream::ptr s = it->second;
+        s->send_window += increment;
+        if (increment == 0 || s->send_window > max_window_size) {
+            reset_stream(s->id, increment == 0 ? error_type::protocol_error : error_type::flow_control_error);
+            abandon_stream(s);
+        }
+    }
+
+    void http2_service::dispatch_request(const stream::ptr &s) {
+        request &req = s->exch.request();
+
+        // A Content-Length sent by the client must match the DATA frames it sent
+        bool has_content_length = req.has_header(header_id::content_length);
+        if (has_content_length) {
+            try {
+                if (s->parser.body_size(http1::http_parser::message_mode::request).second != s->request_body.length()) {
+                    throw error::http::invalid_body_size_exception { };
+                }
+            }
+            catch (const error::base_exception &) {
+                reset_stream(s->id, error_type::protocol_error);
+                abandon_stream(s);
+                return;
+            }
+        }
+
+        req.set_body(s->request_body);
+        std::string().swap(s->request_body);
+
+        // HTTP/2 frames delimit the body, but the server needs a Content-Length
+        method verb = req.get_method();
+        if (!has_content_length && (req.content_length() != 0 || verb == method::POST || verb == method::PUT || verb == method::PATCH)) {
+            req.set_content_length();
+        }
+
+        if (handshake_error.has_value()) {
+            send_error_response(s, status::bad_gateway, handshake_error.value());
+            return;
+        }
+
+        try {
+            interceptors.http.run(intercept::http_event::any_request, flow, s->exch);
+            req.add_header("Via", out::string::stream("2 ", constants::lowercase_name));
+            interceptors.http.run(intercept::http_event::request_body, flow, s->exch);
+            interceptors.http.run(intercept::http_event::request, flow, s->exch);
+        }
+        catch (const error::base_exception &ex) {
+            flow.error.set_proxy_error(ex);
+            send_error_response(s, status::bad_request, ex.what());
+            return;
+        }
+
+        // Response set by an interceptor
+        if (s->exch.has_response()) {
+            s->body_done = true;
+            forward_response(s);
+        }
+        else if (!serve_from_cache(s)) {
+            connect_server(s);
+        }
+    }
+
+    bool http2_service::serve_from_cache(const stream::ptr &s) {
+        if (!program::options::instance().cache) {
+            return false;
+        }
+
+        s->cache_state = cache::response_cache::instance().lookup(s->exch.request());
+        switch (s->cache_state.status) {
+            case cache::lookup_status::hit:
+                s->exch.make_response() = std::move(s->cache_state.res);
+                s->body_done = true;
+                forward_response(s);
+                return true;
+            case cache::lookup_status::unavailable:
+                send_error_response(s, status::gateway_timeout, "No cached response is available.");
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    void http2_service::connect_server(const stream::ptr &s) {
+        const request &req = s->exch.request();
+        std::string host = req.get_host_name();
+        port_t port = req.get_host_port();
+        bool secure = req.get_target().scheme == "https";
+
+        s->server = std::make_shared<connection::server_connection>(ioc);
+        if (s->server->acquire_pooled(host, port, secure ? connection::upstream_pool::tls_key(server_tls_args) : std::string { })) {
+            forward_request(s);
+            return;
+        }
+
+        ++pending_operations;
+        s->server->connect_async(host, port, boost::bind(&http2_service::on_connect_server, this, s,
+            boost::asio::placeholders::error));
+    }
+
+    void http2_service::on_connect_server(const stream::ptr &s, const boost::system::error_code &error) {
+        --pending_operations;
+        if (s->abandoned) {
+            stop_when_finished();
+            return;
+        }
+        if (error != boost::system::errc::success) {
+            on_server_error(s, error, status::bad_gateway);
+            return;
+        }
+
+        if (s->exch.request().get_target().scheme == "https") {
+            try {
+                ++pending_operations;
+                s->server->establish_tls_async(server_tls_args, boost::bind(&http2_service::on_establish_tls_with_server, this, s,
+                    boost::asio::placeholders::error));
+            }
+            catch (const error::base_exception &ex) {
+                --pending_operations;
+                flow.error.set_proxy_error(ex);
+                send_error_response(s, status::bad_gateway, ex.what());
+            }
+            return;
+        }
+        forward_request(s);
+    }
+
+    void http2_service::on_establish_tls_with_server(const stream::ptr &s, const boost::system::error_code &error) {
+        --pending_operations;
+        if (s->abandoned) {
+            stop_when_finished();
+            return;
+        }
+        if (error != boost::system::errc::success) {
+            flow.error.set_proxy_error(errc::upstream_handshake_failed);
+            on_server_error(s, error, status::bad_gateway);
+            return;
+        }
+        forward_request(s);
+    }
+
+    void http2_service::forward_request(const stream::ptr &s) {
+        std::ostream out = s->server->output_stream();
+        message::body_buffers body = s->exch.request().serialize(out);
+        ++pending_operations;
+        s->server->write_async(body, boost::bind(&http2_service::on_forward_request, this, s,
+            boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+    }
+
+    void http2_service::on_forward_request(const stream::ptr &s, const boost::system::error_code &error, std::size_t bytes_transferred) {
+        --pending_operations;
+        if (s->abandoned) {
+            stop_when_finished();
+            return;
+        }
+        if (error != boost::system::errc::success) {
+            if (error != boost::asio::error::operation_aborted && retry_on_stale_server(s)) {
+                return;
+            }
+            on_server_error(s, error, status::internal_server_error);
+            return;
+        }
+        read_response_head(s);
+    }
+
+    bool http2_service::retry_on_stale_server(const stream::ptr &s) {
+        // Nothing from the server may have been read, or it could have processed the request
+        if (s->retried || !s->server->was_reused() || !s->exch.request().is_idempotent() || s->server->input_buffer().size() != 0) {
+            return false;
+        }
+        s->retried = true;
+        out::debug::log("Retrying request on a new connection to ", s->server->get_host(), ':', s->server->get_port());
+        s->server->disconnect();
+        connect_server(s);
+        return true;
+    }
+
+    void http2_service::read_response_head(const stream::ptr &s) {
+        ++pending_operations;
+        if (s->server->input_buffer().size() != 0) {
+            on_read_response_head(s, boost::system::error_code(), 0);
+        }
+        else {
+            s->server->read_async(boost::bind(&http2_service::on_read_response_head, this, s,
+                boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+        }
+    }
+
+    void http2_service::on_read_response_head(const stream::ptr &s, const boost::system::error_code &error, std::size_t bytes_transferred) {
+        --pending_operations;
+        if (s->abandoned) {
+            stop_when_finished();
+            return;
+        }
+        if (error != boost::system::errc::success) {
+            if (error != boost::asio::error::operation_aborted && retry_on_stale_server(s)) {
+                return;
+            }
+            on_server_error(s, error, status::internal_server_error);
+            return;
+        }
+
+        try {
+            // Only part of the head has arrived, the next scan picks up where this one stopped
+            if (!s->parser.scan_head(s->server->input_buffer())) {
+                ++pending_operations;
+                s->server->read_async(boost::bind(&http2_service::on_read_response_head, this, s,
+                    boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+                return;
+            }
+
+            s->exch.make_response();
+            s->parser.read_response_head(s->server->input_buffer());
+        }
+        catch (const error::base_exception &ex) {
+            flow.error.set_proxy_error(ex);
+            send_error_response(s, status::internal_server_error, ex.what());
+            return;
+        }
+
+        // Interim responses are not passed on, since the whole request body was sent already
+        if (s->exch.response().is_1xx()) {
+            read_response_head(s);
+            return;
+        }
+        start_response_body(s);
+    }
+
+    void http2_service::start_response_body(const stream::ptr &s) {
+        interceptors.http.run(intercept::http_event::response_head, flow, s->exch);
+
+        std::pair<http1::http_parser::body_size_type, std::size_t> body_size;
+        try {
+            body_size = s->parser.body_size(http1::http_parser::message_mode::response);
+        }
+        catch (const error::base_exception &ex) {
+            flow.error.set_proxy_error(ex);
+            send_error_response(s, status::internal_server_error, ex.what());
+            return;
+        }
+
+        auto [type, size] = body_size;
+        if (type == http1::http_parser::body_size_type::none) {
+            s->body_done = true;
+            s->server->set_keep_alive(!s->exch.response().should_close_connection());
+            forward_response(s);
+            return;
+        }
+
+        const program::options &options = program::options::instance();
+        if (!options.stream_response_body || s->exch.buffer_response()) {
+            s->mode = stream::body_mode::buffered;
+        }
+        // Events must reach the client as soon as they are sent, however small they are
+        else if (s->exch.response().is_event_stream() || (type == http1::http_parser::body_size_type::given && size > options.stream_response_threshold)) {
+            stream_response(s);
+            return;
+        }
+        relay_response_body(s, false);
+    }
+
+    void http2_service::read_response_body(const stream::ptr &s) {
+        s->reading_server = true;
+        ++pending_operations;
+        s->server->read_async(boost::bind(&http2_service::on_read_response_body, this, s,
+            boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+    }
+
+    void http2_service::on_read_response_body(const stream::ptr &s, const boost::system::error_code &error, std::size_t bytes_transferred) {
+        --pending_operations;
+        s->reading_server = false;
+        if (s->abandoned) {
+            stop_when_finished();
+            return;
+        }
+
+        // Connection was closed by the server, which may be how the body ends
+        bool eof = error == boost::asio::error::eof;
+        if (error != boost::system::errc::success && !eof) {
+            on_server_error(s, error, status::internal_server_error);
+            return;
+        }
+        relay_response_body(s, eof);
+    }
+
+    void http2_service::relay_response_body(const stream::ptr &s, bool eof) {
+        bool done = false;
+        try {
+            done = s->parser.decode_body(s->server->input_buffer(), s->response_data, http1::http_parser::message_mode::response, eof);
+        }
+        catch (const error::base_exception &ex) {
+            flow.error.set_proxy_error(ex);
+            send_error_response(s, status::internal_server_error, ex.what());
+            return;
+        }
+
+        // The server closed the connection in the middle of the body
+        if (eof && !done) {
+            flow.error.set_proxy_error(errc::malformed_response_body);
+            send_error_response(s, status::internal_server_error, flow.error.get_proxy_error().message());
+            return;
+        }
+
+        if (done) {
+            s->body_done = true;
+            s->server->set_keep_alive(!eof && !s->exch.response().should_close_connection());
+        }
+
+        switch (s->mode) {
+            case stream::body_mode::held:
+            case stream::body_mode::buffered:
+                if (done) {
+                    forward_response(s);
+                }
+                else if (s->mode == stream::body_mode::held && s->response_data.size() > program::options::instance().stream_response_threshold) {
+                    stream_response(s);
+                }
+                else if (s->response_data.size() > program::options::instance().body_size_limit) {
+                    flow.error.set_proxy_error(errc::body_size_too_large);
+                    send_error_response(s, status::internal_server_error, flow.error.get_proxy_error().message());
+                }
+                else {
+                    read_response_body(s);
+                }
+                break;
+            case stream::body_mode::streamed:
+                // Reading resumes once the client has taken enough of what is waiting
+                if (!done && s->response_data.size() < stream_buffer_limit) {
+                    read_response_body(s);
+                }
+                send_frames();
+                break;
+        }
+    }
+
+    void http2_service::stream_response(const stream::ptr &s) {
+        s->mode = stream::body_mode::streamed;
+
+        // Interceptors only get to see the head, since the body is never stored
+        interceptors.http.run(intercept::http_event::response, flow, s->exch);
+
+        send_response_head(*s, false);
+        relay_response_body(s, false);
+    }
+
+    void http2_service::forward_response(const stream::ptr &s) {
+        response &res = s->exch.response();
+
+        // The body goes back into the message, where interceptors can see and change it
+        if (s->response_data.size() != 0) {
+            res.set_body({ static_cast<const char *>(s->response_data.data().data()), s->response_data.size() });
+            s->response_data.consume(s->response_data.size());
+            if (res.has_header(header_id::content_length)) {
+                res.set_content_length();
+            }
+        }
+
+        // Interceptors see the response the client gets, which is the stored one if the server only validated it
+        if (s->cache_state.status != cache::lookup_status::bypass) {
+            cache::response_cache::instance().complete(s->exch.request(), res, s->cache_state);
+        }
+
+        interceptors.http.run(intercept::http_event::response, flow, s->exch);
+        queue_response(*s);
+        send_frames();
+    }
+
+    void http2_service::queue_response(stream &s) {
+        const response &res = s.exch.response();
+        std::string body = s.exch.request().get_method() == method::HEAD ? std::string { } : res.get_body();
+
+        // A cached body on disk is read through the segment's mapping, since the connection is secured
+        std::shared_ptr<const cache::disk_body> cached_body = std::move(s.cache_state.body);
+        send_response_head(s, body.empty() && !cached_body);
+        if (cached_body) {
+            boost::asio::const_buffer data = cached_body->buffer(0, static_cast<std::size_t>(cached_body->length));
+            s.response_data.commit(boost::asio::buffer_copy(s.response_data.prepare(data.size()), data));
+        }
+        else if (!body.empty()) {
+            s.response_data.commit(boost::asio::buffer_copy(s.response_data.prepare(body.length()), boost::asio::buffer(body)));
+        }
+        s.body_done = true;
+    }
+
+    void http2_service::send_response_head(stream &s, bool end_stream) {
+        const response &res = s.exch.response();
+
+        std::string block;
+        encoder.begin_block(block);
+        encoder.encode(":status", out::string::stream(res.get_status()), block);
+        for (const auto &field : res.all_headers()) {
+            // Field names must be lowercase in HTTP/2
+            std::string name = util::string::lowercase(field.name);
+            if (!is_connection_specific(name)) {
+                encoder.encode(name, field.value, block);
+            }
+        }
+
+        std::size_t pos = 0;
+        do {
+            std::size_t length = std::min<std::size_t>(block.length() - pos, max_send_frame_size);
+            std::uint8_t frame_flags = pos + length == block.length() ? flags::end_headers : 0;
+            if (pos == 0 && end_stream) {
+                frame_flags |= flags::end_stream;
+            }
+            queue_frame(pos == 0 ? frame_type::headers : frame_type::continuation, frame_flags, s.id, { block.data() + pos, length });
+            pos += length;
+        } while (pos < block.length());
+
+        s.headers_sent = true;
+        s.end_stream_sent = end_stream;
+    }
+
+    void http2_service::on_server_error(const stream::ptr &s, const boost::system::error_code &error, status response_status) {
+        flow.error.set_boost_error(error);
+        if (error == boost::asio::error::operation_aborted) {
+            send_error_response(s, status::gateway_timeout, error.message());
+        }
+        else {
+            send_error_response(s, response_status, error.message());
+        }
+    }
+
+    void http2_service::send_error_response(const stream::ptr &s, status response_status, std::string_view msg) {
+        // Part of the response may already be on its way, so the client can only be told by resetting the stream
+        if (s->headers_sent) {
+            reset_stream(s->id, error_type::internal_error);
+            abandon_stream(s);
+            send_frames();
+            return;
+        }
+
+        response &res = s->exch.make_response();
+        res.set_status(response_status);
+
+        std::string_view reason = http::convert::status_to_reason(response_status);
+
+        // A small hint of server-side rendering
+        std::stringstream content;
+        content << "<html><head>";
+        content << "<title>" << response_status << ' ' << reason << "</title>";
+        content << "</head><body>";
+        content << "<h1>" << response_status << ' ' << reason << "</h1>";
+        content << "<p>" << msg << "</p>";
+        content << "</body></html>";
+        res.set_body(content.str());
+
+        res.add_header("Server", constants::full_server_name.data());
+        res.add_header("Content-Type", "text/html");
+        res.set_content_length();
+
+        // The server connection is left in an unknown state
+        if (s->server) {
+            s->server->set_keep_alive(false);
+        }
+        s->response_data.consume(s->response_data.size());
+
+        interceptors.http.run(intercept::http_event::error, flow, s->exch);
+        queue_response(*s);
+        send_frames();
+    }
+
+    void http2_service::finish_stream(const stream::ptr &s) {
+        if (s->server && !s->server->release_to_pool()) {
+            s->server->disconnect();
+        }
+
+        // The client is told to stop sending a request body that will not be read
+        if (!s->request_done) {
+            reset_stream(s->id, error_type::no_error);
+        }
+        streams.erase(s->id);
+
+        if (goaway_received && streams.empty()) {
+            close_connection();
+        }
+    }
+
+    void http2_service::reset_stream(std::uint32_t stream_id, error_type code) {
+        std::string payload;
+        append_uint32(payload, static_cast<std::uint32_t>(code));
+        queue_frame(frame_type::rst_stream, 0, stream_id, payload);
+    }
+
+    void http2_service::abandon_stream(const stream::ptr &s) {
+        s->abandoned = true;
+        // Pending operations on the server connection finish with an error
+        if (s->server) {
+            s->server->disconnect();
+        }
+        streams.erase(s->id);
+    }
+
+    void http2_service::queue_frame(frame_type type, std::uint8_t flags, std::uint32_t stream_id, std::string_view payload) {
+        frame_header { static_cast<std::uint32_t>(payload.length()), type, flags, stream_id }.write(queued_frames);
+        queued_frames.commit(boost::asio::buffer_copy(queued_frames.prepare(payload.length()), boost::asio::buffer(payload)));
+    }
+
+    void http2_service::queue_window_update(std::uint32_t stream_id, std::uint32_t increment) {
+        std::string payload;
+        append_uint32(payload, increment);
+        queue_frame(frame_type::window_update, 0, stream_id, payload);
+    }
+
+    void http2_service::send_frames() {
+        // Frames are sent once the write in progress finishes
+        if (writing) {
+            return;
+        }
+
+        streambuf &output = flow.client.output_buffer();
+        output.commit(boost::asio::buffer_copy(output.prepare(queued_frames.size()), queued_frames.data()));
+        queued_frames.consume(queued_frames.size());
+
+        if (!closing) {
+            // Streams take turns sending one frame at a time, as far as the flow-control windows allow
+            bool sent = true;
+            while (sent && output.size() < write_batch_size && send_window > 0) {
+                sent = false;
+                for (auto &[stream_id, s] : streams) {
+                    if (!s->headers_sent || s->end_stream_sent || s->response_data.size() == 0 || s->send_window <= 0 || send_window <= 0) {
+                        continue;
+                    }
+
+                    std::size_t length = std::min<std::size_t>({ s->response_data.size(), static_cast<std::size_t>(send_window),
+                        static_cast<std::size_t>(s->send_window), max_send_frame_size });
+                    bool last = s->body_done && length == s->response_data.size();
+                    frame_header { static_cast<std::uint32_t>(length), frame_type::data, last ? flags::end_stream : std::uint8_t(0), stream_id }.write(output);
+                    output.commit(boost::asio::buffer_copy(output.prepare(length), s->response_data.data(), length));
+                    s->response_data.consume(length);
+
+                    send_window -= length;
+                    s->send_window -= length;
+                    s->end_stream_sent = last;
+                    sent = true;
+                }
+            }
+
+            std::vector<stream::ptr> finished;
+            std::vector<stream::ptr> resumed;
+            for (auto &[stream_id, s] : streams) {
+                // An empty frame ends a stream whose body has already been sent
+                if (s->headers_sent && !s->end_stream_sent && s->body_done && s->response_data.size() == 0) {
+                    frame_header { 0, frame_type::data, flags::end_stream, stream_id }.write(output);
+                    s->end_stream_sent = true;
+                }
+
+                if (s->end_stream_sent) {
+                    finished.push_back(s);
+                }
+                else if (s->mode == stream::body_mode::streamed && !s->body_done && !s->reading_server && s->response_data.size() < stream_buffer_limit) {
+                    resumed.push_back(s);
+                }
+            }
+
+            for (const auto &s : finished) {
+                finish_stream(s);
+            }
+            for (const auto &s : resumed) {
+                read_response_body(s);
+            }
+        }
+
+        if (output.size() == 0) {
+            return;
+        }
+
+        writing = true;
+        flow.client.set_mode(streams.empty() ? connection::base_connection::io_mode::idle : connection::base_connection::io_mode::regular);
+        ++pending_operations;
+        flow.client.write_async(boost::bind(&http2_service::on_send_frames, this,
+            boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+    }
+
+    void http2_service::on_send_frames(const boost::system::error_code &error, std::size_t bytes_transferred) {
+        --pending_operations;
+        writing = false;
+        if (error != boost::system::errc::success) {
+            flow.error.set_boost_error(error);
+            close_connection();
+        }
+        else if (closing) {
+            // The GOAWAY frame may have been queued behind this write
+            if (queued_frames.size() != 0) {
+                send_frames();
+            }
+            else {
+                flow.client.close();
+                stop_when_finished();
+            }
+        }
+        else {
+            send_frames();
+        }
+    }
+
+    void http2_service::send_goaway(error_type code, std::string_view debug_data) {
+        if (closing) {
+            return;
+        }
+
+        std::string payload;
+        append_uint32(payload, last_stream_id);
+        append_uint32(payload, static_cast<std::uint32_t>(code));
+        payload.append(debug_data);
+        queue_frame(frame_type::goaway, 0, 0, payload);
+
+        drop_streams();
+        send_frames();
+        if (!writing) {
+            flow.client.close();
+            stop_when_finished();
+        }
+    }
+
+    void http2_service::close_connection() {
+        if (!closing) {
+            drop_streams();
+            flow.client.close();
+        }
+        stop_when_finished();
+    }
+
+    void http2_service::drop_streams() {
+        closing = true;
+        auto dropped = std::move(streams);
+        streams.clear();
+        for (auto &[stream_id, s] : dropped) {
+            s->abandoned = true;
+            if (s->server) {
+                s->server->disconnect();
+            }
+        }
+    }
+
+    void http2_service::stop_when_finished() {
+        if (closing && !stopped && pending_operations == 0) {
+            stopped = true;
+            stop();
+        }
+    }
+}
\ No newline at end of file
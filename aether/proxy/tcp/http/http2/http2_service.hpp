@@ -0,0 +1,217 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <boost/asio.hpp>
+
+#include <aether/proxy/types.hpp>
+#include <aether/proxy/constants/server_constants.hpp>
+#include <aether/proxy/tcp/base_service.hpp>
+#include <aether/proxy/connection/connection_flow.hpp>
+#include <aether/proxy/tcp/http/http2/frame.hpp>
+#include <aether/proxy/tcp/http/http2/stream.hpp>
+#include <aether/proxy/tcp/http/http2/hpack/decoder.hpp>
+#include <aether/proxy/tcp/http/http2/hpack/encoder.hpp>
+#include <aether/proxy/tcp/tls/openssl/ssl_context.hpp>
+
+namespace proxy::tcp::http::http2 {
+    /*
+        Service for handling HTTP/2 connections negotiated with the client over TLS.
+        Every stream the client opens becomes an HTTP exchange that goes through the same
+            interceptor events as an HTTP/1.x request.
+        Requests are sent to the server over HTTP/1.1, one pooled connection per active stream.
+    */
+    class http2_service
+        : public base_service {
+    public:
+        // Receive windows are larger than the protocol default so uploads are not held back by round trips
+        static constexpr std::uint32_t connection_window_size = 16 * 1024 * 1024;
+        static constexpr std::uint32_t stream_window_size = 1024 * 1024;
+        static constexpr std::uint32_t max_header_list_size = 64 * 1024;
+
+        // Reading a streamed response body from the server pauses once this much is waiting for the client
+        static constexpr std::size_t stream_buffer_limit = 256 * 1024;
+
+    private:
+        // Parameters for securing server connections, copied from the ones the TLS service negotiated with
+        tls::openssl::ssl_context_args server_tls_args;
+
+        hpack::decoder decoder;
+        hpack::encoder encoder;
+
+        std::map<std::uint32_t, stream::ptr> streams;
+        std::uint32_t last_stream_id;
+
+        // Header block being collected from a HEADERS frame and its CONTINUATION frames
+        std::uint32_t header_block_stream;
+        bool header_block_end_stream;
+        std::string header_block;
+
+        // Settings sent by the client
+        std::int64_t initial_send_window;
+        std::uint32_t max_send_frame_size;
+
+        // Flow-control windows for the whole connection
+        std::int64_t send_window;
+        std::int64_t receive_window;
+        std::uint32_t unacknowledged_data;
+
+        // Frames that are sent before any DATA frame on the next write
+        streambuf queued_frames;
+
+        // Error from establishing TLS with the server, which every stream is answered with
+        std::optional<std::string> handshake_error;
+
+        bool preface_received;
+        bool writing;
+        bool goaway_received;
+        bool closing;
+        bool stopped;
+
+        // Asynchronous operations that still refer to the service
+        std::size_t pending_operations;
+
+        void read_client();
+        void on_read_client(const boost::system::error_code &error, std::size_t bytes_transferred);
+
+        /*
+            Handles every complete frame in the client input buffer.
+            Throws an HTTP/2 exception for errors that affect the whole connection.
+        */
+        void read_frames();
+        void handle_frame(const frame_header &header, const std::uint8_t *payload);
+        void on_data_frame(const frame_header &header, const std::uint8_t *payload);
+        void on_headers_frame(const frame_header &header, const std::uint8_t *payload);
+        void on_continuation_frame(const frame_header &header, const std::uint8_t *payload);
+        void on_rst_stream_frame(const frame_header &header, const std::uint8_t *payload);
+        void on_settings_frame(const frame_header &header, const std::uint8_t *payload);
+        void on_ping_frame(const frame_header &header, const std::uint8_t *payload);
+        void on_goaway_frame(const frame_header &header, const std::uint8_t *payload);
+        void on_window_update_frame(const frame_header &header, const std::uint8_t *payload);
+
+        /*
+            Decodes a complete header block, which either opens a new stream or ends one with trailers.
+        */
+        void on_header_block();
+
+        /*
+            Builds the stream's request from its decoded header list.
+            Returns false if the request is malformed.
+        */
+        bool make_request(stream &s, hpack::header_list &headers);
+
+        /*
+            Sends a window update once enough received data has been consumed.
+        */
+        void acknowledge_data(std::uint32_t stream_id, std::uint32_t &unacknowledged, std::int64_t &window, std::uint32_t size);
+
+        /*
+            Runs request interceptors once the client has sent the whole request, then sends it on.
+        */
+        void dispatch_request(const stream::ptr &s);
+
+        /*
+            Answers the request from the response cache if it can be.
+            Returns false if the request must be sent to the server, possibly with conditional headers added.
+        */
+        bool serve_from_cache(const stream::ptr &s);
+        void connect_server(const stream::ptr &s);
+        void on_connect_server(const stream::ptr &s, const boost::system::error_code &error);
+        void on_establish_tls_with_server(const stream::ptr &s, const boost::system::error_code &error);
+        void forward_request(const stream::ptr &s);
+        void on_forward_request(const stream::ptr &s, const boost::system::error_code &error, std::size_t bytes_transferred);
+
+        /*
+            Sends the request again on a new connection if it failed on a pooled one that went stale while idle.
+        */
+        bool retry_on_stale_server(const stream::ptr &s);
+        void read_response_head(const stream::ptr &s);
+        void on_read_response_head(const stream::ptr &s, const boost::system::error_code &error, std::size_t bytes_transferred);
+        void start_response_body(const stream::ptr &s);
+        void read_response_body(const stream::ptr &s);
+        void on_read_response_body(const stream::ptr &s, const boost::system::error_code &error, std::size_t bytes_transferred);
+
+        /*
+            Moves the response body the server has sent so far into the stream, and decides what to do with it.
+        */
+        void relay_response_body(const stream::ptr &s, bool eof);
+
+        /*
+            Starts sending a response body as it arrives, once it is known to be too large to hold.
+        */
+        void stream_response(const stream::ptr &s);
+
+        /*
+            Sends a response whose whole body has been read, after the response interceptors have run.
+        */
+        void forward_response(const stream::ptr &s);
+
+        /*
+            Queues the response head and its whole body, which is taken out of the message.
+        */
+        void queue_response(stream &s);
+
+        /*
+            Queues the response head as HEADERS and CONTINUATION frames.
+            Fields that only apply to a single HTTP/1.x connection are left out.
+        */
+        void send_response_head(stream &s, bool end_stream);
+
+        /*
+            Sends an HTML error response on the stream, or resets it if the response has already started.
+        */
+        void send_error_response(const stream::ptr &s, status response_status, std::string_view msg = "No message given");
+        void on_server_error(const stream::ptr &s, const boost::system::error_code &error, status response_status);
+
+        /*
+            Releases the stream's server connection once the response has been sent.
+        */
+        void finish_stream(const stream::ptr &s);
+        void reset_stream(std::uint32_t stream_id, error_type code);
+
+        /*
+            Drops a stream, cancelling anything it is waiting on.
+        */
+        void abandon_stream(const stream::ptr &s);
+
+        void queue_frame(frame_type type, std::uint8_t flags, std::uint32_t stream_id, std::string_view payload);
+        void queue_window_update(std::uint32_t stream_id, std::uint32_t increment);
+
+        /*
+            Writes queued frames and as much response data as the flow-control windows allow.
+        */
+        void send_frames();
+        void on_send_frames(const boost::system::error_code &error, std::size_t bytes_transferred);
+
+        /*
+            Tells the client the connection is closing because of an error, then closes it.
+        */
+        void send_goaway(error_type code, std::string_view debug_data = { });
+
+        /*
+            Closes the connection, stopping the service once every pending operation has finished.
+        */
+        void close_connection();
+
+        /*
+            Marks the connection as closing and abandons every open stream.
+        */
+        void drop_streams();
+        void stop_when_finished();
+
+    public:
+        http2_service(connection::connection_flow &flow, connection_handler &owner,
+            tcp::intercept::interceptor_manager &interceptors, tls::openssl::ssl_context_args &server_tls_args);
+
+        void start() override;
+    };
+}
\ No newline at end of file
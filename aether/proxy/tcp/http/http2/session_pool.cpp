@@ -0,0 +1,100 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "session_pool.hpp"
+
+#include <algorithm>
+#include <aether/program/options.hpp>
+#include <aether/proxy/connection/upstream_pool.hpp>
+
+namespace proxy::tcp::http::http2 {
+    boost::asio::execution_context::id session_pool::id;
+
+    session_pool::session_pool(boost::asio::io_context &ioc)
+        : boost::asio::execution_context::service(ioc),
+        ioc(ioc),
+        sessions(),
+        max_sessions_per_host(program::options::instance().http2_upstream_connections)
+    { }
+
+    void session_pool::shutdown() {
+        sessions.clear();
+    }
+
+    client_session::ptr session_pool::find(const std::string &key) const {
+        auto it = sessions.find(key);
+        if (it == sessions.end()) {
+            return nullptr;
+        }
+
+        client_session::ptr best;
+        for (const auto &session : it->second) {
+            if (session->usable() && (!best || session->load() < best->load())) {
+                best = session;
+            }
+        }
+        return best;
+    }
+
+    client_session::ptr session_pool::acquire(const std::string &host, port_t port, const tls::openssl::ssl_context_args &tls_args) {
+        std::string key = connection::upstream_pool::make_key(host, port, connection::upstream_pool::tls_key(tls_args));
+        client_session::ptr best = find(key);
+        if (best && best->has_capacity()) {
+            return best;
+        }
+
+        auto &list = sessions[key];
+        if (best && list.size() >= max_sessions_per_host) {
+            return best;
+        }
+
+        auto session = std::make_shared<client_session>(ioc, host, port, tls_args);
+        list.push_back(session);
+        session->connect();
+        return session;
+    }
+
+    client_session::ptr session_pool::adopt(connection::server_connection &established, const tls::openssl::ssl_context_args &tls_args) {
+        auto session = std::make_shared<client_session>(ioc, established.get_host(), established.get_port(), tls_args);
+        auto &list = sessions[session->get_key()];
+
+        // Flows that connected at the same time share the sessions that were kept
+        if (list.size() >= max_sessions_per_host) {
+            client_session::ptr best;
+            for (const auto &other : list) {
+                if (other->connected() && other->usable() && (!best || other->load() < best->load())) {
+                    best = other;
+                }
+            }
+            if (best) {
+                // Taken over first, so the flow's connection is left as if it was never secured
+                auto discarded = std::make_shared<connection::server_connection>(ioc);
+                discarded->take_over(established);
+                discarded->disconnect();
+                return best;
+            }
+        }
+
+        list.push_back(session);
+        session->adopt(established);
+        return session;
+    }
+
+    void session_pool::remove(const client_session &session) {
+        auto it = sessions.find(session.get_key());
+        if (it == sessions.end()) {
+            return;
+        }
+
+        auto &list = it->second;
+        list.erase(std::remove_if(list.begin(), list.end(),
+            [&session](const client_session::ptr &other) { return other.get() == &session; }), list.end());
+        if (list.empty()) {
+            sessions.erase(it);
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <boost/asio.hpp>
+
+#include <aether/proxy/types.hpp>
+#include <aether/proxy/tcp/http/http2/client_session.hpp>
+#include <aether/proxy/tcp/tls/openssl/ssl_context.hpp>
+
+namespace proxy::tcp::http::http2 {
+    /*
+        HTTP/2 connections to servers, shared by every flow on the same io_context.
+        Attached to each io_context as an Asio service, so sessions are never used from two threads.
+        Sessions are keyed like upstream pool connections, by host, port, and TLS parameters.
+        Each key holds at most --http2-upstream-connections sessions.
+    */
+    class session_pool
+        : public boost::asio::execution_context::service {
+    public:
+        static boost::asio::execution_context::id id;
+
+    private:
+        boost::asio::io_context &ioc;
+        std::unordered_map<std::string, std::vector<client_session::ptr>> sessions;
+        std::size_t max_sessions_per_host;
+
+        void shutdown() override;
+
+    public:
+        explicit session_pool(boost::asio::io_context &ioc);
+
+        /*
+            Returns the least busy usable session for the given key, if there is one.
+        */
+        client_session::ptr find(const std::string &key) const;
+
+        /*
+            Returns a session to send a request on.
+            A new session is connected when every existing one is at its stream limit and more are allowed.
+            Otherwise, the least busy session is returned, where the request may wait for a free stream.
+        */
+        client_session::ptr acquire(const std::string &host, port_t port, const tls::openssl::ssl_context_args &tls_args);
+
+        /*
+            Makes an established HTTP/2 connection available to other flows.
+            The connection is taken over by the new session.
+            If the server already has as many established sessions as allowed, the connection is closed
+                and the least busy of them is returned instead.
+        */
+        client_session::ptr adopt(connection::server_connection &established, const tls::openssl::ssl_context_args &tls_args);
+
+        /*
+            Removes a session that can no longer be used.
+        */
+        void remove(const client_session &session);
+    };
+}
\ No newline at end of file
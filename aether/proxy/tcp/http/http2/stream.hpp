@@ -0,0 +1,95 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <boost/noncopyable.hpp>
+
+#include <aether/proxy/types.hpp>
+#include <aether/proxy/connection/server_connection.hpp>
+#include <aether/proxy/tcp/http/exchange.hpp>
+#include <aether/proxy/tcp/http/cache/response_cache.hpp>
+#include <aether/proxy/tcp/http/http1/http_parser.hpp>
+
+namespace proxy::tcp::http::http2 {
+    /*
+        State of one HTTP/2 stream, which carries a single request and its response.
+        Each stream is forwarded on its own HTTP/1.1 connection to the server.
+    */
+    struct stream
+        : private boost::noncopyable {
+        using ptr = std::shared_ptr<stream>;
+
+        /*
+            How the response body is handled as it is read from the server.
+        */
+        enum class body_mode {
+            // Kept until it ends so that interceptors see it, or until it grows past the streaming threshold
+            held,
+            // Kept until it ends, whatever its size
+            buffered,
+            // Sent to the client as it arrives
+            streamed
+        };
+
+        const std::uint32_t id;
+
+        exchange exch;
+        http1::http_parser parser;
+        std::shared_ptr<connection::server_connection> server;
+
+        // Flow-control windows for this stream
+        std::int64_t send_window;
+        std::int64_t receive_window;
+        std::uint32_t unacknowledged_data;
+
+        // The client has ended its side of the stream
+        bool request_done;
+        // The response head has been queued for the client
+        bool headers_sent;
+        // The whole response body is in response_data
+        bool body_done;
+        // The final frame of the stream has been queued for the client
+        bool end_stream_sent;
+        // The stream was reset or the connection is closing, so pending handlers must drop it
+        bool abandoned;
+
+        bool reading_server;
+        bool retried;
+        body_mode mode;
+        cache::lookup_result cache_state;
+
+        // Request body, collected from DATA frames until the client ends the stream
+        std::string request_body;
+
+        // Response body data waiting to be sent, with any chunk framing removed
+        streambuf response_data;
+
+        stream(std::uint32_t id, std::int64_t send_window, std::int64_t receive_window)
+            : id(id),
+            exch(),
+            parser(exch),
+            server(),
+            send_window(send_window),
+            receive_window(receive_window),
+            unacknowledged_data(0),
+            request_done(false),
+            headers_sent(false),
+            body_done(false),
+            end_stream_sent(false),
+            abandoned(false),
+            reading_server(false),
+            retried(false),
+            mode(body_mode::held),
+            cache_state(),
+            request_body(),
+            response_data()
+        { }
+    };
+}
\ No newline at end of file
@@ -0,0 +1,281 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "header_collection.hpp"
+
+#include <algorithm>
+
+#include <aether/util/string.hpp>
+
+namespace proxy::tcp::http {
+    namespace {
+        bool list_has_token(std::string_view list, std::string_view token, bool case_insensitive) {
+            while (true) {
+                std::size_t comma = list.find(',');
+                std::string_view item = util::string::trim(list.substr(0, comma));
+                if (case_insensitive ? util::string::iequals_fn(item, token) : item == token) {
+                    return true;
+                }
+                if (comma == std::string_view::npos) {
+                    return false;
+                }
+                list.remove_prefix(comma + 1);
+            }
+        }
+    }
+
+    header_collection::const_iterator::const_iterator(const header_collection *headers, std::size_t index)
+        : headers(headers),
+        index(index)
+    { }
+
+    header_collection::field header_collection::const_iterator::operator*() const {
+        return headers->make_field(headers->entries[index]);
+    }
+
+    header_collection::const_iterator &header_collection::const_iterator::operator++() {
+        ++index;
+        return *this;
+    }
+
+    header_collection::const_iterator header_collection::const_iterator::operator++(int) {
+        const_iterator previous = *this;
+        ++index;
+        return previous;
+    }
+
+    bool header_collection::const_iterator::operator==(const const_iterator &other) const {
+        return headers == other.headers && index == other.index;
+    }
+
+    bool header_collection::const_iterator::operator!=(const const_iterator &other) const {
+        return !(*this == other);
+    }
+
+    header_collection::header_collection()
+        : arena(),
+        entries()
+    {
+        first_entry.fill(no_entry);
+    }
+
+    header_collection::field header_collection::make_field(const entry &e) const {
+        const char *name = arena.data() + e.offset;
+        return { { name, e.name_length }, { name + e.name_length, e.value_length } };
+    }
+
+    std::size_t header_collection::find_index(std::string_view name, header_id id, std::size_t from) const {
+        if (id != header_id::unknown) {
+            if (from == 0) {
+                std::uint32_t first = first_entry[static_cast<std::size_t>(id)];
+                return first == no_entry ? entries.size() : first;
+            }
+            for (std::size_t i = from; i < entries.size(); ++i) {
+                if (entries[i].id == id) {
+                    return i;
+                }
+            }
+            return entries.size();
+        }
+
+        // A well-known name can never match an unknown one, so only those fields are compared
+        for (std::size_t i = from; i < entries.size(); ++i) {
+            if (entries[i].id == header_id::unknown && util::string::iequals_fn(make_field(entries[i]).name, name)) {
+                return i;
+            }
+        }
+        return entries.size();
+    }
+
+    void header_collection::rebuild_index() {
+        first_entry.fill(no_entry);
+        for (std::size_t i = entries.size(); i-- > 0; ) {
+            if (entries[i].id != header_id::unknown) {
+                first_entry[static_cast<std::size_t>(entries[i].id)] = static_cast<std::uint32_t>(i);
+            }
+        }
+    }
+
+    void header_collection::add(std::string_view name, std::string_view value) {
+        // Appending may move the arena out from under a view into it
+        if (name.data() >= arena.data() && name.data() < arena.data() + arena.size()) {
+            add(std::string(name), value);
+            return;
+        }
+        if (value.data() >= arena.data() && value.data() < arena.data() + arena.size()) {
+            add(name, std::string(value));
+            return;
+        }
+
+        entry e { static_cast<std::uint32_t>(arena.size()), static_cast<std::uint32_t>(name.length()),
+            static_cast<std::uint32_t>(value.length()), convert::to_header_id(name) };
+        arena.append(name);
+        arena.append(value);
+
+        if (e.id != header_id::unknown && first_entry[static_cast<std::size_t>(e.id)] == no_entry) {
+            first_entry[static_cast<std::size_t>(e.id)] = static_cast<std::uint32_t>(entries.size());
+        }
+        entries.push_back(e);
+    }
+
+    void header_collection::set(std::string_view name, std::string_view value) {
+        if (value.data() >= arena.data() && value.data() < arena.data() + arena.size()) {
+            set(name, std::string(value));
+            return;
+        }
+
+        header_id id = convert::to_header_id(name);
+        std::size_t index = find_index(name, id, 0);
+        if (index == entries.size()) {
+            add(name, value);
+            return;
+        }
+
+        // Overwrite the value in place if it fits, otherwise move the field to the end of the arena
+        entry &e = entries[index];
+        if (value.length() <= e.value_length) {
+            std::copy(value.begin(), value.end(), arena.begin() + e.offset + e.name_length);
+        }
+        else {
+            arena.reserve(arena.size() + e.name_length + value.length());
+            std::uint32_t offset = static_cast<std::uint32_t>(arena.size());
+            arena.append(arena.data() + e.offset, e.name_length);
+            arena.append(value);
+            e.offset = offset;
+        }
+        e.value_length = static_cast<std::uint32_t>(value.length());
+
+        auto duplicates = std::remove_if(entries.begin() + index + 1, entries.end(),
+            [this, &name, id](const entry &other) {
+                return id != header_id::unknown ? other.id == id
+                    : other.id == header_id::unknown && util::string::iequals_fn(make_field(other).name, name);
+            });
+        if (duplicates != entries.end()) {
+            entries.erase(duplicates, entries.end());
+            rebuild_index();
+        }
+    }
+
+    void header_collection::remove(std::string_view name) {
+        header_id id = convert::to_header_id(name);
+        std::size_t index = find_index(name, id, 0);
+        if (index == entries.size()) {
+            return;
+        }
+
+        auto removed = std::remove_if(entries.begin() + index, entries.end(),
+            [this, &name, id](const entry &e) {
+                return id != header_id::unknown ? e.id == id
+                    : e.id == header_id::unknown && util::string::iequals_fn(make_field(e).name, name);
+            });
+        entries.erase(removed, entries.end());
+        rebuild_index();
+
+        // Reclaim the arena once most of it belongs to removed fields
+        std::size_t live = 0;
+        for (const entry &e : entries) {
+            live += e.name_length + e.value_length;
+        }
+        if (live * 2 < arena.size()) {
+            std::string compacted;
+            compacted.reserve(live);
+            for (entry &e : entries) {
+                std::uint32_t offset = static_cast<std::uint32_t>(compacted.size());
+                compacted.append(arena, e.offset, e.name_length + e.value_length);
+                e.offset = offset;
+            }
+            arena = std::move(compacted);
+        }
+    }
+
+    void header_collection::clear() {
+        arena.clear();
+        entries.clear();
+        first_entry.fill(no_entry);
+    }
+
+    bool header_collection::contains(std::string_view name) const {
+        return find_index(name, convert::to_header_id(name), 0) != entries.size();
+    }
+
+    bool header_collection::contains(header_id id) const {
+        return id != header_id::unknown && first_entry[static_cast<std::size_t>(id)] != no_entry;
+    }
+
+    std::optional<std::string_view> header_collection::find(std::string_view name) const {
+        std::size_t index = find_index(name, convert::to_header_id(name), 0);
+        if (index == entries.size()) {
+            return { };
+        }
+        return make_field(entries[index]).value;
+    }
+
+    std::optional<std::string_view> header_collection::find(header_id id) const {
+        if (!contains(id)) {
+            return { };
+        }
+        return make_field(entries[first_entry[static_cast<std::size_t>(id)]]).value;
+    }
+
+    header_collection::value_list header_collection::find_all(std::string_view name) const {
+        header_id id = convert::to_header_id(name);
+        value_list values;
+        for (std::size_t i = find_index(name, id, 0); i < entries.size(); i = find_index(name, id, i + 1)) {
+            values.push_back(make_field(entries[i]).value);
+        }
+        return values;
+    }
+
+    bool header_collection::has_value(std::string_view name, std::string_view value, bool case_insensitive) const {
+        header_id id = convert::to_header_id(name);
+        for (std::size_t i = find_index(name, id, 0); i < entries.size(); i = find_index(name, id, i + 1)) {
+            std::string_view field_value = make_field(entries[i]).value;
+            if (case_insensitive ? util::string::iequals_fn(field_value, value) : field_value == value) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool header_collection::has_token(std::string_view name, std::string_view token, bool case_insensitive) const {
+        header_id id = convert::to_header_id(name);
+        for (std::size_t i = find_index(name, id, 0); i < entries.size(); i = find_index(name, id, i + 1)) {
+            if (list_has_token(make_field(entries[i]).value, token, case_insensitive)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool header_collection::has_token(header_id id, std::string_view token, bool case_insensitive) const {
+        if (id == header_id::unknown) {
+            return false;
+        }
+        for (std::size_t i = find_index({ }, id, 0); i < entries.size(); i = find_index({ }, id, i + 1)) {
+            if (list_has_token(make_field(entries[i]).value, token, case_insensitive)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::size_t header_collection::size() const {
+        return entries.size();
+    }
+
+    bool header_collection::empty() const {
+        return entries.empty();
+    }
+
+    header_collection::const_iterator header_collection::begin() const {
+        return { this, 0 };
+    }
+
+    header_collection::const_iterator header_collection::end() const {
+        return { this, entries.size() };
+    }
+}
\ No newline at end of file
@@ -0,0 +1,144 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <boost/container/small_vector.hpp>
+
+#include <aether/proxy/tcp/http/message/header_id.hpp>
+
+namespace proxy::tcp::http {
+    /*
+        Ordered collection of HTTP header fields.
+        Fields are kept in the order they were added, so they are written out the way they came in.
+        Names and values are stored back to back in a single arena owned by the collection.
+        Well-known names are indexed by their ID, so looking them up does not search the fields.
+        Views returned by the collection are only valid until it is modified.
+    */
+    class header_collection {
+    public:
+        /*
+            A single header field, viewed in place.
+        */
+        struct field {
+            std::string_view name;
+            std::string_view value;
+        };
+
+        /*
+            All values of one header, held inline for the common case of only a few.
+        */
+        using value_list = boost::container::small_vector<std::string_view, 4>;
+
+    private:
+        struct entry {
+            // The value is stored right after the name
+            std::uint32_t offset;
+            std::uint32_t name_length;
+            std::uint32_t value_length;
+            header_id id;
+        };
+
+        static constexpr std::uint32_t no_entry = UINT32_MAX;
+
+        std::string arena;
+        boost::container::small_vector<entry, 16> entries;
+
+        // Index of the first field for each well-known name
+        std::array<std::uint32_t, well_known_header_count> first_entry;
+
+        field make_field(const entry &e) const;
+
+        /*
+            Finds the next field with the given name, starting at the given index.
+            Returns the number of fields if there is none.
+        */
+        std::size_t find_index(std::string_view name, header_id id, std::size_t from) const;
+
+        void rebuild_index();
+
+    public:
+        class const_iterator {
+        private:
+            const header_collection *headers;
+            std::size_t index;
+
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = field;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const field *;
+            using reference = field;
+
+            const_iterator(const header_collection *headers, std::size_t index);
+
+            field operator*() const;
+            const_iterator &operator++();
+            const_iterator operator++(int);
+            bool operator==(const const_iterator &other) const;
+            bool operator!=(const const_iterator &other) const;
+        };
+
+        header_collection();
+
+        /*
+            Adds a field after all existing fields.
+        */
+        void add(std::string_view name, std::string_view value);
+
+        /*
+            Sets a header to a single value.
+            The first field of the name keeps its position, any others are removed.
+        */
+        void set(std::string_view name, std::string_view value);
+
+        /*
+            Removes all fields of the given name.
+        */
+        void remove(std::string_view name);
+
+        void clear();
+
+        bool contains(std::string_view name) const;
+        bool contains(header_id id) const;
+
+        /*
+            Gets the first value of the given header.
+        */
+        std::optional<std::string_view> find(std::string_view name) const;
+        std::optional<std::string_view> find(header_id id) const;
+
+        /*
+            Gets every value of the given header, in order.
+        */
+        value_list find_all(std::string_view name) const;
+
+        /*
+            Checks if any value of the header is exactly the given value.
+        */
+        bool has_value(std::string_view name, std::string_view value, bool case_insensitive = false) const;
+
+        /*
+            Checks if any value of the header contains the token in its comma-separated list.
+            Does not allocate.
+        */
+        bool has_token(std::string_view name, std::string_view token, bool case_insensitive = false) const;
+        bool has_token(header_id id, std::string_view token, bool case_insensitive = false) const;
+
+        std::size_t size() const;
+        bool empty() const;
+
+        const_iterator begin() const;
+        const_iterator end() const;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,88 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Header names that are looked up often enough to be indexed in every message
+#define HTTP_WELL_KNOWN_HEADERS(X) \
+X(accept, "Accept") \
+X(accept_encoding, "Accept-Encoding") \
+X(accept_language, "Accept-Language") \
+X(access_control_allow_origin, "Access-Control-Allow-Origin") \
+X(age, "Age") \
+X(authorization, "Authorization") \
+X(cache_control, "Cache-Control") \
+X(connection, "Connection") \
+X(content_encoding, "Content-Encoding") \
+X(content_length, "Content-Length") \
+X(content_range, "Content-Range") \
+X(content_type, "Content-Type") \
+X(cookie, "Cookie") \
+X(date, "Date") \
+X(etag, "ETag") \
+X(expect, "Expect") \
+X(expires, "Expires") \
+X(host, "Host") \
+X(if_modified_since, "If-Modified-Since") \
+X(if_none_match, "If-None-Match") \
+X(keep_alive, "Keep-Alive") \
+X(last_modified, "Last-Modified") \
+X(location, "Location") \
+X(origin, "Origin") \
+X(pragma, "Pragma") \
+X(proxy_authorization, "Proxy-Authorization") \
+X(proxy_connection, "Proxy-Connection") \
+X(range, "Range") \
+X(referer, "Referer") \
+X(sec_websocket_accept, "Sec-WebSocket-Accept") \
+X(sec_websocket_extensions, "Sec-WebSocket-Extensions") \
+X(sec_websocket_key, "Sec-WebSocket-Key") \
+X(sec_websocket_protocol, "Sec-WebSocket-Protocol") \
+X(sec_websocket_version, "Sec-WebSocket-Version") \
+X(server, "Server") \
+X(set_cookie, "Set-Cookie") \
+X(te, "TE") \
+X(trailer, "Trailer") \
+X(transfer_encoding, "Transfer-Encoding") \
+X(upgrade, "Upgrade") \
+X(user_agent, "User-Agent") \
+X(vary, "Vary") \
+X(via, "Via") \
+X(x_forwarded_for, "X-Forwarded-For")
+
+namespace proxy::tcp::http {
+    /*
+        Enumeration type for well-known header names.
+        Any other header name is unknown.
+    */
+    enum class header_id : std::uint8_t {
+#define X(name, string) name,
+        HTTP_WELL_KNOWN_HEADERS(X)
+#undef X
+        unknown
+    };
+
+    constexpr std::size_t well_known_header_count = static_cast<std::size_t>(header_id::unknown);
+
+    namespace convert {
+        /*
+            Converts a well-known header ID to its canonical name.
+            Returns an empty string for header_id::unknown.
+        */
+        std::string_view to_string(header_id id);
+
+        /*
+            Converts a header name to its ID, ignoring case.
+            Returns header_id::unknown if the name is not well known.
+        */
+        header_id to_header_id(std::string_view name);
+    }
+}
\ No newline at end of file
@@ -5,10 +5,16 @@
 
 *********************************************/
 
+#include "header_id.hpp"
 #include "method.hpp"
 #include "status.hpp"
 #include "version.hpp"
 
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <vector>
+
 // Function implementations for converting HTTP types to string and vice versa
 
 namespace proxy::tcp::http {
@@ -80,10 +86,8 @@ namespace proxy::tcp::http {
 
         status to_status_from_code(std::string_view str) {
             std::size_t code;
-            try {
-                code = boost::lexical_cast<std::size_t>(str);
-            }
-            catch (const boost::bad_lexical_cast &) {
+            auto result = std::from_chars(str.data(), str.data() + str.size(), code);
+            if (result.ec != std::errc() || result.ptr != str.data() + str.size()) {
                 throw error::http::invalid_status_exception { };
             }
             return to_status_from_code(code);
@@ -93,6 +97,47 @@ namespace proxy::tcp::http {
             // Allow invalid HTTP statuses
             return static_cast<status>(code);
         }
+
+        std::string_view to_string(header_id id) {
+            switch (id) {
+#define X(name, string) case header_id::name: return string;
+                HTTP_WELL_KNOWN_HEADERS(X)
+#undef X
+                case header_id::unknown: break;
+            }
+            return { };
+        }
+
+        // Well-known header names grouped by length, so a lookup only compares names that could match
+        struct header_id_table {
+            static constexpr std::size_t max_length = 32;
+
+            std::array<std::vector<std::pair<std::string_view, header_id>>, max_length + 1> by_length;
+
+            header_id_table() {
+#define X(name, string) by_length[std::string_view(string).length()].emplace_back(string, header_id::name);
+                HTTP_WELL_KNOWN_HEADERS(X)
+#undef X
+            }
+        };
+
+        header_id to_header_id(std::string_view name) {
+            static const header_id_table table;
+            if (name.length() > header_id_table::max_length) {
+                return header_id::unknown;
+            }
+            for (const auto &[known_name, id] : table.by_length[name.length()]) {
+                // ASCII case folding is enough for header names, and much cheaper than std::tolower
+                bool equal = std::equal(name.begin(), name.end(), known_name.begin(),
+                    [](char a, char b) {
+                        return a == b || ((a | 0x20) == (b | 0x20) && (b | 0x20) >= 'a' && (b | 0x20) <= 'z');
+                    });
+                if (equal) {
+                    return id;
+                }
+            }
+            return header_id::unknown;
+        }
     }
 
     // Output operators for HTTP types
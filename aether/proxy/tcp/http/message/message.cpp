@@ -14,9 +14,12 @@ namespace proxy::tcp::http {
 
     message::message(version _version, std::initializer_list<header_pair> headers, const std::string &body)
         : _version(_version),
-        headers(headers),
         body(body)
-    { }
+    {
+        for (const auto &[name, value] : headers) {
+            this->headers.add(name, value);
+        }
+    }
 
     message::message(const message &other) {
         *this = other;
@@ -34,7 +37,7 @@ namespace proxy::tcp::http {
     }
 
     message &message::operator=(message &&other) noexcept {
-        headers = other.headers;
+        headers = std::move(other.headers);
         _version = other._version;
         body = std::move(other.body);
         return *this;
@@ -60,122 +63,117 @@ namespace proxy::tcp::http {
         return body.length();
     }
 
-    const message::headers_map &message::all_headers() const {
+    const header_collection &message::all_headers() const {
         return headers;
     }
 
     void message::add_header(std::string_view name, std::string_view value) {
-        headers.insert({ name.data(), value.data() });
+        headers.add(name, value);
     }
 
-    void message::set_header_to_value(const std::string &name, std::string_view value) {
-        remove_header(name);
-        add_header(name, value);
+    void message::set_header_to_value(std::string_view name, std::string_view value) {
+        headers.set(name, value);
     }
 
-    void message::remove_header(const std::string &name) {
-        headers.erase(name);
+    void message::remove_header(std::string_view name) {
+        headers.remove(name);
     }
 
-    bool message::has_header(const std::string &name) const {
-        return headers.find(name) != headers.end();
+    bool message::has_header(std::string_view name) const {
+        return headers.contains(name);
     }
 
-    bool message::header_is_nonempty(const std::string &name) const {
-        auto equal_range = headers.equal_range(name);
-        return std::all_of(equal_range.first, equal_range.second,
-            [](auto pair) { return !pair.second.empty(); });
+    bool message::has_header(header_id id) const {
+        return headers.contains(id);
     }
 
-    bool message::header_has_value(const std::string &name, std::string_view value, bool case_insensitive) const {
-        auto equal_range = headers.equal_range(name);
-        if (case_insensitive) {
-            return std::any_of(equal_range.first, equal_range.second,
-                [&value](auto pair) { return util::string::iequals_fn(pair.second, value); });
-        }
-        else {
-            return std::any_of(equal_range.first, equal_range.second,
-                [&value](auto pair) { return pair.second == value; });
-        }
+    bool message::header_is_nonempty(std::string_view name) const {
+        auto values = headers.find_all(name);
+        return std::all_of(values.begin(), values.end(),
+            [](std::string_view value) { return !value.empty(); });
     }
-    
-    bool message::header_has_token(const std::string &name, std::string_view value, bool case_insensitive) const {
-        auto equal_range = headers.equal_range(name);
-        if (case_insensitive) {
-            return std::any_of(equal_range.first, equal_range.second,
-                [&value](const auto &pair) {
-                    std::vector<std::string> tokens = util::string::split_trim(pair.second, ',');
-                    return std::any_of(tokens.begin(), tokens.end(),
-                        [&value](const auto &str) {
-                            return util::string::iequals_fn(str, value);
-                        });
-                });
-        }
-        else {
-            return std::any_of(equal_range.first, equal_range.second,
-                [&value](const auto &pair) {
-                    std::vector<std::string> tokens = util::string::split_trim(pair.second, ',');
-                    return std::any_of(tokens.begin(), tokens.end(),
-                        [&value](const auto &str) {
-                            return str == value;
-                        });
-                });
-        }
+
+    bool message::header_has_value(std::string_view name, std::string_view value, bool case_insensitive) const {
+        return headers.has_value(name, value, case_insensitive);
+    }
+
+    bool message::header_has_token(std::string_view name, std::string_view value, bool case_insensitive) const {
+        return headers.has_token(name, value, case_insensitive);
     }
 
-    std::string message::get_header(const std::string &name) const {
-        auto it = headers.find(name);
-        if (it == headers.end()) {
-            throw error::http::header_not_found_exception { "Header \"" + name + "\" does not exist" };
+    bool message::header_has_token(header_id id, std::string_view value, bool case_insensitive) const {
+        return headers.has_token(id, value, case_insensitive);
+    }
+
+    std::string message::get_header(std::string_view name) const {
+        auto value = headers.find(name);
+        if (!value.has_value()) {
+            throw error::http::header_not_found_exception { "Header \"" + std::string(name) + "\" does not exist" };
         }
-        return it->second;
+        return std::string(value.value());
     }
 
-    std::optional<std::string> message::get_optional_header(const std::string &name) const {
-        auto it = headers.find(name);
-        return it == headers.end() ? std::optional<std::string> { } : it->second;
+    std::optional<std::string> message::get_optional_header(std::string_view name) const {
+        auto value = headers.find(name);
+        return value.has_value() ? std::string(value.value()) : std::optional<std::string> { };
     }
 
-    std::vector<std::string> message::get_all_of_header(const std::string &name) const {
-        auto equal_range = headers.equal_range(name);
-        std::vector<std::string> out;
-        std::transform(equal_range.first, equal_range.second, std::back_inserter(out),
-            [](auto it) { return it.second; });
-        return out;
+    std::vector<std::string> message::get_all_of_header(std::string_view name) const {
+        auto values = headers.find_all(name);
+        return std::vector<std::string>(values.begin(), values.end());
     }
 
     void message::set_content_length() {
-        add_header("Content-Length", boost::lexical_cast<std::string>(content_length()));
+        set_header_to_value("Content-Length", boost::lexical_cast<std::string>(content_length()));
     }
 
 
     bool message::should_close_connection() const {
-        if (has_header("Connection")) {
-            auto connection_header = get_header("Connection");
-            if (connection_header == "keep-alive") {
-                return false;
-            }
-            if (connection_header == "close") {
-                return true;
-            }
+        if (headers.has_token(header_id::connection, "keep-alive", true)) {
+            return false;
+        }
+        if (headers.has_token(header_id::connection, "close", true)) {
+            return true;
         }
         return _version == version::http1_0;
     }
 
-    std::ostream &operator<<(std::ostream &out, const message &msg) {
-        for (const auto &[name, value] : msg.headers) {
-            out << name << ": " << value << message::CRLF;
+    void message::write_headers(std::ostream &out) const {
+        for (const auto &field : headers) {
+            out << field.name << ": " << field.value << CRLF;
         }
-        out << message::CRLF;
+        out << CRLF;
+    }
+
+    message::body_buffers message::write_body(std::ostream &out) const {
+        static constexpr std::string_view last_chunk = "0\r\n\r\n";
+        static constexpr std::string_view end_of_chunk_body = "\r\n0\r\n\r\n";
 
-        if (msg.header_has_token("Transfer-Encoding", "chunked")) {
-            out << std::hex << msg.body.length() << message::CRLF;
-            out << msg.body;
-            out << message::CRLF;
-            out << '0' << message::CRLF_CRLF;
+        if (!headers.has_token(header_id::transfer_encoding, "chunked")) {
+            if (body.length() <= copied_body_limit) {
+                out << body;
+                return { };
+            }
+            return { boost::asio::buffer(body), boost::asio::const_buffer() };
         }
-        else {
-            out << msg.body;
+
+        // The whole body is sent as a single chunk
+        if (body.empty()) {
+            out << last_chunk;
+            return { };
+        }
+        out << std::hex << body.length() << std::dec << CRLF;
+        if (body.length() <= copied_body_limit) {
+            out << body << end_of_chunk_body;
+            return { };
+        }
+        return { boost::asio::buffer(body), boost::asio::buffer(end_of_chunk_body.data(), end_of_chunk_body.length()) };
+    }
+
+    std::ostream &operator<<(std::ostream &out, const message &msg) {
+        msg.write_headers(out);
+        for (const auto &buffer : msg.write_body(out)) {
+            out.write(static_cast<const char *>(buffer.data()), buffer.size());
         }
         return out;
     }
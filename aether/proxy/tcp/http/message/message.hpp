@@ -7,16 +7,18 @@
 
 #pragma once
 
-#include <map>
+#include <array>
 #include <string>
 #include <vector>
 #include <optional>
 #include <string_view>
 #include <sstream>
+#include <boost/asio/buffer.hpp>
 
 #include <aether/proxy/types.hpp>
 #include <aether/proxy/error/exceptions.hpp>
 #include <aether/util/string.hpp>
+#include <aether/proxy/tcp/http/message/header_collection.hpp>
 #include <aether/proxy/tcp/http/message/version.hpp>
 
 namespace proxy::tcp::http {
@@ -31,13 +33,33 @@ namespace proxy::tcp::http {
         static constexpr char SP = ' ';
 
         using header_pair = std::pair<const std::string, std::string>;
-        using headers_map = std::multimap<std::string, std::string, util::string::iless>;
+
+        /*
+            Buffers for the part of a message that follows what was written to a stream.
+            They point into the message itself, so it must not change until they are written.
+        */
+        using body_buffers = std::array<boost::asio::const_buffer, 2>;
+
+        // Bodies up to this size are copied next to the head rather than written from the message
+        static constexpr std::size_t copied_body_limit = 16 * 1024;
 
     protected:
         version _version;
-        headers_map headers;
+        header_collection headers;
         std::string body;
 
+        /*
+            Writes the header block, including the blank line that ends it.
+        */
+        void write_headers(std::ostream &out) const;
+
+        /*
+            Writes the body and its chunk framing after the head.
+            A small body is copied into the stream, a large one is returned as buffers instead
+                so it can be sent straight from the message in the same gathered write as the head.
+        */
+        body_buffers write_body(std::ostream &out) const;
+
     public:
         message();
         message(version _version, std::initializer_list<header_pair> headers, const std::string &body);
@@ -51,53 +73,55 @@ namespace proxy::tcp::http {
         void set_body(std::string_view body);
         std::string get_body() const;
         std::size_t content_length() const;
-        const headers_map &all_headers() const;
+        const header_collection &all_headers() const;
 
         void add_header(std::string_view name, std::string_view value = "");
 
         /*
             Sets a header to a single value. All previous headers of the same name are removed.
         */
-        void set_header_to_value(const std::string &name, std::string_view value);
+        void set_header_to_value(std::string_view name, std::string_view value);
 
         /*
             Removes all values for the given header.
         */
-        void remove_header(const std::string &name);
+        void remove_header(std::string_view name);
 
-        bool has_header(const std::string &name) const;
+        bool has_header(std::string_view name) const;
+        bool has_header(header_id id) const;
 
         /*
             Checks if header has any value except an empty string.
         */
-        bool header_is_nonempty(const std::string &name) const;
+        bool header_is_nonempty(std::string_view name) const;
 
         /*
             Checks if a header was given the value exactly.
         */
-        bool header_has_value(const std::string &name, std::string_view value, bool case_insensitive = false) const;
+        bool header_has_value(std::string_view name, std::string_view value, bool case_insensitive = false) const;
 
         /*
             Checks if a header was given the value in a comma-separated list.
         */
-        bool header_has_token(const std::string &name, std::string_view value, bool case_insensitive = false) const;
+        bool header_has_token(std::string_view name, std::string_view value, bool case_insensitive = false) const;
+        bool header_has_token(header_id id, std::string_view value, bool case_insensitive = false) const;
 
         /*
             Gets the first value for a given header, throwing if it does not exist.
             Since headers can be duplicated, it is safer to use get_all_of_header.
         */
-        std::string get_header(const std::string &name) const;
+        std::string get_header(std::string_view name) const;
 
         /*
             Gets the first value for an optional header.
         */
-        std::optional<std::string> get_optional_header(const std::string &name) const;
+        std::optional<std::string> get_optional_header(std::string_view name) const;
 
         /*
             Returns a vector of all the values for a given header.
             Will be empty if header does not exist.
         */
-        std::vector<std::string> get_all_of_header(const std::string &name) const;
+        std::vector<std::string> get_all_of_header(std::string_view name) const;
 
         /*
             Calculates content length and sets the Content-Length header accordingly.
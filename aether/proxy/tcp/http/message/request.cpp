@@ -92,6 +92,20 @@ namespace proxy::tcp::http {
         set_header_to_value("Cookie", cookies.request_string());
     }
 
+    bool request::is_idempotent() const {
+        switch (_method) {
+            case method::GET:
+            case method::HEAD:
+            case method::OPTIONS:
+            case method::TRACE:
+            case method::PUT:
+            case method::DELETE:
+                return true;
+            default:
+                return false;
+        }
+    }
+
     method request::get_method() const {
         return _method;
     }
@@ -124,6 +138,19 @@ namespace proxy::tcp::http {
         return out.str();
     }
 
+    void request::write_head(std::ostream &out) const {
+        out << _method << ' ';
+        out << target << ' ';
+        out << _version;
+        out << CRLF;
+        write_headers(out);
+    }
+
+    message::body_buffers request::serialize(std::ostream &out) const {
+        write_head(out);
+        return write_body(out);
+    }
+
     std::ostream &operator<<(std::ostream &out, const request &req) {
         out << req._method << ' ';
         out << req.target << ' ';
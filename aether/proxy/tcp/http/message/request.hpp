@@ -85,6 +85,24 @@ namespace proxy::tcp::http {
         */
         void set_cookies(const cookie_collection &cookies);
 
+        /*
+            Tests if the request method is idempotent, meaning the request can be safely sent again
+                if the connection fails before a response arrives.
+        */
+        bool is_idempotent() const;
+
+        /*
+            Writes the request line and headers only.
+            Used when the body is forwarded separately.
+        */
+        void write_head(std::ostream &out) const;
+
+        /*
+            Writes the whole request for a gathered write, without copying a large body.
+            Returns the buffers that must be written after the stream's contents.
+        */
+        body_buffers serialize(std::ostream &out) const;
+
         method get_method() const;
         const url &get_target() const;
         std::string get_host_name() const;
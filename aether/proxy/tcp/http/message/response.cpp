@@ -69,6 +69,15 @@ namespace proxy::tcp::http {
         return has_header("Set-Cookie");
     }
 
+    bool response::is_event_stream() const {
+        auto content_type = headers.find(header_id::content_type);
+        if (!content_type.has_value()) {
+            return false;
+        }
+        // Ignore parameters such as charset
+        return util::string::iequals_fn(content_type->substr(0, event_stream_type.length()), event_stream_type);
+    }
+
     cookie_collection response::get_cookies() const {
         std::vector<std::string> cookie_headers = get_all_of_header("Set-Cookie");
         cookie_collection cookies;
@@ -88,6 +97,19 @@ namespace proxy::tcp::http {
         }
     }
 
+    void response::write_head(std::ostream &out) const {
+        out << _version << ' ';
+        out << status_code << ' ';
+        out << convert::status_to_reason(status_code);
+        out << CRLF;
+        write_headers(out);
+    }
+
+    message::body_buffers response::serialize(std::ostream &out) const {
+        write_head(out);
+        return write_body(out);
+    }
+
     std::ostream &operator<<(std::ostream &out, const response &res) {
         out << res._version << ' ';
         out << res.status_code << ' ';
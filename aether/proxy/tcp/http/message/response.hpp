@@ -18,6 +18,8 @@ namespace proxy::tcp::http {
     class response 
         : public message {
     private:
+        static constexpr std::string_view event_stream_type = "text/event-stream";
+
         status status_code;
 
     public:
@@ -42,6 +44,11 @@ namespace proxy::tcp::http {
         */
         bool has_cookies() const;
 
+        /*
+            Returns if the response is a stream of server-sent events.
+        */
+        bool is_event_stream() const;
+
         /*
             Parses and returns the cookies attached to all Set-Cookie headers.
         */
@@ -53,6 +60,18 @@ namespace proxy::tcp::http {
         */
         void set_cookies(const cookie_collection &cookies);
 
+        /*
+            Writes the status line and headers only.
+            Used when the body is forwarded separately.
+        */
+        void write_head(std::ostream &out) const;
+
+        /*
+            Writes the whole response for a gathered write, without copying a large body.
+            Returns the buffers that must be written after the stream's contents.
+        */
+        body_buffers serialize(std::ostream &out) const;
+
         friend std::ostream &operator<<(std::ostream &out, const response &res);
     };
 }
\ No newline at end of file
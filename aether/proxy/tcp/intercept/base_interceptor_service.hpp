@@ -103,6 +103,14 @@ namespace proxy::tcp::intercept {
                 }
             }
 
+            /*
+                Checks if any interceptor is attached to the event.
+            */
+            bool has_interceptors(Event ev) const {
+                auto events = interceptors.find(ev);
+                return events != interceptors.end() && !events->second.empty();
+            }
+
             void run(Event ev, Args... args) const {
                 auto events = interceptors.find(ev);
                 if (events != interceptors.end()) {
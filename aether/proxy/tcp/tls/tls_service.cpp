@@ -7,6 +7,8 @@
 
 #include "tls_service.hpp"
 #include <aether/proxy/connection_handler.hpp>
+#include <aether/proxy/tcp/http/http2/http2_service.hpp>
+#include <aether/proxy/tcp/http/http2/session_pool.hpp>
 
 namespace proxy::tcp::tls {
     std::unique_ptr<x509::client_store> tls_service::client_store;
@@ -103,6 +105,25 @@ namespace proxy::tcp::tls {
     }
 
     void tls_service::connect_server() {
+        make_ssl_client_context_args();
+
+        // A shared HTTP/2 connection to the server skips the connect, and requests are sent on it later
+        if (program::options::instance().http2_upstream) {
+            auto session = boost::asio::use_service<http::http2::session_pool>(ioc).find(flow.secure_server_key(*ssl_client_context_args));
+            if (session && session->connected()) {
+                flow.upstream_session = session;
+                establish_tls_with_client();
+                return;
+            }
+        }
+
+        // An idle connection secured with the same parameters skips both the connect and the handshake
+        if (flow.reuse_secure_server(*ssl_client_context_args)) {
+            interceptors.server.run(intercept::server_event::connect, flow);
+            establish_tls_with_client();
+            return;
+        }
+
         connect_server_async(boost::bind(&tls_service::on_connect_server, this, 
             boost::asio::placeholders::error));
     }
@@ -121,7 +142,7 @@ namespace proxy::tcp::tls {
         }
     }
 
-    void tls_service::establish_tls_with_server() {
+    void tls_service::make_ssl_client_context_args() {
         if (!client_hello_msg) {
             throw error::tls::tls_service_error_exception { "Must parse Client Hello message before establishing TLS with server" };
         }
@@ -142,7 +163,7 @@ namespace proxy::tcp::tls {
                 [](const std::string &protocol) {
                     return !((protocol.rfind("h2-") == 0) || (protocol == "SPDY"));
                 });
-            // TODO: Remove this line once HTTP 2 is supported
+            // HTTP/2 is only spoken with the client, requests are sent to the server over HTTP/1.1
             ssl_client_context_args->alpn_protos.erase(std::remove(ssl_client_context_args->alpn_protos.begin(), ssl_client_context_args->alpn_protos.end(), "h2"), ssl_client_context_args->alpn_protos.end());
         }
         // Set default ALPN
@@ -155,6 +176,15 @@ namespace proxy::tcp::tls {
             ssl_client_context_args->alpn_protos.clear();
             ssl_client_context_args->alpn_protos.push_back(flow.client.get_alpn());
         }
+        // Requests from clients that are not served HTTP/2 themselves can share an HTTP/2 connection to the server
+        else if (program::options::instance().http2_upstream) {
+            auto &protos = ssl_client_context_args->alpn_protos;
+            bool client_http2 = program::options::instance().http2 && client_hello_msg->has_alpn_extension()
+                && std::find(client_hello_msg->alpn.begin(), client_hello_msg->alpn.end(), http2_alpn) != client_hello_msg->alpn.end();
+            if (!client_http2 && std::find(protos.begin(), protos.end(), default_alpn) != protos.end()) {
+                protos.emplace(protos.begin(), http2_alpn);
+            }
+        }
 
         if (!program::options::instance().ssl_negotiate_ciphers) {
             // Use only ciphers we have named with the server
@@ -163,7 +193,9 @@ namespace proxy::tcp::tls {
                     return handshake::is_valid(cipher);
                 });
         }
+    }
 
+    void tls_service::establish_tls_with_server() {
         flow.establish_tls_with_server_async(*ssl_client_context_args, boost::bind(&tls_service::on_establish_tls_with_server, this,
             boost::asio::placeholders::error));
     }
@@ -178,6 +210,10 @@ namespace proxy::tcp::tls {
             establish_tls_with_client();
         }
         else {
+            // The connection is shared with other flows, and this flow's requests are sent on it as well
+            if (flow.server.get_alpn() == http2_alpn) {
+                flow.upstream_session = boost::asio::use_service<http::http2::session_pool>(ioc).adopt(flow.server, *ssl_client_context_args);
+            }
             establish_tls_with_client();
         }
     }
@@ -193,9 +229,22 @@ namespace proxy::tcp::tls {
         std::string &&protos = { reinterpret_cast<const char *>(in), inlen };
         std::size_t pos = 0;
 
+        // Offer HTTP/2 to the client whenever the server speaks HTTP/1.1, since the proxy translates between them
+        std::string_view server_alpn = arg != nullptr ? reinterpret_cast<const char *>(arg) : "";
+        if (program::options::instance().http2 && (server_alpn.empty() || server_alpn == tls_service::default_alpn)) {
+            // Protocols are length-prefixed, so the list is walked rather than searched
+            for (unsigned int i = 0; i < inlen; i += in[i] + 1) {
+                std::string_view protocol { reinterpret_cast<const char *>(in + i + 1), std::min<unsigned int>(in[i], inlen - i - 1) };
+                if (protocol == tls_service::http2_alpn) {
+                    *out = in + i + 1;
+                    *outlen = in[i];
+                    return SSL_TLSEXT_ERR_OK;
+                }
+            }
+        }
+
         // Use ALPN already negotiated
         if (arg != nullptr) {
-            std::string &&server_alpn = reinterpret_cast<const char *>(arg);
             if ((pos = protos.find(server_alpn)) != std::string::npos) {
                 *out = in + pos;
                 *outlen = static_cast<unsigned int>(server_alpn.length());
@@ -231,7 +280,9 @@ namespace proxy::tcp::tls {
                     default_client_ciphers,
                     { },
                     alpn_select_callback,
-                    flow.server.secured() ? flow.server.get_alpn() : std::optional<std::string> { }
+                    // Requests on a shared HTTP/2 connection are translated from HTTP/1.1
+                    flow.upstream_session ? std::string(default_alpn)
+                        : flow.server.secured() ? flow.server.get_alpn() : std::optional<std::string> { }
                 },
                 cert.cert,
                 cert.pkey,
@@ -239,8 +290,13 @@ namespace proxy::tcp::tls {
             }
         );
 
-        if (program::options::instance().ssl_supply_server_chain_to_client && flow.server.connected() && flow.server.secured()) {
-            ssl_server_context_args->cert_chain = flow.server.get_cert_chain();
+        if (program::options::instance().ssl_supply_server_chain_to_client) {
+            if (flow.upstream_session) {
+                ssl_server_context_args->cert_chain = flow.upstream_session->get_cert_chain();
+            }
+            else if (flow.server.connected() && flow.server.secured()) {
+                ssl_server_context_args->cert_chain = flow.server.get_cert_chain();
+            }
         }
 
         flow.establish_tls_with_client_async(*ssl_server_context_args, boost::bind(&tls_service::on_establish_tls_with_client, this,
@@ -251,13 +307,13 @@ namespace proxy::tcp::tls {
         // Information that may be needed for the client certificate
         x509::certificate_interface cert_interface;
 
-        if (flow.server.connected()) {
+        if (flow.server.connected() || flow.upstream_session) {
             // Always use host as the common name
-            cert_interface.common_name = flow.server.get_host();
+            cert_interface.common_name = flow.upstream_session ? flow.upstream_session->get_host() : flow.server.get_host();
 
             // TLS is established, use certificate data
-            if (flow.server.secured()) {
-                auto cert = flow.server.get_cert();
+            if (flow.upstream_session || flow.server.secured()) {
+                auto cert = flow.upstream_session ? flow.upstream_session->get_cert() : flow.server.get_cert();
                 auto cert_sans = cert.sans();
                 std::copy(cert_sans.begin(), cert_sans.end(), std::inserter(cert_interface.sans, cert_interface.sans.end()));
 
@@ -310,7 +366,11 @@ namespace proxy::tcp::tls {
             // TLS is successfully established within the connection objects
             interceptors.tls.run(intercept::tls_event::established, flow);
             std::string alpn = flow.client.get_alpn();
-            if (alpn == "http/1.1" || alpn.empty()) {
+            if (alpn == tls_service::http2_alpn) {
+                // Any TLS errors are reported on each stream by the HTTP/2 service
+                owner.switch_service<http::http2::http2_service>(*ssl_client_context_args);
+            }
+            else if (alpn == "http/1.1" || alpn.empty()) {
                 // Any TLS errors are reported to the client by the HTTP service
                 owner.switch_service<http::http1::http_service>();
             }
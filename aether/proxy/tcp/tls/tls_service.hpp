@@ -25,6 +25,7 @@ namespace proxy::tcp::tls {
         : public base_service {
     public:
         static constexpr std::string_view default_alpn = "http/1.1";
+        static constexpr std::string_view http2_alpn = "h2";
         static const std::vector<handshake::cipher_suite_name> default_client_ciphers;
 
     private:
@@ -42,6 +43,11 @@ namespace proxy::tcp::tls {
 
         void connect_server();
         void on_connect_server(const boost::system::error_code &error);
+
+        /*
+            Builds the TLS parameters for the server connection from the client's Client Hello.
+        */
+        void make_ssl_client_context_args();
         void establish_tls_with_server();
         void on_establish_tls_with_server(const boost::system::error_code &error);
         
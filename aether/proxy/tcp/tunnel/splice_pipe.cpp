@@ -0,0 +1,115 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "splice_pipe.hpp"
+
+#ifdef __linux__
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace proxy::tcp::tunnel {
+    splice_pipe::splice_pipe()
+        : read_end(-1),
+        write_end(-1),
+        buffered(0)
+    { }
+
+    splice_pipe::~splice_pipe() {
+        close();
+    }
+
+    bool splice_pipe::is_open() const {
+        return read_end != -1;
+    }
+
+    std::size_t splice_pipe::size() const {
+        return buffered;
+    }
+
+#ifdef __linux__
+    namespace {
+        boost::system::error_code last_error() {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return boost::asio::error::would_block;
+            }
+            return boost::system::error_code(errno, boost::system::system_category());
+        }
+    }
+
+    void splice_pipe::open(boost::system::error_code &error) {
+        close();
+        int fds[2];
+        if (::pipe2(fds, O_NONBLOCK | O_CLOEXEC) == -1) {
+            error = last_error();
+            return;
+        }
+        read_end = fds[0];
+        write_end = fds[1];
+        error = boost::system::errc::make_error_code(boost::system::errc::success);
+    }
+
+    void splice_pipe::close() {
+        if (read_end != -1) {
+            ::close(read_end);
+            ::close(write_end);
+            read_end = -1;
+            write_end = -1;
+        }
+        buffered = 0;
+    }
+
+    std::size_t splice_pipe::fill(native_handle socket_fd, boost::system::error_code &error) {
+        ssize_t moved = ::splice(socket_fd, nullptr, write_end, nullptr, chunk_size, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (moved < 0) {
+            error = last_error();
+            return 0;
+        }
+        else if (moved == 0) {
+            error = boost::asio::error::eof;
+            return 0;
+        }
+        buffered += static_cast<std::size_t>(moved);
+        error = boost::system::errc::make_error_code(boost::system::errc::success);
+        return static_cast<std::size_t>(moved);
+    }
+
+    std::size_t splice_pipe::drain(native_handle socket_fd, boost::system::error_code &error) {
+        std::size_t total = 0;
+        while (buffered > 0) {
+            ssize_t moved = ::splice(read_end, nullptr, socket_fd, nullptr, buffered, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (moved <= 0) {
+                error = moved < 0 ? last_error() : boost::asio::error::eof;
+                return total;
+            }
+            buffered -= static_cast<std::size_t>(moved);
+            total += static_cast<std::size_t>(moved);
+        }
+        error = boost::system::errc::make_error_code(boost::system::errc::success);
+        return total;
+    }
+#else
+    void splice_pipe::open(boost::system::error_code &error) {
+        error = boost::asio::error::operation_not_supported;
+    }
+
+    void splice_pipe::close() {
+        buffered = 0;
+    }
+
+    std::size_t splice_pipe::fill(native_handle, boost::system::error_code &error) {
+        error = boost::asio::error::operation_not_supported;
+        return 0;
+    }
+
+    std::size_t splice_pipe::drain(native_handle, boost::system::error_code &error) {
+        error = boost::asio::error::operation_not_supported;
+        return 0;
+    }
+#endif
+}
\ No newline at end of file
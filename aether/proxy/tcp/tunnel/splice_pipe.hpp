@@ -0,0 +1,75 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace proxy::tcp::tunnel {
+    /*
+        Kernel pipe used to move bytes between two sockets with splice().
+        Data goes from the source socket into the pipe and from the pipe into the destination socket
+            without ever being copied into user space.
+        Only available on Linux. On other platforms, is_supported() is always false.
+    */
+    class splice_pipe
+        : private boost::noncopyable {
+    public:
+        using native_handle = boost::asio::ip::tcp::socket::native_handle_type;
+
+        // Maximum number of bytes moved into the pipe at once
+        static constexpr std::size_t chunk_size = 64 * 1024;
+
+    private:
+        int read_end;
+        int write_end;
+        std::size_t buffered;
+
+    public:
+        splice_pipe();
+        ~splice_pipe();
+
+        static constexpr bool is_supported() {
+#ifdef __linux__
+            return true;
+#else
+            return false;
+#endif
+        }
+
+        /*
+            Creates the underlying pipe.
+        */
+        void open(boost::system::error_code &error);
+
+        /*
+            Closes the underlying pipe, dropping any data left in it.
+        */
+        void close();
+
+        bool is_open() const;
+
+        /*
+            Moves up to chunk_size bytes from the socket into the pipe.
+            Sets error to eof if the socket has been closed and to would_block if there is nothing to read.
+        */
+        std::size_t fill(native_handle socket_fd, boost::system::error_code &error);
+
+        /*
+            Moves as many buffered bytes as possible from the pipe into the socket.
+            Sets error to would_block if the socket cannot accept any more data.
+        */
+        std::size_t drain(native_handle socket_fd, boost::system::error_code &error);
+
+        /*
+            Returns the number of bytes sitting in the pipe.
+        */
+        std::size_t size() const;
+    };
+}
\ No newline at end of file
@@ -6,56 +6,243 @@
 *********************************************/
 
 #include "tunnel_loop.hpp"
+#include <aether/program/options.hpp>
 
 namespace proxy::tcp::tunnel {
+    std::atomic<std::uint64_t> tunnel_loop::total_bytes { 0 };
+
     tunnel_loop::tunnel_loop(connection::base_connection &source, connection::base_connection &destination)
         : source(source),
-        destination(destination)
+        destination(destination),
+        is_finished(false),
+        bytes(0),
+        pipe(),
+        use_splice(false),
+        ring(),
+        read_size(0),
+        high_watermark(0),
+        low_watermark(0),
+        reading(false),
+        writing(false),
+        paused(false),
+        source_closed(false),
+        failed(false)
     { }
 
     void tunnel_loop::start(const callback &handler) {
         on_finished = handler;
         is_finished = false;
+        bytes = 0;
+        use_splice = try_splice();
         source.set_mode(connection::base_connection::io_mode::tunnel);
         // We write first in case something is waiting to be sent before any reads can occur
         // If there is no data to send, the write method returns immediately
-        write();
+        flush();
     }
 
-    void tunnel_loop::read() {
-        source.read_async(boost::bind(&tunnel_loop::on_read, this,
+    void tunnel_loop::flush() {
+        destination.output_stream() << source.input_stream().rdbuf();
+        // No timeout because there is a timeout on the read operation already
+        // Timeout cancels ALL socket operations
+        // Attempting to use the same timeout service will cause the latter operation to never timeout
+        destination.write_untimed_async(boost::bind(&tunnel_loop::on_flush, this,
             boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
     }
 
-    void tunnel_loop::on_read(const boost::system::error_code &error, std::size_t bytes_transferred) {
+    void tunnel_loop::on_flush(const boost::system::error_code &error, std::size_t bytes_transferred) {
         if (error != boost::system::errc::success) {
             finish();
         }
         else {
-            write();
+            count(bytes_transferred);
+            if (use_splice) {
+                read();
+            }
+            else {
+                start_relay();
+            }
         }
     }
 
-    void tunnel_loop::write() {
-        destination.output_stream() << source.input_stream().rdbuf();
-        // No timeout because there is a timeout on the read operation already
-        // Timeout cancels ALL socket operations
-        // Attempting to use the same timeout service will cause the latter operation to never timeout
-        destination.write_untimed_async(boost::bind(&tunnel_loop::on_write, this,
+    bool tunnel_loop::try_splice() {
+        if (!splice_pipe::is_supported() || !program::options::instance().tunnel_splice
+            || source.secured() || destination.secured()) {
+            return false;
+        }
+
+        boost::system::error_code error;
+        pipe.open(error);
+        if (error != boost::system::errc::success) {
+            return false;
+        }
+
+        // splice() must never block the io_context
+        source.get_socket().native_non_blocking(true, error);
+        if (error == boost::system::errc::success) {
+            destination.get_socket().native_non_blocking(true, error);
+        }
+        if (error != boost::system::errc::success) {
+            pipe.close();
+            return false;
+        }
+        return true;
+    }
+
+    void tunnel_loop::read() {
+        source.wait_readable_async(boost::bind(&tunnel_loop::on_readable, this,
             boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
     }
 
-    void tunnel_loop::on_write(const boost::system::error_code &error, std::size_t bytes_transferred) {
+    void tunnel_loop::on_readable(const boost::system::error_code &error, std::size_t bytes_transferred) {
         if (error != boost::system::errc::success) {
             finish();
+            return;
+        }
+
+        boost::system::error_code splice_error;
+        pipe.fill(source.get_socket().native_handle(), splice_error);
+        if (splice_error == boost::asio::error::would_block) {
+            read();
+        }
+        else if (splice_error == boost::asio::error::invalid_argument && bytes == 0) {
+            // The kernel cannot splice this socket, fall back to relaying through a buffer
+            pipe.close();
+            use_splice = false;
+            start_relay();
+        }
+        else if (splice_error != boost::system::errc::success) {
+            finish();
+        }
+        else {
+            drain();
+        }
+    }
+
+    void tunnel_loop::drain() {
+        boost::system::error_code error;
+        count(pipe.drain(destination.get_socket().native_handle(), error));
+        if (error == boost::asio::error::would_block) {
+            destination.wait_writable_async(boost::bind(&tunnel_loop::on_writable, this,
+                boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+        }
+        else if (error != boost::system::errc::success) {
+            finish();
         }
         else {
             read();
         }
     }
 
+    void tunnel_loop::on_writable(const boost::system::error_code &error, std::size_t bytes_transferred) {
+        if (error != boost::system::errc::success) {
+            finish();
+        }
+        else {
+            drain();
+        }
+    }
+
+    void tunnel_loop::start_relay() {
+        const auto &options = program::options::instance();
+        if (!ring || ring->capacity() != options.tunnel_buffer_size) {
+            ring.emplace(options.tunnel_buffer_size);
+        }
+        else {
+            ring->clear();
+        }
+
+        read_size = options.tunnel_read_size;
+        high_watermark = ring->capacity() - ring->capacity() / 4;
+        low_watermark = ring->capacity() / 4;
+        reading = false;
+        writing = false;
+        paused = false;
+        source_closed = false;
+        failed = false;
+        pump();
+    }
+
+    void tunnel_loop::pump() {
+        write_more();
+        read_more();
+    }
+
+    void tunnel_loop::read_more() {
+        if (reading || paused || source_closed || failed) {
+            return;
+        }
+
+        // Backpressure: let the destination catch up before reading more
+        if (ring->size() >= high_watermark) {
+            paused = true;
+            return;
+        }
+
+        auto buffer = ring->prepare(read_size);
+        if (buffer.size() == 0) {
+            paused = true;
+            return;
+        }
+
+        reading = true;
+        source.read_async(buffer, boost::bind(&tunnel_loop::on_relay_read, this,
+            boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+    }
+
+    void tunnel_loop::on_relay_read(const boost::system::error_code &error, std::size_t bytes_transferred) {
+        reading = false;
+        ring->commit(bytes_transferred);
+        if (error != boost::system::errc::success) {
+            // Whatever is still buffered is written before the loop finishes
+            source_closed = true;
+        }
+        pump();
+        finish_if_done();
+    }
+
+    void tunnel_loop::write_more() {
+        if (writing || failed || ring->empty()) {
+            return;
+        }
+
+        writing = true;
+        destination.write_untimed_async(ring->data(), boost::bind(&tunnel_loop::on_relay_write, this,
+            boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+    }
+
+    void tunnel_loop::on_relay_write(const boost::system::error_code &error, std::size_t bytes_transferred) {
+        writing = false;
+        ring->consume(bytes_transferred);
+        count(bytes_transferred);
+        if (error != boost::system::errc::success) {
+            failed = true;
+            // Nothing more can be delivered, so stop waiting on the source
+            if (reading) {
+                boost::system::error_code cancel_error;
+                source.cancel(cancel_error);
+            }
+        }
+        else if (paused && ring->size() <= low_watermark) {
+            paused = false;
+        }
+        pump();
+        finish_if_done();
+    }
+
+    void tunnel_loop::finish_if_done() {
+        if (!reading && !writing && (failed || (source_closed && ring->empty()))) {
+            finish();
+        }
+    }
+
+    void tunnel_loop::count(std::size_t bytes_transferred) {
+        bytes += bytes_transferred;
+        total_bytes.fetch_add(bytes_transferred, std::memory_order_relaxed);
+    }
+
     void tunnel_loop::finish() {
         source.set_mode(connection::base_connection::io_mode::regular);
+        pipe.close();
         is_finished = true;
         on_finished();
     }
@@ -63,4 +250,12 @@ namespace proxy::tcp::tunnel {
     bool tunnel_loop::finished() const {
         return is_finished;
     }
+
+    std::uint64_t tunnel_loop::bytes_transferred() const {
+        return bytes;
+    }
+
+    std::uint64_t tunnel_loop::total_bytes_transferred() {
+        return total_bytes.load(std::memory_order_relaxed);
+    }
 }
\ No newline at end of file
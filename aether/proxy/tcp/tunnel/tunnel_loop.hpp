@@ -7,30 +7,89 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <optional>
+
 #include <aether/util/buffer_segment.hpp>
+#include <aether/util/ring_buffer.hpp>
 #include <aether/proxy/connection/base_connection.hpp>
+#include <aether/proxy/tcp/tunnel/splice_pipe.hpp>
 
 namespace proxy::tcp::tunnel {
     /*
-        Implements an asynchronous read/write loop from one connection to another.
+        Implements an asynchronous relay from one connection to another.
         Connections must outlive any tunnel loop it is connected to.
+        When neither connection has TLS established, bytes are moved with splice() where supported,
+            so they never pass through the connection buffers.
+        Otherwise, bytes go through a fixed-size ring buffer. Reads continue while a write is in flight,
+            and stop while the buffer is above its high watermark until writes drain it below the low watermark.
     */
     class tunnel_loop {
     private:
+        static std::atomic<std::uint64_t> total_bytes;
+
         connection::base_connection &source;
         connection::base_connection &destination;
         callback on_finished;
         bool is_finished;
+        std::uint64_t bytes;
 
-        void read();
-        void on_read(const boost::system::error_code &error, std::size_t bytes_transferred);
-        void write();
-        void on_write(const boost::system::error_code &error, std::size_t bytes_transferred);
+        splice_pipe pipe;
+        bool use_splice;
+
+        std::optional<util::buffer::ring_buffer> ring;
+        std::size_t read_size;
+        std::size_t high_watermark;
+        std::size_t low_watermark;
+        bool reading;
+        bool writing;
+        bool paused;
+        bool source_closed;
+        bool failed;
+
+        /*
+            Writes anything left in the source's input buffer before relaying begins.
+        */
+        void flush();
+        void on_flush(const boost::system::error_code &error, std::size_t bytes_transferred);
         void finish();
+        void count(std::size_t bytes_transferred);
+
+        /*
+            Opens the splice pipe if the connections and platform allow it.
+        */
+        bool try_splice();
+        void read();
+        void on_readable(const boost::system::error_code &error, std::size_t bytes_transferred);
+        void drain();
+        void on_writable(const boost::system::error_code &error, std::size_t bytes_transferred);
+
+        void start_relay();
+
+        /*
+            Starts a read and a write if they are not already in flight and the buffer allows them.
+        */
+        void pump();
+        void read_more();
+        void on_relay_read(const boost::system::error_code &error, std::size_t bytes_transferred);
+        void write_more();
+        void on_relay_write(const boost::system::error_code &error, std::size_t bytes_transferred);
+        void finish_if_done();
 
     public:
         tunnel_loop(connection::base_connection &source, connection::base_connection &destination);
         void start(const callback &handler);
         bool finished() const;
+
+        /*
+            Returns the number of bytes written to the destination by this loop.
+        */
+        std::uint64_t bytes_transferred() const;
+
+        /*
+            Returns the number of bytes written by all tunnel loops.
+        */
+        static std::uint64_t total_bytes_transferred();
     };
 }
\ No newline at end of file
@@ -200,6 +200,8 @@ namespace util::buffer {
     void buffer_segment::read_all(std::streambuf &in) {
         if (!is_complete) {
             std::copy(std::istreambuf_iterator<char>(&in), std::istreambuf_iterator<char>(), std::back_inserter(buffer));
+            num_bytes_read_last = buffer.size() - bytes_in_buffer;
+            bytes_in_buffer = buffer.size();
             is_complete = true;
             commit_buffer();
         }
@@ -207,7 +209,10 @@ namespace util::buffer {
 
     void buffer_segment::read_all(std::istream &in) {
         if (!is_complete) {
-            std::copy(std::istream_iterator<char>(in), std::istream_iterator<char>(), std::back_inserter(buffer));
+            // istream_iterator would skip whitespace
+            std::copy(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>(), std::back_inserter(buffer));
+            num_bytes_read_last = buffer.size() - bytes_in_buffer;
+            bytes_in_buffer = buffer.size();
             is_complete = true;
             commit_buffer();
         }
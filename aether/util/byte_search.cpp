@@ -0,0 +1,109 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "byte_search.hpp"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define UTIL_BYTES_X86_64
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC allows AVX2 intrinsics in any function, the CPU is checked before they are used
+#define UTIL_BYTES_TARGET_AVX2
+#else
+#define UTIL_BYTES_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace util::bytes {
+    namespace {
+        const char *find_scalar(const char *begin, const char *end, char target) {
+            for (; begin != end; ++begin) {
+                if (*begin == target) {
+                    return begin;
+                }
+            }
+            return end;
+        }
+
+#ifdef UTIL_BYTES_X86_64
+        inline unsigned int first_set_bit(unsigned int mask) {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward(&index, mask);
+            return static_cast<unsigned int>(index);
+#else
+            return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+        }
+
+        // SSE2 is part of every x86-64 CPU
+        const char *find_sse2(const char *begin, const char *end, char target) {
+            const __m128i needle = _mm_set1_epi8(target);
+            while (end - begin >= 16) {
+                __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(begin));
+                unsigned int mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)));
+                if (mask != 0) {
+                    return begin + first_set_bit(mask);
+                }
+                begin += 16;
+            }
+            return find_scalar(begin, end, target);
+        }
+
+        UTIL_BYTES_TARGET_AVX2
+        const char *find_avx2(const char *begin, const char *end, char target) {
+            const __m256i needle = _mm256_set1_epi8(target);
+            while (end - begin >= 32) {
+                __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(begin));
+                unsigned int mask = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)));
+                if (mask != 0) {
+                    return begin + first_set_bit(mask);
+                }
+                begin += 32;
+            }
+            return find_sse2(begin, end, target);
+        }
+
+        bool cpu_has_avx2() {
+#ifdef _MSC_VER
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] < 7) {
+                return false;
+            }
+            // The OS must also save the AVX registers on context switches
+            __cpuid(info, 1);
+            bool os_saves_avx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0
+                && (_xgetbv(0) & 0x6) == 0x6;
+            if (!os_saves_avx) {
+                return false;
+            }
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+#else
+            return __builtin_cpu_supports("avx2");
+#endif
+        }
+#endif
+
+        using find_function = const char *(*)(const char *, const char *, char);
+
+        find_function select_find() {
+#ifdef UTIL_BYTES_X86_64
+            return cpu_has_avx2() ? find_avx2 : find_sse2;
+#else
+            return find_scalar;
+#endif
+        }
+    }
+
+    const char *find(const char *begin, const char *end, char target) {
+        static const find_function implementation = select_find();
+        return implementation(begin, end, target);
+    }
+}
\ No newline at end of file
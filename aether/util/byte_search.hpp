@@ -0,0 +1,22 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <cstddef>
+
+// Vectorized searches over raw bytes
+
+namespace util::bytes {
+    /*
+        Finds the first occurrence of the target byte in the range.
+        Returns end if the byte is not found.
+        Compares 32 bytes at a time with AVX2 if the CPU supports it, 16 bytes at a time with SSE2 otherwise,
+            and falls back to a plain loop on other architectures.
+    */
+    const char *find(const char *begin, const char *end, char target);
+}
\ No newline at end of file
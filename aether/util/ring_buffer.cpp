@@ -0,0 +1,65 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#include "ring_buffer.hpp"
+
+#include <algorithm>
+
+namespace util::buffer {
+    ring_buffer::ring_buffer(std::size_t capacity)
+        : storage(capacity),
+        head(0),
+        length(0)
+    { }
+
+    std::size_t ring_buffer::capacity() const {
+        return storage.size();
+    }
+
+    std::size_t ring_buffer::size() const {
+        return length;
+    }
+
+    std::size_t ring_buffer::free() const {
+        return storage.size() - length;
+    }
+
+    bool ring_buffer::empty() const {
+        return length == 0;
+    }
+
+    bool ring_buffer::full() const {
+        return length == storage.size();
+    }
+
+    boost::asio::mutable_buffer ring_buffer::prepare(std::size_t max_size) {
+        std::size_t tail = (head + length) % storage.size();
+        // Free space either runs to the end of storage or up to the head
+        std::size_t contiguous = tail >= head && length != storage.size() ? storage.size() - tail : free();
+        return boost::asio::buffer(storage.data() + tail, std::min(contiguous, max_size));
+    }
+
+    void ring_buffer::commit(std::size_t bytes) {
+        length += std::min(bytes, free());
+    }
+
+    boost::asio::const_buffer ring_buffer::data() const {
+        std::size_t contiguous = std::min(length, storage.size() - head);
+        return boost::asio::buffer(storage.data() + head, contiguous);
+    }
+
+    void ring_buffer::consume(std::size_t bytes) {
+        bytes = std::min(bytes, length);
+        head = (head + bytes) % storage.size();
+        length -= bytes;
+    }
+
+    void ring_buffer::clear() {
+        head = 0;
+        length = 0;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+/*********************************************
+
+    Copyright (c) Jackson Nestelroad 2020
+    jackson.nestelroad.com
+
+*********************************************/
+
+#pragma once
+
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace util::buffer {
+    /*
+        Fixed-capacity circular byte buffer for relaying data between sockets.
+        One side fills free space while the other drains data, so a read and a write
+            may be in flight at the same time on different regions of the buffer.
+        Regions are exposed one contiguous piece at a time.
+    */
+    class ring_buffer
+        : private boost::noncopyable {
+    private:
+        std::vector<char> storage;
+        std::size_t head;
+        std::size_t length;
+
+    public:
+        explicit ring_buffer(std::size_t capacity);
+
+        std::size_t capacity() const;
+        std::size_t size() const;
+        std::size_t free() const;
+        bool empty() const;
+        bool full() const;
+
+        /*
+            Returns the largest contiguous region of free space, up to max_size bytes.
+        */
+        boost::asio::mutable_buffer prepare(std::size_t max_size);
+
+        /*
+            Marks bytes written into the region returned by prepare() as data.
+        */
+        void commit(std::size_t bytes);
+
+        /*
+            Returns the largest contiguous region of data.
+        */
+        boost::asio::const_buffer data() const;
+
+        /*
+            Removes bytes from the front of the data.
+            Never moves the free region, so a read into prepared space may still be in flight.
+        */
+        void consume(std::size_t bytes);
+
+        /*
+            Drops all data. Capacity is unchanged.
+        */
+        void clear();
+    };
+}
\ No newline at end of file